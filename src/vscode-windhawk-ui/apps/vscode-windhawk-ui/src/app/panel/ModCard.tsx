@@ -1,6 +1,15 @@
-import { faUser } from '@fortawesome/free-solid-svg-icons';
+import { faStopwatch, faUser } from '@fortawesome/free-solid-svg-icons';
 import { FontAwesomeIcon } from '@fortawesome/react-fontawesome';
-import { Badge, Button, Card, Divider, Rate, Switch, Tooltip } from 'antd';
+import {
+  Badge,
+  Button,
+  Card,
+  Divider,
+  Rate,
+  Switch,
+  Tooltip,
+  Typography,
+} from 'antd';
 import { useTranslation } from 'react-i18next';
 import styled, { css } from 'styled-components';
 import { PopconfirmModal } from '../components/InputWithContextMenu';
@@ -60,6 +69,13 @@ const ModLocalIcon = styled.img`
   cursor: help;
 `;
 
+const ModCardStartupCost = styled(Typography.Text)`
+  display: block;
+  width: fit-content;
+  margin-top: 12px;
+  cursor: help;
+`;
+
 const ModCardActionsContainer = styled.div`
   display: flex;
   align-items: center;
@@ -106,6 +122,11 @@ interface Props {
     users: number;
     rating: number;
   };
+  startupCost?: {
+    text: string;
+    tooltip?: string;
+    overBudget: boolean;
+  };
 }
 
 function ModCard(props: Props) {
@@ -134,6 +155,15 @@ function ModCard(props: Props) {
             }
             description={props.description || <i>{t('mod.noDescription')}</i>}
           />
+          {props.startupCost && (
+            <Tooltip title={props.startupCost.tooltip} placement="bottom">
+              <ModCardStartupCost
+                type={props.startupCost.overBudget ? 'warning' : 'secondary'}
+              >
+                <FontAwesomeIcon icon={faStopwatch} /> {props.startupCost.text}
+              </ModCardStartupCost>
+            </Tooltip>
+          )}
           <ModCardActionsContainer>
             {props.buttons.map((button, i) =>
               button.confirmText ? (
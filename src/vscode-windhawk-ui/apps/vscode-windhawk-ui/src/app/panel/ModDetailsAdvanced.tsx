@@ -1,4 +1,4 @@
-import { Alert, Button, Dropdown, List, message, Select, Space, Switch } from 'antd';
+import { Alert, Button, Dropdown, List, message, Select, Space, Switch, Table, Typography } from 'antd';
 import { useCallback, useEffect, useState } from 'react';
 import { Trans, useTranslation } from 'react-i18next';
 import styled from 'styled-components';
@@ -7,9 +7,12 @@ import {
   showAdvancedDebugLogOutput,
   useGetModConfig,
   useGetModSettings,
+  useGetModsStartupCost,
   useSetModSettings,
   useUpdateModConfig,
+  useUpdateModsStartupCost,
 } from '../webviewIPC';
+import { ModStartupCost, ModStartupCostProcess } from '../webviewIPCMessages';
 
 const SettingsListItemMeta = styled(List.Item.Meta)`
   .ant-list-item-meta {
@@ -30,6 +33,10 @@ const SpaceWithWidth = styled(Space)`
   max-width: 600px;
 `;
 
+function formatTime(ms: number) {
+  return ms.toFixed(1) + ' ms';
+}
+
 function engineArrayToProcessList(processArray: string[]) {
   return processArray.join('\n');
 }
@@ -81,6 +88,29 @@ function ModDetailsAdvanced({ modId }: Props) {
     }, [])
   );
 
+  const [startupCost, setStartupCost] = useState<ModStartupCost | null>();
+  const [startupCostBudget, setStartupCostBudget] = useState(0);
+
+  const { getModsStartupCost, getModsStartupCostPending } =
+    useGetModsStartupCost(
+      useCallback(
+        (data) => {
+          setStartupCost(data.startupCost?.[modId] ?? null);
+          setStartupCostBudget(data.budget);
+        },
+        [modId]
+      )
+    );
+
+  useUpdateModsStartupCost(
+    useCallback(
+      (data) => {
+        setStartupCost(data.startupCost?.[modId] ?? null);
+      },
+      [modId]
+    )
+  );
+
   const { getModSettings } = useGetModSettings<{ formatted?: boolean }>(
     useCallback((data, context) => {
       setModSettingsUI(
@@ -108,7 +138,8 @@ function ModDetailsAdvanced({ modId }: Props) {
   useEffect(() => {
     getModConfig({ modId });
     getModSettings({ modId });
-  }, [getModConfig, getModSettings, modId]);
+    getModsStartupCost({});
+  }, [getModConfig, getModSettings, getModsStartupCost, modId]);
 
   const [messageApi, contextHolder] = message.useMessage();
 
@@ -388,6 +419,77 @@ function ModDetailsAdvanced({ modId }: Props) {
             }}
           />
         </List.Item>
+        <List.Item>
+          <SettingsListItemMeta
+            title={t('modDetails.advanced.startupCost.title')}
+            description={t('modDetails.advanced.startupCost.description')}
+          />
+          <SpaceWithWidth direction="vertical">
+            <Table<ModStartupCostProcess>
+              size="small"
+              pagination={false}
+              loading={getModsStartupCostPending}
+              rowKey="processId"
+              dataSource={startupCost?.processes ?? []}
+              locale={{
+                emptyText: t('modDetails.advanced.startupCost.noData'),
+              }}
+              columns={[
+                {
+                  title: t('modDetails.advanced.startupCost.process'),
+                  key: 'process',
+                  render: (_, process) =>
+                    `${process.processName} (${process.processId})`,
+                },
+                {
+                  title: t('modDetails.advanced.startupCost.load'),
+                  dataIndex: 'loadTime',
+                  render: formatTime,
+                },
+                {
+                  title: t('modDetails.advanced.startupCost.init'),
+                  dataIndex: 'initTime',
+                  render: formatTime,
+                },
+                {
+                  title: t('modDetails.advanced.startupCost.symbols'),
+                  dataIndex: 'symbolResolutionTime',
+                  render: formatTime,
+                },
+                {
+                  title: t('modDetails.advanced.startupCost.hooks'),
+                  dataIndex: 'hookSetupTime',
+                  render: formatTime,
+                },
+                {
+                  title: t('modDetails.advanced.startupCost.total'),
+                  key: 'total',
+                  render: (_, process) => {
+                    const total = process.loadTime + process.initTime;
+                    const overBudget =
+                      startupCostBudget > 0 && total > startupCostBudget;
+                    return (
+                      <Typography.Text
+                        type={overBudget ? 'warning' : undefined}
+                      >
+                        {formatTime(total)}
+                      </Typography.Text>
+                    );
+                  },
+                },
+              ]}
+            />
+            {startupCost && startupCost.processCount > 0 && (
+              <Typography.Text type="secondary">
+                {t('modDetails.advanced.startupCost.summary', {
+                  count: startupCost.processCount,
+                  time: formatTime(startupCost.totalTime),
+                  budget: startupCostBudget,
+                })}
+              </Typography.Text>
+            )}
+          </SpaceWithWidth>
+        </List.Item>
       </List>
     </>
   );
@@ -15,18 +15,23 @@ import {
   useEnableMod,
   useGetFeaturedMods,
   useGetInstalledMods,
+  useGetModsStartupCost,
   useInstallMod,
   useUpdateInstalledModsDetails,
   useUpdateModRating,
+  useUpdateModsStartupCost,
 } from '../webviewIPC';
 import {
   ModConfig,
   ModMetadata,
+  ModStartupCost,
   RepositoryDetails,
 } from '../webviewIPCMessages';
 import {
   mockModsBrowserLocalFeaturedMods,
   mockModsBrowserLocalInitialMods,
+  mockModsStartupCost,
+  mockSettings,
 } from './mockData';
 import ModCard from './ModCard';
 import ModDetails from './ModDetails';
@@ -104,6 +109,15 @@ function ModsBrowserLocal({ ContentWrapper }: Props) {
     ModDetailsType
   > | null>(mockModsBrowserLocalInitialMods);
 
+  const [modsStartupCost, setModsStartupCost] = useState<Record<
+    string,
+    ModStartupCost
+  > | null>(mockModsStartupCost);
+
+  const [startupCostBudget, setStartupCostBudget] = useState(
+    mockSettings?.modStartupCostBudget ?? 0
+  );
+
   const [featuredMods, setFeaturedMods] = useState<
     Record<string, FeaturedModDetailsType> | undefined | null
   >(mockModsBrowserLocalFeaturedMods || undefined);
@@ -191,10 +205,55 @@ function ModsBrowserLocal({ ContentWrapper }: Props) {
     }, [])
   );
 
+  const { getModsStartupCost } = useGetModsStartupCost(
+    useCallback((data) => {
+      setModsStartupCost(data.startupCost);
+      setStartupCostBudget(data.budget);
+    }, [])
+  );
+
+  useUpdateModsStartupCost(
+    useCallback((data) => {
+      setModsStartupCost(data.startupCost);
+    }, [])
+  );
+
   useEffect(() => {
     getInstalledMods({});
     getFeaturedMods({});
-  }, [getInstalledMods, getFeaturedMods]);
+    getModsStartupCost({});
+  }, [getInstalledMods, getFeaturedMods, getModsStartupCost]);
+
+  const getStartupCostProps = (modStartupCost?: ModStartupCost) => {
+    if (!modStartupCost || modStartupCost.processCount === 0) {
+      return undefined;
+    }
+
+    const average = modStartupCost.totalTime / modStartupCost.processCount;
+
+    // Flag mods which are slow in a single process, such as explorer, even
+    // if they're fast on average.
+    const worst = Math.max(
+      average,
+      ...modStartupCost.processes.map(
+        (process) => process.loadTime + process.initTime
+      )
+    );
+    const overBudget = startupCostBudget > 0 && worst > startupCostBudget;
+
+    return {
+      text: t('mod.startupCost.text', { time: average.toFixed(1) }) as string,
+      tooltip: (overBudget
+        ? t('mod.startupCost.overBudget', {
+          time: worst.toFixed(1),
+          budget: startupCostBudget,
+        })
+        : t('mod.startupCost.tooltip', {
+          count: modStartupCost.processCount,
+        })) as string,
+      overBudget,
+    };
+  };
 
   useUpdateInstalledModsDetails(
     useCallback(
@@ -377,6 +436,7 @@ function ModsBrowserLocal({ ContentWrapper }: Props) {
                     onChange: (checked) =>
                       enableMod({ modId, enable: checked }),
                   }}
+                  startupCost={getStartupCostProps(modsStartupCost?.[modId])}
                 />
               ))}
             </ModsGrid>
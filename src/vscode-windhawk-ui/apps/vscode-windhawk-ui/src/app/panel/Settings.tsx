@@ -319,6 +319,24 @@ function Settings() {
                 }}
               />
             </List.Item>
+            <List.Item>
+              <SettingsListItemMeta
+                title={t('settings.modStartupCostBudget.title')}
+                description={t('settings.modStartupCostBudget.description')}
+              />
+              <SettingInputNumber
+                value={appSettings.modStartupCostBudget}
+                min={0}
+                max={2147483647}
+                onChange={(value) => {
+                  updateAppSettings({
+                    appSettings: {
+                      modStartupCostBudget: parseIntLax(value),
+                    },
+                  });
+                }}
+              />
+            </List.Item>
             <List.Item>
               <Button
                 type="primary"
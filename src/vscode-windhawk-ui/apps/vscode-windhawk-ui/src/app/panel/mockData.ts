@@ -13,6 +13,7 @@ export const mockSettings = !useMockData
     hideTrayIcon: false,
     dontAutoShowToolkit: false,
     modTasksDialogDelay: 2000,
+    modStartupCostBudget: 200,
     safeMode: false,
     loggingVerbosity: 0,
     engine: {
@@ -83,6 +84,30 @@ export const mockModsBrowserLocalInitialMods = !useMockData
     asdf7: mockModDetails,
   };
 
+export const mockModsStartupCost = !useMockData
+  ? null
+  : {
+    'custom-message-box': {
+      totalTime: 412.5,
+      processCount: 3,
+      processes: [
+        {
+          processId: 1234,
+          processName: 'explorer.exe',
+          loadTime: 12.3,
+          initTime: 305.1,
+          symbolResolutionTime: 280.4,
+          hookSetupTime: 1.2,
+        },
+      ],
+    },
+    'local@asdf2': {
+      totalTime: 8.1,
+      processCount: 1,
+      processes: [],
+    },
+  };
+
 export const mockModsBrowserLocalFeaturedMods = !useMockData
   ? null
   : {
@@ -29,6 +29,7 @@ import {
   GetModSettingsReplyData,
   GetModSourceDataData,
   GetModSourceDataReplyData,
+  GetModsStartupCostReplyData,
   GetRepositoryModSourceDataData,
   GetRepositoryModSourceDataReplyData,
   GetRepositoryModsReplyData,
@@ -47,6 +48,7 @@ import {
   UpdateModConfigReplyData,
   UpdateModRatingData,
   UpdateModRatingReplyData,
+  UpdateModsStartupCostData,
 } from './webviewIPCMessages';
 
 // Message types:
@@ -322,6 +324,26 @@ export function useGetInstalledMods<TContext extends Record<string, unknown>>(
   };
 }
 
+export function useGetModsStartupCost<
+  TContext extends Record<string, unknown>
+>(
+  handler: (
+    data: GetModsStartupCostReplyData,
+    context?: TContext
+  ) => void
+) {
+  const result = usePostMessageWithReplyWithHandler<
+    NoData,
+    GetModsStartupCostReplyData,
+    TContext
+  >('getModsStartupCost', handler);
+  return {
+    getModsStartupCost: result.postMessage,
+    getModsStartupCostPending: result.pending,
+    getModsStartupCostContext: result.context,
+  };
+}
+
 export function useGetFeaturedMods<TContext extends Record<string, unknown>>(
   handler: (data: GetFeaturedModsReplyData, context?: TContext) => void
 ) {
@@ -578,6 +600,15 @@ export function useUpdateInstalledModsDetails(
   );
 }
 
+export function useUpdateModsStartupCost(
+  handler: (data: UpdateModsStartupCostData) => void
+) {
+  useEventMessageWithHandler<UpdateModsStartupCostData>(
+    'updateModsStartupCost',
+    handler
+  );
+}
+
 export function useSetEditedModId(handler: (data: SetEditedModIdData) => void) {
   useEventMessageWithHandler<SetEditedModIdData>('setEditedModId', handler);
 }
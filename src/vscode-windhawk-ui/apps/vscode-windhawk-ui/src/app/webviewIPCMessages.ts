@@ -76,6 +76,7 @@ export type AppSettings = {
   hideTrayIcon: boolean;
   dontAutoShowToolkit: boolean;
   modTasksDialogDelay: number;
+  modStartupCostBudget: number;
   safeMode: boolean;
   loggingVerbosity: number;
   engine: {
@@ -112,6 +113,25 @@ export type RepositoryDetails = {
   updated: number;
 };
 
+// Times are in milliseconds.
+export type ModStartupCostProcess = {
+  processId: number;
+  processName: string;
+  loadTime: number;
+  initTime: number;
+  symbolResolutionTime: number;
+  hookSetupTime: number;
+};
+
+export type ModStartupCost = {
+  // The load and init times, added up over all processes the mod was loaded
+  // in since Windhawk started.
+  totalTime: number;
+  processCount: number;
+  // The processes which are still running.
+  processes: ModStartupCostProcess[];
+};
+
 export type AppUISettings = {
   language: string;
   devModeOptOut: boolean;
@@ -209,6 +229,11 @@ export type GetInstalledModsReplyData = {
   >;
 };
 
+export type GetModsStartupCostReplyData = {
+  startupCost: Record<string, ModStartupCost> | null;
+  budget: number;
+};
+
 export type GetFeaturedModsReplyData = {
   featuredMods: Record<
     string,
@@ -368,6 +393,10 @@ export type UpdateInstalledModsDetailsData = {
   >;
 };
 
+export type UpdateModsStartupCostData = {
+  startupCost: Record<string, ModStartupCost> | null;
+};
+
 export type SetEditedModIdData = {
   modId: string;
 };
@@ -10,6 +10,7 @@ import * as storagePaths from './storagePaths';
 import { AppSettings, AppSettingsUtils, AppSettingsUtilsNonPortable, AppSettingsUtilsPortable } from './utils/appSettingsUtils';
 import CompilerUtils, { CompilerError } from './utils/compilerUtils';
 import EditorWorkspaceUtils from './utils/editorWorkspaceUtils';
+import EngineMetricsUtils from './utils/engineMetricsUtils';
 import { ModConfigUtils, ModConfigUtilsNonPortable, ModConfigUtilsPortable } from './utils/modConfigUtils';
 import ModSourceUtils from './utils/modSourceUtils';
 import TrayProgramUtils from './utils/trayProgramUtils';
@@ -31,6 +32,7 @@ import {
 	InstallModData,
 	ModConfig,
 	ModMetadata,
+	ModStartupCost,
 	SetModSettingsData,
 	UpdateAppSettingsData,
 	UpdateModConfigData,
@@ -44,7 +46,8 @@ type AppUtils = {
 	editorWorkspace: EditorWorkspaceUtils,
 	trayProgram: TrayProgramUtils,
 	userProfile: UserProfileUtils,
-	appSettings: AppSettingsUtils
+	appSettings: AppSettingsUtils,
+	engineMetrics: EngineMetricsUtils
 };
 
 // Set to a local folder to use a dev environment.
@@ -81,7 +84,8 @@ export function activate(context: vscode.ExtensionContext) {
 			userProfile: new UserProfileUtils(appDataPath),
 			appSettings: paths.portable
 				? new AppSettingsUtilsPortable(appDataPath)
-				: new AppSettingsUtilsNonPortable(paths.regKey, paths.regSubKey)
+				: new AppSettingsUtilsNonPortable(paths.regKey, paths.regSubKey),
+			engineMetrics: new EngineMetricsUtils(appDataPath)
 		};
 
 		const sidebarWebviewViewProvider = new WindhawkViewProvider(context.extensionUri, context.extensionPath, utils);
@@ -389,6 +393,28 @@ class WindhawkPanel {
 		}
 	}
 
+	private async _refreshModsStartupCost() {
+		try {
+			// Ask the tray program for a fresh export. If it's not running,
+			// the previous export stays in use.
+			const exported = await this._utils.engineMetrics.refreshExport(
+				() => this._utils.trayProgram.postExportMetrics(), 3000);
+			if (!exported) {
+				return;
+			}
+
+			this._panel.webview.postMessage({
+				type: 'event',
+				command: 'updateModsStartupCost',
+				data: {
+					startupCost: this._utils.engineMetrics.getModsStartupCost()
+				}
+			});
+		} catch (e) {
+			reportException(e);
+		}
+	}
+
 	private readonly _handleMessageMap: Record<string, (message: any) => void> = {
 		getInitialAppSettings: message => {
 			let appUISettings = null;
@@ -449,6 +475,31 @@ class WindhawkPanel {
 				}
 			});
 		},
+		getModsStartupCost: message => {
+			let startupCost: Record<string, ModStartupCost> | null = null;
+			let budget = 0;
+			try {
+				budget = this._utils.appSettings.getAppSettings().modStartupCostBudget;
+
+				// Reply with the previous export right away, the page is
+				// updated if a fresh export arrives.
+				startupCost = this._utils.engineMetrics.getModsStartupCost();
+			} catch (e) {
+				reportException(e);
+			}
+
+			this._panel.webview.postMessage({
+				type: 'reply',
+				command: 'getModsStartupCost',
+				messageId: message.messageId,
+				data: {
+					startupCost,
+					budget
+				}
+			});
+
+			this._refreshModsStartupCost();
+		},
 		getFeaturedMods: async message => {
 			let featuredMods = null;
 			try {
@@ -13,6 +13,7 @@ export type AppSettings = {
 	hideTrayIcon: boolean,
 	dontAutoShowToolkit: boolean,
 	modTasksDialogDelay: number,
+	modStartupCostBudget: number,
 	safeMode: boolean,
 	loggingVerbosity: number,
 	engine: {
@@ -54,6 +55,7 @@ export class AppSettingsUtilsPortable implements AppSettingsUtils {
 			hideTrayIcon: !!parseInt(iniFileParsed.Settings?.HideTrayIcon ?? '0', 10),
 			dontAutoShowToolkit: !!parseInt(iniFileParsed.Settings?.DontAutoShowToolkit ?? '0', 10),
 			modTasksDialogDelay: parseInt(iniFileParsed.Settings?.ModTasksDialogDelay ?? '2000', 10),
+			modStartupCostBudget: parseInt(iniFileParsed.Settings?.ModStartupCostBudget ?? '200', 10),
 			safeMode: !!parseInt(iniFileParsed.Settings?.SafeMode ?? '0', 10),
 			loggingVerbosity: parseInt(iniFileParsed.Settings?.LoggingVerbosity ?? '0', 10),
 			engine: {
@@ -96,6 +98,9 @@ export class AppSettingsUtilsPortable implements AppSettingsUtils {
 		if (appSettings.modTasksDialogDelay !== undefined) {
 			iniFileParsed.Settings.ModTasksDialogDelay = appSettings.modTasksDialogDelay.toString();
 		}
+		if (appSettings.modStartupCostBudget !== undefined) {
+			iniFileParsed.Settings.ModStartupCostBudget = appSettings.modStartupCostBudget.toString();
+		}
 		if (appSettings.safeMode !== undefined) {
 			iniFileParsed.Settings.SafeMode = appSettings.safeMode ? '1' : '0';
 		}
@@ -174,6 +179,7 @@ export class AppSettingsUtilsNonPortable implements AppSettingsUtils {
 				hideTrayIcon: !!reg.getValue(key, null, 'HideTrayIcon', reg.GetValueFlags.RT_REG_DWORD),
 				dontAutoShowToolkit: !!reg.getValue(key, null, 'DontAutoShowToolkit', reg.GetValueFlags.RT_REG_DWORD),
 				modTasksDialogDelay: (reg.getValue(key, null, 'ModTasksDialogDelay', reg.GetValueFlags.RT_REG_DWORD) ?? 2000) as number,
+				modStartupCostBudget: (reg.getValue(key, null, 'ModStartupCostBudget', reg.GetValueFlags.RT_REG_DWORD) ?? 200) as number,
 				safeMode: !!reg.getValue(key, null, 'SafeMode', reg.GetValueFlags.RT_REG_DWORD),
 				loggingVerbosity: (reg.getValue(key, null, 'LoggingVerbosity', reg.GetValueFlags.RT_REG_DWORD) ?? 0) as number,
 				engine: {
@@ -226,6 +232,9 @@ export class AppSettingsUtilsNonPortable implements AppSettingsUtils {
 			if (appSettings.modTasksDialogDelay !== undefined) {
 				reg.setValueDWORD(key, 'ModTasksDialogDelay', appSettings.modTasksDialogDelay);
 			}
+			if (appSettings.modStartupCostBudget !== undefined) {
+				reg.setValueDWORD(key, 'ModStartupCostBudget', appSettings.modStartupCostBudget);
+			}
 			if (appSettings.safeMode !== undefined) {
 				reg.setValueDWORD(key, 'SafeMode', appSettings.safeMode ? 1 : 0);
 			}
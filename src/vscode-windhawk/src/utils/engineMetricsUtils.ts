@@ -0,0 +1,149 @@
+import * as fs from 'fs';
+import * as path from 'path';
+import { ModStartupCost } from '../webviewIPCMessages';
+
+type EngineMetrics = Record<string, number | undefined>;
+
+type EngineMetricsFile = {
+	totals?: {
+		mod: string,
+		processCount: number,
+		metrics: EngineMetrics
+	}[],
+	processes?: {
+		processId: number,
+		processName: string,
+		mod: string,
+		metrics: EngineMetrics
+	}[]
+};
+
+function usToMs(value?: number) {
+	return (value ?? 0) / 1000;
+}
+
+export default class EngineMetricsUtils {
+	private metricsJsonPath: string;
+	private minExportIntervalMs = 30 * 1000;
+	private refreshPromise: Promise<boolean> | null = null;
+	private cachedStartupCost: {
+		exportTime: number,
+		startupCost: Record<string, ModStartupCost> | null
+	} | null = null;
+
+	public constructor(appDataPath: string) {
+		this.metricsJsonPath = path.join(appDataPath, 'Engine', 'ModsWritable', 'engine-metrics', 'metrics.json');
+	}
+
+	public getExportTime() {
+		try {
+			return fs.statSync(this.metricsJsonPath).mtimeMs;
+		} catch (e) {
+			// Ignore if file doesn't exist.
+			if (e.code !== 'ENOENT') {
+				throw e;
+			}
+
+			return 0;
+		}
+	}
+
+	// The export is done asynchronously by the tray program. Resolves when the
+	// file is updated, or on timeout, in which case the previous export is
+	// used, if any.
+	private async waitForExport(previousExportTime: number, timeoutMs: number) {
+		const pollIntervalMs = 100;
+		for (let elapsedMs = 0; elapsedMs < timeoutMs; elapsedMs += pollIntervalMs) {
+			if (this.getExportTime() !== previousExportTime) {
+				return true;
+			}
+
+			await new Promise(resolve => setTimeout(resolve, pollIntervalMs));
+		}
+
+		return false;
+	}
+
+	// Requests a new export with postExport, unless the last export is recent
+	// enough or a request is already in progress, in which case the pending
+	// request is shared. Resolves to true if a new export was written.
+	public refreshExport(postExport: () => void, timeoutMs: number) {
+		if (this.refreshPromise) {
+			return this.refreshPromise;
+		}
+
+		if (Date.now() - this.getExportTime() < this.minExportIntervalMs) {
+			return Promise.resolve(false);
+		}
+
+		const previousExportTime = this.getExportTime();
+		postExport();
+		this.refreshPromise = this.waitForExport(previousExportTime, timeoutMs).finally(() => {
+			this.refreshPromise = null;
+		});
+
+		return this.refreshPromise;
+	}
+
+	// Returns the startup cost from the last export. The parsed result is
+	// cached until the file is replaced by a new export.
+	public getModsStartupCost() {
+		const exportTime = this.getExportTime();
+		if (this.cachedStartupCost && this.cachedStartupCost.exportTime === exportTime) {
+			return this.cachedStartupCost.startupCost;
+		}
+
+		const startupCost = exportTime ? this.readModsStartupCost() : null;
+		this.cachedStartupCost = { exportTime, startupCost };
+		return startupCost;
+	}
+
+	private readModsStartupCost() {
+		let metricsText: string;
+		try {
+			metricsText = fs.readFileSync(this.metricsJsonPath, 'utf8');
+		} catch (e) {
+			// Ignore if file doesn't exist.
+			if (e.code !== 'ENOENT') {
+				throw e;
+			}
+
+			return null;
+		}
+
+		const metrics: EngineMetricsFile = JSON.parse(metricsText);
+
+		const result: Record<string, ModStartupCost> = {};
+
+		for (const { mod, processCount, metrics: modMetrics } of metrics.totals || []) {
+			// The engine's own counters have an empty mod name.
+			if (!mod) {
+				continue;
+			}
+
+			result[mod] = {
+				totalTime: usToMs(modMetrics.load_time_us) + usToMs(modMetrics.init_time_us),
+				processCount,
+				processes: []
+			};
+		}
+
+		for (const { processId, processName, mod, metrics: processMetrics } of metrics.processes || []) {
+			const modStartupCost = result[mod];
+			if (!modStartupCost) {
+				continue;
+			}
+
+			modStartupCost.processes.push({
+				processId,
+				processName,
+				loadTime: usToMs(processMetrics.load_time_us),
+				initTime: usToMs(processMetrics.init_time_us),
+				symbolResolutionTime: usToMs(processMetrics.symbol_resolution_time_us),
+				hookSetupTime: usToMs(processMetrics.hook_setup_time_us)
+			});
+		}
+
+		return result;
+	}
+}
@@ -68,4 +68,10 @@ export default class TrayProgramUtils {
 			'-app-settings-changed'
 		]);
 	}
+
+	public postExportMetrics() {
+		this.runTrayProgramWithArgs([
+			'-export-metrics'
+		]);
+	}
 }
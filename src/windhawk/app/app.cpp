@@ -24,6 +24,7 @@ enum class Action {
     kCheckForUpdates,
     kNewUpdatesFound,
     kAppSettingsChanged,
+    kExportMetrics,
     kExit,
     kRestart,
     kRestartBg,
@@ -35,6 +36,7 @@ void RunDaemon();
 void CheckForUpdates();
 void NotifyNewUpdatesFound();
 void NotifyAppSettingsChanged();
+void NotifyExportMetrics();
 void ExitApp(bool wait, DWORD timeout);
 void RestartApp(DWORD timeout, bool trayOnly);
 void RestartAppBg(DWORD timeout);
@@ -93,6 +95,8 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance,
         action = Action::kNewUpdatesFound;
     } else if (DoesParamExist(L"-app-settings-changed")) {
         action = Action::kAppSettingsChanged;
+    } else if (DoesParamExist(L"-export-metrics")) {
+        action = Action::kExportMetrics;
     } else if (DoesParamExist(L"-exit")) {
         action = Action::kExit;
     } else if (DoesParamExist(L"-restart")) {
@@ -196,6 +200,11 @@ void Run(Action action) {
             NotifyAppSettingsChanged();
             break;
 
+        case Action::kExportMetrics:
+            VERBOSE("Notifying about metrics export");
+            NotifyExportMetrics();
+            break;
+
         case Action::kExit: {
             VERBOSE("Exiting app");
             DWORD timeout = GetIntParam(L"-timeout");
@@ -351,6 +360,16 @@ void NotifyAppSettingsChanged() {
         L"Global\\WindhawkAppSettingsChangedEvent-daemon-session=");
 }
 
+void NotifyExportMetrics() {
+    if (StorageManager::GetInstance().IsPortable()) {
+        SetNamedEvent(L"WindhawkExportMetricsEvent-daemon");
+        return;
+    }
+
+    SetNamedEventForAllSessions(
+        L"Global\\WindhawkExportMetricsEvent-daemon-session=");
+}
+
 void ExitApp(bool wait, DWORD timeout) {
     if (StorageManager::GetInstance().IsPortable()) {
         PostCommandToPortableRunningDaemon(
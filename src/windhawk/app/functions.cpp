@@ -214,23 +214,41 @@ PCWSTR LoadStrFromRsrc(UINT uStrId) {
     return pStr;
 }
 
+namespace {
+
+template <typename T>
+std::vector<T> SplitStringImpl(std::wstring_view s, WCHAR delim) {
+    // Like std::views::split, an empty string has no parts.
+    if (s.empty()) {
+        return {};
+    }
+
+    // Count first to allocate once, symbol caches can have tens of thousands
+    // of parts.
+    std::vector<T> result;
+    result.reserve(std::ranges::count(s, delim) + 1);
+
+    size_t start = 0;
+    size_t end;
+    while ((end = s.find(delim, start)) != s.npos) {
+        result.emplace_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+
+    result.emplace_back(s.substr(start));
+
+    return result;
+}
+
+}  // namespace
+
 std::vector<std::wstring> SplitString(std::wstring_view s, WCHAR delim) {
-    // https://stackoverflow.com/a/48403210
-    auto view =
-        s | std::views::split(delim) | std::views::transform([](auto&& rng) {
-            return std::wstring_view(rng.data(), rng.size());
-        });
-    return std::vector<std::wstring>(view.begin(), view.end());
+    return SplitStringImpl<std::wstring>(s, delim);
 }
 
 std::vector<std::wstring_view> SplitStringToViews(std::wstring_view s,
                                                   WCHAR delim) {
-    // https://stackoverflow.com/a/48403210
-    auto view =
-        s | std::views::split(delim) | std::views::transform([](auto&& rng) {
-            return std::wstring_view(rng.data(), rng.size());
-        });
-    return std::vector<std::wstring_view>(view.begin(), view.end());
+    return SplitStringImpl<std::wstring_view>(s, delim);
 }
 
 // https://stackoverflow.com/a/29752943
@@ -238,35 +256,40 @@ std::wstring ReplaceAll(std::wstring_view source,
                         std::wstring_view from,
                         std::wstring_view to,
                         bool ignoreCase) {
-    auto findString = [ignoreCase](std::wstring_view haystack,
-                                   std::wstring_view needle,
-                                   size_t pos) -> size_t {
-        if (!ignoreCase) {
-            return haystack.find(needle, pos);
-        }
-
-        auto it = std::search(
-            haystack.begin() + pos, haystack.end(), needle.begin(),
-            needle.end(), [](WCHAR ch1, WCHAR ch2) {
-                LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE, &ch1,
-                              1, &ch1, 1, nullptr, nullptr, 0);
-                LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE, &ch2,
-                              1, &ch2, 1, nullptr, nullptr, 0);
-                return ch1 == ch2;
-            });
-        if (it == haystack.end()) {
-            return haystack.npos;
-        }
+    // For a case insensitive search, both strings are uppercased once instead
+    // of mapping each pair of compared characters. Uppercasing doesn't change
+    // the length of the string, so positions remain valid for the source.
+    std::wstring sourceUpper;
+    std::wstring fromUpper;
+    std::wstring_view haystack = source;
+    std::wstring_view needle = from;
+    if (ignoreCase) {
+        auto toUpper = [](std::wstring_view s) {
+            std::wstring result(s);
+            if (!result.empty()) {
+                THROW_LAST_ERROR_IF(
+                    LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE,
+                                  s.data(), static_cast<int>(s.length()),
+                                  result.data(),
+                                  static_cast<int>(result.length()), nullptr,
+                                  nullptr, 0) == 0);
+            }
+
+            return result;
+        };
 
-        return std::distance(haystack.begin(), it);
-    };
+        sourceUpper = toUpper(source);
+        fromUpper = toUpper(from);
+        haystack = sourceUpper;
+        needle = fromUpper;
+    }
 
     std::wstring newString;
 
     size_t lastPos = 0;
     size_t findPos;
 
-    while ((findPos = findString(source, from, lastPos)) != source.npos) {
+    while ((findPos = haystack.find(needle, lastPos)) != haystack.npos) {
         newString.append(source, lastPos, findPos - lastPos);
         newString += to;
         lastPos = findPos + from.length();
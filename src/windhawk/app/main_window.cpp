@@ -15,6 +15,7 @@ constexpr auto kUpdateInitialDelay = 1000 * 10;        // 10sec
 constexpr auto kUpdateInterval = 1000 * 60 * 60 * 24;  // 24h
 constexpr auto kUpdateRetryTime = 1000 * 60 * 60;      // 1h
 constexpr auto kModTasksDlgInitialDelay = 1000;        // 1sec
+constexpr auto kScrapeMetricsInterval = 1000 * 10;     // 10sec
 
 ULONGLONG GetTaskbarProcessCreationTime() {
     HWND currentTaskbarWindow = FindWindow(L"Shell_TrayWnd", nullptr);
@@ -74,6 +75,7 @@ BOOL CMainWindow::OnIdle() {
         kServiceMutex,
         kAppSettingsChanged,
         kNewUpdatesFound,
+        kExportMetrics,
         kModTasksChanged,
         kModStatusesChanged,
         kExplorerCrashed,
@@ -102,6 +104,12 @@ BOOL CMainWindow::OnIdle() {
         handleCount++;
     }
 
+    if (m_exportMetricsEvent) {
+        handleArray[handleCount] = m_exportMetricsEvent.get();
+        handleTypes[handleCount] = kExportMetrics;
+        handleCount++;
+    }
+
     if (m_modTasksChangeNotification) {
         handleArray[handleCount] = m_modTasksChangeNotification->GetHandle();
         handleTypes[handleCount] = kModTasksChanged;
@@ -144,6 +152,10 @@ BOOL CMainWindow::OnIdle() {
                     }
                     break;
 
+                case kExportMetrics:
+                    ExportMetrics();
+                    break;
+
                 case kModTasksChanged:
                     if (m_modTasksDlg) {
                         m_modTasksDlg->DataChanged();
@@ -237,11 +249,19 @@ int CMainWindow::OnCreate(LPCREATESTRUCT lpCreateStruct) {
     LoadSettings();
 
     try {
-        m_modTasksChangeNotification.emplace(L"mod-task");
+        m_modTasksChangeNotification.emplace(m_serviceInfo.processId,
+                                            ModStatusTable::Kind::kTask);
     } catch (const std::exception& e) {
         LOG(L"Tasks ChangeNotification failed: %S", e.what());
     }
 
+    try {
+        m_metricsCollector.emplace(m_serviceInfo.processId);
+        SetTimer(Timer::kScrapeMetrics, kScrapeMetricsInterval);
+    } catch (const std::exception& e) {
+        LOG(L"MetricsCollector failed: %S", e.what());
+    }
+
     m_toolkitHotkeyRegistered =
         ::RegisterHotKey(m_hWnd, static_cast<int>(Hotkey::kToolkit),
                          MOD_CONTROL | MOD_WIN | MOD_NOREPEAT, 'W');
@@ -311,17 +331,17 @@ void CMainWindow::OnTimer(UINT_PTR nIDEvent) {
             KillTimer(Timer::kModTasksDlgCreate);
 
             try {
-                m_modTasksChangeNotification.emplace(L"mod-task");
+                m_modTasksChangeNotification.emplace(
+                    m_serviceInfo.processId, ModStatusTable::Kind::kTask);
 
                 if (!CTaskManagerDlg::IsDataSourceEmpty(
-                        CTaskManagerDlg::DataSource::kModTask)) {
+                        CTaskManagerDlg::DataSource::kModTask,
+                        m_serviceInfo.processId)) {
                     m_modTasksDlg.emplace(CTaskManagerDlg::DialogOptions{
                         .dataSource = CTaskManagerDlg::DataSource::kModTask,
                         .autonomousMode = true,
                         .autonomousModeShowDelay = m_modTasksDlgDelay,
                         .sessionManagerProcessId = m_serviceInfo.processId,
-                        .sessionManagerProcessCreationTime =
-                            m_serviceInfo.processCreationTime,
                         .runButtonCallback = [this](HWND hWnd) { RunUI(hWnd); },
                         .finalMessageCallback =
                             [this](HWND hWnd) { m_modTasksDlg.reset(); }});
@@ -334,6 +354,14 @@ void CMainWindow::OnTimer(UINT_PTR nIDEvent) {
                 LOG(L"%S", e.what());
             }
             break;
+
+        case Timer::kScrapeMetrics:
+            try {
+                m_metricsCollector->Scrape();
+            } catch (const std::exception& e) {
+                LOG(L"Scraping metrics failed: %S", e.what());
+            }
+            break;
     }
 }
 
@@ -539,6 +567,9 @@ void CMainWindow::InitForPortableVersion() {
     m_appSettingsChangedEvent.reset(Functions::CreateEventForMediumIntegrity(
         L"WindhawkAppSettingsChangedEvent-daemon"));
 
+    m_exportMetricsEvent.reset(Functions::CreateEventForMediumIntegrity(
+        L"WindhawkExportMetricsEvent-daemon"));
+
     FILETIME creationTime;
     FILETIME exitTime;
     FILETIME kernelTime;
@@ -578,6 +609,13 @@ void CMainWindow::InitForNonPortableVersion() {
     m_newUpdatesFoundEvent.reset(Functions::CreateEventForMediumIntegrity(
         newUpdatesFoundEventName.c_str()));
 
+    std::wstring exportMetricsEventName =
+        L"Global\\WindhawkExportMetricsEvent-daemon-session=" +
+        std::to_wstring(sessionId);
+
+    m_exportMetricsEvent.reset(Functions::CreateEventForMediumIntegrity(
+        exportMetricsEventName.c_str()));
+
     wil::unique_handle fileMapping(OpenFileMapping(
         FILE_MAP_READ, FALSE, ServiceCommon::kInfoFileMappingName));
     THROW_LAST_ERROR_IF(!fileMapping);
@@ -1007,7 +1045,6 @@ void CMainWindow::ShowLoadedModsDialog() {
     m_modStatusesDlg.emplace(CTaskManagerDlg::DialogOptions{
         .dataSource = CTaskManagerDlg::DataSource::kModStatus,
         .sessionManagerProcessId = m_serviceInfo.processId,
-        .sessionManagerProcessCreationTime = m_serviceInfo.processCreationTime,
         .runButtonCallback = [this](HWND hWnd) { RunUI(hWnd); },
         .finalMessageCallback =
             [this](HWND hWnd) {
@@ -1023,7 +1060,8 @@ void CMainWindow::ShowLoadedModsDialog() {
     m_modStatusesDlg->ShowWindow(SW_SHOWNORMAL);
 
     try {
-        m_modStatusesChangeNotification.emplace(L"mod-status");
+        m_modStatusesChangeNotification.emplace(m_serviceInfo.processId,
+                                               ModStatusTable::Kind::kStatus);
     } catch (const std::exception& e) {
         LOG(L"Statuses ChangeNotification failed: %S", e.what());
     }
@@ -1137,3 +1175,22 @@ void CMainWindow::HandleExplorerCrash(int explorerCrashCount) {
 
     m_explorerLastTerminatedTickCount = currentTickCount;
 }
+
+void CMainWindow::ExportMetrics() {
+    if (!m_metricsCollector) {
+        return;
+    }
+
+    try {
+        m_metricsCollector->Scrape();
+
+        auto metricsPath =
+            StorageManager::GetInstance().GetModMetadataPath(L"engine-metrics");
+        std::filesystem::create_directories(metricsPath);
+
+        m_metricsCollector->ExportJson(metricsPath / L"metrics.json");
+        m_metricsCollector->ExportCsv(metricsPath / L"metrics.csv");
+    } catch (const std::exception& e) {
+        LOG(L"Exporting metrics failed: %S", e.what());
+    }
+}
@@ -2,6 +2,8 @@
 
 #include "engine_control.h"
 #include "event_viewer_crash_monitor.h"
+#include "metrics_collector.h"
+#include "mod_status_table.h"
 #include "service_common.h"
 #include "storage_manager.h"
 #include "task_manager_dlg.h"
@@ -35,6 +37,7 @@ class CMainWindow : public CWindowImpl<CMainWindow, CWindow, CNullTraits>,
         kHandleNewProcesses = 1,
         kUpdateCheck,
         kModTasksDlgCreate,
+        kScrapeMetrics,
     };
 
     enum class Hotkey {
@@ -90,6 +93,7 @@ class CMainWindow : public CWindowImpl<CMainWindow, CWindow, CNullTraits>,
     void ShowToolkitDialog(bool trigerredBySystemInstability = false);
     void SwitchToSafeMode();
     void HandleExplorerCrash(int explorerCrashCount);
+    void ExportMetrics();
 
     bool m_trayOnly;
     bool m_portable;
@@ -97,6 +101,7 @@ class CMainWindow : public CWindowImpl<CMainWindow, CWindow, CNullTraits>,
     wil::unique_mutex_nothrow m_serviceMutex;
     wil::unique_event_nothrow m_appSettingsChangedEvent;
     wil::unique_event_nothrow m_newUpdatesFoundEvent;
+    wil::unique_event_nothrow m_exportMetricsEvent;
     std::optional<AppTrayIcon> m_trayIcon;
     ServiceCommon::ServiceInfo m_serviceInfo{};
     std::optional<EngineControl> m_engineControl;
@@ -116,17 +121,21 @@ class CMainWindow : public CWindowImpl<CMainWindow, CWindow, CNullTraits>,
     // Shown automatically when mods are doing tasks such as initializing or
     // loading symbols.
     std::optional<CTaskManagerDlg> m_modTasksDlg;
-    std::optional<StorageManager::ModMetadataChangeNotification>
+    std::optional<ModStatusTable::ChangeNotification>
         m_modTasksChangeNotification;
 
     // Opened by the user.
     std::optional<CTaskManagerDlg> m_modStatusesDlg;
-    std::optional<StorageManager::ModMetadataChangeNotification>
+    std::optional<ModStatusTable::ChangeNotification>
         m_modStatusesChangeNotification;
 
     // Opened from the tray icon, with a hotkey, or when explorer isn't running.
     std::optional<CToolkitDlg> m_toolkitDlg;
 
+    // Engine counters, scraped periodically to keep the counters of processes
+    // which exited, and exported on request.
+    std::optional<MetricsCollector> m_metricsCollector;
+
     // Explorer instability monitoring. Instability is detected when explorer
     // terminates more than once in a short period of time.
     constexpr static UINT kExplorerSecondCrashMaxPeriod = 1000 * 60;
@@ -0,0 +1,157 @@
+#include "stdafx.h"
+
+#include "metrics_collector.h"
+
+using json = nlohmann::ordered_json;
+
+namespace {
+
+using Metric = ModStatusTable::Metric;
+
+std::string ToUtf8(std::wstring_view s) {
+    return std::string(CW2A(std::wstring(s).c_str(), CP_UTF8));
+}
+
+json CountersToJson(
+    const std::array<LONG64, ModStatusTable::kMetricCount>& counters) {
+    json result = json::object();
+    for (size_t i = 0; i < counters.size(); i++) {
+        PCWSTR name = ModStatusTable::GetMetricName(static_cast<Metric>(i));
+        result[ToUtf8(name)] = counters[i];
+    }
+
+    return result;
+}
+
+// Quotes a CSV field if needed, as described in RFC 4180.
+std::string CsvField(std::wstring_view s) {
+    std::string field = ToUtf8(s);
+    if (field.find_first_of(",\"\r\n") == std::string::npos) {
+        return field;
+    }
+
+    std::string quoted = "\"";
+    for (char c : field) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+}  // namespace
+
+MetricsCollector::MetricsCollector(DWORD sessionManagerProcessId)
+    : m_modStatusTable(ModStatusTable::Open(sessionManagerProcessId)) {}
+
+void MetricsCollector::Scrape() {
+    std::map<RowKey, RowMetrics> rows;
+
+    for (const auto& row :
+         m_modStatusTable.ReadRows(ModStatusTable::Kind::kMetrics)) {
+        RowKey key{
+            .processId = row.processId,
+            .creationTime = wil::filetime::to_int64(row.creationTime),
+            .modName = row.modName,
+        };
+
+        RowMetrics& rowMetrics = rows[std::move(key)];
+        rowMetrics.processName = row.processName;
+        std::copy(std::begin(row.metrics), std::end(row.metrics),
+                  rowMetrics.counters.begin());
+    }
+
+    // Counters of rows which disappeared since the previous scrape are kept
+    // with their last seen values. Changes made between the last scrape and
+    // the row's release are lost.
+    for (const auto& [key, rowMetrics] : m_rows) {
+        if (rows.contains(key)) {
+            continue;
+        }
+
+        m_retiredTotals[key.modName].Add(rowMetrics.counters);
+    }
+
+    m_rows = std::move(rows);
+}
+
+void MetricsCollector::ExportJson(const std::filesystem::path& path) {
+    json processes = json::array();
+    for (const auto& [key, rowMetrics] : m_rows) {
+        processes.push_back({
+            {"processId", key.processId},
+            {"processName", ToUtf8(rowMetrics.processName)},
+            {"mod", ToUtf8(key.modName)},
+            {"metrics", CountersToJson(rowMetrics.counters)},
+        });
+    }
+
+    json totals = json::array();
+    for (const auto& [modName, modTotals] : GetTotals()) {
+        totals.push_back({
+            {"mod", ToUtf8(modName)},
+            {"processCount", modTotals.processCount},
+            {"metrics", CountersToJson(modTotals.counters)},
+        });
+    }
+
+    json result = {
+        {"totals", std::move(totals)},
+        {"processes", std::move(processes)},
+    };
+
+    std::ofstream file(path);
+    THROW_HR_IF(E_FAIL, !file);
+    file << std::setw(2) << result;
+}
+
+void MetricsCollector::ExportCsv(const std::filesystem::path& path) {
+    std::ofstream file(path);
+    THROW_HR_IF(E_FAIL, !file);
+
+    file << "scope,process_id,process_name,mod,process_count";
+    for (size_t i = 0; i < ModStatusTable::kMetricCount; i++) {
+        PCWSTR name = ModStatusTable::GetMetricName(static_cast<Metric>(i));
+        file << ',' << ToUtf8(name);
+    }
+    file << '\n';
+
+    for (const auto& [modName, modTotals] : GetTotals()) {
+        file << "total,,," << CsvField(modName) << ','
+             << modTotals.processCount;
+        for (LONG64 value : modTotals.counters) {
+            file << ',' << value;
+        }
+        file << '\n';
+    }
+
+    for (const auto& [key, rowMetrics] : m_rows) {
+        file << "process," << key.processId << ','
+             << CsvField(rowMetrics.processName) << ','
+             << CsvField(key.modName) << ",1";
+        for (LONG64 value : rowMetrics.counters) {
+            file << ',' << value;
+        }
+        file << '\n';
+    }
+}
+
+void MetricsCollector::ModTotals::Add(const Counters& rowCounters) {
+    processCount++;
+    for (size_t i = 0; i < counters.size(); i++) {
+        counters[i] += rowCounters[i];
+    }
+}
+
+std::map<std::wstring, MetricsCollector::ModTotals>
+MetricsCollector::GetTotals() {
+    auto totals = m_retiredTotals;
+
+    for (const auto& [key, rowMetrics] : m_rows) {
+        totals[key.modName].Add(rowMetrics.counters);
+    }
+
+    return totals;
+}
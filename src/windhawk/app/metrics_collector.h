@@ -0,0 +1,48 @@
+#pragma once
+
+#include "mod_status_table.h"
+
+// Collects the engine counters published in the mod status table. Rows of
+// processes which exited, or of mods which were unloaded, disappear from the
+// table, so their last seen counters are kept as per-mod totals.
+class MetricsCollector {
+   public:
+    MetricsCollector(DWORD sessionManagerProcessId);
+
+    void Scrape();
+
+    // Writes the counters of the current rows, and the per-mod totals which
+    // also include the rows which disappeared, with the number of processes
+    // they add up. The engine counters have an empty mod name.
+    void ExportJson(const std::filesystem::path& path);
+    void ExportCsv(const std::filesystem::path& path);
+
+   private:
+    using Counters = std::array<LONG64, ModStatusTable::kMetricCount>;
+
+    struct RowKey {
+        DWORD processId;
+        ULONGLONG creationTime;
+        std::wstring modName;
+
+        auto operator<=>(const RowKey&) const = default;
+    };
+
+    struct RowMetrics {
+        std::wstring processName;
+        Counters counters;
+    };
+
+    struct ModTotals {
+        size_t processCount = 0;
+        Counters counters{};
+
+        void Add(const Counters& rowCounters);
+    };
+
+    std::map<std::wstring, ModTotals> GetTotals();
+
+    ModStatusTable m_modStatusTable;
+    std::map<RowKey, RowMetrics> m_rows;
+    std::map<std::wstring, ModTotals> m_retiredTotals;
+};
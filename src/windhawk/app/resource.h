@@ -47,6 +47,9 @@
 #define IDS_SAFE_MODE_TEXT              0x117
 #define IDS_SAFE_MODE_DETECTED_TITLE    0x120
 #define IDS_SAFE_MODE_DETECTED_TEXT     0x121
+#define IDS_TASKDLG_MENU_HOOK_CALL_STATS 0x130
+#define IDS_TASKDLG_HOOK_CALL_STATS_TITLE 0x131
+#define IDS_TASKDLG_HOOK_CALL_STATS_EMPTY 0x132
 #define IDC_TASK_LIST                   1001
 #define IDC_TOOLKIT_EXPLANATION         1002
 #define IDC_TOOLKIT_LOADED_MODS         1003
@@ -58,7 +61,7 @@
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        0x122
+#define _APS_NEXT_RESOURCE_VALUE        0x133
 #define _APS_NEXT_COMMAND_VALUE         32775
 #define _APS_NEXT_CONTROL_VALUE         1007
 #define _APS_NEXT_SYMED_VALUE           101
@@ -53,17 +53,20 @@ extern CAppModule _Module;
 //////////////////////////////////////////////////////////////////////////
 // STL
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <exception>
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <ranges>
 #include <string>
+#include <unordered_map>
 #include <variant>
 
 //////////////////////////////////////////////////////////////////////////
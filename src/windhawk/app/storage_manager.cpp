@@ -43,7 +43,7 @@ std::unique_ptr<PortableSettings> StorageManager::GetAppConfig(PCWSTR section,
     if (portableStorage) {
         const auto& iniFileSettingsPath = std::get<IniFilePath>(settingsPath);
         return std::make_unique<IniFileSettings>(
-            iniFileSettingsPath.path.c_str(), section, write);
+            iniFileSettingsPath.path.c_str(), section, write, &iniFileCache);
     } else {
         const auto& registrySettingsPath = std::get<RegistryPath>(settingsPath);
         std::wstring subKey = registrySettingsPath.subKey + L'\\' + section;
@@ -174,28 +174,3 @@ StorageManager::~StorageManager() = default;
 std::filesystem::path StorageManager::GetEngineAppDataPath() {
     return appDataPath / L"Engine";
 }
-
-StorageManager::ModMetadataChangeNotification::ModMetadataChangeNotification(
-    PCWSTR metadataCategory) {
-    auto& storageManager = GetInstance();
-
-    auto metadataPath = storageManager.GetModMetadataPath(metadataCategory);
-
-    if (!std::filesystem::is_directory(metadataPath)) {
-        std::error_code ec;
-        std::filesystem::create_directories(metadataPath, ec);
-    }
-
-    m_findChange = wil::unique_hfind_change(FindFirstChangeNotification(
-        metadataPath.c_str(), FALSE,
-        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE));
-    THROW_LAST_ERROR_IF(!m_findChange);
-}
-
-HANDLE StorageManager::ModMetadataChangeNotification::GetHandle() {
-    return m_findChange.get();
-}
-
-void StorageManager::ModMetadataChangeNotification::ContinueMonitoring() {
-    THROW_IF_WIN32_BOOL_FALSE(FindNextChangeNotification(m_findChange.get()));
-}
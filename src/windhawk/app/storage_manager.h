@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ini_file.h"
 #include "portable_settings.h"
 
 class StorageManager {
@@ -24,17 +25,6 @@ class StorageManager {
     std::filesystem::path GetEditorWorkspacePath();
     std::filesystem::path GetUserProfileJsonPath();
 
-    class ModMetadataChangeNotification {
-       public:
-        ModMetadataChangeNotification(PCWSTR metadataCategory);
-
-        HANDLE GetHandle();
-        void ContinueMonitoring();
-
-       private:
-        wil::unique_hfind_change m_findChange;
-    };
-
    private:
     StorageManager();
     ~StorageManager();
@@ -56,4 +46,5 @@ class StorageManager {
     std::filesystem::path uiPath;
     std::filesystem::path compilerPath;
     std::variant<std::monostate, RegistryPath, IniFilePath> settingsPath;
+    IniFileCache iniFileCache;
 };
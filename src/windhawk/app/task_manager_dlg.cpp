@@ -4,7 +4,6 @@
 
 #include "functions.h"
 #include "logger.h"
-#include "storage_manager.h"
 
 namespace {
 
@@ -14,11 +13,12 @@ constexpr auto kRefreshListOnDataChangeDelay = 200;
 constexpr auto kUpdateProcessesStatusInterval = 1000;
 
 struct ListItemData {
-    std::wstring filePath;
+    std::wstring modName;
     std::wstring processName;
     DWORD processId = 0;
     ULONGLONG creationTime = 0;
     bool isFrozen = false;
+    wil::unique_process_handle process;
     wil::unique_process_handle executionRequiredRequestProcess;
     wil::unique_handle executionRequiredRequest;
 };
@@ -41,34 +41,17 @@ bool CanShowDialog() {
     return true;
 }
 
-std::wstring GetMetadataContent(PCWSTR filePath, FILETIME* pCreationTime) {
-    wil::unique_hfile file(
-        CreateFile(filePath, GENERIC_READ,
-                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-                   nullptr, OPEN_EXISTING, 0, nullptr));
-    THROW_LAST_ERROR_IF(!file);
-
-    LARGE_INTEGER fileSizeLarge;
-    THROW_IF_WIN32_BOOL_FALSE(GetFileSizeEx(file.get(), &fileSizeLarge));
-
-    DWORD fileSize = 0;
-    if (fileSizeLarge.QuadPart <= DWORD_MAX ||
-        (fileSizeLarge.QuadPart % sizeof(WCHAR)) == 0) {
-        fileSize = static_cast<DWORD>(fileSizeLarge.QuadPart);
-    }
-
-    std::wstring fileContents(fileSize / sizeof(WCHAR), L'\0');
-
-    DWORD numberOfBytesRead;
-    THROW_IF_WIN32_BOOL_FALSE(ReadFile(file.get(), fileContents.data(),
-                                       fileSize, &numberOfBytesRead, nullptr));
+ModStatusTable::Kind GetModStatusTableKind(
+    CTaskManagerDlg::DataSource dataSource) {
+    switch (dataSource) {
+        case CTaskManagerDlg::DataSource::kModStatus:
+            return ModStatusTable::Kind::kStatus;
 
-    if (pCreationTime) {
-        THROW_IF_WIN32_BOOL_FALSE(
-            GetFileTime(file.get(), pCreationTime, nullptr, nullptr));
+        case CTaskManagerDlg::DataSource::kModTask:
+            return ModStatusTable::Kind::kTask;
     }
 
-    return fileContents;
+    throw std::logic_error("Unknown data source");
 }
 
 std::wstring LocalizeStatus(PCWSTR status) {
@@ -108,34 +91,11 @@ bool IsProcessFrozen(DWORD processId) {
 }  // namespace
 
 // static
-bool CTaskManagerDlg::IsDataSourceEmpty(DataSource dataSource) {
-    PCWSTR metadataCategory = nullptr;
-    switch (dataSource) {
-        case DataSource::kModStatus:
-            metadataCategory = L"mod-status";
-            break;
-
-        case DataSource::kModTask:
-            metadataCategory = L"mod-task";
-            break;
-    }
-
-    auto metadataPath =
-        StorageManager::GetInstance().GetModMetadataPath(metadataCategory);
-
-    if (!std::filesystem::exists(metadataPath)) {
-        return true;
-    }
-
-    for (const auto& p : std::filesystem::directory_iterator(metadataPath)) {
-        if (!p.is_regular_file()) {
-            continue;
-        }
-
-        return false;
-    }
-
-    return true;
+bool CTaskManagerDlg::IsDataSourceEmpty(DataSource dataSource,
+                                        DWORD sessionManagerProcessId) {
+    return ModStatusTable::Open(sessionManagerProcessId)
+        .ReadRows(GetModStatusTableKind(dataSource))
+        .empty();
 }
 
 CTaskManagerDlg::CTaskManagerDlg(DialogOptions dialogOptions)
@@ -305,11 +265,35 @@ void CTaskManagerDlg::OnCancel(UINT uNotifyCode, int nID, CWindow wndCtl) {
 }
 
 LRESULT CTaskManagerDlg::OnListRightClick(LPNMHDR pnmh) {
-    // LPNMITEMACTIVATE pnmItemActivate = (LPNMITEMACTIVATE)pnmh;
+    LPNMITEMACTIVATE pnmItemActivate = (LPNMITEMACTIVATE)pnmh;
+
+    if (m_dialogOptions.dataSource != DataSource::kModStatus ||
+        pnmItemActivate->iItem == -1) {
+        return 1;
+    }
+
+    auto* itemData = reinterpret_cast<ListItemData*>(
+        m_taskListSort.GetItemData(pnmItemActivate->iItem));
 
-    // if (m_taskListSort.GetItemCount() == 0) {
-    //     return 1;
-    // }
+    enum {
+        kMenuIdHookCallStats = 1,
+    };
+
+    CMenu menu;
+    menu.CreatePopupMenu();
+    menu.AppendMenu(
+        MF_STRING, kMenuIdHookCallStats,
+        Functions::LoadStrFromRsrc(IDS_TASKDLG_MENU_HOOK_CALL_STATS));
+
+    CPoint point;
+    GetCursorPos(&point);
+    int nCmd = menu.TrackPopupMenu(TPM_RIGHTBUTTON | TPM_RETURNCMD, point.x,
+                                   point.y, m_hWnd);
+    switch (nCmd) {
+        case kMenuIdHookCallStats:
+            ShowHookCallStats(itemData->modName.c_str(), itemData->processId);
+            break;
+    }
 
     return 1;
 }
@@ -431,19 +415,13 @@ void CTaskManagerDlg::LoadTaskList() {
             RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
     });
 
-    PCWSTR metadataCategory = nullptr;
-    switch (m_dialogOptions.dataSource) {
-        case DataSource::kModStatus:
-            metadataCategory = L"mod-status";
-            break;
-
-        case DataSource::kModTask:
-            metadataCategory = L"mod-task";
-            break;
+    if (!m_modStatusTable) {
+        m_modStatusTable.emplace(
+            ModStatusTable::Open(m_dialogOptions.sessionManagerProcessId));
     }
 
-    auto metadataPath =
-        StorageManager::GetInstance().GetModMetadataPath(metadataCategory);
+    auto rows = m_modStatusTable->ReadRows(
+        GetModStatusTableKind(m_dialogOptions.dataSource));
 
     int firstItemIndex = m_taskListSort.GetItemCount();
     int itemIndex = firstItemIndex;
@@ -452,39 +430,26 @@ void CTaskManagerDlg::LoadTaskList() {
     bool isSelectionVisible = selectedIndex == -1
                                   ? false
                                   : m_taskListSort.IsItemVisible(selectedIndex);
-    std::wstring selectedFilePath =
-        selectedIndex == -1 ? std::wstring()
+    const ListItemData* selectedItemData =
+        selectedIndex == -1 ? nullptr
                             : reinterpret_cast<ListItemData*>(
-                                  m_taskListSort.GetItemData(selectedIndex))
-                                  ->filePath;
-
-    if (std::filesystem::exists(metadataPath)) {
-        for (const auto& p :
-             std::filesystem::directory_iterator(metadataPath)) {
-            if (!p.is_regular_file()) {
-                continue;
-            }
-
-            try {
-                if (!LoadTaskItemFromMetadataFile(p.path(), itemIndex)) {
-                    VERBOSE(L"Didn't load %s", p.path().c_str());
-                    continue;
-                }
-
-                if (selectedFilePath == p.path()) {
-                    // Like SelectItem, but without EnsureVisible.
-                    if (m_taskListSort.SetItemState(
-                            itemIndex, LVIS_SELECTED | LVIS_FOCUSED,
-                            LVIS_SELECTED | LVIS_FOCUSED)) {
-                        m_taskListSort.SetSelectionMark(itemIndex);
-                    }
-                }
-
-                itemIndex++;
-            } catch (const std::exception& e) {
-                LOG(L"Error handling %s: %S", p.path().c_str(), e.what());
+                                  m_taskListSort.GetItemData(selectedIndex));
+
+    for (const auto& row : rows) {
+        AddItemToList(itemIndex, row.modName.c_str(), row.processName.c_str(),
+                      row.processId, row.text.c_str(), row.creationTime);
+
+        if (selectedItemData && selectedItemData->modName == row.modName &&
+            selectedItemData->processId == row.processId) {
+            // Like SelectItem, but without EnsureVisible.
+            if (m_taskListSort.SetItemState(itemIndex,
+                                            LVIS_SELECTED | LVIS_FOCUSED,
+                                            LVIS_SELECTED | LVIS_FOCUSED)) {
+                m_taskListSort.SetSelectionMark(itemIndex);
             }
         }
+
+        itemIndex++;
     }
 
     // Remove old items only after adding new items to preserve the scroll
@@ -505,49 +470,7 @@ void CTaskManagerDlg::LoadTaskList() {
     }
 }
 
-bool CTaskManagerDlg::LoadTaskItemFromMetadataFile(
-    const std::filesystem::path& filePath,
-    int itemIndex) {
-    auto filenameParts =
-        Functions::SplitString(filePath.filename().native(), L'_');
-    if (filenameParts.size() != 4) {
-        return false;
-    }
-
-    DWORD sessionManagerProcessId = std::stoul(filenameParts[0]);
-    ULONGLONG sessionManagerProcessCreationTime = std::stoull(filenameParts[1]);
-    if (sessionManagerProcessId != m_dialogOptions.sessionManagerProcessId ||
-        sessionManagerProcessCreationTime !=
-            m_dialogOptions.sessionManagerProcessCreationTime) {
-        // Probably a stale file, try to remove.
-        std::error_code ec;
-        std::filesystem::remove(filePath, ec);
-        return false;
-    }
-
-    DWORD targetProcessId = std::stoul(filenameParts[2]);
-
-    auto& modName = filenameParts[3];
-
-    FILETIME creationTime;
-    std::wstring metadata = GetMetadataContent(filePath.c_str(), &creationTime);
-
-    PCWSTR processName = metadata.c_str();
-    PCWSTR status = L"";
-
-    auto separator = metadata.find(L'|');
-    if (separator != metadata.npos) {
-        metadata[separator] = L'\0';
-        status = metadata.c_str() + separator + 1;
-    }
-
-    AddItemToList(itemIndex, filePath.c_str(), modName.c_str(), processName,
-                  targetProcessId, status, creationTime);
-    return true;
-}
-
 void CTaskManagerDlg::AddItemToList(int itemIndex,
-                                    PCWSTR filePath,
                                     PCWSTR mod,
                                     PCWSTR processName,
                                     DWORD processId,
@@ -586,11 +509,13 @@ void CTaskManagerDlg::AddItemToList(int itemIndex,
     }
 
     auto* itemData = new ListItemData{
-        .filePath = filePath,
+        .modName = mod,
         .processName = processName,
         .processId = processId,
         .creationTime = wil::filetime::to_int64(creationTime),
         .isFrozen = isFrozen,
+        .process = wil::unique_process_handle(
+            OpenProcess(SYNCHRONIZE, FALSE, processId)),
         .executionRequiredRequestProcess =
             std::move(executionRequiredRequestProcess),
         .executionRequiredRequest = std::move(executionRequiredRequest),
@@ -599,6 +524,74 @@ void CTaskManagerDlg::AddItemToList(int itemIndex,
                                reinterpret_cast<DWORD_PTR>(itemData));
 }
 
+void CTaskManagerDlg::ShowHookCallStats(PCWSTR modName, DWORD processId) {
+    std::vector<ModStatusTable::Row> rows;
+    try {
+        rows = ModStatusTable::Open(m_dialogOptions.sessionManagerProcessId)
+                   .ReadRows(ModStatusTable::Kind::kHookCalls);
+    } catch (const std::exception& e) {
+        LOG(L"Failed to read hook call stats: %S", e.what());
+    }
+
+    struct HookCallStats {
+        std::wstring_view target;
+        LONG64 callCount;
+        LONG64 callsPerSecond;
+    };
+
+    std::vector<HookCallStats> stats;
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+
+    for (const auto& row : rows) {
+        if (row.processId != processId || row.modName != modName) {
+            continue;
+        }
+
+        LONG64 callCount = row.metrics[static_cast<size_t>(
+            ModStatusTable::Metric::kHookCalls)];
+
+        // The row is claimed on the first call of the function, so the rate is
+        // the average since then.
+        LONG64 elapsedSeconds = (wil::filetime::to_int64(now) -
+                                 wil::filetime::to_int64(row.creationTime)) /
+                                wil::filetime_duration::one_second;
+
+        stats.push_back({
+            .target = row.text,
+            .callCount = callCount,
+            .callsPerSecond = callCount / std::max(elapsedSeconds, 1LL),
+        });
+    }
+
+    if (stats.empty()) {
+        MessageBox(
+            Functions::LoadStrFromRsrc(IDS_TASKDLG_HOOK_CALL_STATS_EMPTY),
+            Functions::LoadStrFromRsrc(IDS_TASKDLG_HOOK_CALL_STATS_TITLE),
+            MB_ICONINFORMATION);
+        return;
+    }
+
+    // Show the hottest hooks first.
+    std::ranges::stable_sort(stats, std::ranges::greater{},
+                             &HookCallStats::callsPerSecond);
+
+    std::wstring text;
+    for (const auto& item : stats) {
+        text += item.target;
+        text += L": ";
+        text += std::to_wstring(item.callCount);
+        text += L" (";
+        text += std::to_wstring(item.callsPerSecond);
+        text += L"/s)\n";
+    }
+
+    MessageBox(text.c_str(),
+               Functions::LoadStrFromRsrc(IDS_TASKDLG_HOOK_CALL_STATS_TITLE),
+               MB_ICONINFORMATION);
+}
+
 void CTaskManagerDlg::RefreshTaskList() {
     try {
         LoadTaskList();
@@ -624,6 +617,14 @@ void CTaskManagerDlg::UpdateTaskListProcessesStatus() {
         auto* itemData =
             reinterpret_cast<ListItemData*>(m_taskListSort.GetItemData(i));
 
+        if (itemData->process &&
+            WaitForSingleObject(itemData->process.get(), 0) ==
+                WAIT_OBJECT_0) {
+            // Rows of exited processes are left in the table, reload the list
+            // to drop them.
+            DataChanged();
+        }
+
         bool isFrozen = IsProcessFrozen(itemData->processId);
         if (isFrozen == itemData->isFrozen) {
             continue;
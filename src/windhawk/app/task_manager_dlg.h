@@ -1,5 +1,6 @@
 #pragma once
 
+#include "mod_status_table.h"
 #include "resource.h"
 
 class CTaskManagerDlg : public CDialogImpl<CTaskManagerDlg>,
@@ -29,12 +30,12 @@ class CTaskManagerDlg : public CDialogImpl<CTaskManagerDlg>,
         bool autonomousMode = false;
         int autonomousModeShowDelay = kAutonomousModeShowDelayDefault;
         DWORD sessionManagerProcessId{};
-        ULONGLONG sessionManagerProcessCreationTime{};
         DlgCallback runButtonCallback;
         DlgCallback finalMessageCallback;
     };
 
-    static bool IsDataSourceEmpty(DataSource dataSource);
+    static bool IsDataSourceEmpty(DataSource dataSource,
+                                  DWORD sessionManagerProcessId);
 
     CTaskManagerDlg(DialogOptions dialogOptions);
 
@@ -76,10 +77,7 @@ class CTaskManagerDlg : public CDialogImpl<CTaskManagerDlg>,
     void PlaceWindowAtTrayArea();
     void InitTaskList();
     void LoadTaskList();
-    bool LoadTaskItemFromMetadataFile(const std::filesystem::path& filePath,
-                                      int itemIndex);
     void AddItemToList(int itemIndex,
-                       PCWSTR filePath,
                        PCWSTR mod,
                        PCWSTR processName,
                        DWORD processId,
@@ -87,10 +85,12 @@ class CTaskManagerDlg : public CDialogImpl<CTaskManagerDlg>,
                        FILETIME creationTime);
     void RefreshTaskList();
     void UpdateTaskListProcessesStatus();
+    void ShowHookCallStats(PCWSTR modName, DWORD processId);
     void UpdateDialogAfterListUpdate();
 
     const DialogOptions m_dialogOptions;
     CSortListViewCtrl m_taskListSort;
+    std::optional<ModStatusTable> m_modStatusTable;
     bool m_refreshListOnDataChangePending = false;
     bool m_showDlgPending = false;
 };
@@ -4,9 +4,9 @@
 #include "dll_inject.h"
 #include "functions.h"
 #include "logger.h"
-#include "process_lists.h"
 #include "session_private_namespace.h"
 #include "storage_manager.h"
+#include "trace_recorder.h"
 #include "var_init_once.h"
 
 #ifndef STATUS_NO_MORE_ENTRIES
@@ -49,6 +49,17 @@ struct __declspec(align(16)) MY_CONTEXT_AMD64 {
 
 #define MY_CONTEXT_AMD64_CONTROL 0x100001
 
+std::filesystem::path GetLoggingJsonFilePath() {
+    try {
+        auto settings = StorageManager::GetInstance().GetAppConfig(L"Settings");
+        return settings->GetString(L"LoggingJsonFile").value_or(L"");
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+
+    return {};
+}
+
 USHORT GetNativeMachineImpl() {
     using IsWow64Process2_t = BOOL(WINAPI*)(
         HANDLE hProcess, USHORT * pProcessMachine, USHORT * pNativeMachine);
@@ -182,6 +193,18 @@ HANDLE OpenProcessInitAPCMutex(DWORD processId, DWORD desiredAccess) {
 }  // namespace
 
 AllProcessesInjector::AllProcessesInjector() {
+    if (TraceRecorder::IsEnabled()) {
+        TraceRecorder::DeleteFiles();
+    }
+
+    // Hook call statistics used to be written to files, which were left
+    // behind by processes that didn't exit cleanly. They're now in the mod
+    // status table.
+    std::error_code ec;
+    std::filesystem::remove_all(
+        StorageManager::GetInstance().GetModMetadataPath(L"mod-hook-stats"),
+        ec);
+
     HMODULE hNtdll = GetModuleHandle(L"ntdll.dll");
     THROW_LAST_ERROR_IF_NULL(hNtdll);
 
@@ -215,38 +238,48 @@ AllProcessesInjector::AllProcessesInjector() {
     m_appPrivateNamespace =
         SessionPrivateNamespace::Create(GetCurrentProcessId());
 
-    auto settings = StorageManager::GetInstance().GetAppConfig(L"Settings");
-    m_includePattern = settings->GetString(L"Include").value_or(L"");
-    m_excludePattern = settings->GetString(L"Exclude").value_or(L"");
-    m_threadAttachExemptPattern =
-        settings->GetString(L"ThreadAttachExempt").value_or(L"");
-
-    if (!settings->GetInt(L"InjectIntoCriticalProcesses").value_or(0)) {
-        if (!m_excludePattern.empty()) {
-            m_excludePattern += L'|';
-        }
-
-        m_excludePattern += ProcessLists::kCriticalProcesses;
+    try {
+        m_configMirrorPublisher.emplace();
+    } catch (const std::exception& e) {
+        // Injected processes read the config from the storage in this case.
+        LOG(L"ConfigMirrorPublisher constructor failed: %S", e.what());
     }
 
-    if (!settings->GetInt(L"InjectIntoIncompatiblePrograms").value_or(0)) {
-        if (!m_excludePattern.empty()) {
-            m_excludePattern += L'|';
-        }
+    try {
+        m_modStatusTable.emplace(ModStatusTable::Create());
+    } catch (const std::exception& e) {
+        // Mod statuses and tasks aren't reported in this case.
+        LOG(L"ModStatusTable::Create failed: %S", e.what());
+    }
 
-        m_excludePattern += ProcessLists::kIncompatiblePrograms;
+    try {
+        m_logRingBufferConsumer.emplace(GetLoggingJsonFilePath());
+    } catch (const std::exception& e) {
+        // Injected processes write to the debugger output directly in this
+        // case.
+        LOG(L"LogRingBufferConsumer constructor failed: %S", e.what());
     }
 
-    if (!settings->GetInt(L"InjectIntoGames").value_or(0)) {
-        if (!m_excludePattern.empty()) {
-            m_excludePattern += L'|';
-        }
+    UpdateModTargetFilter();
+}
 
-        m_excludePattern += ProcessLists::kGames;
+AllProcessesInjector::~AllProcessesInjector() {
+    if (TraceRecorder::IsEnabled()) {
+        // Injected processes write their files after initializing and when
+        // their session ends, so the merged timeline includes at least the
+        // startup of each of them.
+        try {
+            TraceRecorder::GetInstance().WriteProcessFile();
+            TraceRecorder::MergeFiles();
+        } catch (const std::exception& e) {
+            LOG(L"Writing the trace files failed: %S", e.what());
+        }
     }
 }
 
 int AllProcessesInjector::InjectIntoNewProcesses() noexcept {
+    UpdateModTargetFilter();
+
     int count = 0;
 
     while (true) {
@@ -279,10 +312,12 @@ int AllProcessesInjector::InjectIntoNewProcesses() noexcept {
 
         try {
             bool threadAttachExempt;
+            bool propagationOnly;
             if (!ShouldSkipNewProcess(hNewProcess, dwNewProcessId,
-                                      &threadAttachExempt)) {
+                                      &threadAttachExempt, &propagationOnly)) {
+                TraceRecorder::Span span("InjectIntoNewProcess");
                 InjectIntoNewProcess(hNewProcess, dwNewProcessId,
-                                     threadAttachExempt);
+                                     threadAttachExempt, propagationOnly);
                 count++;
             }
         } catch (const std::exception& e) {
@@ -299,27 +334,58 @@ int AllProcessesInjector::InjectIntoNewProcesses() noexcept {
     return count;
 }
 
+void AllProcessesInjector::UpdateModTargetFilter() noexcept {
+    std::optional<DWORD> configChangeCount;
+    if (m_configMirrorPublisher) {
+        configChangeCount = m_configMirrorPublisher->GetConfigChangeCount();
+    }
+
+    if (configChangeCount == m_modTargetFilterConfigChangeCount) {
+        return;
+    }
+
+    m_modTargetFilterConfigChangeCount = configChangeCount;
+    m_modTargetFilter.reset();
+
+    if (configChangeCount) {
+        try {
+            m_modTargetFilter.emplace();
+        } catch (const std::exception& e) {
+            LOG(L"ModTargetFilter constructor failed: %S", e.what());
+        }
+    }
+}
+
 bool AllProcessesInjector::ShouldSkipNewProcess(HANDLE hProcess,
                                                 DWORD dwProcessId,
-                                                bool* threadAttachExempt) {
+                                                bool* threadAttachExempt,
+                                                bool* propagationOnly) {
     auto processImageName =
         wil::QueryFullProcessImageName<std::wstring>(hProcess);
 
-    if (Functions::DoesPathMatchPattern(processImageName, m_excludePattern) &&
-        !Functions::DoesPathMatchPattern(processImageName, m_includePattern)) {
+    auto decision = m_injectionFilter.Decide(processImageName);
+    if (decision.skip) {
         VERBOSE(L"Skipping excluded process %u", dwProcessId);
         return true;
     }
 
-    *threadAttachExempt = Functions::DoesPathMatchPattern(
-        processImageName, m_threadAttachExemptPattern);
+    *threadAttachExempt = decision.threadAttachExempt;
+
+    // Not skipped even if no mod targets it, so that its children are
+    // injected into when they're created.
+    *propagationOnly = m_modTargetFilter &&
+                       !m_modTargetFilter->MightBeTargeted(processImageName);
+    if (*propagationOnly) {
+        VERBOSE(L"Process %u isn't targeted by any mod", dwProcessId);
+    }
 
     return false;
 }
 
 void AllProcessesInjector::InjectIntoNewProcess(HANDLE hProcess,
                                                 DWORD dwProcessId,
-                                                bool threadAttachExempt) {
+                                                bool threadAttachExempt,
+                                                bool propagationOnly) {
     // We check whether the process began running or not. If it didn't, it's
     // supposed to have only one thread which has its instruction pointer at
     // RtlUserThreadStart. For other cases, we assume the main thread was
@@ -424,7 +490,7 @@ void AllProcessesInjector::InjectIntoNewProcess(HANDLE hProcess,
 
             DllInject::DllInject(hProcess, suspendedThread.get(),
                                  GetCurrentProcess(), mutex.get(),
-                                 threadAttachExempt);
+                                 threadAttachExempt, propagationOnly);
             VERBOSE(L"DllInject succeeded for new process %u via APC",
                     dwProcessId);
 
@@ -439,7 +505,7 @@ void AllProcessesInjector::InjectIntoNewProcess(HANDLE hProcess,
     }
 
     DllInject::DllInject(hProcess, nullptr, GetCurrentProcess(), nullptr,
-                         threadAttachExempt);
+                         threadAttachExempt, propagationOnly);
     VERBOSE(L"DllInject succeeded for new process %u via a remote thread",
             dwProcessId);
 }
@@ -1,18 +1,27 @@
 #pragma once
 
+#include "config_mirror.h"
+#include "injection_filter.h"
+#include "log_ring_buffer.h"
+#include "mod_status_table.h"
+
 class AllProcessesInjector {
    public:
     AllProcessesInjector();
+    ~AllProcessesInjector();
 
     int InjectIntoNewProcesses() noexcept;
 
    private:
+    void UpdateModTargetFilter() noexcept;
     bool ShouldSkipNewProcess(HANDLE hProcess,
                               DWORD dwProcessId,
-                              bool* threadAttachExempt);
+                              bool* threadAttachExempt,
+                              bool* propagationOnly);
     void InjectIntoNewProcess(HANDLE hProcess,
                               DWORD dwProcessId,
-                              bool threadAttachExempt);
+                              bool threadAttachExempt,
+                              bool propagationOnly);
 
     using NtGetNextProcess_t = NTSTATUS(NTAPI*)(_In_opt_ HANDLE ProcessHandle,
                                                 _In_ ACCESS_MASK DesiredAccess,
@@ -32,8 +41,15 @@ class AllProcessesInjector {
     DWORD64 m_pRtlUserThreadStart = 0;
     DWORD64 m_pRtlUserThreadStart_x64OnArm64 = 0;
     wil::unique_private_namespace_destroy m_appPrivateNamespace;
-    std::wstring m_includePattern;
-    std::wstring m_excludePattern;
-    std::wstring m_threadAttachExemptPattern;
+    std::optional<ConfigMirrorPublisher> m_configMirrorPublisher;
+    std::optional<ModStatusTable> m_modStatusTable;
+    std::optional<LogRingBufferConsumer> m_logRingBufferConsumer;
+    InjectionFilter m_injectionFilter;
     wil::unique_process_handle m_lastEnumeratedProcess;
+    // Processes which no mod targets get a propagation-only session, which
+    // only injects into their children, and loads mods once a mod config
+    // change makes the process targeted. Without a filter, for example if mod
+    // config changes can't be tracked, all processes get a full session.
+    std::optional<ModTargetFilter> m_modTargetFilter;
+    std::optional<DWORD> m_modTargetFilterConfigChangeCount;
 };
@@ -0,0 +1,455 @@
+#include "stdafx.h"
+
+#include "config_mirror.h"
+#include "logger.h"
+#include "session_private_namespace.h"
+
+namespace {
+
+struct ConfigMirrorHeader {
+    // The sequence number of the current snapshot, zero until the first
+    // snapshot is published or after the mirror is invalidated. A 32-bit value
+    // is used, since 64-bit reads aren't atomic in 32-bit processes.
+    volatile LONG sequence;
+};
+
+// Readers might be in the middle of switching snapshots while a new one is
+// published, in which case the objects they're looking for might be gone.
+constexpr int kReaderUpdateAttempts = 5;
+
+// A failed publish, for example due to a transient error while the storage is
+// being written, is retried a few times before the mirror is invalidated.
+constexpr int kPublishRetryAttempts = 5;
+constexpr DWORD kPublishRetryDelay = 1000;
+
+std::wstring MakeObjectName(DWORD sessionManagerProcessId, PCWSTR objectName) {
+    WCHAR sessionPrivateNamespaceName
+        [SessionPrivateNamespace::kPrivateNamespaceMaxLen + 1];
+    SessionPrivateNamespace::MakeName(sessionPrivateNamespaceName,
+                                      sessionManagerProcessId);
+
+    std::wstring name = sessionPrivateNamespaceName;
+    name += L'\\';
+    name += objectName;
+    return name;
+}
+
+std::wstring MakeObjectName(DWORD sessionManagerProcessId,
+                            PCWSTR objectName,
+                            DWORD sequence) {
+    return MakeObjectName(sessionManagerProcessId, objectName) + L'-' +
+           std::to_wstring(sequence);
+}
+
+// Allows the processes the engine runs in to open the object with the given
+// access only: processes of interactively logged on users, including app
+// containers, and system processes. Processes with a lower integrity level
+// than low, and restricted app containers, can't open the object, and read the
+// config from the storage if they can. The session manager process keeps full
+// access through the handles it creates.
+//
+// SY - Local System
+// IU - Interactive Users
+// S-1-15-2-1 - All Application Packages
+// LW - Low Mandatory Level, with the No Read-Up and No Write-Up policies
+wil::unique_hlocal CreateReadOnlySecurityDescriptor(DWORD access) {
+    WCHAR stringSecurityDescriptor[256];
+    swprintf_s(stringSecurityDescriptor,
+               L"D:P(A;;0x%08X;;;SY)(A;;0x%08X;;;IU)"
+               L"(A;;0x%08X;;;S-1-15-2-1)S:(ML;;NRNW;;;LW)",
+               access, access, access);
+
+    wil::unique_hlocal secDesc;
+    THROW_IF_WIN32_BOOL_FALSE(
+        ConvertStringSecurityDescriptorToSecurityDescriptor(
+            stringSecurityDescriptor, SDDL_REVISION_1, &secDesc, nullptr));
+
+    return secDesc;
+}
+
+wil::unique_handle CreateReadOnlyFileMapping(PCWSTR name, size_t size) {
+    auto secDesc = CreateReadOnlySecurityDescriptor(FILE_MAP_READ);
+
+    SECURITY_ATTRIBUTES secAttr = {sizeof(SECURITY_ATTRIBUTES)};
+    secAttr.lpSecurityDescriptor = secDesc.get();
+    secAttr.bInheritHandle = FALSE;
+
+    ULONGLONG mappingSize = size;
+    wil::unique_handle fileMapping(CreateFileMapping(
+        INVALID_HANDLE_VALUE, &secAttr, PAGE_READWRITE,
+        static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize),
+        name));
+    THROW_LAST_ERROR_IF(!fileMapping || GetLastError() == ERROR_ALREADY_EXISTS);
+
+    return fileMapping;
+}
+
+wil::unique_private_namespace_close OpenSessionPrivateNamespace(
+    DWORD sessionManagerProcessId) {
+    // The namespace is already available in the session manager process.
+    if (sessionManagerProcessId == GetCurrentProcessId()) {
+        return {};
+    }
+
+    return SessionPrivateNamespace::Open(sessionManagerProcessId);
+}
+
+// Appends the values to `config`, in a form which can be compared to find
+// changed values.
+void AppendConfigValues(std::wstring& config,
+                        const std::wstring& name,
+                        const std::wstring& value) {
+    for (const auto* str : {&name, &value}) {
+        config += std::to_wstring(str->length());
+        config += L':';
+        config += *str;
+    }
+}
+
+struct MappedSnapshot {
+    wil::unique_mapview_ptr<void> view;
+    std::optional<ConfigSnapshot::Reader> reader;
+};
+
+std::shared_ptr<const ConfigSnapshot::Reader> MapSnapshot(HANDLE fileMapping) {
+    auto mappedSnapshot = std::make_shared<MappedSnapshot>();
+
+    mappedSnapshot->view.reset(
+        MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0));
+    THROW_LAST_ERROR_IF(!mappedSnapshot->view);
+
+    // The view size is the section size rounded up to the page size.
+    MEMORY_BASIC_INFORMATION memoryInfo;
+    THROW_LAST_ERROR_IF(VirtualQuery(mappedSnapshot->view.get(), &memoryInfo,
+                                     sizeof(memoryInfo)) == 0);
+
+    mappedSnapshot->reader.emplace(mappedSnapshot->view.get(),
+                                   memoryInfo.RegionSize);
+
+    // Share the ownership of the view with the reader.
+    return std::shared_ptr<const ConfigSnapshot::Reader>(
+        mappedSnapshot, &*mappedSnapshot->reader);
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// ConfigMirrorPublisher
+
+ConfigMirrorPublisher::ConfigMirrorPublisher() {
+    m_modConfigChangeNotification.emplace();
+    if (!m_modConfigChangeNotification->CanMonitorAcrossThreads()) {
+        throw std::runtime_error(
+            "Config change notifications can't be monitored from the thread "
+            "pool");
+    }
+
+    m_headerMapping = CreateReadOnlyFileMapping(
+        MakeObjectName(GetCurrentProcessId(), L"ConfigMirror").c_str(),
+        sizeof(ConfigMirrorHeader));
+
+    m_headerView.reset(
+        MapViewOfFile(m_headerMapping.get(), FILE_MAP_WRITE, 0, 0, 0));
+    THROW_LAST_ERROR_IF(!m_headerView);
+
+    Publish();
+
+    m_publishRetryTimer.reset(
+        CreateThreadpoolTimer(PublishRetryTimerCallback, this, nullptr));
+    THROW_LAST_ERROR_IF_NULL(m_publishRetryTimer);
+
+    m_configChangedWait.reset(
+        CreateThreadpoolWait(ConfigChangedCallback, this, nullptr));
+    THROW_LAST_ERROR_IF_NULL(m_configChangedWait);
+
+    SetThreadpoolWait(m_configChangedWait.get(),
+                      m_modConfigChangeNotification->GetHandle(), nullptr);
+}
+
+// static
+void CALLBACK
+ConfigMirrorPublisher::ConfigChangedCallback(PTP_CALLBACK_INSTANCE instance,
+                                             PVOID context,
+                                             PTP_WAIT wait,
+                                             TP_WAIT_RESULT waitResult) {
+    auto* this_ = static_cast<ConfigMirrorPublisher*>(context);
+
+    try {
+        this_->m_modConfigChangeNotification->ContinueMonitoring();
+    } catch (const std::exception& e) {
+        // Without monitoring, there's no way to know when to publish. Readers
+        // go back to reading the storage, which they monitor themselves.
+        LOG(L"ContinueMonitoring failed, no longer publishing: %S", e.what());
+        this_->m_monitoringStopped = true;
+
+        std::lock_guard<std::mutex> guard(this_->m_publishMutex);
+        this_->m_publishRetryCount = 0;
+        this_->Invalidate();
+        return;
+    }
+
+    this_->m_configChangeCount++;
+
+    this_->PublishOrScheduleRetry();
+
+    SetThreadpoolWait(wait, this_->m_modConfigChangeNotification->GetHandle(),
+                      nullptr);
+}
+
+// static
+void CALLBACK ConfigMirrorPublisher::PublishRetryTimerCallback(
+    PTP_CALLBACK_INSTANCE instance,
+    PVOID context,
+    PTP_TIMER timer) {
+    auto* this_ = static_cast<ConfigMirrorPublisher*>(context);
+
+    {
+        // A config change might have been published in the meantime, or the
+        // mirror might have been invalidated.
+        std::lock_guard<std::mutex> guard(this_->m_publishMutex);
+        if (this_->m_publishRetryCount == 0) {
+            return;
+        }
+    }
+
+    this_->PublishOrScheduleRetry();
+}
+
+std::optional<DWORD> ConfigMirrorPublisher::GetConfigChangeCount() const {
+    if (m_monitoringStopped) {
+        return std::nullopt;
+    }
+
+    return m_configChangeCount;
+}
+
+ConfigSnapshot::Builder ConfigMirrorPublisher::BuildSnapshot(DWORD sequence) {
+    auto& storageManager = StorageManager::GetInstance();
+
+    ConfigSnapshot::Builder builder;
+
+    auto addSection = [&builder](std::wstring_view sectionName,
+                                 const PortableSettings& settings,
+                                 std::wstring* config) {
+        builder.AddSection(sectionName);
+        for (auto it = settings.EnumStringValues(); it; ++it) {
+            builder.SetValue(sectionName, it->first, it->second);
+            if (config) {
+                AppendConfigValues(*config, it->first, it->second);
+            }
+        }
+    };
+
+    addSection(L"Settings", *storageManager.GetAppConfig(L"Settings"),
+               nullptr);
+
+    // A mod's generation is the sequence of the snapshot in which its config
+    // last changed. It's derived from the config itself, so that changes are
+    // detected no matter which writer made them.
+    std::unordered_map<std::wstring, ModConfigState> newModConfigStates;
+
+    storageManager.EnumMods([&](PCWSTR modName) {
+        std::wstring sectionName = L"Mods\\";
+        sectionName += modName;
+
+        std::wstring config;
+        addSection(sectionName, *storageManager.GetModConfig(modName, nullptr),
+                   &config);
+        config += L'\n';
+        addSection(sectionName + L"\\Settings",
+                   *storageManager.GetModConfig(modName, L"Settings"),
+                   &config);
+
+        DWORD generation = sequence;
+        if (auto it = m_modConfigStates.find(modName);
+            it != m_modConfigStates.end() && it->second.config == config) {
+            generation = it->second.generation;
+        }
+
+        newModConfigStates.try_emplace(modName,
+                                       ModConfigState{std::move(config),
+                                                      generation});
+    });
+
+    builder.AddSection(L"Mods");
+    for (const auto& [modName, state] : newModConfigStates) {
+        builder.SetValue(L"Mods", modName, std::to_wstring(state.generation));
+    }
+
+    m_modConfigStates = std::move(newModConfigStates);
+
+    return builder;
+}
+
+void ConfigMirrorPublisher::Publish() {
+    DWORD sequence = m_sequence + 1;
+
+    auto data = BuildSnapshot(sequence).Serialize(sequence);
+
+    auto snapshotMapping = CreateReadOnlyFileMapping(
+        MakeObjectName(GetCurrentProcessId(), L"ConfigMirror", sequence)
+            .c_str(),
+        data.size());
+
+    {
+        wil::unique_mapview_ptr<void> snapshotView(
+            MapViewOfFile(snapshotMapping.get(), FILE_MAP_WRITE, 0, 0, 0));
+        THROW_LAST_ERROR_IF(!snapshotView);
+
+        memcpy(snapshotView.get(), data.data(), data.size());
+    }
+
+    auto eventSecDesc = CreateReadOnlySecurityDescriptor(SYNCHRONIZE);
+
+    SECURITY_ATTRIBUTES eventSecAttr = {sizeof(SECURITY_ATTRIBUTES)};
+    eventSecAttr.lpSecurityDescriptor = eventSecDesc.get();
+    eventSecAttr.bInheritHandle = FALSE;
+
+    wil::unique_event snapshotReplacedEvent;
+    snapshotReplacedEvent.create(
+        wil::EventOptions::ManualReset,
+        MakeObjectName(GetCurrentProcessId(), L"ConfigMirrorReplaced", sequence)
+            .c_str(),
+        &eventSecAttr);
+
+    auto* header = static_cast<ConfigMirrorHeader*>(m_headerView.get());
+    InterlockedExchange(&header->sequence, static_cast<LONG>(sequence));
+
+    if (m_snapshotReplacedEvent) {
+        m_snapshotReplacedEvent.SetEvent();
+    }
+
+    m_sequence = sequence;
+    m_snapshotMapping = std::move(snapshotMapping);
+    m_snapshotReplacedEvent = std::move(snapshotReplacedEvent);
+
+    VERBOSE(L"Published config snapshot %u, %zu bytes", sequence, data.size());
+}
+
+void ConfigMirrorPublisher::PublishOrScheduleRetry() {
+    std::lock_guard<std::mutex> guard(m_publishMutex);
+
+    try {
+        Publish();
+        m_publishRetryCount = 0;
+        return;
+    } catch (const std::exception& e) {
+        LOG(L"Publishing the config failed (attempt %d): %S",
+            m_publishRetryCount + 1, e.what());
+    }
+
+    if (m_publishRetryCount < kPublishRetryAttempts) {
+        m_publishRetryCount++;
+
+        FILETIME dueTime = wil::filetime::from_int64(
+            -static_cast<INT64>(kPublishRetryDelay) *
+            wil::filetime_duration::one_millisecond);
+        SetThreadpoolTimer(m_publishRetryTimer.get(), &dueTime, 0, 0);
+        return;
+    }
+
+    // Don't leave readers with a stale snapshot. The next config change
+    // publishes a new one, which new processes pick up.
+    m_publishRetryCount = 0;
+    Invalidate();
+}
+
+void ConfigMirrorPublisher::Invalidate() {
+    auto* header = static_cast<ConfigMirrorHeader*>(m_headerView.get());
+    InterlockedExchange(&header->sequence, 0);
+
+    if (m_snapshotReplacedEvent) {
+        m_snapshotReplacedEvent.SetEvent();
+    }
+
+    m_snapshotMapping.reset();
+    m_snapshotReplacedEvent.reset();
+
+    LOG(L"Config mirror invalidated");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ConfigMirrorReader
+
+ConfigMirrorReader::ConfigMirrorReader(DWORD sessionManagerProcessId)
+    : m_sessionManagerProcessId(sessionManagerProcessId) {
+    auto privateNamespace =
+        OpenSessionPrivateNamespace(m_sessionManagerProcessId);
+
+    wil::unique_handle headerMapping(OpenFileMapping(
+        FILE_MAP_READ, FALSE,
+        MakeObjectName(m_sessionManagerProcessId, L"ConfigMirror").c_str()));
+    THROW_LAST_ERROR_IF(!headerMapping);
+
+    m_headerView.reset(
+        MapViewOfFile(headerMapping.get(), FILE_MAP_READ, 0, 0, 0));
+    THROW_LAST_ERROR_IF(!m_headerView);
+
+    Update();
+}
+
+ConfigMirrorReader::~ConfigMirrorReader() {
+    StorageManager::GetInstance().SetConfigSnapshot(nullptr);
+}
+
+HANDLE ConfigMirrorReader::GetChangeEvent() {
+    return m_snapshotReplacedEvent.get();
+}
+
+void ConfigMirrorReader::Update() {
+    auto& storageManager = StorageManager::GetInstance();
+
+    try {
+        auto privateNamespace =
+            OpenSessionPrivateNamespace(m_sessionManagerProcessId);
+
+        auto* header =
+            static_cast<const ConfigMirrorHeader*>(m_headerView.get());
+
+        for (int attempt = 1;; attempt++) {
+            DWORD sequence =
+                static_cast<DWORD>(ReadAcquire(&header->sequence));
+            if (sequence == 0) {
+                throw std::runtime_error("No config snapshot is available");
+            }
+
+            auto eventName = MakeObjectName(m_sessionManagerProcessId,
+                                            L"ConfigMirrorReplaced", sequence);
+            auto mappingName = MakeObjectName(m_sessionManagerProcessId,
+                                              L"ConfigMirror", sequence);
+
+            // Open the event first, so that a snapshot which is published
+            // after the one being mapped isn't missed.
+            wil::unique_event_nothrow snapshotReplacedEvent(
+                OpenEvent(SYNCHRONIZE, FALSE, eventName.c_str()));
+            wil::unique_handle snapshotMapping;
+            if (snapshotReplacedEvent) {
+                snapshotMapping.reset(
+                    OpenFileMapping(FILE_MAP_READ, FALSE, mappingName.c_str()));
+            }
+
+            if (!snapshotMapping) {
+                // The snapshot was replaced in the meantime, try again.
+                DWORD error = GetLastError();
+                if (error == ERROR_FILE_NOT_FOUND &&
+                    attempt < kReaderUpdateAttempts) {
+                    continue;
+                }
+
+                THROW_WIN32(error);
+            }
+
+            auto snapshot = MapSnapshot(snapshotMapping.get());
+            if (snapshot->GetSequence() != sequence) {
+                throw std::runtime_error("Config snapshot sequence mismatch");
+            }
+
+            storageManager.SetConfigSnapshot(std::move(snapshot));
+            m_snapshotReplacedEvent = std::move(snapshotReplacedEvent);
+            return;
+        }
+    } catch (...) {
+        storageManager.SetConfigSnapshot(nullptr);
+        throw;
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "config_snapshot.h"
+#include "storage_manager.h"
+
+// The session manager process publishes a snapshot of the engine config in its
+// session private namespace, and the engine in the other processes reads the
+// config from the snapshot instead of the registry or the INI files. This way,
+// a config change is read once instead of once per process, and processes
+// which can't access the storage, such as app container processes, can still
+// read the config.
+//
+// Each published snapshot is an immutable section object. A small header
+// section holds the sequence number of the current snapshot, and an event per
+// snapshot is set once the snapshot is replaced by a newer one.
+//
+// The snapshot mirrors the registry layout under the engine key: the app
+// config sections, such as "Settings", and the mod config sections, such as
+// "Mods\<name>" and "Mods\<name>\Settings". The values of the "Mods" section
+// are the mod generations, which the publisher bumps for each mod whose config
+// changed, so that readers only have to re-read the changed mods.
+//
+// If publishing keeps failing, or config changes can no longer be monitored,
+// the mirror is invalidated: the header is reset and the replaced event of the
+// current snapshot is set. Readers then go back to reading the storage instead
+// of using a stale snapshot.
+
+// Runs in the session manager process. Publishes a new snapshot whenever the
+// mods config changes.
+class ConfigMirrorPublisher {
+   public:
+    // The session private namespace must already exist.
+    ConfigMirrorPublisher();
+
+    ConfigMirrorPublisher(const ConfigMirrorPublisher&) = delete;
+    ConfigMirrorPublisher& operator=(const ConfigMirrorPublisher&) = delete;
+
+    // Incremented on each mods config change, even if publishing fails. If
+    // changes are no longer monitored, returns std::nullopt. Can be called
+    // from any thread.
+    std::optional<DWORD> GetConfigChangeCount() const;
+
+   private:
+    static void CALLBACK ConfigChangedCallback(PTP_CALLBACK_INSTANCE instance,
+                                               PVOID context,
+                                               PTP_WAIT wait,
+                                               TP_WAIT_RESULT waitResult);
+    static void CALLBACK PublishRetryTimerCallback(
+        PTP_CALLBACK_INSTANCE instance,
+        PVOID context,
+        PTP_TIMER timer);
+
+    // The config of a mod as of the last published snapshot.
+    struct ModConfigState {
+        std::wstring config;
+        DWORD generation;
+    };
+
+    ConfigSnapshot::Builder BuildSnapshot(DWORD sequence);
+    void Publish();
+    // Publishes, and on failure, schedules a retry. Invalidates the mirror
+    // once the retries are used up.
+    void PublishOrScheduleRetry();
+    void Invalidate();
+
+    wil::unique_handle m_headerMapping;
+    wil::unique_mapview_ptr<void> m_headerView;
+    std::atomic<DWORD> m_configChangeCount = 0;
+    std::atomic<bool> m_monitoringStopped = false;
+    // Serializes publishing between the config change and the retry
+    // callbacks.
+    std::mutex m_publishMutex;
+    int m_publishRetryCount = 0;
+    DWORD m_sequence = 0;
+    std::unordered_map<std::wstring, ModConfigState> m_modConfigStates;
+    // The objects of the current snapshot. Readers keep their own handles, so
+    // the objects of older snapshots are freed once no longer used.
+    wil::unique_handle m_snapshotMapping;
+    wil::unique_event m_snapshotReplacedEvent;
+    std::optional<StorageManager::ModConfigChangeNotification>
+        m_modConfigChangeNotification;
+    // Must be last, so that they're destroyed, and pending callbacks are
+    // waited for, before the rest of the members. The wait is destroyed first,
+    // since its callback might schedule the timer.
+    wil::unique_threadpool_timer m_publishRetryTimer;
+    wil::unique_threadpool_wait m_configChangedWait;
+};
+
+// Runs in the processes with a customization session. While it exists, the
+// current snapshot is used by StorageManager.
+class ConfigMirrorReader {
+   public:
+    ConfigMirrorReader(DWORD sessionManagerProcessId);
+    ~ConfigMirrorReader();
+
+    ConfigMirrorReader(const ConfigMirrorReader&) = delete;
+    ConfigMirrorReader& operator=(const ConfigMirrorReader&) = delete;
+
+    // Signaled once a newer snapshot is published.
+    HANDLE GetChangeEvent();
+    // Switches to the newest snapshot. If it fails, StorageManager goes back
+    // to reading the storage.
+    void Update();
+
+   private:
+    DWORD m_sessionManagerProcessId;
+    wil::unique_mapview_ptr<void> m_headerView;
+    wil::unique_event_nothrow m_snapshotReplacedEvent;
+};
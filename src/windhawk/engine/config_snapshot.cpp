@@ -0,0 +1,351 @@
+#include "config_snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace ConfigSnapshot {
+
+// The layout is: the header, the section entries ordered by name, the value
+// entries of each section ordered by name, and the string pool.
+struct Reader::Header {
+    std::uint32_t magic;
+    std::uint32_t formatVersion;
+    std::uint64_t sequence;
+    std::uint32_t totalSize;
+    std::uint32_t sectionCount;
+    std::uint32_t sectionsOffset;
+    std::uint32_t reserved;
+};
+
+struct Reader::SectionEntry {
+    std::uint32_t nameOffset;
+    std::uint32_t nameLength;
+    std::uint32_t valuesOffset;
+    std::uint32_t valueCount;
+};
+
+struct Reader::ValueEntry {
+    std::uint32_t nameOffset;
+    std::uint32_t nameLength;
+    std::uint32_t valueOffset;
+    std::uint32_t valueLength;
+};
+
+namespace {
+
+wchar_t FoldAsciiCase(wchar_t c) {
+    return (c >= L'a' && c <= L'z') ? static_cast<wchar_t>(c - L'a' + L'A')
+                                    : c;
+}
+
+int CompareNames(std::wstring_view a, std::wstring_view b) {
+    size_t length = std::min(a.length(), b.length());
+    for (size_t i = 0; i < length; i++) {
+        wchar_t ca = FoldAsciiCase(a[i]);
+        wchar_t cb = FoldAsciiCase(b[i]);
+        if (ca != cb) {
+            return ca < cb ? -1 : 1;
+        }
+    }
+
+    if (a.length() != b.length()) {
+        return a.length() < b.length() ? -1 : 1;
+    }
+
+    return 0;
+}
+
+std::uint32_t ToOffset(size_t value) {
+    if (value > UINT32_MAX) {
+        throw std::length_error("Config snapshot is too large");
+    }
+
+    return static_cast<std::uint32_t>(value);
+}
+
+size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// Builder
+
+bool Builder::NameLess::operator()(std::wstring_view a,
+                                   std::wstring_view b) const {
+    return CompareNames(a, b) < 0;
+}
+
+void Builder::AddSection(std::wstring_view sectionName) {
+    if (!m_sections.contains(sectionName)) {
+        m_sections.emplace(sectionName, Values{});
+    }
+}
+
+void Builder::SetValue(std::wstring_view sectionName,
+                       std::wstring_view valueName,
+                       std::wstring_view value) {
+    auto it = m_sections.find(sectionName);
+    if (it == m_sections.end()) {
+        it = m_sections.emplace(sectionName, Values{}).first;
+    }
+
+    auto& values = it->second;
+    auto valueIt = values.find(valueName);
+    if (valueIt != values.end()) {
+        valueIt->second = value;
+    } else {
+        values.emplace(valueName, value);
+    }
+}
+
+std::vector<std::uint8_t> Builder::Serialize(std::uint64_t sequence) const {
+    size_t valueCount = 0;
+    for (const auto& [sectionName, values] : m_sections) {
+        valueCount += values.size();
+    }
+
+    size_t sectionsOffset = sizeof(Reader::Header);
+    size_t valuesOffset =
+        sectionsOffset + m_sections.size() * sizeof(Reader::SectionEntry);
+    size_t stringsOffset =
+        valuesOffset + valueCount * sizeof(Reader::ValueEntry);
+
+    size_t stringsSize = 0;
+    for (const auto& [sectionName, values] : m_sections) {
+        stringsSize += sectionName.length() + 1;
+        for (const auto& [valueName, value] : values) {
+            stringsSize += valueName.length() + 1 + value.length() + 1;
+        }
+    }
+
+    size_t totalSize = AlignUp(
+        stringsOffset + stringsSize * sizeof(wchar_t), alignof(Reader::Header));
+
+    std::vector<std::uint8_t> result(totalSize);
+    std::uint8_t* data = result.data();
+
+    Reader::Header header{
+        .magic = kMagic,
+        .formatVersion = kFormatVersion,
+        .sequence = sequence,
+        .totalSize = ToOffset(totalSize),
+        .sectionCount = ToOffset(m_sections.size()),
+        .sectionsOffset = ToOffset(sectionsOffset),
+        .reserved = 0,
+    };
+    memcpy(data, &header, sizeof(header));
+
+    size_t nextStringOffset = stringsOffset;
+    auto addString = [data, &nextStringOffset](std::wstring_view string) {
+        size_t offset = nextStringOffset;
+        memcpy(data + offset, string.data(), string.length() * sizeof(wchar_t));
+        // The terminating null is already there, since the buffer is zeroed.
+        nextStringOffset += (string.length() + 1) * sizeof(wchar_t);
+        return ToOffset(offset);
+    };
+
+    size_t nextSectionOffset = sectionsOffset;
+    size_t nextValueOffset = valuesOffset;
+    for (const auto& [sectionName, values] : m_sections) {
+        Reader::SectionEntry sectionEntry{
+            .nameOffset = addString(sectionName),
+            .nameLength = ToOffset(sectionName.length()),
+            .valuesOffset = ToOffset(nextValueOffset),
+            .valueCount = ToOffset(values.size()),
+        };
+        memcpy(data + nextSectionOffset, &sectionEntry, sizeof(sectionEntry));
+        nextSectionOffset += sizeof(sectionEntry);
+
+        for (const auto& [valueName, value] : values) {
+            Reader::ValueEntry valueEntry{
+                .nameOffset = addString(valueName),
+                .nameLength = ToOffset(valueName.length()),
+                .valueOffset = addString(value),
+                .valueLength = ToOffset(value.length()),
+            };
+            memcpy(data + nextValueOffset, &valueEntry, sizeof(valueEntry));
+            nextValueOffset += sizeof(valueEntry);
+        }
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reader
+
+Reader::Reader(const void* data, size_t size)
+    : m_data(static_cast<const std::uint8_t*>(data)), m_size(size) {
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(Header) != 0) {
+        throw std::runtime_error("Config snapshot is misaligned");
+    }
+
+    if (size < sizeof(Header)) {
+        throw std::runtime_error("Config snapshot is truncated");
+    }
+
+    m_header = reinterpret_cast<const Header*>(m_data);
+    if (m_header->magic != kMagic ||
+        m_header->formatVersion != kFormatVersion) {
+        throw std::runtime_error("Config snapshot format is unsupported");
+    }
+
+    // The mapping might be larger than the snapshot, since it's rounded up to
+    // the page size.
+    if (m_header->totalSize > size) {
+        throw std::runtime_error("Config snapshot is truncated");
+    }
+
+    m_size = m_header->totalSize;
+
+    size_t sectionsOffset = m_header->sectionsOffset;
+    size_t sectionCount = m_header->sectionCount;
+    if (sectionsOffset % alignof(SectionEntry) != 0 ||
+        sectionsOffset > m_size ||
+        sectionCount > (m_size - sectionsOffset) / sizeof(SectionEntry)) {
+        throw std::runtime_error("Config snapshot sections are invalid");
+    }
+
+    m_sections = reinterpret_cast<const SectionEntry*>(m_data + sectionsOffset);
+
+    // Validate everything once, so that lookups don't have to.
+    for (size_t i = 0; i < sectionCount; i++) {
+        const SectionEntry& section = m_sections[i];
+        ValidateString(section.nameOffset, section.nameLength);
+
+        if (i > 0 &&
+            CompareNames(GetString(m_sections[i - 1].nameOffset,
+                                   m_sections[i - 1].nameLength),
+                         GetString(section.nameOffset, section.nameLength)) >=
+                0) {
+            throw std::runtime_error("Config snapshot sections are unordered");
+        }
+
+        size_t valuesOffset = section.valuesOffset;
+        size_t valueCount = section.valueCount;
+        if (valuesOffset % alignof(ValueEntry) != 0 || valuesOffset > m_size ||
+            valueCount > (m_size - valuesOffset) / sizeof(ValueEntry)) {
+            throw std::runtime_error("Config snapshot values are invalid");
+        }
+
+        auto* values =
+            reinterpret_cast<const ValueEntry*>(m_data + valuesOffset);
+        for (size_t j = 0; j < valueCount; j++) {
+            ValidateString(values[j].nameOffset, values[j].nameLength);
+            ValidateString(values[j].valueOffset, values[j].valueLength);
+
+            if (j > 0 &&
+                CompareNames(GetString(values[j - 1].nameOffset,
+                                       values[j - 1].nameLength),
+                             GetString(values[j].nameOffset,
+                                       values[j].nameLength)) >= 0) {
+                throw std::runtime_error(
+                    "Config snapshot values are unordered");
+            }
+        }
+    }
+}
+
+std::uint64_t Reader::GetSequence() const {
+    return m_header->sequence;
+}
+
+std::optional<Reader::Section> Reader::FindSection(
+    std::wstring_view sectionName) const {
+    const SectionEntry* begin = m_sections;
+    const SectionEntry* end = m_sections + m_header->sectionCount;
+    auto it = std::lower_bound(
+        begin, end, sectionName,
+        [this](const SectionEntry& entry, std::wstring_view name) {
+            return CompareNames(GetString(entry.nameOffset, entry.nameLength),
+                                name) < 0;
+        });
+    if (it == end ||
+        CompareNames(GetString(it->nameOffset, it->nameLength), sectionName) !=
+            0) {
+        return std::nullopt;
+    }
+
+    return Section(this, it);
+}
+
+size_t Reader::GetSectionCount() const {
+    return m_header->sectionCount;
+}
+
+Reader::Section Reader::GetSectionAt(size_t index) const {
+    if (index >= m_header->sectionCount) {
+        throw std::out_of_range("Section index is out of range");
+    }
+
+    return Section(this, &m_sections[index]);
+}
+
+std::wstring_view Reader::GetString(std::uint32_t offset,
+                                    std::uint32_t length) const {
+    return std::wstring_view(reinterpret_cast<const wchar_t*>(m_data + offset),
+                             length);
+}
+
+void Reader::ValidateString(std::uint32_t offset, std::uint32_t length) const {
+    // The string must fit along with its terminating null.
+    if (offset % alignof(wchar_t) != 0 || offset > m_size ||
+        length >= (m_size - offset) / sizeof(wchar_t)) {
+        throw std::runtime_error("Config snapshot string is invalid");
+    }
+
+    auto* string = reinterpret_cast<const wchar_t*>(m_data + offset);
+    if (string[length] != L'\0') {
+        throw std::runtime_error("Config snapshot string is unterminated");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reader::Section
+
+std::wstring_view Reader::Section::GetName() const {
+    return m_reader->GetString(m_entry->nameOffset, m_entry->nameLength);
+}
+
+std::optional<std::wstring_view> Reader::Section::GetValue(
+    std::wstring_view valueName) const {
+    auto* begin = reinterpret_cast<const ValueEntry*>(m_reader->m_data +
+                                                      m_entry->valuesOffset);
+    auto* end = begin + m_entry->valueCount;
+    auto it = std::lower_bound(
+        begin, end, valueName,
+        [this](const ValueEntry& entry, std::wstring_view name) {
+            return CompareNames(m_reader->GetString(entry.nameOffset,
+                                                    entry.nameLength),
+                                name) < 0;
+        });
+    if (it == end ||
+        CompareNames(m_reader->GetString(it->nameOffset, it->nameLength),
+                     valueName) != 0) {
+        return std::nullopt;
+    }
+
+    return m_reader->GetString(it->valueOffset, it->valueLength);
+}
+
+size_t Reader::Section::GetValueCount() const {
+    return m_entry->valueCount;
+}
+
+std::pair<std::wstring_view, std::wstring_view> Reader::Section::GetValueAt(
+    size_t index) const {
+    if (index >= m_entry->valueCount) {
+        throw std::out_of_range("Value index is out of range");
+    }
+
+    auto* entry = reinterpret_cast<const ValueEntry*>(m_reader->m_data +
+                                                      m_entry->valuesOffset) +
+                  index;
+    return {m_reader->GetString(entry->nameOffset, entry->nameLength),
+            m_reader->GetString(entry->valueOffset, entry->valueLength)};
+}
+
+}  // namespace ConfigSnapshot
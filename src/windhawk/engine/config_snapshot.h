@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A read-only binary snapshot of configuration values. Values are strings,
+// grouped in named sections. Section and value names are compared
+// case-insensitively for ASCII letters, and ordinally otherwise.
+//
+// The snapshot is a single block of memory which only contains 32-bit offsets
+// and no pointers, so that it can be mapped and read in place by processes of
+// any architecture. Strings are stored as null-terminated wchar_t arrays.
+//
+// Only the standard library is used, and the precompiled header isn't, so that
+// the code can be built and tested on any host.
+namespace ConfigSnapshot {
+
+inline constexpr std::uint32_t kMagic = 0x53434857;  // "WHCS"
+inline constexpr std::uint32_t kFormatVersion = 1;
+
+class Builder {
+   public:
+    // Adds an empty section if it doesn't exist yet.
+    void AddSection(std::wstring_view sectionName);
+    // Adds the section if needed, and replaces the value if it already exists.
+    void SetValue(std::wstring_view sectionName,
+                  std::wstring_view valueName,
+                  std::wstring_view value);
+
+    // Throws std::length_error if the snapshot doesn't fit 32-bit offsets.
+    std::vector<std::uint8_t> Serialize(std::uint64_t sequence) const;
+
+   private:
+    struct NameLess {
+        using is_transparent = void;
+        bool operator()(std::wstring_view a, std::wstring_view b) const;
+    };
+
+    using Values = std::map<std::wstring, std::wstring, NameLess>;
+
+    std::map<std::wstring, Values, NameLess> m_sections;
+};
+
+class Reader {
+   public:
+    struct SectionEntry;
+    struct ValueEntry;
+
+    class Section {
+       public:
+        std::wstring_view GetName() const;
+        std::optional<std::wstring_view> GetValue(
+            std::wstring_view valueName) const;
+
+        // Values are ordered by name.
+        size_t GetValueCount() const;
+        std::pair<std::wstring_view, std::wstring_view> GetValueAt(
+            size_t index) const;
+
+       private:
+        friend class Reader;
+
+        Section(const Reader* reader, const SectionEntry* entry)
+            : m_reader(reader), m_entry(entry) {}
+
+        const Reader* m_reader;
+        const SectionEntry* m_entry;
+    };
+
+    // The whole snapshot is validated once, and std::runtime_error is thrown
+    // if it's malformed. The data must be aligned to 8 bytes, and must stay
+    // valid and unchanged as long as the reader is used.
+    Reader(const void* data, size_t size);
+
+    std::uint64_t GetSequence() const;
+    std::optional<Section> FindSection(std::wstring_view sectionName) const;
+
+    // Sections are ordered by name.
+    size_t GetSectionCount() const;
+    Section GetSectionAt(size_t index) const;
+
+   private:
+    friend class Builder;
+
+    struct Header;
+
+    std::wstring_view GetString(std::uint32_t offset,
+                                std::uint32_t length) const;
+    void ValidateString(std::uint32_t offset, std::uint32_t length) const;
+
+    const std::uint8_t* m_data;
+    size_t m_size;
+    const Header* m_header;
+    const SectionEntry* m_sections;
+};
+
+}  // namespace ConfigSnapshot
@@ -4,13 +4,92 @@
 #include "functions.h"
 #include "logger.h"
 #include "session_private_namespace.h"
+#include "trace_recorder.h"
 
 extern HINSTANCE g_hDllInst;
 
+namespace {
+
+// How often the hook call counts of the loaded mods are published, if hook
+// call counting is enabled.
+constexpr DWORD kHookCallCountsUpdateInterval = 1000;
+
+bool ReadHookCallCountingSetting() {
+#ifndef WH_HOOKING_ENGINE_MINHOOK_DETOURS
+    try {
+        auto settings = StorageManager::GetInstance().GetAppConfig(L"Settings");
+        return settings->GetInt(L"HookCallCounting").value_or(0) != 0;
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+#endif  // WH_HOOKING_ENGINE_MINHOOK_DETOURS
+
+    return false;
+}
+
+void WriteTraceFile() {
+    if (!TraceRecorder::IsEnabled()) {
+        return;
+    }
+
+    try {
+        TraceRecorder::GetInstance().WriteProcessFile();
+    } catch (const std::exception& e) {
+        LOG(L"Writing the trace file failed: %S", e.what());
+    }
+}
+
+// The table is shared by the slots of all mods and of the engine, and is
+// unmapped once no slots are left.
+struct ModStatusTableCache {
+    std::mutex mutex;
+    std::weak_ptr<ModStatusTable> table;
+};
+
+std::optional<ConfigMirrorReader> CreateConfigMirror() {
+    try {
+        return std::optional<ConfigMirrorReader>(
+            std::in_place, CustomizationSession::GetSessionManagerProcessId());
+    } catch (const std::exception& e) {
+        // The config is read from the storage in this case, for example if
+        // the session manager failed to publish the mirror.
+        LOG(L"Config mirror isn't available: %S", e.what());
+    }
+
+    return std::nullopt;
+}
+
+bool MightBeTargetedProcess() {
+    try {
+        auto processImageName =
+            wil::QueryFullProcessImageName<std::wstring>(GetCurrentProcess());
+        return ModTargetFilter().MightBeTargeted(processImageName);
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+
+    return true;
+}
+
+std::optional<ModsManager> CreateModsManager(bool propagationOnly) {
+    // Checked again in case a mod config change made the process targeted
+    // after it was injected into and before the config mirror was opened.
+    if (propagationOnly && !MightBeTargetedProcess()) {
+        VERBOSE(L"No mod targets this process, starting a propagation-only "
+                L"session");
+        return std::nullopt;
+    }
+
+    return std::optional<ModsManager>(std::in_place);
+}
+
+}  // namespace
+
 // static
 void CustomizationSession::Start(
     bool runningFromAPC,
     bool threadAttachExempt,
+    bool propagationOnly,
     wil::unique_process_handle sessionManagerProcess,
     wil::unique_mutex_nothrow sessionMutex) {
     std::wstring semaphoreName = L"WindhawkCustomizationSessionSemaphore-pid=" +
@@ -25,7 +104,8 @@ void CustomizationSession::Start(
     }
 
     session.emplace(ConstructorSecret{}, runningFromAPC, threadAttachExempt,
-                    std::move(sessionManagerProcess), std::move(sessionMutex));
+                    propagationOnly, std::move(sessionManagerProcess),
+                    std::move(sessionMutex));
 
     session->StartInitialized(std::move(semaphore), std::move(semaphoreLock),
                               runningFromAPC);
@@ -56,6 +136,22 @@ FILETIME CustomizationSession::GetSessionManagerProcessCreationTime() {
     return creationTime;
 }
 
+// static
+std::shared_ptr<ModStatusTable> CustomizationSession::GetModStatusTable() {
+    STATIC_INIT_ONCE(ModStatusTableCache, cache);
+
+    std::lock_guard<std::mutex> guard(cache->mutex);
+
+    auto table = cache->table.lock();
+    if (!table) {
+        table = std::make_shared<ModStatusTable>(
+            ModStatusTable::Open(GetSessionManagerProcessId()));
+        cache->table = table;
+    }
+
+    return table;
+}
+
 // static
 bool CustomizationSession::IsEndingSoon() {
     HANDLE sessionManagerProcess =
@@ -63,10 +159,18 @@ bool CustomizationSession::IsEndingSoon() {
     return WaitForSingleObject(sessionManagerProcess, 0) == WAIT_OBJECT_0;
 }
 
+// static
+bool CustomizationSession::IsHookCallCountingEnabled() {
+    // Engine settings changes restart the engine, so reading once is enough.
+    STATIC_INIT_ONCE_TRIVIAL(bool, enabled, ReadHookCallCountingSetting());
+    return enabled;
+}
+
 CustomizationSession::CustomizationSession(
     ConstructorSecret constructorSecret,
     bool runningFromAPC,
     bool threadAttachExempt,
+    bool propagationOnly,
     wil::unique_process_handle sessionManagerProcess,
     wil::unique_mutex_nothrow sessionMutex)
     : m_threadAttachExempt(threadAttachExempt),
@@ -76,9 +180,12 @@ CustomizationSession::CustomizationSession(
       // If runningFromAPC, no other threads should be running, skip thread
       // freeze.
       m_minHookScopeInit(runningFromAPC ? MH_FREEZE_METHOD_NONE_UNSAFE
-                                        : MH_FREEZE_METHOD_FAST_UNDOCUMENTED),
+                                        : MH_FREEZE_METHOD_FAST_UNDOCUMENTED,
+                         IsHookCallCountingEnabled()),
 #endif  // WH_HOOKING_ENGINE_MINHOOK
-      m_modsManager(),
+      m_configMirror(CreateConfigMirror()),
+      m_logRingBufferScope(),
+      m_modsManager(CreateModsManager(propagationOnly)),
       m_newProcessInjector(m_scopedStaticSessionManagerProcess)
 #ifdef WH_HOOKING_ENGINE_MINHOOK
       ,
@@ -86,23 +193,46 @@ CustomizationSession::CustomizationSession(
 #endif  // WH_HOOKING_ENGINE_MINHOOK
 {
     try {
-        m_modsManager.AfterInit();
+        if (m_modsManager) {
+            m_modsManager->AfterInit();
+        }
     } catch (const std::exception& e) {
         LOG(L"AfterInit failed: %S", e.what());
     }
+
+    WriteTraceFile();
 }
 
 CustomizationSession::~CustomizationSession() {
     try {
-        m_modsManager.BeforeUninit();
+        if (m_modsManager) {
+            m_modsManager->BeforeUninit();
+        }
     } catch (const std::exception& e) {
         LOG(L"BeforeUninit failed: %S", e.what());
     }
+
+    WriteTraceFile();
+}
+
+CustomizationSession::LogRingBufferScope::LogRingBufferScope() {
+    try {
+        Logger::GetInstance().SetRingBuffer(std::make_shared<LogRingBuffer>(
+            LogRingBuffer::Open(GetSessionManagerProcessId())));
+    } catch (const std::exception& e) {
+        // Lines are written to the debugger output directly in this case.
+        LOG(L"Log ring buffer isn't available: %S", e.what());
+    }
+}
+
+CustomizationSession::LogRingBufferScope::~LogRingBufferScope() {
+    Logger::GetInstance().SetRingBuffer(nullptr);
 }
 
 #ifdef WH_HOOKING_ENGINE_MINHOOK
 CustomizationSession::MinHookScopeInit::MinHookScopeInit(
-    MH_THREAD_FREEZE_METHOD freezeMethod) {
+    MH_THREAD_FREEZE_METHOD freezeMethod,
+    bool callCounting) {
     MH_STATUS status = MH_Initialize();
     if (status != MH_OK) {
         LOG(L"MH_Initialize failed with %d", status);
@@ -111,6 +241,12 @@ CustomizationSession::MinHookScopeInit::MinHookScopeInit(
 
     MH_SetThreadFreezeMethod(freezeMethod);
 
+#ifndef WH_HOOKING_ENGINE_MINHOOK_DETOURS
+    if (callCounting) {
+        MH_SetCallCounting(TRUE);
+    }
+#endif  // WH_HOOKING_ENGINE_MINHOOK_DETOURS
+
 #ifdef WH_HOOKING_ENGINE_MINHOOK_DETOURS
     MH_SetBulkOperationMode(
         /*continueOnError=*/TRUE, [](LPVOID pTarget, NTSTATUS detoursStatus) {
@@ -128,9 +264,21 @@ CustomizationSession::MinHookScopeInit::~MinHookScopeInit() {
 }
 
 CustomizationSession::MinHookScopeApply::MinHookScopeApply() {
-    MH_STATUS status = MH_ApplyQueuedEx(MH_ALL_IDENTS);
+    TraceRecorder::Span span("ApplyHooks");
+
+    MH_STATUS status;
+    BOOL threadsFrozen;
+    {
+        EngineMetrics::ScopedTimer timer(
+            EngineMetrics::GetEngineInstance(),
+            EngineMetrics::Metric::kThreadFreezeTime);
+        status = MH_ApplyQueuedEx2(MH_ALL_IDENTS, &threadsFrozen);
+    }
+    if (threadsFrozen) {
+        EngineMetrics::AddToEngine(EngineMetrics::Metric::kThreadFreezes);
+    }
     if (status != MH_OK) {
-        LOG(L"MH_ApplyQueuedEx failed with %d", status);
+        LOG(L"MH_ApplyQueuedEx2 failed with %d", status);
     }
 
     MH_SetThreadFreezeMethod(MH_FREEZE_METHOD_FAST_UNDOCUMENTED);
@@ -144,7 +292,13 @@ CustomizationSession::MinHookScopeApply::~MinHookScopeApply() {
 }
 #endif  // WH_HOOKING_ENGINE_MINHOOK
 
-CustomizationSession::MainLoopRunner::MainLoopRunner() noexcept {
+CustomizationSession::MainLoopRunner::MainLoopRunner(
+    std::optional<ConfigMirrorReader>& configMirror) noexcept
+    : m_configMirror(configMirror) {
+    if (m_configMirror) {
+        return;
+    }
+
     try {
         m_modConfigChangeNotification.emplace();
     } catch (const std::exception& e) {
@@ -155,18 +309,28 @@ CustomizationSession::MainLoopRunner::MainLoopRunner() noexcept {
 CustomizationSession::MainLoopRunner::Result
 CustomizationSession::MainLoopRunner::Run(
     HANDLE sessionManagerProcess) noexcept {
-    HANDLE waitHandles[] = {sessionManagerProcess,
-                            m_modConfigChangeNotification
-                                ? m_modConfigChangeNotification->GetHandle()
-                                : nullptr};
-    DWORD waitHandlesCount = m_modConfigChangeNotification ? 2 : 1;
+    HANDLE configChangeHandle = nullptr;
+    if (m_configMirror) {
+        configChangeHandle = m_configMirror->GetChangeEvent();
+    } else if (m_modConfigChangeNotification) {
+        configChangeHandle = m_modConfigChangeNotification->GetHandle();
+    }
+
+    HANDLE waitHandles[] = {sessionManagerProcess, configChangeHandle};
+    DWORD waitHandlesCount = configChangeHandle ? 2 : 1;
+
+    DWORD timeout = IsHookCallCountingEnabled() ? kHookCallCountsUpdateInterval
+                                                : INFINITE;
 
     DWORD waitResult =
-        WaitForMultipleObjects(waitHandlesCount, waitHandles, FALSE, INFINITE);
+        WaitForMultipleObjects(waitHandlesCount, waitHandles, FALSE, timeout);
     switch (waitResult) {
         case WAIT_OBJECT_0:
             return Result::kCompleted;
 
+        case WAIT_TIMEOUT:
+            return Result::kUpdateHookCallCounts;
+
         case WAIT_OBJECT_0 + 1:
             // Wait for a bit before notifying about the change, in case
             // more config changes will follow.
@@ -184,6 +348,27 @@ CustomizationSession::MainLoopRunner::Run(
 }
 
 bool CustomizationSession::MainLoopRunner::ContinueMonitoring() noexcept {
+    if (m_configMirror) {
+        try {
+            m_configMirror->Update();
+            return true;
+        } catch (const std::exception& e) {
+            LOG(L"Config mirror update failed: %S", e.what());
+        }
+
+        // Fall back to monitoring and reading the storage.
+        m_configMirror.reset();
+
+        try {
+            m_modConfigChangeNotification.emplace();
+        } catch (const std::exception& e) {
+            LOG(L"ModConfigChangeNotification constructor failed: %S",
+                e.what());
+        }
+
+        return false;
+    }
+
     if (!m_modConfigChangeNotification) {
         return false;
     }
@@ -230,7 +415,7 @@ void CustomizationSession::StartInitialized(
     m_sessionSemaphoreLock = std::move(semaphoreLock);
 
     if (runningFromAPC) {
-        m_mainLoopRunner.emplace();
+        m_mainLoopRunner.emplace(m_configMirror);
         if (!m_mainLoopRunner->CanRunAcrossThreads()) {
             m_mainLoopRunner.reset();
         }
@@ -263,7 +448,7 @@ void CustomizationSession::StartInitialized(
                 auto* this_ = reinterpret_cast<CustomizationSession*>(pThis);
 
                 if (!this_->m_mainLoopRunner) {
-                    this_->m_mainLoopRunner.emplace();
+                    this_->m_mainLoopRunner.emplace(this_->m_configMirror);
                 }
 
                 if (this_->m_threadAttachExempt) {
@@ -284,7 +469,7 @@ void CustomizationSession::StartInitialized(
     } else {
         // No need to create a new thread, a dedicated thread was created for us
         // before injection.
-        m_mainLoopRunner.emplace();
+        m_mainLoopRunner.emplace(m_configMirror);
         RunMainLoop();
         DeleteThis();
     }
@@ -292,16 +477,14 @@ void CustomizationSession::StartInitialized(
 
 void CustomizationSession::
     RunMainLoopAndDeleteThisWithThreadRecreate() noexcept {
-    bool modConfigChanged =
-        m_mainLoopRunner->Run(m_scopedStaticSessionManagerProcess) ==
-        MainLoopRunner::Result::kReloadModsAndSettings;
+    auto result = m_mainLoopRunner->Run(m_scopedStaticSessionManagerProcess);
 
     if (!m_mainLoopRunner->CanRunAcrossThreads()) {
         m_mainLoopRunner.reset();
     }
 
     LPTHREAD_START_ROUTINE routine;
-    if (modConfigChanged) {
+    if (result == MainLoopRunner::Result::kReloadModsAndSettings) {
         routine = [](LPVOID pThis) -> DWORD {
             SetThreadErrorMode(SEM_FAILCRITICALERRORS, nullptr);
             auto* this_ = reinterpret_cast<CustomizationSession*>(pThis);
@@ -309,11 +492,11 @@ void CustomizationSession::
             if (this_->m_mainLoopRunner) {
                 this_->m_mainLoopRunner->ContinueMonitoring();
             } else {
-                this_->m_mainLoopRunner.emplace();
+                this_->m_mainLoopRunner.emplace(this_->m_configMirror);
             }
 
             try {
-                this_->m_modsManager.ReloadModsAndSettings();
+                this_->ReloadModsAndSettings();
             } catch (const std::exception& e) {
                 LOG(L"ReloadModsAndSettings failed: %S", e.what());
             }
@@ -321,6 +504,28 @@ void CustomizationSession::
             this_->RunMainLoop();
             this_->DeleteThis();
 
+            FreeLibraryAndExitThread(g_hDllInst, 0);
+        };
+    } else if (result == MainLoopRunner::Result::kUpdateHookCallCounts) {
+        routine = [](LPVOID pThis) -> DWORD {
+            SetThreadErrorMode(SEM_FAILCRITICALERRORS, nullptr);
+            auto* this_ = reinterpret_cast<CustomizationSession*>(pThis);
+
+            if (!this_->m_mainLoopRunner) {
+                this_->m_mainLoopRunner.emplace(this_->m_configMirror);
+            }
+
+            try {
+                if (this_->m_modsManager) {
+                    this_->m_modsManager->UpdateHookCallCounts();
+                }
+            } catch (const std::exception& e) {
+                LOG(L"UpdateHookCallCounts failed: %S", e.what());
+            }
+
+            this_->RunMainLoop();
+            this_->DeleteThis();
+
             FreeLibraryAndExitThread(g_hDllInst, 0);
         };
     } else {
@@ -353,6 +558,18 @@ void CustomizationSession::RunMainLoop() noexcept {
     while (true) {
         auto result =
             m_mainLoopRunner->Run(m_scopedStaticSessionManagerProcess);
+        if (result == MainLoopRunner::Result::kUpdateHookCallCounts) {
+            try {
+                if (m_modsManager) {
+                    m_modsManager->UpdateHookCallCounts();
+                }
+            } catch (const std::exception& e) {
+                LOG(L"UpdateHookCallCounts failed: %S", e.what());
+            }
+
+            continue;
+        }
+
         if (result != MainLoopRunner::Result::kReloadModsAndSettings) {
             break;
         }
@@ -360,7 +577,7 @@ void CustomizationSession::RunMainLoop() noexcept {
         m_mainLoopRunner->ContinueMonitoring();
 
         try {
-            m_modsManager.ReloadModsAndSettings();
+            ReloadModsAndSettings();
         } catch (const std::exception& e) {
             LOG(L"ReloadModsAndSettings failed: %S", e.what());
         }
@@ -377,3 +594,39 @@ void CustomizationSession::DeleteThis() noexcept {
 
     GetInstance().reset();
 }
+
+void CustomizationSession::ReloadModsAndSettings() {
+    m_newProcessInjector.ResetModTargetFilter();
+
+    if (m_modsManager) {
+        m_modsManager->ReloadModsAndSettings();
+        return;
+    }
+
+    if (!MightBeTargetedProcess()) {
+        return;
+    }
+
+    VERBOSE(L"A mod now targets this process, loading mods");
+
+    m_modsManager.emplace();
+
+#ifdef WH_HOOKING_ENGINE_MINHOOK
+    MH_STATUS status;
+    BOOL threadsFrozen;
+    {
+        EngineMetrics::ScopedTimer timer(
+            EngineMetrics::GetEngineInstance(),
+            EngineMetrics::Metric::kThreadFreezeTime);
+        status = MH_ApplyQueuedEx2(MH_ALL_IDENTS, &threadsFrozen);
+    }
+    if (threadsFrozen) {
+        EngineMetrics::AddToEngine(EngineMetrics::Metric::kThreadFreezes);
+    }
+    if (status != MH_OK) {
+        LOG(L"MH_ApplyQueuedEx2 failed with %d", status);
+    }
+#endif  // WH_HOOKING_ENGINE_MINHOOK
+
+    m_modsManager->AfterInit();
+}
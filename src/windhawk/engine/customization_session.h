@@ -1,5 +1,7 @@
 #pragma once
 
+#include "config_mirror.h"
+#include "engine_metrics.h"
 #include "mods_manager.h"
 #include "new_process_injector.h"
 #include "no_destructor.h"
@@ -19,17 +21,21 @@ class CustomizationSession {
 
     static void Start(bool runningFromAPC,
                       bool threadAttachExempt,
+                      bool propagationOnly,
                       wil::unique_process_handle sessionManagerProcess,
                       wil::unique_mutex_nothrow sessionMutex);
     static DWORD GetSessionManagerProcessId();
     static FILETIME GetSessionManagerProcessCreationTime();
+    static std::shared_ptr<ModStatusTable> GetModStatusTable();
     static bool IsEndingSoon();
+    static bool IsHookCallCountingEnabled();
 
     // Must be public for std emplace and destruction, but shouldn't be used
     // outside of this file.
     CustomizationSession(ConstructorSecret constructorSecret,
                          bool runningFromAPC,
                          bool threadAttachExempt,
+                         bool propagationOnly,
                          wil::unique_process_handle sessionManagerProcess,
                          wil::unique_mutex_nothrow sessionMutex);
     ~CustomizationSession();
@@ -57,13 +63,25 @@ class CustomizationSession {
         operator HANDLE() { return GetInstance().value().get(); }
     };
 
+    // Attaches the log ring buffer of the session manager to the logger, so
+    // that the lines logged while the mods are loaded and unloaded are kept.
+    class LogRingBufferScope {
+       public:
+        LogRingBufferScope(const LogRingBufferScope&) = delete;
+        LogRingBufferScope& operator=(const LogRingBufferScope&) = delete;
+
+        LogRingBufferScope();
+        ~LogRingBufferScope();
+    };
+
 #ifdef WH_HOOKING_ENGINE_MINHOOK
     class MinHookScopeInit {
        public:
         MinHookScopeInit(const MinHookScopeInit&) = delete;
         MinHookScopeInit& operator=(const MinHookScopeInit&) = delete;
 
-        MinHookScopeInit(MH_THREAD_FREEZE_METHOD freezeMethod);
+        MinHookScopeInit(MH_THREAD_FREEZE_METHOD freezeMethod,
+                         bool callCounting);
         ~MinHookScopeInit();
     };
 
@@ -79,10 +97,15 @@ class CustomizationSession {
 
     class MainLoopRunner {
        public:
-        MainLoopRunner() noexcept;
+        // If a config mirror is used, it's updated on config changes. If the
+        // update fails, the mirror is reset, and the storage is monitored
+        // instead.
+        MainLoopRunner(
+            std::optional<ConfigMirrorReader>& configMirror) noexcept;
 
         enum class Result {
             kReloadModsAndSettings,
+            kUpdateHookCallCounts,
             kCompleted,
             kError,
         };
@@ -92,6 +115,7 @@ class CustomizationSession {
         bool CanRunAcrossThreads() noexcept;
 
        private:
+        std::optional<ConfigMirrorReader>& m_configMirror;
         std::optional<StorageManager::ModConfigChangeNotification>
             m_modConfigChangeNotification;
     };
@@ -104,14 +128,25 @@ class CustomizationSession {
     void RunMainLoopAndDeleteThisWithThreadRecreate() noexcept;
     void RunMainLoop() noexcept;
     void DeleteThis() noexcept;
+    void ReloadModsAndSettings();
 
     bool m_threadAttachExempt;
     ScopedStaticSessionManagerProcess m_scopedStaticSessionManagerProcess;
     wil::unique_mutex_nothrow m_sessionMutex;
+    EngineMetrics::ScopedEngineInstance m_scopedEngineMetrics;
 #ifdef WH_HOOKING_ENGINE_MINHOOK
     MinHookScopeInit m_minHookScopeInit;
 #endif  // WH_HOOKING_ENGINE_MINHOOK
-    ModsManager m_modsManager;
+    // Must be created before the mods are loaded, so that they read the config
+    // from it.
+    std::optional<ConfigMirrorReader> m_configMirror;
+    // Must be attached before the mods are loaded, and detached after they're
+    // unloaded.
+    LogRingBufferScope m_logRingBufferScope;
+    // Not created in a propagation-only session, which is used for processes
+    // no mod targets, until a mod config change makes the process targeted.
+    // Until then, the session only injects into new processes.
+    std::optional<ModsManager> m_modsManager;
     NewProcessInjector m_newProcessInjector;
 #ifdef WH_HOOKING_ENGINE_MINHOOK
     MinHookScopeApply m_minHookScopeApply;
@@ -635,7 +635,8 @@ void DllInject(HANDLE hProcess,
                HANDLE hThreadForAPC,
                HANDLE hSessionManagerProcess,
                HANDLE hSessionMutex,
-               bool threadAttachExempt) {
+               bool threadAttachExempt,
+               bool propagationOnly) {
     const BYTE* shellcode;
     size_t shellcodeSize;
 
@@ -709,6 +710,7 @@ void DllInject(HANDLE hProcess,
         static_cast<INT32>(Logger::GetInstance().GetVerbosity());
     shellcodeData->bRunningFromAPC = !!hThreadForAPC;
     shellcodeData->bThreadAttachExempt = threadAttachExempt;
+    shellcodeData->bPropagationOnly = propagationOnly;
     shellcodeData->hSessionManagerProcess = hRemoteSessionManagerProcess;
     shellcodeData->hSessionMutex = hRemoteSessionMutex;
     memcpy(shellcodeData->szDllName, dllPath.c_str(), dllPathBytes);
@@ -11,6 +11,9 @@ struct LOAD_LIBRARY_REMOTE_DATA {
     INT32 nLogVerbosity;
     BOOL bRunningFromAPC;
     BOOL bThreadAttachExempt;
+    // Takes the padding before the next member, so that the offsets used by
+    // the shellcode don't change.
+    BOOL bPropagationOnly;
     union {
         HANDLE hSessionManagerProcess;
         // Make sure 32-bit/64-bit layouts are the same.
@@ -29,10 +32,14 @@ struct LOAD_LIBRARY_REMOTE_DATA {
     WCHAR szDllName[1];  // flexible array member
 };
 
+static_assert(offsetof(LOAD_LIBRARY_REMOTE_DATA, dw64SessionManagerProcess) ==
+              16);
+
 void DllInject(HANDLE hProcess,
                HANDLE hThreadForAPC,
                HANDLE hSessionManagerProcess,
                HANDLE hSessionMutex,
-               bool threadAttachExempt);
+               bool threadAttachExempt,
+               bool propagationOnly);
 
 }  // namespace DllInject
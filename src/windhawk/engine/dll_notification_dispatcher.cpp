@@ -0,0 +1,141 @@
+#include "stdafx.h"
+
+#include "dll_notification_dispatcher.h"
+#include "logger.h"
+#include "var_init_once.h"
+
+namespace {
+
+// https://learn.microsoft.com/en-us/windows/win32/devnotes/ldrdllnotification
+
+constexpr ULONG kLdrDllNotificationReasonLoaded = 1;
+constexpr ULONG kLdrDllNotificationReasonUnloaded = 2;
+
+struct MY_UNICODE_STRING {
+    USHORT Length;
+    USHORT MaximumLength;
+    PWSTR Buffer;
+};
+
+// Same layout for both the loaded and the unloaded notifications.
+struct MY_LDR_DLL_NOTIFICATION_DATA {
+    ULONG Flags;
+    const MY_UNICODE_STRING* FullDllName;
+    const MY_UNICODE_STRING* BaseDllName;
+    PVOID DllBase;
+    ULONG SizeOfImage;
+};
+
+std::wstring_view UnicodeStringToView(const MY_UNICODE_STRING* string) {
+    if (!string || !string->Buffer) {
+        return {};
+    }
+
+    return std::wstring_view(string->Buffer, string->Length / sizeof(WCHAR));
+}
+
+}  // namespace
+
+// static
+DllNotificationDispatcher& DllNotificationDispatcher::GetInstance() {
+    STATIC_INIT_ONCE(NoDestructorIfTerminating<DllNotificationDispatcher>, s);
+    return **s;
+}
+
+void DllNotificationDispatcher::AddListener(Listener* listener) {
+    std::lock_guard<std::mutex> registrationGuard(m_registrationMutex);
+
+    {
+        auto lock = m_listenersLock.lock_exclusive();
+        m_listeners.push_back(listener);
+    }
+
+    if (!m_cookie) {
+        NTSTATUS status = m_LdrRegisterDllNotification(
+            0, reinterpret_cast<PVOID>(DllNotificationCallback), this,
+            &m_cookie);
+        if (!SUCCEEDED_NTSTATUS(status)) {
+            m_cookie = nullptr;
+
+            auto lock = m_listenersLock.lock_exclusive();
+            std::erase(m_listeners, listener);
+
+            THROW_NTSTATUS(status);
+        }
+    }
+}
+
+void DllNotificationDispatcher::RemoveListener(Listener* listener) {
+    std::lock_guard<std::mutex> registrationGuard(m_registrationMutex);
+
+    bool empty;
+
+    {
+        // Acquiring the lock exclusively also waits for running callbacks to
+        // return.
+        auto lock = m_listenersLock.lock_exclusive();
+        std::erase(m_listeners, listener);
+        empty = m_listeners.empty();
+    }
+
+    if (empty && m_cookie) {
+        // Must be called without holding the listeners lock, since the loader
+        // waits for running callbacks while holding its notification lock.
+        NTSTATUS status = m_LdrUnregisterDllNotification(m_cookie);
+        if (!SUCCEEDED_NTSTATUS(status)) {
+            LOG(L"LdrUnregisterDllNotification failed with status %08X",
+                status);
+        }
+
+        m_cookie = nullptr;
+    }
+}
+
+DllNotificationDispatcher::DllNotificationDispatcher() {
+    HMODULE hNtdll = GetModuleHandle(L"ntdll.dll");
+    THROW_LAST_ERROR_IF_NULL(hNtdll);
+
+    m_LdrRegisterDllNotification = (LdrRegisterDllNotification_t)GetProcAddress(
+        hNtdll, "LdrRegisterDllNotification");
+    THROW_LAST_ERROR_IF_NULL(m_LdrRegisterDllNotification);
+
+    m_LdrUnregisterDllNotification =
+        (LdrUnregisterDllNotification_t)GetProcAddress(
+            hNtdll, "LdrUnregisterDllNotification");
+    THROW_LAST_ERROR_IF_NULL(m_LdrUnregisterDllNotification);
+}
+
+DllNotificationDispatcher::~DllNotificationDispatcher() {
+    if (m_cookie) {
+        m_LdrUnregisterDllNotification(m_cookie);
+    }
+}
+
+// static
+VOID CALLBACK
+DllNotificationDispatcher::DllNotificationCallback(ULONG notificationReason,
+                                                   const void* notificationData,
+                                                   PVOID context) {
+    auto* dispatcher = static_cast<DllNotificationDispatcher*>(context);
+    const auto* data =
+        static_cast<const MY_LDR_DLL_NOTIFICATION_DATA*>(notificationData);
+
+    auto lock = dispatcher->m_listenersLock.lock_shared();
+
+    switch (notificationReason) {
+        case kLdrDllNotificationReasonLoaded: {
+            auto baseDllName = UnicodeStringToView(data->BaseDllName);
+            auto fullDllName = UnicodeStringToView(data->FullDllName);
+            for (auto* listener : dispatcher->m_listeners) {
+                listener->OnDllLoaded(data->DllBase, baseDllName, fullDllName);
+            }
+            break;
+        }
+
+        case kLdrDllNotificationReasonUnloaded:
+            for (auto* listener : dispatcher->m_listeners) {
+                listener->OnDllUnloaded(data->DllBase);
+            }
+            break;
+    }
+}
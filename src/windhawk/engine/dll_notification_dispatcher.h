@@ -0,0 +1,63 @@
+#pragma once
+
+#include "no_destructor.h"
+
+// Registers for loader notifications (LdrRegisterDllNotification) once per
+// process, and dispatches them to the registered listeners. The registration
+// with the loader is only kept while there are listeners.
+//
+// Listeners are called with the loader lock held, and must not do anything
+// beyond recording the event. In particular, they must not load libraries or
+// wait for other threads.
+class DllNotificationDispatcher {
+   public:
+    class Listener {
+       public:
+        virtual void OnDllLoaded(void* dllBase,
+                                 std::wstring_view baseDllName,
+                                 std::wstring_view fullDllName) = 0;
+        virtual void OnDllUnloaded(void* dllBase) = 0;
+
+       protected:
+        ~Listener() = default;
+    };
+
+    static DllNotificationDispatcher& GetInstance();
+
+    DllNotificationDispatcher(const DllNotificationDispatcher&) = delete;
+    DllNotificationDispatcher& operator=(const DllNotificationDispatcher&) =
+        delete;
+
+    void AddListener(Listener* listener);
+    // Once the function returns, the listener is guaranteed not to be called.
+    void RemoveListener(Listener* listener);
+
+   private:
+    friend class NoDestructorIfTerminating<DllNotificationDispatcher>;
+
+    DllNotificationDispatcher();
+    ~DllNotificationDispatcher();
+
+    static VOID CALLBACK DllNotificationCallback(ULONG notificationReason,
+                                                 const void* notificationData,
+                                                 PVOID context);
+
+    using LdrRegisterDllNotification_t =
+        NTSTATUS(NTAPI*)(_In_ ULONG Flags,
+                         _In_ PVOID NotificationFunction,
+                         _In_opt_ PVOID Context,
+                         _Out_ PVOID* Cookie);
+    using LdrUnregisterDllNotification_t = NTSTATUS(NTAPI*)(_In_ PVOID Cookie);
+
+    LdrRegisterDllNotification_t m_LdrRegisterDllNotification;
+    LdrUnregisterDllNotification_t m_LdrUnregisterDllNotification;
+
+    // Serializes the registration with the loader. Never acquired by the
+    // notification callback, since the loader holds its own lock while calling
+    // it.
+    std::mutex m_registrationMutex;
+    PVOID m_cookie = nullptr;
+
+    wil::srwlock m_listenersLock;
+    std::vector<Listener*> m_listeners;
+};
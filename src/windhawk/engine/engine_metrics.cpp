@@ -0,0 +1,75 @@
+#include "stdafx.h"
+
+#include "customization_session.h"
+#include "engine_metrics.h"
+#include "functions.h"
+#include "logger.h"
+#include "no_destructor.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// ScopedTimer
+
+EngineMetrics::ScopedTimer::ScopedTimer(EngineMetrics* metrics, Metric metric)
+    : m_metrics(metrics),
+      m_metric(metric),
+      m_begin(Functions::QueryPerformanceCounterValue()) {}
+
+EngineMetrics::ScopedTimer::~ScopedTimer() {
+    if (!m_metrics) {
+        return;
+    }
+
+    LONGLONG elapsed = Functions::QueryPerformanceCounterValue() - m_begin;
+    m_metrics->Add(m_metric, static_cast<LONG64>(
+                                 Functions::PerformanceCounterToMicroseconds(
+                                     elapsed)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ScopedEngineInstance
+
+EngineMetrics::ScopedEngineInstance::ScopedEngineInstance() {
+    GetEngineInstanceStorage().emplace(std::wstring_view{});
+}
+
+EngineMetrics::ScopedEngineInstance::~ScopedEngineInstance() {
+    GetEngineInstanceStorage().reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EngineMetrics
+
+EngineMetrics::EngineMetrics(std::wstring_view modName) {
+    try {
+        m_slot.emplace(CustomizationSession::GetModStatusTable(),
+                       ModStatusTable::Kind::kMetrics, modName);
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+}
+
+void EngineMetrics::Add(Metric metric, LONG64 value) noexcept {
+    if (m_slot) {
+        m_slot->AddToMetric(metric, value);
+    }
+}
+
+// static
+EngineMetrics* EngineMetrics::GetEngineInstance() {
+    auto& instance = GetEngineInstanceStorage();
+    return instance ? &*instance : nullptr;
+}
+
+// static
+void EngineMetrics::AddToEngine(Metric metric, LONG64 value) noexcept {
+    if (auto* engineMetrics = GetEngineInstance()) {
+        engineMetrics->Add(metric, value);
+    }
+}
+
+// static
+std::optional<EngineMetrics>& EngineMetrics::GetEngineInstanceStorage() {
+    STATIC_INIT_ONCE(NoDestructorIfTerminating<std::optional<EngineMetrics>>,
+                     instance);
+    return **instance;
+}
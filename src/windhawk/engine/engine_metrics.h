@@ -0,0 +1,58 @@
+#pragma once
+
+#include "mod_status_table.h"
+
+// Always-on counters of the engine, kept in metrics rows of the mod status
+// table, which the app scrapes and exports. Each loaded mod has its own
+// counters, and the engine has counters for work which isn't done on behalf
+// of a single mod. Adding to a counter is a single interlocked operation.
+class EngineMetrics {
+   public:
+    using Metric = ModStatusTable::Metric;
+
+    // Adds the elapsed time in microseconds on destruction. Does nothing if
+    // metrics is nullptr.
+    class ScopedTimer {
+       public:
+        ScopedTimer(EngineMetrics* metrics, Metric metric);
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+       private:
+        EngineMetrics* m_metrics;
+        Metric m_metric;
+        LONGLONG m_begin;
+    };
+
+    // Holds the counters of the engine, which are available from static
+    // functions while the scope exists.
+    class ScopedEngineInstance {
+       public:
+        ScopedEngineInstance();
+        ~ScopedEngineInstance();
+
+        ScopedEngineInstance(const ScopedEngineInstance&) = delete;
+        ScopedEngineInstance& operator=(const ScopedEngineInstance&) = delete;
+    };
+
+    // Claims a table slot for the counters of the given mod, or of the engine
+    // if the mod name is empty. If that fails, the counters are discarded.
+    EngineMetrics(std::wstring_view modName);
+
+    EngineMetrics(const EngineMetrics&) = delete;
+    EngineMetrics& operator=(const EngineMetrics&) = delete;
+
+    // Can be called from any thread.
+    void Add(Metric metric, LONG64 value = 1) noexcept;
+
+    // Returns nullptr if there's no ScopedEngineInstance.
+    static EngineMetrics* GetEngineInstance();
+    static void AddToEngine(Metric metric, LONG64 value = 1) noexcept;
+
+   private:
+    static std::optional<EngineMetrics>& GetEngineInstanceStorage();
+
+    std::optional<ModStatusTable::Slot> m_slot;
+};
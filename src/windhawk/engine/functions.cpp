@@ -47,56 +47,71 @@ void PalGetModuleBounds(HANDLE hOsHandle,
 // 	 '?'         matches any single non-Separator character
 // 	 c           matches character c (c != '*', '?')
 bool wcsmatch(PCWSTR pat, size_t plen, PCWSTR str, size_t slen) {
-    if (plen < 0)
-        plen = wcslen(pat);
-    if (slen < 0)
-        slen = wcslen(str);
-    while (plen > 0) {
-        if (pat[0] == L'*') {
-            if (plen == 1)
-                return true;
-            if (pat[1] == L'*') {
-                pat++;
-                plen--;
-                continue;
-            }
-            if (wcsmatch(pat + 1, plen - 1, str, slen))
-                return true;
-            if (slen == 0)
-                return false;
-            str++;
-            slen--;
-            continue;
-        }
-        if (slen == 0)
+    // Iterative matching which only backtracks to the last '*', since a later
+    // '*' can absorb anything that an earlier one could. Worst case is
+    // O(plen * slen), unlike the exponential recursive approach.
+    size_t p = 0;
+    size_t s = 0;
+    size_t starP = SIZE_MAX;
+    size_t starS = 0;
+
+    while (s < slen) {
+        if (p < plen && pat[p] == L'*') {
+            starP = p++;
+            starS = s;
+        } else if (p < plen && (pat[p] == L'?' || pat[p] == str[s])) {
+            p++;
+            s++;
+        } else if (starP != SIZE_MAX) {
+            p = starP + 1;
+            s = ++starS;
+        } else {
             return false;
-        if (pat[0] != L'?' && str[0] != pat[0])
-            return false;
-        pat++;
-        plen--;
-        str++;
-        slen--;
+        }
+    }
+
+    while (p < plen && pat[p] == L'*') {
+        p++;
+    }
+
+    return p == plen;
+}
+
+namespace {
+
+template <typename T>
+std::vector<T> SplitStringImpl(std::wstring_view s, WCHAR delim) {
+    // Like std::views::split, an empty string has no parts.
+    if (s.empty()) {
+        return {};
+    }
+
+    // Count first to allocate once, symbol caches can have tens of thousands
+    // of parts.
+    std::vector<T> result;
+    result.reserve(std::ranges::count(s, delim) + 1);
+
+    size_t start = 0;
+    size_t end;
+    while ((end = s.find(delim, start)) != s.npos) {
+        result.emplace_back(s.substr(start, end - start));
+        start = end + 1;
     }
-    return slen == 0 && plen == 0;
+
+    result.emplace_back(s.substr(start));
+
+    return result;
 }
 
+}  // namespace
+
 std::vector<std::wstring> SplitString(std::wstring_view s, WCHAR delim) {
-    // https://stackoverflow.com/a/48403210
-    auto view =
-        s | std::views::split(delim) | std::views::transform([](auto&& rng) {
-            return std::wstring_view(rng.data(), rng.size());
-        });
-    return std::vector<std::wstring>(view.begin(), view.end());
+    return SplitStringImpl<std::wstring>(s, delim);
 }
 
 std::vector<std::wstring_view> SplitStringToViews(std::wstring_view s,
                                                   WCHAR delim) {
-    // https://stackoverflow.com/a/48403210
-    auto view =
-        s | std::views::split(delim) | std::views::transform([](auto&& rng) {
-            return std::wstring_view(rng.data(), rng.size());
-        });
-    return std::vector<std::wstring_view>(view.begin(), view.end());
+    return SplitStringImpl<std::wstring_view>(s, delim);
 }
 
 // https://stackoverflow.com/a/29752943
@@ -104,35 +119,40 @@ std::wstring ReplaceAll(std::wstring_view source,
                         std::wstring_view from,
                         std::wstring_view to,
                         bool ignoreCase) {
-    auto findString = [ignoreCase](std::wstring_view haystack,
-                                   std::wstring_view needle,
-                                   size_t pos) -> size_t {
-        if (!ignoreCase) {
-            return haystack.find(needle, pos);
-        }
+    // For a case insensitive search, both strings are uppercased once instead
+    // of mapping each pair of compared characters. Uppercasing doesn't change
+    // the length of the string, so positions remain valid for the source.
+    std::wstring sourceUpper;
+    std::wstring fromUpper;
+    std::wstring_view haystack = source;
+    std::wstring_view needle = from;
+    if (ignoreCase) {
+        auto toUpper = [](std::wstring_view s) {
+            std::wstring result(s);
+            if (!result.empty()) {
+                THROW_LAST_ERROR_IF(
+                    LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE,
+                                  s.data(), static_cast<int>(s.length()),
+                                  result.data(),
+                                  static_cast<int>(result.length()), nullptr,
+                                  nullptr, 0) == 0);
+            }
 
-        auto it = std::search(
-            haystack.begin() + pos, haystack.end(), needle.begin(),
-            needle.end(), [](WCHAR ch1, WCHAR ch2) {
-                LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE, &ch1,
-                              1, &ch1, 1, nullptr, nullptr, 0);
-                LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE, &ch2,
-                              1, &ch2, 1, nullptr, nullptr, 0);
-                return ch1 == ch2;
-            });
-        if (it == haystack.end()) {
-            return haystack.npos;
-        }
+            return result;
+        };
 
-        return std::distance(haystack.begin(), it);
-    };
+        sourceUpper = toUpper(source);
+        fromUpper = toUpper(from);
+        haystack = sourceUpper;
+        needle = fromUpper;
+    }
 
     std::wstring newString;
 
     size_t lastPos = 0;
     size_t findPos;
 
-    while ((findPos = findString(source, from, lastPos)) != source.npos) {
+    while ((findPos = haystack.find(needle, lastPos)) != haystack.npos) {
         newString.append(source, lastPos, findPos - lastPos);
         newString += to;
         lastPos = findPos + from.length();
@@ -144,82 +164,54 @@ std::wstring ReplaceAll(std::wstring_view source,
     return newString;
 }
 
-bool DoesPathMatchPattern(std::wstring_view path,
-                          std::wstring_view pattern,
-                          bool explicitOnly) {
-    if (pattern.empty()) {
-        return false;
-    }
-
-    // A case-insensitive comparison as recommended here:
-    // https://stackoverflow.com/q/410502
+std::string WideToUtf8(std::wstring_view s) {
+    int size =
+        WideCharToMultiByte(CP_UTF8, 0, s.data(), static_cast<int>(s.length()),
+                            nullptr, 0, nullptr, nullptr);
+    std::string result(size, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, s.data(), static_cast<int>(s.length()),
+                        result.data(), size, nullptr, nullptr);
+    return result;
+}
 
-    std::wstring pathUpper{path};
+void AppendJsonString(std::wstring* json, std::wstring_view s) {
+    *json += L'"';
 
-    // Don't use CharUpperBuff to avoid depending on user32.dll. Use
-    // LCMapStringEx just like it's called internally by CharUpperBuff.
-    // CharUpperBuff(&pathUpper[0], wil::safe_cast<DWORD>(pathUpper.length()));
-    LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE, &pathUpper[0],
-                  wil::safe_cast<int>(pathUpper.length()), &pathUpper[0],
-                  wil::safe_cast<int>(pathUpper.length()), nullptr, nullptr, 0);
+    for (WCHAR c : s) {
+        switch (c) {
+            case L'"':
+                *json += L"\\\"";
+                break;
 
-    std::wstring_view pathFileNameUpper = pathUpper;
-    if (size_t i = pathFileNameUpper.rfind(L'\\');
-        i != pathFileNameUpper.npos) {
-        pathFileNameUpper.remove_prefix(i + 1);
-    }
+            case L'\\':
+                *json += L"\\\\";
+                break;
 
-    for (const auto& patternPartView : SplitStringToViews(pattern, L'|')) {
-        if (explicitOnly) {
-            bool patternIsWildcard =
-                patternPartView.find_first_of(L"*?") != patternPartView.npos;
-            if (patternIsWildcard) {
-                // If the pattern contains wildcards, it's not an explicit
-                // match.
-                continue;
-            }
-        }
+            case L'\n':
+                *json += L"\\n";
+                break;
 
-        auto patternPart = std::wstring{patternPartView};
+            case L'\r':
+                *json += L"\\r";
+                break;
 
-#ifndef _WIN64
-        BOOL isWow64;
-        if (IsWow64Process(GetCurrentProcess(), &isWow64) && isWow64) {
-            // Get the native Program Files path regardless of the current
-            // process architecture.
-            patternPart = ReplaceAll(patternPart, L"%ProgramFiles%",
-                                     L"%ProgramW6432%", /*ignoreCase=*/true);
-        }
-#endif  // _WIN64
-
-        auto patternPartNormalized =
-            wil::ExpandEnvironmentStrings<std::wstring>(patternPart.c_str());
-
-        // CharUpperBuff(&patternPartNormalized[0],
-        //               wil::safe_cast<DWORD>(patternPartNormalized.length()));
-        LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE,
-                      &patternPartNormalized[0],
-                      wil::safe_cast<int>(patternPartNormalized.length()),
-                      &patternPartNormalized[0],
-                      wil::safe_cast<int>(patternPartNormalized.length()),
-                      nullptr, nullptr, 0);
-
-        std::wstring_view match = pathUpper;
-
-        // If there's no backslash in the pattern part, match only against the
-        // file name, not the full path.
-        if (patternPartNormalized.find(L'\\') == patternPartNormalized.npos) {
-            match = pathFileNameUpper;
-        }
+            case L'\t':
+                *json += L"\\t";
+                break;
 
-        if (wcsmatch(patternPartNormalized.data(),
-                     patternPartNormalized.length(), match.data(),
-                     match.length())) {
-            return true;
+            default:
+                if (c < 0x20) {
+                    WCHAR escaped[8];
+                    swprintf_s(escaped, L"\\u%04X", c);
+                    *json += escaped;
+                } else {
+                    *json += c;
+                }
+                break;
         }
     }
 
-    return false;
+    *json += L'"';
 }
 
 void** FindImportPtr(HMODULE hFindInModule,
@@ -284,6 +276,67 @@ void** FindImportPtr(HMODULE hFindInModule,
     return nullptr;
 }
 
+DWORD* FindExportPtr(HMODULE hFindInModule, PCSTR pExportName) {
+    IMAGE_DOS_HEADER* pDosHeader = (IMAGE_DOS_HEADER*)hFindInModule;
+    IMAGE_NT_HEADERS* pNtHeader =
+        (IMAGE_NT_HEADERS*)((char*)pDosHeader + pDosHeader->e_lfanew);
+
+    if (pNtHeader->OptionalHeader.NumberOfRvaAndSizes <=
+            IMAGE_DIRECTORY_ENTRY_EXPORT ||
+        !pNtHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT]
+             .VirtualAddress) {
+        return nullptr;
+    }
+
+    ULONG_PTR ImageBase = (ULONG_PTR)hFindInModule;
+    IMAGE_EXPORT_DIRECTORY* pExportDirectory =
+        (IMAGE_EXPORT_DIRECTORY*)(ImageBase +
+                                  pNtHeader->OptionalHeader
+                                      .DataDirectory
+                                          [IMAGE_DIRECTORY_ENTRY_EXPORT]
+                                      .VirtualAddress);
+
+    DWORD* pFunctions =
+        (DWORD*)(ImageBase + pExportDirectory->AddressOfFunctions);
+
+    if (((ULONG_PTR)pExportName & ~0xFFFF) == 0) {
+        DWORD index = (DWORD)(ULONG_PTR)pExportName - pExportDirectory->Base;
+        if (index >= pExportDirectory->NumberOfFunctions) {
+            return nullptr;
+        }
+
+        return &pFunctions[index];
+    }
+
+    DWORD* pNames = (DWORD*)(ImageBase + pExportDirectory->AddressOfNames);
+    WORD* pNameOrdinals =
+        (WORD*)(ImageBase + pExportDirectory->AddressOfNameOrdinals);
+
+    // Names are sorted, which allows for a binary search.
+    DWORD low = 0;
+    DWORD high = pExportDirectory->NumberOfNames;
+    while (low < high) {
+        DWORD mid = low + (high - low) / 2;
+        int cmp = strcmp((char*)(ImageBase + pNames[mid]), pExportName);
+        if (cmp == 0) {
+            WORD index = pNameOrdinals[mid];
+            if (index >= pExportDirectory->NumberOfFunctions) {
+                return nullptr;
+            }
+
+            return &pFunctions[index];
+        }
+
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return nullptr;
+}
+
 BOOL GetFullAccessSecurityDescriptor(
     _Outptr_ PSECURITY_DESCRIPTOR* SecurityDescriptor,
     _Out_opt_ PULONG SecurityDescriptorSize) {
@@ -636,4 +689,23 @@ std::string GetModuleVersion(HMODULE hModule) {
     return result;
 }
 
+LONGLONG QueryPerformanceCounterValue() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+ULONGLONG PerformanceCounterToMicroseconds(LONGLONG counter) {
+    STATIC_INIT_ONCE_TRIVIAL(LONGLONG, frequency, []() {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return frequency.QuadPart;
+    }());
+
+    // Split the multiplication to avoid an overflow.
+    ULONGLONG value = static_cast<ULONGLONG>(counter);
+    ULONGLONG f = static_cast<ULONGLONG>(frequency);
+    return value / f * 1000000 + value % f * 1000000 / f;
+}
+
 }  // namespace Functions
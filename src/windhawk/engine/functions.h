@@ -10,12 +10,13 @@ std::wstring ReplaceAll(std::wstring_view source,
                         std::wstring_view from,
                         std::wstring_view to,
                         bool ignoreCase = false);
-bool DoesPathMatchPattern(std::wstring_view path,
-                          std::wstring_view pattern,
-                          bool explicitOnly = false);
+std::string WideToUtf8(std::wstring_view s);
+// Appends the string to a JSON document as a quoted and escaped string.
+void AppendJsonString(std::wstring* json, std::wstring_view s);
 void** FindImportPtr(HMODULE hFindInModule,
                      PCSTR pModuleName,
                      PCSTR pImportName);
+DWORD* FindExportPtr(HMODULE hFindInModule, PCSTR pExportName);
 BOOL GetFullAccessSecurityDescriptor(
     _Outptr_ PSECURITY_DESCRIPTOR* SecurityDescriptor,
     _Out_opt_ PULONG SecurityDescriptorSize);
@@ -52,5 +53,8 @@ bool ModuleGetPDBInfo(HANDLE hOsHandle,
                       _Out_ GUID* pGuidSignature,
                       _Out_ DWORD* pdwAge);
 std::string GetModuleVersion(HMODULE hModule);
+LONGLONG QueryPerformanceCounterValue();
+// Converts a performance counter value or difference to microseconds.
+ULONGLONG PerformanceCounterToMicroseconds(LONGLONG counter);
 
 }  // namespace Functions
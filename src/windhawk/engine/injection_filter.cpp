@@ -0,0 +1,131 @@
+#include "stdafx.h"
+
+#include "injection_filter.h"
+#include "process_lists.h"
+#include "storage_manager.h"
+
+namespace {
+
+// Enough for the executables that are typically launched repeatedly. Once
+// full, the cache is cleared and refilled with the executables which are
+// still in use.
+constexpr size_t kMaxCachedDecisions = 256;
+
+}  // namespace
+
+InjectionFilter::InjectionFilter() {
+    auto settings = StorageManager::GetInstance().GetAppConfig(L"Settings");
+    auto includePattern = settings->GetString(L"Include").value_or(L"");
+    auto excludePattern = settings->GetString(L"Exclude").value_or(L"");
+    auto threadAttachExemptPattern =
+        settings->GetString(L"ThreadAttachExempt").value_or(L"");
+
+    if (!settings->GetInt(L"InjectIntoCriticalProcesses").value_or(0)) {
+        if (!excludePattern.empty()) {
+            excludePattern += L'|';
+        }
+
+        excludePattern += ProcessLists::kCriticalProcesses;
+    }
+
+    if (!settings->GetInt(L"InjectIntoIncompatiblePrograms").value_or(0)) {
+        if (!excludePattern.empty()) {
+            excludePattern += L'|';
+        }
+
+        excludePattern += ProcessLists::kIncompatiblePrograms;
+    }
+
+    if (!settings->GetInt(L"InjectIntoGames").value_or(0)) {
+        if (!excludePattern.empty()) {
+            excludePattern += L'|';
+        }
+
+        excludePattern += ProcessLists::kGames;
+    }
+
+    m_includeMatcher = PathPatternMatcher(includePattern);
+    m_excludeMatcher = PathPatternMatcher(excludePattern);
+    m_threadAttachExemptMatcher = PathPatternMatcher(threadAttachExemptPattern);
+}
+
+InjectionFilter::Decision InjectionFilter::Decide(
+    const std::wstring& processImageName) {
+    {
+        std::lock_guard<std::mutex> guard(m_decisionCacheMutex);
+
+        auto it = m_decisionCache.find(processImageName);
+        if (it != m_decisionCache.end()) {
+            return it->second;
+        }
+    }
+
+    Decision decision = DecideUncached(processImageName);
+
+    std::lock_guard<std::mutex> guard(m_decisionCacheMutex);
+
+    if (m_decisionCache.size() >= kMaxCachedDecisions) {
+        m_decisionCache.clear();
+    }
+
+    m_decisionCache.try_emplace(processImageName, decision);
+
+    return decision;
+}
+
+InjectionFilter::Decision InjectionFilter::DecideUncached(
+    const std::wstring& processImageName) {
+    PathPatternMatcher::Path processImagePath(processImageName);
+
+    if (m_excludeMatcher.Matches(processImagePath) &&
+        !m_includeMatcher.Matches(processImagePath)) {
+        return {.skip = true, .threadAttachExempt = false};
+    }
+
+    return {
+        .skip = false,
+        .threadAttachExempt =
+            m_threadAttachExemptMatcher.Matches(processImagePath),
+    };
+}
+
+ModTargetFilter::ModTargetFilter() {
+    auto& storageManager = StorageManager::GetInstance();
+
+    std::wstring includePattern;
+    auto addPattern = [&includePattern](std::wstring_view pattern) {
+        if (pattern.empty()) {
+            return;
+        }
+
+        if (!includePattern.empty()) {
+            includePattern += L'|';
+        }
+
+        includePattern += pattern;
+    };
+
+    storageManager.EnumMods([&storageManager, &addPattern](PCWSTR modName) {
+        auto settings = storageManager.GetModConfig(modName, nullptr);
+
+        if (settings->GetInt(L"Disabled").value_or(0)) {
+            return;
+        }
+
+        // See Mod::ShouldLoadInRunningProcess. The exclude patterns and the
+        // architecture aren't checked, since matching more processes than
+        // needed is harmless.
+        if (!settings->GetInt(L"IncludeExcludeCustomOnly").value_or(0)) {
+            addPattern(settings->GetString(L"Include").value_or(L""));
+        }
+
+        addPattern(settings->GetString(L"IncludeCustom").value_or(L""));
+    });
+
+    m_includeMatcher = PathPatternMatcher(includePattern);
+}
+
+bool ModTargetFilter::MightBeTargeted(
+    const std::wstring& processImageName) const {
+    return m_includeMatcher.Matches(processImageName);
+}
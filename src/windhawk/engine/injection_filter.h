@@ -0,0 +1,50 @@
+#pragma once
+
+#include "path_pattern_matcher.h"
+
+// Decides which new processes to inject into, based on the include, exclude
+// and thread attach exempt patterns of the engine settings. The same
+// executables are often launched over and over, e.g. compilers during a
+// build, so decisions are cached by image path.
+class InjectionFilter {
+   public:
+    struct Decision {
+        bool skip;
+        bool threadAttachExempt;
+    };
+
+    // Reads the engine settings. Engine settings changes restart the engine,
+    // so the patterns and the cached decisions never become outdated.
+    InjectionFilter();
+
+    InjectionFilter(const InjectionFilter&) = delete;
+    InjectionFilter& operator=(const InjectionFilter&) = delete;
+
+    // Thread-safe.
+    Decision Decide(const std::wstring& processImageName);
+
+   private:
+    Decision DecideUncached(const std::wstring& processImageName);
+
+    PathPatternMatcher m_includeMatcher;
+    PathPatternMatcher m_excludeMatcher;
+    PathPatternMatcher m_threadAttachExemptMatcher;
+
+    std::mutex m_decisionCacheMutex;
+    std::unordered_map<std::wstring, Decision> m_decisionCache;
+};
+
+// Matches the processes which at least one enabled mod might be loaded into,
+// so that the engine isn't injected into processes no mod targets. Only the
+// include patterns of the mods are used, which makes it a superset of the
+// processes the mods are actually loaded into.
+class ModTargetFilter {
+   public:
+    // Reads the config of all mods.
+    ModTargetFilter();
+
+    bool MightBeTargeted(const std::wstring& processImageName) const;
+
+   private:
+    PathPatternMatcher m_includeMatcher;
+};
@@ -428,7 +428,7 @@ static MH_STATUS QueueHook(ULONG_PTR hookIdent, LPVOID pTarget, BOOL queueEnable
     return status;
 }
 
-static MH_STATUS ApplyQueued(ULONG_PTR hookIdent)
+static MH_STATUS ApplyQueued(ULONG_PTR hookIdent, BOOL *pThreadsFrozen)
 {
     MH_STATUS status = MH_OK;
     HRESULT hr;
@@ -439,6 +439,8 @@ static MH_STATUS ApplyQueued(ULONG_PTR hookIdent)
         hr = MHDetoursTransactionBegin();
         if (SUCCEEDED(hr))
         {
+            *pThreadsFrozen = g_threadFreezeMethod != MH_FREEZE_METHOD_NONE_UNSAFE;
+
             do
             {
                 PHOOK_ENTRY pHook = &g_hooks.pItems[pos];
@@ -743,12 +745,19 @@ MH_STATUS WINAPI MH_ApplyQueued(VOID)
 }
 MH_STATUS WINAPI MH_ApplyQueuedEx(ULONG_PTR hookIdent)
 {
+    BOOL threadsFrozen;
+    return MH_ApplyQueuedEx2(hookIdent, &threadsFrozen);
+}
+MH_STATUS WINAPI MH_ApplyQueuedEx2(ULONG_PTR hookIdent, BOOL *pThreadsFrozen)
+{
+    *pThreadsFrozen = FALSE;
+
     if (!g_initialized)
         return MH_ERROR_NOT_INITIALIZED;
 
     EnterCriticalSection(&g_criticalSection);
 
-    MH_STATUS status = ApplyQueued(hookIdent);
+    MH_STATUS status = ApplyQueued(hookIdent, pThreadsFrozen);
 
     LeaveCriticalSection(&g_criticalSection);
 
@@ -242,6 +242,13 @@ extern "C" {
     MH_STATUS WINAPI MH_ApplyQueued(VOID);
     MH_STATUS WINAPI MH_ApplyQueuedEx(ULONG_PTR hookIdent);
 
+    // Same as MH_ApplyQueuedEx, and also reports whether the threads of the
+    // process were suspended, which is only done if there are queued changes
+    // and the freeze method isn't MH_FREEZE_METHOD_NONE_UNSAFE.
+    //   pThreadsFrozen [out] Set to TRUE if the threads were suspended, and
+    //                        to FALSE otherwise.
+    MH_STATUS WINAPI MH_ApplyQueuedEx2(ULONG_PTR hookIdent, BOOL *pThreadsFrozen);
+
     // Translates the MH_STATUS to its name as a string.
     const char *WINAPI MH_StatusToString(MH_STATUS status);
 
@@ -107,6 +107,22 @@ typedef enum MH_THREAD_FREEZE_METHOD
     MH_FREEZE_METHOD_NONE_UNSAFE
 } MH_THREAD_FREEZE_METHOD;
 
+// Statistics of the executable buffers, which hold the relay and trampoline
+// functions of the hooks. Buffers are allocated in slots, slots are grouped
+// in blocks (pages), and blocks are committed from reserved regions, each
+// region close enough to the hooked functions to be reachable by a relative
+// jump.
+typedef struct _MH_BUFFER_STATS
+{
+    UINT   regionCount;         // Number of reserved regions.
+    UINT   committedBlockCount; // Number of committed blocks in all regions.
+    UINT   slotCount;           // Number of slots in all committed blocks.
+    UINT   usedSlotCount;       // Number of slots currently in use.
+    UINT   peakUsedSlotCount;   // Max number of slots in use at the same time.
+    UINT64 allocationCount;     // Total number of slot allocations.
+    UINT64 reusedSlotCount;     // Allocations which reused a released slot.
+} MH_BUFFER_STATS;
+
 // Can be passed as a parameter to MH_EnableHook, MH_DisableHook,
 // MH_QueueEnableHook or MH_QueueDisableHook.
 #define MH_ALL_HOOKS NULL
@@ -129,6 +145,12 @@ extern "C" {
     // Set the method of suspending and resuming threads.
     MH_STATUS WINAPI MH_SetThreadFreezeMethod(MH_THREAD_FREEZE_METHOD method);
 
+    // Enables or disables call counting for the hooks created afterwards. Such
+    // hooks jump to the detour function through a relay which atomically
+    // increments a per-hook counter. Hooks created while call counting is
+    // disabled have no additional overhead.
+    MH_STATUS WINAPI MH_SetCallCounting(BOOL enable);
+
     // Creates a hook for the specified target function, in disabled state.
     // Parameters:
     //   hookIdent   [in]  A hook identifier, can be set to different values for
@@ -245,6 +267,32 @@ extern "C" {
     MH_STATUS WINAPI MH_ApplyQueued(VOID);
     MH_STATUS WINAPI MH_ApplyQueuedEx(ULONG_PTR hookIdent);
 
+    // Same as MH_ApplyQueuedEx, and also reports whether the threads of the
+    // process were suspended, which is only done if there are queued changes
+    // and the freeze method isn't MH_FREEZE_METHOD_NONE_UNSAFE.
+    //   pThreadsFrozen [out] Set to TRUE if the threads were suspended, and
+    //                        to FALSE otherwise.
+    MH_STATUS WINAPI MH_ApplyQueuedEx2(ULONG_PTR hookIdent, BOOL *pThreadsFrozen);
+
+    // Retrieves the number of calls of a hook.
+    // Parameters:
+    //   hookIdent   [in]  A hook identifier, can be set to different values for
+    //                     different hooks to hook the same function more than
+    //                     once. Default value: MH_DEFAULT_IDENT.
+    //   pTarget     [in]  A pointer to the target function.
+    //   pCallCount  [out] A pointer to the variable which receives the number
+    //                     of calls.
+    // Returns MH_ERROR_UNSUPPORTED_FUNCTION if the hook was created while call
+    // counting was disabled, or if its counter couldn't be set up, in which
+    // case the hook works without call counting.
+    MH_STATUS WINAPI MH_GetCallCount(ULONG_PTR hookIdent, LPVOID pTarget, UINT64 *pCallCount);
+
+    // Retrieves the statistics of the executable buffers.
+    // Parameters:
+    //   pStats      [out] A pointer to the structure which receives the
+    //                     statistics.
+    MH_STATUS WINAPI MH_GetBufferStats(MH_BUFFER_STATS *pStats);
+
     // Translates the MH_STATUS to its name as a string.
     const char * WINAPI MH_StatusToString(MH_STATUS status);
 
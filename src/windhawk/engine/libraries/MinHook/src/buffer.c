@@ -27,11 +27,27 @@
  */
 
 #include <windows.h>
+#include "../include/MinHook.h"
 #include "buffer.h"
 
 // Size of each memory block. (= page size of VirtualAlloc)
 #define MEMORY_BLOCK_SIZE 0x1000
 
+// Size of each memory region. Regions are reserved at once and committed
+// block by block. (= allocation granularity of VirtualAlloc)
+#define MEMORY_REGION_SIZE 0x10000
+
+// Number of memory blocks in each memory region.
+#define MEMORY_BLOCKS_PER_REGION (MEMORY_REGION_SIZE / MEMORY_BLOCK_SIZE)
+
+// Number of blocks at the end of each region which hold a 64-bit counter for
+// each slot of the region. They're committed as non-executable on first use,
+// so that writing a counter never touches a code page.
+#define MEMORY_COUNTER_BLOCKS 2
+
+// Number of memory blocks in each memory region which hold slots.
+#define MEMORY_SLOT_BLOCKS_PER_REGION (MEMORY_BLOCKS_PER_REGION - MEMORY_COUNTER_BLOCKS)
+
 // Max range for seeking a memory block. (= 1024MB)
 #define MAX_MEMORY_RANGE 0x40000000
 
@@ -52,17 +68,35 @@ typedef struct _MEMORY_SLOT
 // Memory block info. Placed at the head of each block.
 typedef struct _MEMORY_BLOCK
 {
-    struct _MEMORY_BLOCK *pNext;
-    PMEMORY_SLOT pFree;         // First element of the free slot list.
+    PMEMORY_SLOT pFree;         // First element of the released slot list.
+    PMEMORY_SLOT pUnused;       // First slot which was never used, or NULL.
     UINT usedCount;
 } MEMORY_BLOCK, *PMEMORY_BLOCK;
 
+// Memory region info. Placed right after the info of the first block.
+typedef struct _MEMORY_REGION
+{
+    struct _MEMORY_REGION *pNext;
+    LPBYTE pBase;               // Base address of the reserved region.
+    UINT committedCount;        // Number of committed blocks, from the base.
+    UINT usedCount;             // Number of used slots in all blocks.
+} MEMORY_REGION, *PMEMORY_REGION;
+
 //-------------------------------------------------------------------------
 // Global Variables:
 //-------------------------------------------------------------------------
 
-// First element of the memory block list.
-static PMEMORY_BLOCK g_pMemoryBlocks;
+// First element of the memory region list.
+static PMEMORY_REGION g_pMemoryRegions;
+
+// Allocation statistics.
+static struct
+{
+    UINT   usedSlotCount;
+    UINT   peakUsedSlotCount;
+    UINT64 allocationCount;
+    UINT64 reusedSlotCount;
+} g_stats;
 
 //-------------------------------------------------------------------------
 VOID InitializeBuffer(VOID)
@@ -73,15 +107,17 @@ VOID InitializeBuffer(VOID)
 //-------------------------------------------------------------------------
 VOID UninitializeBuffer(VOID)
 {
-    PMEMORY_BLOCK pBlock = g_pMemoryBlocks;
-    g_pMemoryBlocks = NULL;
+    PMEMORY_REGION pRegion = g_pMemoryRegions;
+    g_pMemoryRegions = NULL;
 
-    while (pBlock)
+    while (pRegion)
     {
-        PMEMORY_BLOCK pNext = pBlock->pNext;
-        VirtualFree(pBlock, 0, MEM_RELEASE);
-        pBlock = pNext;
+        PMEMORY_REGION pNext = pRegion->pNext;
+        VirtualFree(pRegion->pBase, 0, MEM_RELEASE);
+        pRegion = pNext;
     }
+
+    ZeroMemory(&g_stats, sizeof(g_stats));
 }
 
 //-------------------------------------------------------------------------
@@ -148,9 +184,96 @@ static LPVOID FindNextFreeRegion(LPVOID pAddress, LPVOID pMaxAddr, DWORD dwAlloc
 #endif
 
 //-------------------------------------------------------------------------
-static PMEMORY_BLOCK GetMemoryBlock(LPVOID pOrigin)
+static PMEMORY_BLOCK GetRegionBlock(PMEMORY_REGION pRegion, UINT index)
+{
+    return (PMEMORY_BLOCK)(pRegion->pBase + (SIZE_T)index * MEMORY_BLOCK_SIZE);
+}
+
+//-------------------------------------------------------------------------
+static UINT GetBlockSlotCount(PMEMORY_REGION pRegion, PMEMORY_BLOCK pBlock)
+{
+    // The block info takes the first slot. The first block of each region
+    // also holds the region info in the second slot.
+    UINT count = MEMORY_BLOCK_SIZE / MEMORY_SLOT_SIZE - 1;
+    if ((LPBYTE)pBlock == pRegion->pBase)
+        count--;
+
+    return count;
+}
+
+//-------------------------------------------------------------------------
+static VOID InitializeBlock(PMEMORY_REGION pRegion, PMEMORY_BLOCK pBlock)
+{
+    // Slots are handed out sequentially, and released slots are kept in a
+    // list for reuse, so there's no need to build a list of all the slots.
+    pBlock->pFree = NULL;
+    pBlock->pUnused = (PMEMORY_SLOT)pBlock + (MEMORY_BLOCK_SIZE / MEMORY_SLOT_SIZE - GetBlockSlotCount(pRegion, pBlock));
+    pBlock->usedCount = 0;
+}
+
+//-------------------------------------------------------------------------
+static PMEMORY_REGION CreateRegion(LPVOID pAddress)
+{
+    PMEMORY_REGION pRegion;
+    LPBYTE pBase = (LPBYTE)VirtualAlloc(
+        pAddress, MEMORY_REGION_SIZE, MEM_RESERVE, PAGE_NOACCESS);
+    if (pBase == NULL)
+        return NULL;
+
+    // Commit the first block, which holds the region info.
+    if (VirtualAlloc(pBase, MEMORY_BLOCK_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE) == NULL)
+    {
+        VirtualFree(pBase, 0, MEM_RELEASE);
+        return NULL;
+    }
+
+    pRegion = (PMEMORY_REGION)((PMEMORY_SLOT)pBase + 1);
+    pRegion->pBase = pBase;
+    pRegion->committedCount = 1;
+    pRegion->usedCount = 0;
+
+    InitializeBlock(pRegion, (PMEMORY_BLOCK)pBase);
+
+    pRegion->pNext = g_pMemoryRegions;
+    g_pMemoryRegions = pRegion;
+
+    return pRegion;
+}
+
+//-------------------------------------------------------------------------
+static PMEMORY_BLOCK GetRegionFreeBlock(PMEMORY_REGION pRegion)
 {
     PMEMORY_BLOCK pBlock;
+    UINT i;
+
+    // Prefer the committed blocks, released slots first.
+    for (i = 0; i < pRegion->committedCount; i++)
+    {
+        pBlock = GetRegionBlock(pRegion, i);
+        if (pBlock->pFree != NULL || pBlock->pUnused != NULL)
+            return pBlock;
+    }
+
+    if (pRegion->committedCount == MEMORY_SLOT_BLOCKS_PER_REGION)
+        return NULL;
+
+    // Commit the next block of the already reserved region.
+    pBlock = (PMEMORY_BLOCK)VirtualAlloc(
+        GetRegionBlock(pRegion, pRegion->committedCount), MEMORY_BLOCK_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+    if (pBlock == NULL)
+        return NULL;
+
+    InitializeBlock(pRegion, pBlock);
+    pRegion->committedCount++;
+
+    return pBlock;
+}
+
+//-------------------------------------------------------------------------
+static PMEMORY_BLOCK GetMemoryBlock(LPVOID pOrigin, PMEMORY_REGION *ppRegion)
+{
+    PMEMORY_REGION pRegion;
+    PMEMORY_BLOCK pBlock;
 #if defined(_M_X64) || defined(__x86_64__)
     ULONG_PTR minAddr;
     ULONG_PTR maxAddr;
@@ -167,25 +290,31 @@ static PMEMORY_BLOCK GetMemoryBlock(LPVOID pOrigin)
     if (maxAddr > (ULONG_PTR)pOrigin + MAX_MEMORY_RANGE)
         maxAddr = (ULONG_PTR)pOrigin + MAX_MEMORY_RANGE;
 
-    // Make room for MEMORY_BLOCK_SIZE bytes.
-    maxAddr -= MEMORY_BLOCK_SIZE - 1;
+    // Make room for MEMORY_REGION_SIZE bytes.
+    maxAddr -= MEMORY_REGION_SIZE - 1;
 #endif
 
-    // Look the registered blocks for a reachable one.
-    for (pBlock = g_pMemoryBlocks; pBlock != NULL; pBlock = pBlock->pNext)
+    // Look the registered regions for a reachable one.
+    for (pRegion = g_pMemoryRegions; pRegion != NULL; pRegion = pRegion->pNext)
     {
 #if defined(_M_X64) || defined(__x86_64__)
-        // Ignore the blocks too far.
-        if ((ULONG_PTR)pBlock < minAddr || (ULONG_PTR)pBlock >= maxAddr)
+        // Ignore the regions too far.
+        if ((ULONG_PTR)pRegion->pBase < minAddr || (ULONG_PTR)pRegion->pBase >= maxAddr)
             continue;
 #endif
-        // The block has at least one unused slot.
-        if (pBlock->pFree != NULL)
+        // The region has at least one unused slot, or room for a new block.
+        pBlock = GetRegionFreeBlock(pRegion);
+        if (pBlock != NULL)
+        {
+            *ppRegion = pRegion;
             return pBlock;
+        }
     }
 
+    pRegion = NULL;
+
 #if defined(_M_X64) || defined(__x86_64__)
-    // Alloc a new block above if not found.
+    // Alloc a new region above if not found.
     {
         LPVOID pAlloc = pOrigin;
         while ((ULONG_PTR)pAlloc >= minAddr)
@@ -194,15 +323,14 @@ static PMEMORY_BLOCK GetMemoryBlock(LPVOID pOrigin)
             if (pAlloc == NULL)
                 break;
 
-            pBlock = (PMEMORY_BLOCK)VirtualAlloc(
-                pAlloc, MEMORY_BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
-            if (pBlock != NULL)
+            pRegion = CreateRegion(pAlloc);
+            if (pRegion != NULL)
                 break;
         }
     }
 
-    // Alloc a new block below if not found.
-    if (pBlock == NULL)
+    // Alloc a new region below if not found.
+    if (pRegion == NULL)
     {
         LPVOID pAlloc = pOrigin;
         while ((ULONG_PTR)pAlloc <= maxAddr)
@@ -211,50 +339,56 @@ static PMEMORY_BLOCK GetMemoryBlock(LPVOID pOrigin)
             if (pAlloc == NULL)
                 break;
 
-            pBlock = (PMEMORY_BLOCK)VirtualAlloc(
-                pAlloc, MEMORY_BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
-            if (pBlock != NULL)
+            pRegion = CreateRegion(pAlloc);
+            if (pRegion != NULL)
                 break;
         }
     }
 #else
-    // In x86 mode, a memory block can be placed anywhere.
-    pBlock = (PMEMORY_BLOCK)VirtualAlloc(
-        NULL, MEMORY_BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    // In x86 mode, a memory region can be placed anywhere.
+    pRegion = CreateRegion(NULL);
 #endif
 
-    if (pBlock != NULL)
-    {
-        // Build a linked list of all the slots.
-        PMEMORY_SLOT pSlot = (PMEMORY_SLOT)pBlock + 1;
-        pBlock->pFree = NULL;
-        pBlock->usedCount = 0;
-        do
-        {
-            pSlot->pNext = pBlock->pFree;
-            pBlock->pFree = pSlot;
-            pSlot++;
-        } while ((ULONG_PTR)pSlot - (ULONG_PTR)pBlock <= MEMORY_BLOCK_SIZE - MEMORY_SLOT_SIZE);
-
-        pBlock->pNext = g_pMemoryBlocks;
-        g_pMemoryBlocks = pBlock;
-    }
+    if (pRegion == NULL)
+        return NULL;
 
-    return pBlock;
+    *ppRegion = pRegion;
+    return (PMEMORY_BLOCK)pRegion->pBase;
 }
 
 //-------------------------------------------------------------------------
 LPVOID AllocateBuffer(LPVOID pOrigin)
 {
-    PMEMORY_SLOT  pSlot;
-    PMEMORY_BLOCK pBlock = GetMemoryBlock(pOrigin);
+    PMEMORY_SLOT   pSlot;
+    PMEMORY_REGION pRegion;
+    PMEMORY_BLOCK  pBlock = GetMemoryBlock(pOrigin, &pRegion);
     if (pBlock == NULL)
         return NULL;
 
-    // Remove an unused slot from the list.
-    pSlot = pBlock->pFree;
-    pBlock->pFree = pSlot->pNext;
+    if (pBlock->pFree != NULL)
+    {
+        // Reuse a released slot.
+        pSlot = pBlock->pFree;
+        pBlock->pFree = pSlot->pNext;
+        g_stats.reusedSlotCount++;
+    }
+    else
+    {
+        // Take the next never used slot.
+        pSlot = pBlock->pUnused;
+        pBlock->pUnused = pSlot + 1;
+        if ((ULONG_PTR)pBlock->pUnused - (ULONG_PTR)pBlock > MEMORY_BLOCK_SIZE - MEMORY_SLOT_SIZE)
+            pBlock->pUnused = NULL;
+    }
+
     pBlock->usedCount++;
+    pRegion->usedCount++;
+
+    g_stats.allocationCount++;
+    g_stats.usedSlotCount++;
+    if (g_stats.peakUsedSlotCount < g_stats.usedSlotCount)
+        g_stats.peakUsedSlotCount = g_stats.usedSlotCount;
+
 #ifdef _DEBUG
     // Fill the slot with INT3 for debugging.
     memset(pSlot, 0xCC, sizeof(MEMORY_SLOT));
@@ -265,14 +399,16 @@ LPVOID AllocateBuffer(LPVOID pOrigin)
 //-------------------------------------------------------------------------
 VOID FreeBuffer(LPVOID pBuffer)
 {
-    PMEMORY_BLOCK pBlock = g_pMemoryBlocks;
-    PMEMORY_BLOCK pPrev = NULL;
-    ULONG_PTR pTargetBlock = ((ULONG_PTR)pBuffer / MEMORY_BLOCK_SIZE) * MEMORY_BLOCK_SIZE;
+    PMEMORY_REGION pRegion = g_pMemoryRegions;
+    PMEMORY_REGION pPrev = NULL;
 
-    while (pBlock != NULL)
+    while (pRegion != NULL)
     {
-        if ((ULONG_PTR)pBlock == pTargetBlock)
+        ULONG_PTR offset = (ULONG_PTR)pBuffer - (ULONG_PTR)pRegion->pBase;
+        if ((ULONG_PTR)pBuffer >= (ULONG_PTR)pRegion->pBase &&
+            offset < (ULONG_PTR)pRegion->committedCount * MEMORY_BLOCK_SIZE)
         {
+            PMEMORY_BLOCK pBlock = GetRegionBlock(pRegion, (UINT)(offset / MEMORY_BLOCK_SIZE));
             PMEMORY_SLOT pSlot = (PMEMORY_SLOT)pBuffer;
 #ifdef _DEBUG
             // Clear the released slot for debugging.
@@ -282,26 +418,78 @@ VOID FreeBuffer(LPVOID pBuffer)
             pSlot->pNext = pBlock->pFree;
             pBlock->pFree = pSlot;
             pBlock->usedCount--;
+            pRegion->usedCount--;
+            g_stats.usedSlotCount--;
 
-            // Free if unused.
-            if (pBlock->usedCount == 0)
+            // Free if unused. Released slots of a region which is still in
+            // use are kept committed for reuse.
+            if (pRegion->usedCount == 0)
             {
                 if (pPrev)
-                    pPrev->pNext = pBlock->pNext;
+                    pPrev->pNext = pRegion->pNext;
                 else
-                    g_pMemoryBlocks = pBlock->pNext;
+                    g_pMemoryRegions = pRegion->pNext;
 
-                VirtualFree(pBlock, 0, MEM_RELEASE);
+                VirtualFree(pRegion->pBase, 0, MEM_RELEASE);
             }
 
             break;
         }
 
-        pPrev = pBlock;
-        pBlock = pBlock->pNext;
+        pPrev = pRegion;
+        pRegion = pRegion->pNext;
     }
 }
 
+//-------------------------------------------------------------------------
+UINT64 *GetBufferCounter(LPVOID pBuffer)
+{
+    PMEMORY_REGION pRegion;
+
+    for (pRegion = g_pMemoryRegions; pRegion != NULL; pRegion = pRegion->pNext)
+    {
+        ULONG_PTR offset = (ULONG_PTR)pBuffer - (ULONG_PTR)pRegion->pBase;
+        if ((ULONG_PTR)pBuffer >= (ULONG_PTR)pRegion->pBase &&
+            offset < (ULONG_PTR)pRegion->committedCount * MEMORY_BLOCK_SIZE)
+        {
+            UINT64 *pCounters = (UINT64 *)GetRegionBlock(pRegion, MEMORY_SLOT_BLOCKS_PER_REGION);
+            UINT64 *pCounter = pCounters + offset / MEMORY_SLOT_SIZE;
+
+            // Committing an already committed page is a no-op.
+            if (VirtualAlloc(pCounter, sizeof(UINT64), MEM_COMMIT, PAGE_READWRITE) == NULL)
+                return NULL;
+
+            return pCounter;
+        }
+    }
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+VOID GetBufferStats(MH_BUFFER_STATS *pStats)
+{
+    PMEMORY_REGION pRegion;
+
+    ZeroMemory(pStats, sizeof(*pStats));
+
+    for (pRegion = g_pMemoryRegions; pRegion != NULL; pRegion = pRegion->pNext)
+    {
+        UINT i;
+
+        pStats->regionCount++;
+        pStats->committedBlockCount += pRegion->committedCount;
+
+        for (i = 0; i < pRegion->committedCount; i++)
+            pStats->slotCount += GetBlockSlotCount(pRegion, GetRegionBlock(pRegion, i));
+    }
+
+    pStats->usedSlotCount = g_stats.usedSlotCount;
+    pStats->peakUsedSlotCount = g_stats.peakUsedSlotCount;
+    pStats->allocationCount = g_stats.allocationCount;
+    pStats->reusedSlotCount = g_stats.reusedSlotCount;
+}
+
 //-------------------------------------------------------------------------
 BOOL IsExecutableAddress(LPVOID pAddress)
 {
@@ -39,4 +39,6 @@ VOID   InitializeBuffer(VOID);
 VOID   UninitializeBuffer(VOID);
 LPVOID AllocateBuffer(LPVOID pOrigin);
 VOID   FreeBuffer(LPVOID pBuffer);
+UINT64 *GetBufferCounter(LPVOID pBuffer);
+VOID   GetBufferStats(struct _MH_BUFFER_STATS *pStats);
 BOOL   IsExecutableAddress(LPVOID pAddress);
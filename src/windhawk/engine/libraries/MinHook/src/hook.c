@@ -44,6 +44,12 @@
 // Initial capacity of the thread IDs buffer.
 #define INITIAL_THREAD_CAPACITY 128
 
+// Initial capacity of the protected pages buffer.
+#define INITIAL_PAGE_CAPACITY   32
+
+// Size of each page for grouping memory protection changes.
+#define PROTECT_PAGE_SIZE       0x1000
+
 // Special hook position values.
 #define INVALID_HOOK_POS UINT_MAX
 
@@ -100,6 +106,8 @@ typedef struct _HOOK_ENTRY
     LPVOID pTarget;             // Address of the target function.
     LPVOID pDetour;             // Address of the detour function.
     PEXEC_BUFFER pExecBuffer;   // Address of the executable buffer for relay and trampoline.
+    PCOUNTING_RELAY pCountingRelay; // Address of the call counting relay, or NULL.
+    UINT64 *pCallCount;         // Address of the call counter, or NULL.
     UINT8  backup[8];           // Original prologue of the target function.
 
     UINT8  patchAbove  : 1;     // Uses the hot patch area.
@@ -111,6 +119,13 @@ typedef struct _HOOK_ENTRY
     UINT8  newIPs[8];           // Instruction boundaries of the trampoline function.
 } HOOK_ENTRY, *PHOOK_ENTRY;
 
+// A page made writable during a batch of hook changes.
+typedef struct _PROTECTED_PAGE
+{
+    ULONG_PTR pageAddress;      // Address of the page.
+    DWORD     oldProtect;       // Protection to be restored in the end of the batch.
+} PROTECTED_PAGE, *PPROTECTED_PAGE;
+
 //-------------------------------------------------------------------------
 // Global Variables:
 //-------------------------------------------------------------------------
@@ -126,6 +141,9 @@ static MH_THREAD_FREEZE_METHOD g_threadFreezeMethod = MH_FREEZE_METHOD_ORIGINAL;
 
 static NtGetNextThread_t pNtGetNextThread;
 
+// Whether new hooks are created with a call counting relay.
+static BOOL g_callCounting = FALSE;
+
 // Hook entries.
 static struct
 {
@@ -134,6 +152,16 @@ static struct
     UINT        size;       // Actual number of data items
 } g_hooks;
 
+// Pages made writable during a batch of hook changes. Each page's protection
+// is changed once per batch instead of twice per hook.
+static struct
+{
+    PPROTECTED_PAGE pItems;     // Data heap
+    UINT            capacity;   // Size of allocated data heap, items
+    UINT            size;       // Actual number of data items
+    BOOL            active;     // A batch is in progress
+} g_protectedPages;
+
 //-------------------------------------------------------------------------
 // Returns INVALID_HOOK_POS if not found.
 static UINT FindHookEntry(ULONG_PTR hookIdent, LPVOID pTarget)
@@ -212,6 +240,11 @@ static DWORD_PTR FindOldIP(PHOOK_ENTRY pHook, DWORD_PTR ip)
     if (ip == (DWORD_PTR)&pHook->pExecBuffer->jmpRelay)
         return (DWORD_PTR)pHook->pDetour;
 
+    if (pHook->pCountingRelay != NULL &&
+        ip >= (DWORD_PTR)pHook->pCountingRelay &&
+        ip < (DWORD_PTR)(pHook->pCountingRelay + 1))
+        return (DWORD_PTR)pHook->pDetour;
+
     UINT i;
     for (i = 0; i < pHook->nIP; ++i)
     {
@@ -492,6 +525,131 @@ static VOID Unfreeze(PFROZEN_THREADS pThreads)
     }
 }
 
+//-------------------------------------------------------------------------
+static VOID FreeHookBuffers(PHOOK_ENTRY pHook)
+{
+    if (pHook->pCountingRelay != NULL)
+        FreeBuffer(pHook->pCountingRelay);
+
+    FreeBuffer(pHook->pExecBuffer);
+}
+
+//-------------------------------------------------------------------------
+static VOID BeginProtectBatch(VOID)
+{
+    g_protectedPages.size = 0;
+    g_protectedPages.active = TRUE;
+}
+
+//-------------------------------------------------------------------------
+static VOID EndProtectBatch(VOID)
+{
+    UINT i;
+
+    for (i = 0; i < g_protectedPages.size; ++i)
+    {
+        PPROTECTED_PAGE pPage = &g_protectedPages.pItems[i];
+        DWORD oldProtect;
+
+        VirtualProtect((LPVOID)pPage->pageAddress, PROTECT_PAGE_SIZE, pPage->oldProtect, &oldProtect);
+
+        // Just-in-case measure.
+        FlushInstructionCache(GetCurrentProcess(), (LPVOID)pPage->pageAddress, PROTECT_PAGE_SIZE);
+    }
+
+    g_protectedPages.size = 0;
+    g_protectedPages.active = FALSE;
+}
+
+//-------------------------------------------------------------------------
+static BOOL AddProtectedPage(ULONG_PTR pageAddress, DWORD oldProtect)
+{
+    if (g_protectedPages.pItems == NULL)
+    {
+        g_protectedPages.capacity = INITIAL_PAGE_CAPACITY;
+        g_protectedPages.pItems = (PPROTECTED_PAGE)HeapAlloc(
+            g_hHeap, 0, g_protectedPages.capacity * sizeof(PROTECTED_PAGE));
+        if (g_protectedPages.pItems == NULL)
+            return FALSE;
+    }
+    else if (g_protectedPages.size >= g_protectedPages.capacity)
+    {
+        PPROTECTED_PAGE p = (PPROTECTED_PAGE)HeapReAlloc(
+            g_hHeap, 0, g_protectedPages.pItems, (g_protectedPages.capacity * 2) * sizeof(PROTECTED_PAGE));
+        if (p == NULL)
+            return FALSE;
+
+        g_protectedPages.capacity *= 2;
+        g_protectedPages.pItems = p;
+    }
+
+    g_protectedPages.pItems[g_protectedPages.size].pageAddress = pageAddress;
+    g_protectedPages.pItems[g_protectedPages.size].oldProtect = oldProtect;
+    g_protectedPages.size++;
+    return TRUE;
+}
+
+//-------------------------------------------------------------------------
+static BOOL MakeBatchPageWritable(ULONG_PTR pageAddress)
+{
+    DWORD oldProtect;
+    UINT i;
+
+    // Search from the end, hooks of the same module tend to be adjacent.
+    for (i = g_protectedPages.size; i > 0; --i)
+    {
+        if (g_protectedPages.pItems[i - 1].pageAddress == pageAddress)
+            return TRUE;
+    }
+
+    if (!VirtualProtect((LPVOID)pageAddress, PROTECT_PAGE_SIZE, PAGE_EXECUTE_READWRITE, &oldProtect))
+        return FALSE;
+
+    if (!AddProtectedPage(pageAddress, oldProtect))
+    {
+        VirtualProtect((LPVOID)pageAddress, PROTECT_PAGE_SIZE, oldProtect, &oldProtect);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//-------------------------------------------------------------------------
+// Makes the patch target writable. Within a batch, the pages stay writable
+// until EndProtectBatch, otherwise the protection is restored by EndPatch.
+static BOOL BeginPatch(LPBYTE pPatchTarget, SIZE_T patchSize, PDWORD pOldProtect)
+{
+    if (g_protectedPages.active)
+    {
+        ULONG_PTR firstPage = (ULONG_PTR)pPatchTarget & ~(ULONG_PTR)(PROTECT_PAGE_SIZE - 1);
+        ULONG_PTR lastPage = ((ULONG_PTR)pPatchTarget + patchSize - 1) & ~(ULONG_PTR)(PROTECT_PAGE_SIZE - 1);
+
+        if (MakeBatchPageWritable(firstPage) &&
+            (lastPage == firstPage || MakeBatchPageWritable(lastPage)))
+        {
+            return TRUE;
+        }
+
+        // Fall back to changing the protection for this patch only.
+    }
+
+    *pOldProtect = 0;
+    return VirtualProtect(pPatchTarget, patchSize, PAGE_EXECUTE_READWRITE, pOldProtect);
+}
+
+//-------------------------------------------------------------------------
+static VOID EndPatch(LPBYTE pPatchTarget, SIZE_T patchSize, DWORD oldProtect)
+{
+    // Zero means that the pages are restored and flushed by EndProtectBatch.
+    if (oldProtect == 0)
+        return;
+
+    VirtualProtect(pPatchTarget, patchSize, oldProtect, &oldProtect);
+
+    // Just-in-case measure.
+    FlushInstructionCache(GetCurrentProcess(), pPatchTarget, patchSize);
+}
+
 //-------------------------------------------------------------------------
 static MH_STATUS CreateHookTrampoline(UINT pos)
 {
@@ -531,7 +689,7 @@ static MH_STATUS CreateHookTrampoline(UINT pos)
 static MH_STATUS WINAPI EnableHookLL(UINT pos, BOOL enable, PFROZEN_THREADS pThreads)
 {
     PHOOK_ENTRY pHook = &g_hooks.pItems[pos];
-    DWORD  oldProtect;
+    DWORD  oldProtect   = 0;
     SIZE_T patchSize    = sizeof(JMP_REL);
     LPBYTE pPatchTarget = (LPBYTE)pHook->pTarget;
 
@@ -562,7 +720,7 @@ static MH_STATUS WINAPI EnableHookLL(UINT pos, BOOL enable, PFROZEN_THREADS pThr
         }
     }
 
-    if (!VirtualProtect(pPatchTarget, patchSize, PAGE_EXECUTE_READWRITE, &oldProtect))
+    if (!BeginPatch(pPatchTarget, patchSize, &oldProtect))
         return MH_ERROR_MEMORY_PROTECT;
 
     if (enable)
@@ -586,10 +744,7 @@ static MH_STATUS WINAPI EnableHookLL(UINT pos, BOOL enable, PFROZEN_THREADS pThr
             memcpy(pPatchTarget, pHook->backup, sizeof(JMP_REL));
     }
 
-    VirtualProtect(pPatchTarget, patchSize, oldProtect, &oldProtect);
-
-    // Just-in-case measure.
-    FlushInstructionCache(GetCurrentProcess(), pPatchTarget, patchSize);
+    EndPatch(pPatchTarget, patchSize, oldProtect);
 
     ProcessFrozenThreads(pThreads, pos, enable);
 
@@ -623,6 +778,8 @@ static MH_STATUS EnableHooksLL(ULONG_PTR hookIdent, LPVOID pTarget, BOOL enable)
         status = Freeze(&threads);
         if (status == MH_OK)
         {
+            BeginProtectBatch();
+
             for (i = first; i < g_hooks.size; ++i)
             {
                 PHOOK_ENTRY pHook = &g_hooks.pItems[i];
@@ -639,6 +796,8 @@ static MH_STATUS EnableHooksLL(ULONG_PTR hookIdent, LPVOID pTarget, BOOL enable)
                 }
             }
 
+            EndProtectBatch();
+
             Unfreeze(&threads);
         }
     }
@@ -721,6 +880,7 @@ MH_STATUS WINAPI MH_Uninitialize(VOID)
     // memory leak without HeapFree.
     UninitializeBuffer();
     HeapFree(g_hHeap, 0, g_hooks.pItems);
+    HeapFree(g_hHeap, 0, g_protectedPages.pItems);
     HeapDestroy(g_hHeap);
     g_hHeap = NULL;
 
@@ -728,6 +888,10 @@ MH_STATUS WINAPI MH_Uninitialize(VOID)
     g_hooks.capacity = 0;
     g_hooks.size = 0;
 
+    g_protectedPages.pItems = NULL;
+    g_protectedPages.capacity = 0;
+    g_protectedPages.size = 0;
+
     CloseHandle(g_hMutex);
     g_hMutex = NULL;
 
@@ -763,6 +927,58 @@ MH_STATUS WINAPI MH_SetThreadFreezeMethod(MH_THREAD_FREEZE_METHOD method)
     return MH_OK;
 }
 
+//-------------------------------------------------------------------------
+MH_STATUS WINAPI MH_SetCallCounting(BOOL enable)
+{
+    if (g_hMutex == NULL)
+        return MH_ERROR_NOT_INITIALIZED;
+
+    if (WaitForSingleObject(g_hMutex, INFINITE) != WAIT_OBJECT_0)
+        return MH_ERROR_MUTEX_FAILURE;
+
+    g_callCounting = enable;
+
+    ReleaseMutex(g_hMutex);
+
+    return MH_OK;
+}
+
+//-------------------------------------------------------------------------
+MH_STATUS WINAPI MH_GetCallCount(ULONG_PTR hookIdent, LPVOID pTarget, UINT64 *pCallCount)
+{
+    if (g_hMutex == NULL)
+        return MH_ERROR_NOT_INITIALIZED;
+
+    if (WaitForSingleObject(g_hMutex, INFINITE) != WAIT_OBJECT_0)
+        return MH_ERROR_MUTEX_FAILURE;
+
+    MH_STATUS status = MH_OK;
+
+    UINT pos = FindHookEntry(hookIdent, pTarget);
+    if (pos != INVALID_HOOK_POS)
+    {
+        UINT64 *pHookCallCount = g_hooks.pItems[pos].pCallCount;
+        if (pHookCallCount != NULL)
+        {
+            // An interlocked read, to avoid a torn value on x86.
+            *pCallCount = (UINT64)InterlockedCompareExchange64(
+                (volatile LONG64 *)pHookCallCount, 0, 0);
+        }
+        else
+        {
+            status = MH_ERROR_UNSUPPORTED_FUNCTION;
+        }
+    }
+    else
+    {
+        status = MH_ERROR_NOT_CREATED;
+    }
+
+    ReleaseMutex(g_hMutex);
+
+    return status;
+}
+
 //-------------------------------------------------------------------------
 MH_STATUS WINAPI MH_CreateHookEx(ULONG_PTR hookIdent, LPVOID pTarget, LPVOID pDetour, LPVOID *ppOriginal)
 {
@@ -780,6 +996,28 @@ MH_STATUS WINAPI MH_CreateHookEx(ULONG_PTR hookIdent, LPVOID pTarget, LPVOID pDe
         if (pos == INVALID_HOOK_POS)
         {
             PEXEC_BUFFER pBuffer = (PEXEC_BUFFER)AllocateBuffer(pTarget);
+            PCOUNTING_RELAY pCountingRelay = NULL;
+            UINT64 *pCallCount = NULL;
+            if (pBuffer != NULL && g_callCounting)
+            {
+                // If the counting relay can't be set up, the hook is created
+                // without call counting.
+                pCountingRelay = (PCOUNTING_RELAY)AllocateBuffer(pTarget);
+                if (pCountingRelay != NULL)
+                {
+                    // The counter is on a data page of the relay's memory
+                    // region, see GetBufferCounter.
+                    pCallCount = GetBufferCounter(pCountingRelay);
+                    if (pCallCount == NULL ||
+                        !CreateCountingRelayFunction(pCountingRelay, pCallCount, pDetour))
+                    {
+                        FreeBuffer(pCountingRelay);
+                        pCountingRelay = NULL;
+                        pCallCount = NULL;
+                    }
+                }
+            }
+
             if (pBuffer != NULL)
             {
                 PHOOK_ENTRY pHook = AddHookEntry();
@@ -787,12 +1025,23 @@ MH_STATUS WINAPI MH_CreateHookEx(ULONG_PTR hookIdent, LPVOID pTarget, LPVOID pDe
                 {
                     pBuffer->hookIdent = hookIdent;
                     pBuffer->pDisableHookChain = DisableHookChain;
-                    CreateRelayFunction(&pBuffer->jmpRelay, pDetour);
+
+                    if (pCountingRelay != NULL)
+                    {
+                        *pCallCount = 0;
+                        CreateRelayFunction(&pBuffer->jmpRelay, pCountingRelay);
+                    }
+                    else
+                    {
+                        CreateRelayFunction(&pBuffer->jmpRelay, pDetour);
+                    }
 
                     pHook->hookIdent = hookIdent;
                     pHook->pTarget = pTarget;
                     pHook->pDetour = pDetour;
                     pHook->pExecBuffer = pBuffer;
+                    pHook->pCountingRelay = pCountingRelay;
+                    pHook->pCallCount = pCallCount;
                     pHook->isEnabled = FALSE;
                     pHook->queueEnable = FALSE;
 
@@ -806,6 +1055,9 @@ MH_STATUS WINAPI MH_CreateHookEx(ULONG_PTR hookIdent, LPVOID pTarget, LPVOID pDe
 
                 if (status != MH_OK)
                 {
+                    if (pCountingRelay != NULL)
+                        FreeBuffer(pCountingRelay);
+
                     FreeBuffer(pBuffer);
                 }
             }
@@ -858,7 +1110,7 @@ MH_STATUS WINAPI MH_RemoveHookEx(ULONG_PTR hookIdent, LPVOID pTarget)
                 if ((hookIdent == MH_ALL_IDENTS || pHook->hookIdent == hookIdent) &&
                     (pTarget == MH_ALL_HOOKS || (ULONG_PTR)pTarget == (ULONG_PTR)pHook->pTarget))
                 {
-                    FreeBuffer(pHook->pExecBuffer);
+                    FreeHookBuffers(pHook);
                     DeleteHookEntry(i);
                 }
                 else
@@ -887,7 +1139,7 @@ MH_STATUS WINAPI MH_RemoveHookEx(ULONG_PTR hookIdent, LPVOID pTarget)
 
             if (status == MH_OK)
             {
-                FreeBuffer(g_hooks.pItems[pos].pExecBuffer);
+                FreeHookBuffers(&g_hooks.pItems[pos]);
                 DeleteHookEntry(pos);
             }
         }
@@ -926,7 +1178,7 @@ MH_STATUS WINAPI MH_RemoveDisabledHooksEx(ULONG_PTR hookIdent)
         if ((hookIdent == MH_ALL_IDENTS || pHook->hookIdent == hookIdent) &&
             !pHook->isEnabled)
         {
-            FreeBuffer(pHook->pExecBuffer);
+            FreeHookBuffers(pHook);
             DeleteHookEntry(i);
         }
         else
@@ -1110,6 +1362,15 @@ MH_STATUS WINAPI MH_QueueDisableHook(LPVOID pTarget)
 //-------------------------------------------------------------------------
 MH_STATUS WINAPI MH_ApplyQueuedEx(ULONG_PTR hookIdent)
 {
+    BOOL threadsFrozen;
+    return MH_ApplyQueuedEx2(hookIdent, &threadsFrozen);
+}
+
+//-------------------------------------------------------------------------
+MH_STATUS WINAPI MH_ApplyQueuedEx2(ULONG_PTR hookIdent, BOOL *pThreadsFrozen)
+{
+    *pThreadsFrozen = FALSE;
+
     if (g_hMutex == NULL)
         return MH_ERROR_NOT_INITIALIZED;
 
@@ -1136,6 +1397,10 @@ MH_STATUS WINAPI MH_ApplyQueuedEx(ULONG_PTR hookIdent)
         status = Freeze(&threads);
         if (status == MH_OK)
         {
+            *pThreadsFrozen = g_threadFreezeMethod != MH_FREEZE_METHOD_NONE_UNSAFE;
+
+            BeginProtectBatch();
+
             for (i = first; i < g_hooks.size; ++i)
             {
                 PHOOK_ENTRY pHook = &g_hooks.pItems[i];
@@ -1151,6 +1416,8 @@ MH_STATUS WINAPI MH_ApplyQueuedEx(ULONG_PTR hookIdent)
                 }
             }
 
+            EndProtectBatch();
+
             Unfreeze(&threads);
         }
     }
@@ -1166,6 +1433,22 @@ MH_STATUS WINAPI MH_ApplyQueued(VOID)
     return MH_ApplyQueuedEx(MH_DEFAULT_IDENT);
 }
 
+//-------------------------------------------------------------------------
+MH_STATUS WINAPI MH_GetBufferStats(MH_BUFFER_STATS *pStats)
+{
+    if (g_hMutex == NULL)
+        return MH_ERROR_NOT_INITIALIZED;
+
+    if (WaitForSingleObject(g_hMutex, INFINITE) != WAIT_OBJECT_0)
+        return MH_ERROR_MUTEX_FAILURE;
+
+    GetBufferStats(pStats);
+
+    ReleaseMutex(g_hMutex);
+
+    return MH_OK;
+}
+
 //-------------------------------------------------------------------------
 MH_STATUS WINAPI MH_CreateHookApiEx(
     LPCWSTR pszModule, LPCSTR pszProcName, LPVOID pDetour,
@@ -88,6 +88,55 @@ VOID CreateRelayFunction(PJMP_RELAY pJmpRelay, LPVOID pDetour)
     memcpy(pJmpRelay, &jmp, sizeof(jmp));
 }
 
+//-------------------------------------------------------------------------
+BOOL CreateCountingRelayFunction(PCOUNTING_RELAY pCountingRelay, UINT64 *pCallCount, LPVOID pDetour)
+{
+    COUNTING_RELAY relay;
+
+#if defined(_M_X64) || defined(__x86_64__)
+    // The counter is in the relay's memory region, so the distance is
+    // expected to fit in the 32-bit operand. Fail rather than write a
+    // truncated operand if it doesn't.
+    LONG_PTR distance = (LPBYTE)pCallCount - (LPBYTE)&pCountingRelay->jmp;
+    if (distance != (INT32)distance)
+        return FALSE;
+#endif
+
+    memset(&relay, 0, sizeof(relay));
+
+#if defined(_M_X64) || defined(__x86_64__)
+    relay.opcode0 = 0xF0;       // F0 48 FF 05 xxxxxxxx: LOCK INC QWORD PTR [RIP+8+xxxxxxxx]
+    relay.opcode1 = 0x48;
+    relay.opcode2 = 0xFF;
+    relay.opcode3 = 0x05;
+    relay.operand = (UINT32)distance;
+
+    relay.jmp.opcode0 = 0xFF;   // FF25 00000000: JMP [RIP+6]
+    relay.jmp.opcode1 = 0x25;
+    relay.jmp.address = (ULONG_PTR)pDetour;
+#else
+    relay.opcode0 = 0xF0;       // F0 83 05 xxxxxxxx 01: LOCK ADD DWORD PTR [xxxxxxxx], 1
+    relay.opcode1 = 0x83;
+    relay.opcode2 = 0x05;
+    relay.operand0 = (UINT32)pCallCount;
+    relay.imm0 = 0x01;
+
+    relay.opcode3 = 0x73;       // 73 07: JNC +9
+    relay.imm1 = 0x07;
+
+    relay.opcode4 = 0xF0;       // F0 FF 05 xxxxxxxx: LOCK INC DWORD PTR [xxxxxxxx]
+    relay.opcode5 = 0xFF;
+    relay.opcode6 = 0x05;
+    relay.operand1 = (UINT32)pCallCount + sizeof(UINT32);
+
+    relay.jmp.opcode = 0xE9;    // E9 xxxxxxxx: JMP +5+xxxxxxxx
+    relay.jmp.operand = (UINT32)((LPBYTE)pDetour - ((LPBYTE)&pCountingRelay->jmp + sizeof(JMP_REL)));
+#endif
+
+    memcpy(pCountingRelay, &relay, sizeof(relay));
+    return TRUE;
+}
+
 //-------------------------------------------------------------------------
 BOOL CreateTrampolineFunction(PTRAMPOLINE ct)
 {
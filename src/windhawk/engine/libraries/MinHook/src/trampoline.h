@@ -85,6 +85,41 @@ typedef struct _JCC_ABS
     UINT64 address;     // Absolute destination address
 } JCC_ABS;
 
+// The counter is kept on a non-executable page, since writing to the cache
+// line of the code being executed is treated as self-modifying code, and
+// flushes the pipeline on every call.
+#if defined(_M_X64) || defined(__x86_64__)
+// Relay which counts the calls before jumping to the detour function.
+typedef struct _COUNTING_RELAY
+{
+    UINT8   opcode0;    // F0 48 FF 05 xxxxxxxx: LOCK INC QWORD PTR [RIP+8+xxxxxxxx]
+    UINT8   opcode1;
+    UINT8   opcode2;
+    UINT8   opcode3;
+    UINT32  operand;    // Relative address of the counter
+    JMP_ABS jmp;        // FF25 00000000: JMP [+6]
+} COUNTING_RELAY, *PCOUNTING_RELAY;
+#else
+// Relay which counts the calls before jumping to the detour function. The
+// high part of the counter is only incremented on a carry, so that a call
+// costs a single locked instruction.
+typedef struct _COUNTING_RELAY
+{
+    UINT8   opcode0;    // F0 83 05 xxxxxxxx 01: LOCK ADD DWORD PTR [xxxxxxxx], 1
+    UINT8   opcode1;
+    UINT8   opcode2;
+    UINT32  operand0;   // Absolute address of the counter, low part
+    UINT8   imm0;
+    UINT8   opcode3;    // 73 07: JNC +9
+    UINT8   imm1;
+    UINT8   opcode4;    // F0 FF 05 xxxxxxxx: LOCK INC DWORD PTR [xxxxxxxx]
+    UINT8   opcode5;
+    UINT8   opcode6;
+    UINT32  operand1;   // Absolute address of the counter, high part
+    JMP_REL jmp;        // E9 xxxxxxxx: JMP +5+xxxxxxxx
+} COUNTING_RELAY, *PCOUNTING_RELAY;
+#endif
+
 #pragma pack(pop)
 
 #if defined(_M_X64) || defined(__x86_64__)
@@ -108,4 +143,5 @@ typedef struct _TRAMPOLINE
 } TRAMPOLINE, *PTRAMPOLINE;
 
 VOID CreateRelayFunction(PJMP_RELAY pJmpRelay, LPVOID pDetour);
+BOOL CreateCountingRelayFunction(PCOUNTING_RELAY pCountingRelay, UINT64 *pCallCount, LPVOID pDetour);
 BOOL CreateTrampolineFunction(PTRAMPOLINE ct);
@@ -0,0 +1,92 @@
+#include "stdafx.h"
+
+#include "log_rate_limiter.h"
+
+namespace {
+
+constexpr ULONGLONG kMicrosecondsPerSecond = 1000000;
+
+// The minimal interval between reports of suppressed messages, in
+// milliseconds.
+constexpr ULONGLONG kReportInterval = 10000;
+
+}  // namespace
+
+LogRateLimiter::LogRateLimiter(const Limits& limits)
+    : m_rate(limits.rate),
+      m_burst(limits.burst),
+      m_sampling(limits.sampling) {}
+
+void LogRateLimiter::SetLimits(const Limits& limits) {
+    m_rate = limits.rate;
+    m_burst = limits.burst;
+    m_sampling = limits.sampling;
+}
+
+bool LogRateLimiter::ShouldLog(DWORD* suppressedCountToReport) {
+    *suppressedCountToReport = 0;
+
+    if (!Sample() || !TakeToken()) {
+        m_suppressedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (m_suppressedCount.load(std::memory_order_relaxed) > 0) {
+        ULONGLONG now = GetTickCount64();
+        ULONGLONG lastReportTime = m_lastReportTime;
+        if (now - lastReportTime >= kReportInterval &&
+            m_lastReportTime.compare_exchange_strong(lastReportTime, now)) {
+            *suppressedCountToReport = TakeSuppressedCount();
+        }
+    }
+
+    return true;
+}
+
+DWORD LogRateLimiter::TakeSuppressedCount() {
+    return m_suppressedCount.exchange(0);
+}
+
+bool LogRateLimiter::Sample() {
+    DWORD sampling = m_sampling.load(std::memory_order_relaxed);
+    if (sampling <= 1) {
+        return true;
+    }
+
+    // The first message is sampled, then every Nth one.
+    return m_sampleCounter.fetch_add(1, std::memory_order_relaxed) %
+               sampling ==
+           0;
+}
+
+bool LogRateLimiter::TakeToken() {
+    DWORD rate = m_rate.load(std::memory_order_relaxed);
+    if (rate == 0) {
+        return true;
+    }
+
+    DWORD burst = m_burst.load(std::memory_order_relaxed);
+    if (burst == 0) {
+        burst = rate;
+    }
+
+    ULONGLONG interval = std::max(kMicrosecondsPerSecond / rate, ULONGLONG{1});
+    ULONGLONG tolerance = interval * (burst - 1);
+    ULONGLONG now = GetTickCount64() * 1000;
+
+    // Each message advances the theoretical arrival time by the interval.
+    // A message passes unless the arrival time is further ahead than the
+    // burst allows.
+    ULONGLONG theoreticalArrivalTime = m_theoreticalArrivalTime;
+    while (true) {
+        ULONGLONG start = std::max(theoreticalArrivalTime, now);
+        if (start - now > tolerance) {
+            return false;
+        }
+
+        if (m_theoreticalArrivalTime.compare_exchange_weak(
+                theoreticalArrivalTime, start + interval)) {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// Limits the rate of the log messages of a mod. A message passes if it's
+// sampled, and then if a token bucket has a token for it. Can be used from
+// multiple threads without locking.
+class LogRateLimiter {
+   public:
+    struct Limits {
+        // Messages per second, zero for no limit.
+        DWORD rate = 0;
+        // The amount of messages which can pass at once after a quiet period.
+        // Zero means the same as the rate.
+        DWORD burst = 0;
+        // Only every Nth message is sampled, zero or one to sample all
+        // messages.
+        DWORD sampling = 0;
+    };
+
+    LogRateLimiter(const Limits& limits);
+
+    void SetLimits(const Limits& limits);
+
+    // Returns false if the message should be suppressed. If the message
+    // passes, suppressedCountToReport is set to the amount of messages which
+    // were suppressed since the last report, or to zero if it's too early for
+    // another report.
+    bool ShouldLog(DWORD* suppressedCountToReport);
+
+    // Returns the amount of messages which were suppressed since the last
+    // report, and resets it.
+    DWORD TakeSuppressedCount();
+
+   private:
+    bool Sample();
+    bool TakeToken();
+
+    std::atomic<DWORD> m_rate;
+    std::atomic<DWORD> m_burst;
+    std::atomic<DWORD> m_sampling;
+
+    std::atomic<DWORD> m_sampleCounter = 0;
+    // The token bucket is implemented as a generic cell rate algorithm, which
+    // only needs a single value: the time, in microseconds, at which the
+    // bucket is full again.
+    std::atomic<ULONGLONG> m_theoreticalArrivalTime = 0;
+
+    std::atomic<DWORD> m_suppressedCount = 0;
+    std::atomic<ULONGLONG> m_lastReportTime = 0;
+};
@@ -0,0 +1,465 @@
+#include "stdafx.h"
+
+#include "functions.h"
+#include "log_ring_buffer.h"
+#include "logger.h"
+#include "session_private_namespace.h"
+
+struct LogRingBuffer::Header {
+    // Set last, once the slots are initialized.
+    volatile LONG magic;
+    DWORD formatVersion;
+    // The position of the next slot to be reserved. Positions grow
+    // indefinitely and wrap around, the slot index is the position modulo the
+    // slot count.
+    volatile LONG writePosition;
+    volatile LONG droppedCount;
+};
+
+struct LogRingBuffer::Slot {
+    // Equals the position if the slot is free for writing, the position plus
+    // kClaimedSequenceOffset while a producer writes it, and the position plus
+    // one once written.
+    volatile LONG sequence;
+    // The type and the number of slots of the record, set in the first slot
+    // of the record, zero in the rest.
+    RecordType recordType;
+    BYTE recordSlotCount;
+    // The number of bytes in this slot.
+    WORD size;
+    // The producer of the record, set in the first slot of the record.
+    DWORD processId;
+    DWORD threadId;
+    BYTE data[kSlotDataSize];
+};
+
+namespace {
+
+constexpr LONG kMagic = 'BRLW';
+constexpr DWORD kFormatVersion = 3;
+
+// Distinct from the free and the written sequence numbers of the slot, and of
+// the slot in other laps, as long as there are more than two slots.
+constexpr DWORD kClaimedSequenceOffset = 2;
+
+constexpr DWORD kDrainInterval = 50;
+
+// A reserved slot which isn't published for that many drains belongs to a
+// producer which was terminated while writing it, and is skipped.
+constexpr int kMaxStuckDrainCount = 20;
+
+static_assert((LogRingBuffer::kSlotCount & (LogRingBuffer::kSlotCount - 1)) ==
+                  0,
+              "The slot count must divide the position range");
+static_assert(LogRingBuffer::kSlotCount > kClaimedSequenceOffset);
+static_assert(LogRingBuffer::kMaxRecordSlots <= 0xFF);
+static_assert(LogRingBuffer::kSlotDataSize % sizeof(WCHAR) == 0,
+              "Lines must not be split in the middle of a character");
+
+// Positions wrap around, so they're compared and advanced as unsigned values.
+LONG AdvancePosition(LONG position, DWORD count) {
+    return static_cast<LONG>(static_cast<DWORD>(position) + count);
+}
+
+LONG PositionDiff(LONG a, LONG b) {
+    return static_cast<LONG>(static_cast<DWORD>(a) - static_cast<DWORD>(b));
+}
+
+std::wstring MakeObjectName(DWORD sessionManagerProcessId) {
+    WCHAR sessionPrivateNamespaceName
+        [SessionPrivateNamespace::kPrivateNamespaceMaxLen + 1];
+    SessionPrivateNamespace::MakeName(sessionPrivateNamespaceName,
+                                      sessionManagerProcessId);
+
+    std::wstring name = sessionPrivateNamespaceName;
+    name += L"\\LogRingBuffer";
+    return name;
+}
+
+// The session manager writes the lines of all processes, so the debugger
+// output doesn't tell where they come from. The source is added after the
+// "[WH] " prefix, if any, so that the lines can still be filtered by it.
+std::wstring MakeLineWithSource(std::wstring_view line,
+                                const LogRingBuffer::RecordSource& source) {
+    constexpr std::wstring_view kPrefix = L"[WH] ";
+    size_t prefixLength = line.starts_with(kPrefix) ? kPrefix.length() : 0;
+
+    WCHAR sourceText[32];
+    swprintf_s(sourceText, L"[%u:%u] ", source.processId, source.threadId);
+
+    std::wstring result(line.substr(0, prefixLength));
+    result += sourceText;
+    result += line.substr(prefixLength);
+    return result;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// LogRingBuffer
+
+// static
+LogRingBuffer LogRingBuffer::Create() {
+    // Everyone, including app containers and untrusted processes, can write
+    // to the buffer.
+    wil::unique_hlocal secDesc;
+    THROW_IF_WIN32_BOOL_FALSE(
+        Functions::GetFullAccessSecurityDescriptor(&secDesc, nullptr));
+
+    SECURITY_ATTRIBUTES secAttr = {sizeof(SECURITY_ATTRIBUTES)};
+    secAttr.lpSecurityDescriptor = secDesc.get();
+    secAttr.bInheritHandle = FALSE;
+
+    ULONGLONG mappingSize = sizeof(Header) + sizeof(Slot) * kSlotCount;
+    wil::unique_handle mapping(CreateFileMapping(
+        INVALID_HANDLE_VALUE, &secAttr, PAGE_READWRITE,
+        static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize),
+        MakeObjectName(GetCurrentProcessId()).c_str()));
+    THROW_LAST_ERROR_IF(!mapping || GetLastError() == ERROR_ALREADY_EXISTS);
+
+    LogRingBuffer ringBuffer;
+    ringBuffer.MapView(mapping.get());
+
+    // All slots are free for the first lap.
+    for (DWORD i = 0; i < kSlotCount; i++) {
+        ringBuffer.GetSlot(i)->sequence = i;
+    }
+
+    Header* header = ringBuffer.GetHeader();
+    header->formatVersion = kFormatVersion;
+    InterlockedExchange(&header->magic, kMagic);
+
+    return ringBuffer;
+}
+
+// static
+LogRingBuffer LogRingBuffer::Open(DWORD sessionManagerProcessId) {
+    wil::unique_private_namespace_close privateNamespace;
+    if (sessionManagerProcessId != GetCurrentProcessId()) {
+        privateNamespace =
+            SessionPrivateNamespace::Open(sessionManagerProcessId);
+    }
+
+    wil::unique_handle mapping(
+        OpenFileMapping(FILE_MAP_READ | FILE_MAP_WRITE, FALSE,
+                        MakeObjectName(sessionManagerProcessId).c_str()));
+    THROW_LAST_ERROR_IF(!mapping);
+
+    LogRingBuffer ringBuffer;
+    ringBuffer.MapView(mapping.get());
+
+    const Header* header = ringBuffer.GetHeader();
+    if (ReadAcquire(&header->magic) != kMagic ||
+        header->formatVersion != kFormatVersion) {
+        throw std::runtime_error("Log ring buffer format is unsupported");
+    }
+
+    return ringBuffer;
+}
+
+bool LogRingBuffer::Write(RecordType type, std::span<const BYTE> data) {
+    if (data.size() > kMaxRecordSize) {
+        InterlockedIncrement(&GetHeader()->droppedCount);
+        return false;
+    }
+
+    DWORD slotCount = static_cast<DWORD>(std::max(
+        size_t{1}, (data.size() + kSlotDataSize - 1) / kSlotDataSize));
+
+    Header* header = GetHeader();
+
+    // Reserve the slots. The consumer frees slots in order, so if the last
+    // slot is free, so are the rest.
+    LONG position = ReadAcquire(&header->writePosition);
+    while (true) {
+        LONG lastPosition = AdvancePosition(position, slotCount - 1);
+        LONG diff = PositionDiff(ReadAcquire(&GetSlot(lastPosition)->sequence),
+                                 lastPosition);
+        if (diff < 0) {
+            // The slot wasn't consumed yet, the buffer is full.
+            InterlockedIncrement(&header->droppedCount);
+            return false;
+        }
+
+        if (diff > 0) {
+            // Another producer reserved the slot in the meantime.
+            position = ReadAcquire(&header->writePosition);
+            continue;
+        }
+
+        LONG previousPosition = InterlockedCompareExchange(
+            &header->writePosition, AdvancePosition(position, slotCount),
+            position);
+        if (previousPosition == position) {
+            break;
+        }
+
+        position = previousPosition;
+    }
+
+    // Only write a slot after claiming it. If the consumer skipped the slot
+    // since this producer was too slow, the slot might already be reused for
+    // the next lap, and it's left as is.
+    bool written = true;
+
+    for (DWORD i = 0; i < slotCount; i++) {
+        LONG slotPosition = AdvancePosition(position, i);
+        Slot* slot = GetSlot(slotPosition);
+
+        if (InterlockedCompareExchange(
+                &slot->sequence,
+                AdvancePosition(slotPosition, kClaimedSequenceOffset),
+                slotPosition) != slotPosition) {
+            written = false;
+            continue;
+        }
+
+        auto slotData = data.subspan(std::min(data.size(), i * kSlotDataSize));
+        slotData = slotData.first(std::min(slotData.size(), kSlotDataSize));
+
+        slot->recordType = i == 0 ? type : RecordType{};
+        slot->recordSlotCount = i == 0 ? static_cast<BYTE>(slotCount) : 0;
+        slot->size = static_cast<WORD>(slotData.size());
+        slot->processId = i == 0 ? GetCurrentProcessId() : 0;
+        slot->threadId = i == 0 ? GetCurrentThreadId() : 0;
+        memcpy(slot->data, slotData.data(), slotData.size());
+    }
+
+    // Publish the first slot last, so that once it's published, the consumer
+    // can read the whole record. A slot is only published if it's still
+    // claimed, it could have been skipped while it was written.
+    for (DWORD i = slotCount; i-- > 0;) {
+        LONG slotPosition = AdvancePosition(position, i);
+        Slot* slot = GetSlot(slotPosition);
+
+        if (InterlockedCompareExchange(
+                &slot->sequence, AdvancePosition(slotPosition, 1),
+                AdvancePosition(slotPosition, kClaimedSequenceOffset)) !=
+            AdvancePosition(slotPosition, kClaimedSequenceOffset)) {
+            written = false;
+        }
+    }
+
+    return written;
+}
+
+bool LogRingBuffer::Write(std::wstring_view line) {
+    line = line.substr(0, kMaxRecordSize / sizeof(WCHAR));
+    return Write(RecordType::kLine,
+                 std::span(reinterpret_cast<const BYTE*>(line.data()),
+                           line.length() * sizeof(WCHAR)));
+}
+
+DWORD LogRingBuffer::Drain(const DrainCallback& callback) {
+    std::vector<BYTE> record;
+    record.reserve(kMaxRecordSize);
+
+    while (true) {
+        Slot* firstSlot = GetSlot(m_readPosition);
+        if (ReadAcquire(&firstSlot->sequence) !=
+            AdvancePosition(m_readPosition, 1)) {
+            bool reserved =
+                ReadAcquire(&GetHeader()->writePosition) != m_readPosition;
+            if (!reserved || ++m_stuckDrainCount < kMaxStuckDrainCount ||
+                !SkipStuckSlot()) {
+                break;
+            }
+
+            continue;
+        }
+
+        m_stuckDrainCount = 0;
+
+        // The slot count comes from shared memory which everyone can write
+        // to. An invalid count, or a continuation slot whose first slot was
+        // skipped, is consumed as a single slot.
+        DWORD slotCount = firstSlot->recordSlotCount;
+        bool valid = slotCount >= 1 && slotCount <= kMaxRecordSlots;
+        if (!valid) {
+            slotCount = 1;
+        }
+
+        RecordType recordType = firstSlot->recordType;
+        RecordSource recordSource = {
+            .processId = firstSlot->processId,
+            .threadId = firstSlot->threadId,
+        };
+
+        record.clear();
+        for (DWORD i = 0; i < slotCount; i++) {
+            LONG slotPosition = AdvancePosition(m_readPosition, i);
+            Slot* slot = GetSlot(slotPosition);
+
+            if (valid) {
+                record.insert(
+                    record.end(), slot->data,
+                    slot->data + std::min(size_t{slot->size}, kSlotDataSize));
+            }
+
+            // Free the slot for the next lap.
+            InterlockedExchange(&slot->sequence,
+                                AdvancePosition(slotPosition, kSlotCount));
+        }
+
+        m_readPosition = AdvancePosition(m_readPosition, slotCount);
+
+        if (valid) {
+            callback(recordType, recordSource, record);
+        } else {
+            m_skippedCount++;
+        }
+    }
+
+    LONG droppedCount = ReadAcquire(&GetHeader()->droppedCount);
+    DWORD newlyDropped =
+        static_cast<DWORD>(PositionDiff(droppedCount, m_droppedCount)) +
+        m_skippedCount;
+    m_droppedCount = droppedCount;
+    m_skippedCount = 0;
+
+    return newlyDropped;
+}
+
+void LogRingBuffer::MapView(HANDLE mapping) {
+    m_view.reset(MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0,
+                               0));
+    THROW_LAST_ERROR_IF_NULL(m_view);
+}
+
+LogRingBuffer::Header* LogRingBuffer::GetHeader() const {
+    return static_cast<Header*>(m_view.get());
+}
+
+LogRingBuffer::Slot* LogRingBuffer::GetSlot(LONG position) const {
+    return reinterpret_cast<Slot*>(GetHeader() + 1) +
+           static_cast<DWORD>(position) % kSlotCount;
+}
+
+bool LogRingBuffer::SkipStuckSlot() {
+    Slot* slot = GetSlot(m_readPosition);
+
+    // Only skip a slot which is still reserved or claimed. If it was published
+    // in the meantime, it's read normally.
+    LONG nextLapSequence = AdvancePosition(m_readPosition, kSlotCount);
+    LONG claimedSequence =
+        AdvancePosition(m_readPosition, kClaimedSequenceOffset);
+    if (InterlockedCompareExchange(&slot->sequence, nextLapSequence,
+                                   m_readPosition) != m_readPosition &&
+        InterlockedCompareExchange(&slot->sequence, nextLapSequence,
+                                   claimedSequence) != claimedSequence) {
+        return false;
+    }
+
+    m_readPosition = AdvancePosition(m_readPosition, 1);
+    m_stuckDrainCount = 0;
+    m_skippedCount++;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// LogRingBufferConsumer
+
+LogRingBufferConsumer::LogRingBufferConsumer(
+    const std::filesystem::path& jsonFilePath)
+    : m_ringBuffer(LogRingBuffer::Create()) {
+    if (!jsonFilePath.empty()) {
+        m_jsonFile.reset(CreateFile(
+            jsonFilePath.c_str(), FILE_APPEND_DATA,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (!m_jsonFile) {
+            LOG(L"Opening the JSON log file failed: %u", GetLastError());
+        }
+    }
+
+    m_drainTimer.reset(
+        CreateThreadpoolTimer(DrainTimerCallback, this, nullptr));
+    THROW_LAST_ERROR_IF_NULL(m_drainTimer);
+
+    FILETIME dueTime = wil::filetime::from_int64(
+        -static_cast<INT64>(kDrainInterval) *
+        wil::filetime_duration::one_millisecond);
+    SetThreadpoolTimer(m_drainTimer.get(), &dueTime, kDrainInterval, 0);
+}
+
+LogRingBufferConsumer::~LogRingBufferConsumer() {
+    // Stop the timer and wait for a pending callback, then forward what's
+    // left.
+    m_drainTimer.reset();
+    Drain();
+}
+
+// static
+void CALLBACK
+LogRingBufferConsumer::DrainTimerCallback(PTP_CALLBACK_INSTANCE instance,
+                                          PVOID context,
+                                          PTP_TIMER timer) {
+    auto* this_ = static_cast<LogRingBufferConsumer*>(context);
+    this_->Drain();
+}
+
+void LogRingBufferConsumer::Drain() {
+    std::wstring output;
+    DWORD invalidCount = 0;
+
+    DWORD droppedCount = m_ringBuffer.Drain(
+        [this, &output, &invalidCount](
+            LogRingBuffer::RecordType type,
+            const LogRingBuffer::RecordSource& source,
+            std::span<const BYTE> data) {
+            switch (type) {
+                case LogRingBuffer::RecordType::kLine:
+                    // OutputDebugString needs a null-terminated string.
+                    output = MakeLineWithSource(
+                        std::wstring_view(
+                            reinterpret_cast<PCWSTR>(data.data()),
+                            data.size() / sizeof(WCHAR)),
+                        source);
+                    break;
+
+                case LogRingBuffer::RecordType::kModLogFormat:
+                    if (!m_modLogRecordDecoder.AddFormat(data)) {
+                        invalidCount++;
+                    }
+                    return;
+
+                case LogRingBuffer::RecordType::kModLogMessage: {
+                    auto message = m_modLogRecordDecoder.Decode(data);
+                    if (!message) {
+                        invalidCount++;
+                        return;
+                    }
+
+                    output = ModLogRecordDecoder::FormatText(*message);
+                    if (m_jsonFile) {
+                        WriteJsonLine(
+                            ModLogRecordDecoder::FormatJson(*message));
+                    }
+                    break;
+                }
+
+                default:
+                    invalidCount++;
+                    return;
+            }
+
+            OutputDebugString(output.c_str());
+        });
+
+    droppedCount += invalidCount;
+    if (droppedCount > 0) {
+        WCHAR message[128];
+        swprintf_s(message, L"[WH] [%S]: %u log lines were dropped\n",
+                   __FUNCTION__, droppedCount);
+        OutputDebugString(message);
+    }
+}
+
+void LogRingBufferConsumer::WriteJsonLine(std::string_view line) {
+    DWORD written;
+    if (!WriteFile(m_jsonFile.get(), line.data(),
+                   static_cast<DWORD>(line.size()), &written, nullptr)) {
+        LOG(L"Writing to the JSON log file failed: %u", GetLastError());
+        m_jsonFile.reset();
+    }
+}
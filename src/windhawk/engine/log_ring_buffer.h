@@ -0,0 +1,107 @@
+#pragma once
+
+#include "mod_log_record.h"
+
+// A ring buffer of log records in shared memory in the session private
+// namespace. The engine in all processes appends records without locking or
+// system calls, and the session manager process drains the buffer and forwards
+// the records to the debugger output, which is what log viewers read. This
+// way, logging processes aren't serialized by the system-wide debugger output
+// mutex.
+//
+// The buffer is an array of fixed-size slots, each with a sequence number
+// which tells whether the slot is free, being written or written for the
+// current lap of the ring. A producer reserves consecutive slots for a record
+// by advancing the write position with a compare-and-swap, claims each slot
+// with a compare-and-swap of its sequence number, writes the claimed slots,
+// and then publishes them, the first slot last. If there's no room, the record
+// is dropped and counted. Each record carries the ids of the process and the
+// thread which wrote it, since the session manager writes all of the lines to
+// the debugger output.
+class LogRingBuffer {
+   public:
+    enum class RecordType : BYTE {
+        // A formatted line of text.
+        kLine,
+        // Mod log records, see mod_log_record.h.
+        kModLogFormat,
+        kModLogMessage,
+    };
+
+    static constexpr DWORD kSlotCount = 4096;
+    static constexpr size_t kSlotDataSize = 240;
+    static constexpr size_t kMaxRecordSlots = 16;
+    static constexpr size_t kMaxRecordSize = kSlotDataSize * kMaxRecordSlots;
+
+    // Creates the buffer in the session manager process. The session private
+    // namespace must already exist.
+    static LogRingBuffer Create();
+    // Opens the buffer of the given session manager process.
+    static LogRingBuffer Open(DWORD sessionManagerProcessId);
+
+    struct RecordSource {
+        DWORD processId;
+        DWORD threadId;
+    };
+
+    using DrainCallback = std::function<
+        void(RecordType, const RecordSource&, std::span<const BYTE>)>;
+
+    // Can be called from any thread of any process. Returns false if the
+    // record was dropped because the buffer is full, or because it's larger
+    // than kMaxRecordSize.
+    bool Write(RecordType type, std::span<const BYTE> data);
+    // Writes a kLine record. Longer lines are truncated.
+    bool Write(std::wstring_view line);
+
+    // Calls the callback for each complete record. Must only be called by a
+    // single consumer. Returns the amount of records dropped since the
+    // previous call.
+    DWORD Drain(const DrainCallback& callback);
+
+   private:
+    struct Header;
+    struct Slot;
+
+    LogRingBuffer() = default;
+
+    void MapView(HANDLE mapping);
+    Header* GetHeader() const;
+    Slot* GetSlot(LONG position) const;
+    bool SkipStuckSlot();
+
+    wil::unique_mapview_ptr<void> m_view;
+    // Consumer state.
+    LONG m_readPosition = 0;
+    LONG m_droppedCount = 0;
+    int m_stuckDrainCount = 0;
+    DWORD m_skippedCount = 0;
+};
+
+// Runs in the session manager process. Creates the buffer and periodically
+// forwards its records to the debugger output. Mod log messages are also
+// appended as JSON lines to the given file, if any.
+class LogRingBufferConsumer {
+   public:
+    // The session private namespace must already exist.
+    LogRingBufferConsumer(const std::filesystem::path& jsonFilePath = {});
+    ~LogRingBufferConsumer();
+
+    LogRingBufferConsumer(const LogRingBufferConsumer&) = delete;
+    LogRingBufferConsumer& operator=(const LogRingBufferConsumer&) = delete;
+
+   private:
+    static void CALLBACK DrainTimerCallback(PTP_CALLBACK_INSTANCE instance,
+                                            PVOID context,
+                                            PTP_TIMER timer);
+
+    void Drain();
+    void WriteJsonLine(std::string_view line);
+
+    LogRingBuffer m_ringBuffer;
+    ModLogRecordDecoder m_modLogRecordDecoder;
+    wil::unique_hfile m_jsonFile;
+    // Must be last, so that it's destroyed, and pending callbacks are waited
+    // for, before the rest of the members.
+    wil::unique_threadpool_timer m_drainTimer;
+};
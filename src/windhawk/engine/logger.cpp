@@ -55,6 +55,23 @@ bool Logger::ShouldLog(Verbosity verbosity) {
                            : m_initialVerbosity >= verbosity;
 }
 
+void Logger::SetRingBuffer(std::shared_ptr<LogRingBuffer> ringBuffer) {
+    m_ringBuffer = std::move(ringBuffer);
+}
+
+std::shared_ptr<LogRingBuffer> Logger::GetRingBuffer() {
+    return m_ringBuffer.load();
+}
+
+void Logger::WriteLine(PCWSTR line, size_t length) {
+    if (auto ringBuffer = m_ringBuffer.load()) {
+        ringBuffer->Write(std::wstring_view(line, length));
+        return;
+    }
+
+    LoggerBase::WriteLine(line, length);
+}
+
 // static
 std::optional<Logger::Verbosity>& Logger::GetThreadVerbosity() {
     STATIC_INIT_ONCE(ThreadLocal<std::optional<Verbosity>>, s);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "log_ring_buffer.h"
 #include "logger_base.h"
 
 class Logger : public LoggerBase {
@@ -25,6 +26,14 @@ class Logger : public LoggerBase {
 
     bool ShouldLog(Verbosity verbosity);
 
+    // While set, lines are appended to the session log ring buffer instead of
+    // being written to the debugger output directly.
+    void SetRingBuffer(std::shared_ptr<LogRingBuffer> ringBuffer);
+    std::shared_ptr<LogRingBuffer> GetRingBuffer();
+
+   protected:
+    void WriteLine(PCWSTR line, size_t length) override;
+
    private:
     static std::optional<Verbosity>& GetThreadVerbosity();
     bool SetThreadVerbosity(Verbosity verbosity);
@@ -33,6 +42,7 @@ class Logger : public LoggerBase {
     const std::atomic<Verbosity> m_initialVerbosity;
     std::mutex m_threadVerbosityMutex;
     int m_threadVerbosityCount = 0;
+    std::atomic<std::shared_ptr<LogRingBuffer>> m_ringBuffer;
 };
 
 #define LOG_WITH_VERBOSITY(verbosity, message, ...)                          \
@@ -6,6 +6,7 @@
 #include "logger.h"
 #include "no_destructor.h"
 #include "storage_manager.h"
+#include "trace_recorder.h"
 
 HINSTANCE g_hDllInst;
 
@@ -47,8 +48,12 @@ bool LazyInitialize() {
 
 // Exported
 BOOL InjectInit(const DllInject::LOAD_LIBRARY_REMOTE_DATA* pInjData) {
-    if (!LazyInitialize()) {
-        return FALSE;
+    {
+        // Only traced here, the other exports call it repeatedly.
+        TraceRecorder::Span span("LazyInitialize");
+        if (!LazyInitialize()) {
+            return FALSE;
+        }
     }
 
     VERBOSE(L"Running InjectInit");
@@ -68,7 +73,8 @@ BOOL InjectInit(const DllInject::LOAD_LIBRARY_REMOTE_DATA* pInjData) {
     try {
         CustomizationSession::Start(
             pInjData->bRunningFromAPC, pInjData->bThreadAttachExempt,
-            std::move(sessionManagerProcess), std::move(sessionMutex));
+            pInjData->bPropagationOnly, std::move(sessionManagerProcess),
+            std::move(sessionMutex));
     } catch (const std::exception& e) {
         LOG(L"%S", e.what());
     }
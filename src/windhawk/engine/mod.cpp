@@ -4,10 +4,15 @@
 #include "functions.h"
 #include "logger.h"
 #include "mod.h"
+#include "mod_config.h"
+#include "mod_status_table.h"
+#include "path_pattern_matcher.h"
 #include "process_lists.h"
 #include "session_private_namespace.h"
 #include "storage_manager.h"
+#include "symbol_cache.h"
 #include "symbol_enum.h"
+#include "trace_recorder.h"
 #include "version.h"
 
 extern HINSTANCE g_hDllInst;
@@ -16,6 +21,40 @@ namespace {
 
 const PCWSTR emptySettingStringValue = L"";
 
+// The maximum number of hook calls rows of a mod in a process, see
+// LoadedMod::ClaimHookCallsRow.
+constexpr std::ptrdiff_t kMaxHookCallsRows = 64;
+
+// Same conversion as the one done by the settings storage for string values,
+// but returns `std::nullopt` instead of throwing if the string isn't a number.
+std::optional<int> SettingStringToInt(const std::wstring& value) {
+    PCWSTR begin = value.c_str();
+    PWSTR end;
+    errno = 0;
+    long longValue = wcstol(begin, &end, 0);
+    if (end == begin || errno == ERANGE) {
+        return std::nullopt;
+    }
+
+    if (longValue > INT_MAX) {
+        return INT_MAX;
+    } else if (longValue < INT_MIN) {
+        return INT_MIN;
+    }
+
+    return wil::safe_cast<int>(longValue);
+}
+
+std::wstring FormatSettingName(PCWSTR valueName, va_list args) {
+    va_list argsCopy;
+    va_copy(argsCopy, args);  // https://stackoverflow.com/q/55274350
+    std::wstring valueNameFormatted(_vscwprintf(valueName, argsCopy), L'\0');
+    va_end(argsCopy);
+    vswprintf_s(valueNameFormatted.data(), valueNameFormatted.length() + 1,
+                valueName, args);
+    return valueNameFormatted;
+}
+
 class ModDebugLoggingScope {
    public:
     ModDebugLoggingScope(PCSTR funcName)
@@ -121,74 +160,38 @@ class CrossModMutex {
     wil::mutex_release_scope_exit m_mutexLock;
 };
 
-std::wstring GenerateModInstanceId(PCWSTR modName) {
-    DWORD sessionManagerProcessId =
-        CustomizationSession::GetSessionManagerProcessId();
-
-    FILETIME sessionManagerProcessCreationTime =
-        CustomizationSession::GetSessionManagerProcessCreationTime();
-
-    return std::to_wstring(sessionManagerProcessId) + L"_" +
-           std::to_wstring(
-               wil::filetime::to_int64(sessionManagerProcessCreationTime)) +
-           L"_" + std::to_wstring(GetCurrentProcessId()) + L"_" + modName;
-}
-
-void SetModMetadataValue(wil::unique_hfile& metadataFile,
-                         PCWSTR value,
-                         PCWSTR metadataCategory,
-                         PCWSTR modInstanceId) {
-    if (!value) {
-        metadataFile.reset();
+void SetModStatusTableText(std::optional<ModStatusTable::Slot>& slot,
+                           PCWSTR text,
+                           ModStatusTable::Kind kind,
+                           PCWSTR modName) {
+    if (!text) {
+        slot.reset();
         return;
     }
 
-    auto& storageManager = StorageManager::GetInstance();
-
-    if (!metadataFile) {
-        metadataFile = storageManager.CreateModMetadataFile(metadataCategory,
-                                                            modInstanceId);
+    if (!slot) {
+        slot.emplace(CustomizationSession::GetModStatusTable(), kind,
+                     modName);
     }
 
-    std::filesystem::path fullProcessImageName =
-        wil::QueryFullProcessImageName<std::wstring>(GetCurrentProcess());
-    std::wstring fullValue =
-        fullProcessImageName.filename().native() + L'|' + value;
-
-    storageManager.SetModMetadataValue(metadataFile, fullValue.c_str());
+    slot->SetText(text);
 }
 
-bool DoesArchitectureMatchPatternPart(std::wstring_view patternPart) {
-#if defined(_M_IX86)
-    if (patternPart == L"x86") {
-        return true;
-    }
-#elif defined(_M_X64)
-    // For now, x86-64 matches both x64 and ARM64.
-    if (patternPart == L"x86-64" || patternPart == L"amd64") {
-        return true;
-    }
-#elif defined(_M_ARM64)
-    // For now, x86-64 matches both x64 and ARM64.
-    if (patternPart == L"x86-64" || patternPart == L"arm64") {
-        return true;
-    }
-#else
-#error "Unsupported architecture"
-#endif
-
-    return false;
+const PathPatternMatcher::Path& GetProcessPathForMatching() {
+    STATIC_INIT_ONCE(PathPatternMatcher::Path, processPath,
+                     wil::GetModuleFileName<std::wstring>());
+    return *processPath;
 }
 
-bool DoesArchitectureMatchPattern(std::wstring_view pattern) {
-    for (const auto& patternPart :
-         Functions::SplitStringToViews(pattern, L'|')) {
-        if (DoesArchitectureMatchPatternPart(patternPart)) {
-            return true;
-        }
-    }
-
-    return false;
+bool IsCriticalProcessForMods() {
+    // The process path and the lists don't change, so the result is computed
+    // once.
+    STATIC_INIT_ONCE_TRIVIAL(
+        bool, isCriticalProcess,
+        PathPatternMatcher(std::wstring(ProcessLists::kCriticalProcesses) +
+                           L'|' + ProcessLists::kCriticalProcessesForMods)
+            .Matches(GetProcessPathForMatching()));
+    return isCriticalProcess;
 }
 
 std::wstring GetModVersion(PCWSTR modName) {
@@ -540,7 +543,8 @@ class HookSymbolsSession {
 
         if (symbolHook->hookFunction) {
             m_pendingHooks.emplace_back(address, symbolHook->hookFunction,
-                                        symbolHook->pOriginalFunction);
+                                        symbolHook->pOriginalFunction,
+                                        std::wstring(symbol));
             VERBOSE(L"To be hooked %p: %.*s", address,
                     wil::safe_cast<int>(symbol.length()), symbol.data());
         } else {
@@ -562,44 +566,32 @@ class HookSymbolsSession {
     }
 
     void ResolveSymbolsFromCache(std::wstring_view cache) {
-        auto cacheParts = Functions::SplitStringToViews(cache, m_cacheSep);
-        ResolveSymbolsFromCacheParts(cacheParts);
-    }
-
-    void ResolveSymbolsFromCacheParts(
-        std::vector<std::wstring_view>& cacheParts) {
-        // In the new format, cacheParts[1] and cacheParts[2] are
-        // ignored and act like comments.
-        if (cacheParts.size() < 3 ||
-            cacheParts[0] != std::wstring_view(&kCacheVer, 1)) {
+        auto entries =
+            SymbolCache::Parse(cache, m_cacheSep, m_moduleSizeOfImage);
+        if (!entries) {
+            LOG(L"Ignoring symbol cache with an invalid address");
             return;
         }
 
-        for (size_t i = 3; i + 1 < cacheParts.size(); i += 2) {
-            const auto& symbol = cacheParts[i];
-            const auto& address = cacheParts[i + 1];
-            if (address.length() == 0) {
+        for (const auto& entry : *entries) {
+            if (!entry.offset) {
                 continue;
             }
 
-            void* addressPtr =
-                (void*)(std::stoull(std::wstring(address), nullptr, 10) +
-                        (ULONG_PTR)m_module);
+            void* addressPtr = (void*)(*entry.offset + (ULONG_PTR)m_module);
 
-            OnSymbolResolved(symbol, addressPtr);
+            OnSymbolResolved(entry.symbol, addressPtr);
         }
 
-        std::erase_if(m_symbolHooksUnresolved, [this, &cacheParts](
+        std::erase_if(m_symbolHooksUnresolved, [this, &entries](
                                                    const auto* symbolHook) {
             if (!symbolHook->optional) {
                 return false;
             }
 
             size_t noAddressMatchCount = 0;
-            for (size_t j = 3; j + 1 < cacheParts.size(); j += 2) {
-                const auto& symbol = cacheParts[j];
-                const auto& address = cacheParts[j + 1];
-                if (address.length() != 0) {
+            for (const auto& [symbol, offset] : *entries) {
+                if (offset) {
                     continue;
                 }
 
@@ -682,12 +674,13 @@ class HookSymbolsSession {
     }
 
     void ApplyPendingHooks(
-        std::function<void(void*, void*, void**)> setFunctionHookCallback) {
+        std::function<void(void*, void*, void**, PCWSTR)>
+            setFunctionHookCallback) {
         VERBOSE(L"Applying hooks");
 
         for (const auto& hook : m_pendingHooks) {
             setFunctionHookCallback(hook.targetFunction, hook.hookFunction,
-                                    hook.originalFunction);
+                                    hook.originalFunction, hook.symbol.c_str());
         }
 
         m_pendingHooks.clear();
@@ -765,11 +758,13 @@ class HookSymbolsSession {
 
         m_isHybridModule = isHybridModule;
 
+        m_moduleSizeOfImage = ntHeader->OptionalHeader.SizeOfImage;
+
         m_cacheSep = isHybridModule ? L';' : L'#';
 
         m_cacheStrKey = std::move(cacheStrKey);
 
-        m_newSystemCacheStr = kCacheVer;
+        m_newSystemCacheStr = SymbolCache::kVersion;
         m_newSystemCacheStr += m_cacheSep;
         m_newSystemCacheStr += moduleFileName;
         m_newSystemCacheStr += m_cacheSep;
@@ -782,12 +777,12 @@ class HookSymbolsSession {
         void* targetFunction;
         void* hookFunction;
         void** originalFunction;
+        std::wstring symbol;
     };
 
-    static constexpr WCHAR kCacheVer = L'1';
-
     HMODULE m_module;
     bool m_isHybridModule;
+    DWORD m_moduleSizeOfImage;
     WCHAR m_cacheSep;
     std::wstring m_cacheStrKey;
     std::wstring m_newSystemCacheStr;
@@ -798,14 +793,16 @@ class HookSymbolsSession {
 }  // namespace
 
 LoadedMod::LoadedMod(PCWSTR modName,
-                     PCWSTR modInstanceId,
                      PCWSTR libraryPath,
                      bool loggingEnabled,
-                     bool debugLoggingEnabled)
+                     bool debugLoggingEnabled,
+                     const LogRateLimiter::Limits& logLimits)
     : m_modName(modName),
-      m_modInstanceId(modInstanceId),
       m_loggingEnabled(loggingEnabled),
       m_debugLoggingEnabled(debugLoggingEnabled),
+      m_logRateLimiter(logLimits),
+      m_logRecordWriter(m_modName),
+      m_metrics(m_modName),
       m_compatDemangling(ShouldUseCompatDemangling(m_modName)) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
 
@@ -819,8 +816,13 @@ LoadedMod::LoadedMod(PCWSTR modName,
     VERBOSE(L"Mod id: %s", m_modName.c_str());
     VERBOSE(L"Mod version: %s", GetModVersion(m_modName.c_str()).c_str());
 
-    m_modModule.reset(
-        LoadLibraryEx(libraryPath, nullptr, LOAD_WITH_ALTERED_SEARCH_PATH));
+    {
+        TraceRecorder::Span span("LoadModLibrary", m_modName);
+        EngineMetrics::ScopedTimer timer(&m_metrics,
+                                         EngineMetrics::Metric::kLoadTime);
+        m_modModule.reset(LoadLibraryEx(libraryPath, nullptr,
+                                        LOAD_WITH_ALTERED_SEARCH_PATH));
+    }
     THROW_LAST_ERROR_IF_NULL(m_modModule);
 
     VERBOSE(L"Mod base address: %p", m_modModule.get());
@@ -844,6 +846,14 @@ LoadedMod::LoadedMod(PCWSTR modName,
 LoadedMod::~LoadedMod() {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
 
+    StopModuleLoadHooks();
+    RemoveAllTableHooks();
+    StopStorageWriteBehind();
+
+    if (DWORD count = m_logRateLimiter.TakeSuppressedCount()) {
+        ReportSuppressedLogMessages(count);
+    }
+
 #ifdef WH_HOOKING_ENGINE_MINHOOK
     MH_STATUS status =
         MH_RemoveHookEx(reinterpret_cast<ULONG_PTR>(this), MH_ALL_HOOKS);
@@ -867,15 +877,27 @@ bool LoadedMod::Initialize() {
 
     SetTask(L"Initializing...");
 
+    TraceRecorder::Span span("Wh_ModInit", m_modName);
+
     using WH_MOD_INIT_T = BOOL(__cdecl*)();
     auto pWH_ModInit = reinterpret_cast<WH_MOD_INIT_T>(
         GetProcAddress(m_modModule.get(), "_Z10Wh_ModInitv"));
     if (pWH_ModInit) {
+        EngineMetrics::ScopedTimer timer(&m_metrics,
+                                         EngineMetrics::Metric::kInitTime);
         m_initialized = pWH_ModInit();
     } else {
         m_initialized = true;
     }
 
+    // Table hooks don't require suspending threads, so unlike function hooks,
+    // there's no benefit in batching them with the other mods.
+    if (m_initialized) {
+        EngineMetrics::ScopedTimer timer(
+            &m_metrics, EngineMetrics::Metric::kHookSetupTime);
+        ApplyTableHooks();
+    }
+
     SetTask(nullptr);
 
     return m_initialized;
@@ -897,6 +919,8 @@ void LoadedMod::BeforeUninit() {
 
     SetTask(L"Uninitializing...");
 
+    StopModuleLoadHooks();
+
     using WH_MOD_BEFORE_UNINIT_T = void(__cdecl*)();
     auto pWH_ModBeforeUninit = reinterpret_cast<WH_MOD_BEFORE_UNINIT_T>(
         GetProcAddress(m_modModule.get(), "_Z18Wh_ModBeforeUninitv"));
@@ -906,6 +930,8 @@ void LoadedMod::BeforeUninit() {
 
     m_uninitializing = true;
 
+    RemoveAllTableHooks();
+
 #ifdef WH_HOOKING_ENGINE_MINHOOK
     MH_STATUS status =
         MH_QueueDisableHookEx(reinterpret_cast<ULONG_PTR>(this), MH_ALL_HOOKS);
@@ -929,6 +955,8 @@ void LoadedMod::Uninitialize() {
     if (pWH_ModUninit) {
         pWH_ModUninit();
     }
+
+    StopStorageWriteBehind();
 }
 
 void LoadedMod::EnableLogging(bool enable) {
@@ -939,11 +967,20 @@ void LoadedMod::EnableDebugLogging(bool enable) {
     m_debugLoggingEnabled = enable;
 }
 
+void LoadedMod::SetLogLimits(const LogRateLimiter::Limits& limits) {
+    m_logRateLimiter.SetLimits(limits);
+}
+
 bool LoadedMod::SettingsChanged(bool* reload) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
 
     *reload = false;
 
+    {
+        std::lock_guard<std::mutex> guard(m_settingsSnapshotMutex);
+        m_settingsSnapshot.reset();
+    }
+
     using WH_MOD_SETTINGS_CHANGED_EX_T = BOOL(__cdecl*)(BOOL*);
     auto pWH_ModSettingsChangedEx =
         reinterpret_cast<WH_MOD_SETTINGS_CHANGED_EX_T>(
@@ -970,11 +1007,101 @@ HMODULE LoadedMod::GetModModuleHandle() {
     return m_modModule.get();
 }
 
+void LoadedMod::UpdateHookCallCounts() {
+#ifndef WH_HOOKING_ENGINE_MINHOOK_DETOURS
+    std::lock_guard<std::mutex> guard(m_hookedFunctionsMutex);
+
+    for (auto it = m_hookedFunctions.begin(); it != m_hookedFunctions.end();) {
+        UINT64 callCount;
+        MH_STATUS status = MH_GetCallCount(reinterpret_cast<ULONG_PTR>(this),
+                                           it->targetFunction, &callCount);
+        if (status != MH_OK) {
+            // The hook was removed.
+            it = m_hookedFunctions.erase(it);
+            continue;
+        }
+
+        UINT64 newCalls = callCount - it->lastCallCount;
+        it->lastCallCount = callCount;
+
+        if (newCalls > 0) {
+            m_metrics.Add(EngineMetrics::Metric::kHookCalls, newCalls);
+
+            if (it->slot) {
+                it->slot->AddToMetric(ModStatusTable::Metric::kHookCalls,
+                                      newCalls);
+            } else {
+                // The row starts with all calls so far.
+                it->slot = ClaimHookCallsRow(it->targetName, callCount);
+            }
+        }
+
+        ++it;
+    }
+#endif  // WH_HOOKING_ENGINE_MINHOOK_DETOURS
+}
+
+std::unique_ptr<ModStatusTable::Slot> LoadedMod::ClaimHookCallsRow(
+    const std::wstring& targetName,
+    UINT64 callCount) {
+    if (m_hookCallRowsUnavailable) {
+        return nullptr;
+    }
+
+    // The table is shared by all processes of the session, so the rows of a
+    // mod in a process are capped. Calls of the rest of the hooked functions
+    // are only counted in the mod's metrics.
+    auto rowCount = std::ranges::count_if(
+        m_hookedFunctions,
+        [](const HookedFunction& hooked) { return hooked.slot != nullptr; });
+    if (rowCount >= kMaxHookCallsRows) {
+        return nullptr;
+    }
+
+    try {
+        auto slot = std::make_unique<ModStatusTable::Slot>(
+            CustomizationSession::GetModStatusTable(),
+            ModStatusTable::Kind::kHookCalls, m_modName);
+        slot->SetText(targetName);
+        slot->AddToMetric(ModStatusTable::Metric::kHookCalls, callCount);
+        return slot;
+    } catch (const std::exception& e) {
+        LOG(L"Mod %s: no longer reporting hook calls per function: %S",
+            m_modName.c_str(), e.what());
+        m_hookCallRowsUnavailable = true;
+    }
+
+    return nullptr;
+}
+
 BOOL LoadedMod::IsLogEnabled() {
-    return m_loggingEnabled || m_debugLoggingEnabled;
+    if (!m_loggingEnabled && !m_debugLoggingEnabled) {
+        return FALSE;
+    }
+
+    // Called before the arguments of Wh_Log are evaluated, so suppressed
+    // messages cost nothing else.
+    DWORD suppressedCount;
+    if (!m_logRateLimiter.ShouldLog(&suppressedCount)) {
+        return FALSE;
+    }
+
+    if (suppressedCount > 0) {
+        ReportSuppressedLogMessages(suppressedCount);
+    }
+
+    return TRUE;
 }
 
 void LoadedMod::Log(PCWSTR format, va_list args) {
+    // If possible, only copy the arguments, and leave the formatting to the
+    // session manager.
+    if (auto ringBuffer = Logger::GetInstance().GetRingBuffer()) {
+        if (m_logRecordWriter.Write(*ringBuffer, format, args)) {
+            return;
+        }
+    }
+
     va_list argsCopy;
     va_copy(argsCopy, args);  // https://stackoverflow.com/q/55274350
     WCHAR logFormatted[1025];
@@ -990,6 +1117,19 @@ int LoadedMod::GetIntValue(PCWSTR valueName, int defaultValue) {
     VERBOSE(L"valueName: %s", valueName);
 
     try {
+        if (auto queuedValue = GetQueuedStorageWrite(valueName)) {
+            int value = defaultValue;
+            if (auto intValue = std::get_if<int>(&*queuedValue)) {
+                value = *intValue;
+            } else if (auto stringValue =
+                           std::get_if<std::wstring>(&*queuedValue)) {
+                value = SettingStringToInt(*stringValue).value_or(defaultValue);
+            }
+
+            VERBOSE(L"queued value: %d", value);
+            return value;
+        }
+
         auto settings = StorageManager::GetInstance().GetModWritableConfig(
             m_modName.c_str(), L"LocalStorage", false);
         int value = settings->GetInt(valueName).value_or(defaultValue);
@@ -1008,6 +1148,10 @@ BOOL LoadedMod::SetIntValue(PCWSTR valueName, int value) {
     VERBOSE(L"value: %d", value);
 
     try {
+        if (QueueStorageWrite(valueName, value)) {
+            return TRUE;
+        }
+
         auto settings = StorageManager::GetInstance().GetModWritableConfig(
             m_modName.c_str(), L"LocalStorage", true);
         settings->SetInt(valueName, value);
@@ -1030,9 +1174,20 @@ size_t LoadedMod::GetStringValue(PCWSTR valueName,
     }
 
     try {
-        auto settings = StorageManager::GetInstance().GetModWritableConfig(
-            m_modName.c_str(), L"LocalStorage", false);
-        auto value = settings->GetString(valueName).value_or(L"");
+        std::wstring value;
+        if (auto queuedValue = GetQueuedStorageWrite(valueName)) {
+            if (auto intValue = std::get_if<int>(&*queuedValue)) {
+                value = std::to_wstring(*intValue);
+            } else if (auto stringValue =
+                           std::get_if<std::wstring>(&*queuedValue)) {
+                value = *stringValue;
+            }
+        } else {
+            auto settings = StorageManager::GetInstance().GetModWritableConfig(
+                m_modName.c_str(), L"LocalStorage", false);
+            value = settings->GetString(valueName).value_or(L"");
+        }
+
         if (value.length() <= bufferChars - 1) {
             wcscpy_s(stringBuffer, bufferChars, value.c_str());
             VERBOSE(L"value: %s", value.c_str());
@@ -1055,6 +1210,10 @@ BOOL LoadedMod::SetStringValue(PCWSTR valueName, PCWSTR value) {
     VERBOSE(L"value: %s", value);
 
     try {
+        if (QueueStorageWrite(valueName, std::wstring(value))) {
+            return TRUE;
+        }
+
         auto settings = StorageManager::GetInstance().GetModWritableConfig(
             m_modName.c_str(), L"LocalStorage", true);
         settings->SetString(valueName, value);
@@ -1073,10 +1232,19 @@ size_t LoadedMod::GetBinaryValue(PCWSTR valueName,
     VERBOSE(L"valueName: %s", valueName);
 
     try {
-        auto settings = StorageManager::GetInstance().GetModWritableConfig(
-            m_modName.c_str(), L"LocalStorage", false);
-        auto value =
-            settings->GetBinary(valueName).value_or(std::vector<BYTE>{});
+        std::vector<BYTE> value;
+        if (auto queuedValue = GetQueuedStorageWrite(valueName)) {
+            if (auto binaryValue =
+                    std::get_if<std::vector<BYTE>>(&*queuedValue)) {
+                value = *binaryValue;
+            }
+        } else {
+            auto settings = StorageManager::GetInstance().GetModWritableConfig(
+                m_modName.c_str(), L"LocalStorage", false);
+            value =
+                settings->GetBinary(valueName).value_or(std::vector<BYTE>{});
+        }
+
         if (value.size() <= bufferSize) {
             memcpy(buffer, value.data(), value.size());
             return value.size();
@@ -1097,10 +1265,16 @@ BOOL LoadedMod::SetBinaryValue(PCWSTR valueName,
     VERBOSE(L"valueName: %s", valueName);
 
     try {
+        auto bufferBytes = reinterpret_cast<const BYTE*>(buffer);
+        if (QueueStorageWrite(valueName, std::vector<BYTE>(
+                                             bufferBytes,
+                                             bufferBytes + bufferSize))) {
+            return TRUE;
+        }
+
         auto settings = StorageManager::GetInstance().GetModWritableConfig(
             m_modName.c_str(), L"LocalStorage", true);
-        settings->SetBinary(valueName, reinterpret_cast<const BYTE*>(buffer),
-                            bufferSize);
+        settings->SetBinary(valueName, bufferBytes, bufferSize);
         return TRUE;
     } catch (const std::exception& e) {
         LogFunctionError(e);
@@ -1114,6 +1288,10 @@ BOOL LoadedMod::DeleteValue(PCWSTR valueName) {
     VERBOSE(L"valueName: %s", valueName);
 
     try {
+        if (QueueStorageWrite(valueName, std::monostate{})) {
+            return TRUE;
+        }
+
         auto settings = StorageManager::GetInstance().GetModWritableConfig(
             m_modName.c_str(), L"LocalStorage", true);
         settings->Remove(valueName);
@@ -1125,6 +1303,86 @@ BOOL LoadedMod::DeleteValue(PCWSTR valueName) {
     return FALSE;
 }
 
+BOOL LoadedMod::BeginStorageBatch() {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    std::lock_guard<std::mutex> guard(m_storageMutex);
+    m_storageBatchDepth++;
+    VERBOSE(L"Batch depth: %d", m_storageBatchDepth);
+    return TRUE;
+}
+
+BOOL LoadedMod::CommitStorageBatch() {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    try {
+        std::lock_guard<std::mutex> guard(m_storageMutex);
+
+        if (m_storageBatchDepth == 0) {
+            throw std::logic_error("No storage batch in progress");
+        }
+
+        m_storageBatchDepth--;
+        VERBOSE(L"Batch depth: %d", m_storageBatchDepth);
+
+        if (m_storageBatchDepth == 0) {
+            WriteQueuedStorageValues();
+        }
+
+        return TRUE;
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+
+    return FALSE;
+}
+
+BOOL LoadedMod::SetStorageWriteBehind(DWORD flushDelay) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    VERBOSE(L"flushDelay: %u", flushDelay);
+
+    try {
+        std::lock_guard<std::mutex> guard(m_storageMutex);
+
+        if (flushDelay > 0 && !m_storageFlushTimer) {
+            m_storageFlushTimer.reset(CreateThreadpoolTimer(
+                StorageFlushTimerCallback, this, nullptr));
+            THROW_LAST_ERROR_IF_NULL(m_storageFlushTimer);
+        }
+
+        m_storageWriteBehindDelay = flushDelay;
+
+        if (flushDelay == 0 && m_storageBatchDepth == 0) {
+            WriteQueuedStorageValues();
+        }
+
+        return TRUE;
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+
+    return FALSE;
+}
+
+BOOL LoadedMod::FlushStorage() {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    try {
+        std::lock_guard<std::mutex> guard(m_storageMutex);
+
+        if (m_storageBatchDepth > 0) {
+            throw std::logic_error("A storage batch is in progress");
+        }
+
+        WriteQueuedStorageValues();
+        return TRUE;
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+
+    return FALSE;
+}
+
 size_t LoadedMod::GetModStoragePath(PWSTR pathBuffer, size_t bufferChars) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
 
@@ -1156,20 +1414,18 @@ int LoadedMod::GetIntSetting(PCWSTR valueName, va_list args) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
     VERBOSE(L"valueName: %s", valueName);
 
+    m_metrics.Add(EngineMetrics::Metric::kSettingsReads);
+
     try {
-        va_list argsCopy;
-        va_copy(argsCopy, args);  // https://stackoverflow.com/q/55274350
-        std::wstring valueNameFormatted(_vscwprintf(valueName, argsCopy),
-                                        L'\0');
-        va_end(argsCopy);
-        vswprintf_s(valueNameFormatted.data(), valueNameFormatted.length() + 1,
-                    valueName, args);
+        std::wstring valueNameFormatted = FormatSettingName(valueName, args);
 
         VERBOSE(L"valueNameFormatted: %s", valueNameFormatted.c_str());
 
-        auto settings = StorageManager::GetInstance().GetModConfig(
-            m_modName.c_str(), L"Settings");
-        int value = settings->GetInt(valueNameFormatted.c_str()).value_or(0);
+        auto settingsSnapshot = GetSettingsSnapshot();
+        auto it = settingsSnapshot->find(valueNameFormatted);
+        int value = it != settingsSnapshot->end()
+                        ? SettingStringToInt(it->second).value_or(0)
+                        : 0;
         VERBOSE(L"value: %d", value);
         return value;
     } catch (const std::exception& e) {
@@ -1183,24 +1439,20 @@ PCWSTR LoadedMod::GetStringSetting(PCWSTR valueName, va_list args) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
     VERBOSE(L"valueName: %s", valueName);
 
+    m_metrics.Add(EngineMetrics::Metric::kSettingsReads);
+
     try {
-        va_list argsCopy;
-        va_copy(argsCopy, args);  // https://stackoverflow.com/q/55274350
-        std::wstring valueNameFormatted(_vscwprintf(valueName, argsCopy),
-                                        L'\0');
-        va_end(argsCopy);
-        vswprintf_s(valueNameFormatted.data(), valueNameFormatted.length() + 1,
-                    valueName, args);
+        std::wstring valueNameFormatted = FormatSettingName(valueName, args);
 
         VERBOSE(L"valueNameFormatted: %s", valueNameFormatted.c_str());
 
-        auto settings = StorageManager::GetInstance().GetModConfig(
-            m_modName.c_str(), L"Settings");
-        auto value =
-            settings->GetString(valueNameFormatted.c_str()).value_or(L"");
+        auto settingsSnapshot = GetSettingsSnapshot();
+        auto it = settingsSnapshot->find(valueNameFormatted);
+        std::wstring_view value =
+            it != settingsSnapshot->end() ? it->second : std::wstring_view();
 
         auto valueAllocated = std::make_unique<WCHAR[]>(value.length() + 1);
-        wcscpy_s(valueAllocated.get(), value.length() + 1, value.c_str());
+        value.copy(valueAllocated.get(), value.length());
         VERBOSE(L"value: %s", valueAllocated.get());
         return valueAllocated.release();
     } catch (const std::exception& e) {
@@ -1218,9 +1470,107 @@ void LoadedMod::FreeStringSetting(PCWSTR string) {
     }
 }
 
+const WH_SETTINGS_SNAPSHOT* LoadedMod::CreateSettingsSnapshot() {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    m_metrics.Add(EngineMetrics::Metric::kSettingsReads);
+
+    try {
+        auto settingsSnapshot = GetSettingsSnapshot();
+
+        // Everything is placed in a single allocation: the snapshot header,
+        // followed by the settings array, followed by the strings.
+        size_t stringsChars = 0;
+        for (const auto& [name, value] : *settingsSnapshot) {
+            stringsChars += name.length() + 1 + value.length() + 1;
+        }
+
+        size_t settingsOffset = sizeof(WH_SETTINGS_SNAPSHOT);
+        size_t stringsOffset =
+            settingsOffset + sizeof(WH_SETTING) * settingsSnapshot->size();
+        size_t allocationSize = stringsOffset + sizeof(WCHAR) * stringsChars;
+
+        auto allocation = std::make_unique<BYTE[]>(allocationSize);
+        auto snapshot =
+            reinterpret_cast<WH_SETTINGS_SNAPSHOT*>(allocation.get());
+        auto settings =
+            reinterpret_cast<WH_SETTING*>(allocation.get() + settingsOffset);
+        auto strings =
+            reinterpret_cast<WCHAR*>(allocation.get() + stringsOffset);
+
+        snapshot->settings = settings;
+        snapshot->count = settingsSnapshot->size();
+
+        // The cached settings are sorted with the same order as the one used
+        // by FindSetting.
+        for (const auto& [name, value] : *settingsSnapshot) {
+            settings->name = strings;
+            strings += name.copy(strings, name.length());
+            *strings++ = L'\0';
+
+            settings->stringValue = strings;
+            strings += value.copy(strings, value.length());
+            *strings++ = L'\0';
+
+            settings->intValue = SettingStringToInt(value).value_or(0);
+            settings++;
+        }
+
+        VERBOSE(L"%zu settings", snapshot->count);
+        allocation.release();
+        return snapshot;
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+
+    return nullptr;
+}
+
+const WH_SETTING* LoadedMod::FindSetting(const WH_SETTINGS_SNAPSHOT* snapshot,
+                                         PCWSTR valueName,
+                                         va_list args) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    VERBOSE(L"valueName: %s", valueName);
+
+    try {
+        if (!snapshot) {
+            throw std::invalid_argument("Snapshot is null");
+        }
+
+        std::wstring valueNameFormatted = FormatSettingName(valueName, args);
+
+        VERBOSE(L"valueNameFormatted: %s", valueNameFormatted.c_str());
+
+        const WH_SETTING* settingsBegin = snapshot->settings;
+        const WH_SETTING* settingsEnd = snapshot->settings + snapshot->count;
+        const WH_SETTING* setting = std::lower_bound(
+            settingsBegin, settingsEnd, valueNameFormatted,
+            [](const WH_SETTING& item, const std::wstring& name) {
+                return SettingNameLess{}(item.name, name);
+            });
+        if (setting != settingsEnd &&
+            !SettingNameLess{}(valueNameFormatted, setting->name)) {
+            return setting;
+        }
+
+        VERBOSE(L"Setting not found");
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+
+    return nullptr;
+}
+
+void LoadedMod::FreeSettingsSnapshot(const WH_SETTINGS_SNAPSHOT* snapshot) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    delete[] reinterpret_cast<const BYTE*>(snapshot);
+}
+
 BOOL LoadedMod::SetFunctionHook(void* targetFunction,
                                 void* hookFunction,
-                                void** originalFunction) {
+                                void** originalFunction,
+                                PCWSTR targetName) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
     VERBOSE(L"Target: %p", targetFunction);
     VERBOSE(L"Hook: %p", hookFunction);
@@ -1231,6 +1581,9 @@ BOOL LoadedMod::SetFunctionHook(void* targetFunction,
         return FALSE;
     }
 
+    EngineMetrics::ScopedTimer timer(&m_metrics,
+                                     EngineMetrics::Metric::kHookSetupTime);
+
     MH_STATUS status =
         MH_CreateHookEx(reinterpret_cast<ULONG_PTR>(this), targetFunction,
                         hookFunction, originalFunction);
@@ -1248,6 +1601,16 @@ BOOL LoadedMod::SetFunctionHook(void* targetFunction,
         return FALSE;
     }
 
+    m_metrics.Add(EngineMetrics::Metric::kHooksInstalled);
+
+    if (CustomizationSession::IsHookCallCountingEnabled()) {
+        try {
+            AddHookedFunction(targetFunction, targetName);
+        } catch (const std::exception& e) {
+            LOG(L"%S", e.what());
+        }
+    }
+
     return TRUE;
 #elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
     // For testing without a hooking engine.
@@ -1304,10 +1667,26 @@ BOOL LoadedMod::ApplyHookOperations() {
         return FALSE;
     }
 
+    TraceRecorder::Span span("ApplyHookOperations", m_modName);
+    EngineMetrics::ScopedTimer hookSetupTimer(
+        &m_metrics, EngineMetrics::Metric::kHookSetupTime);
+
+    ApplyTableHooks();
+
 #ifdef WH_HOOKING_ENGINE_MINHOOK
-    MH_STATUS status = MH_ApplyQueuedEx(reinterpret_cast<ULONG_PTR>(this));
+    MH_STATUS status;
+    BOOL threadsFrozen;
+    {
+        EngineMetrics::ScopedTimer timer(
+            &m_metrics, EngineMetrics::Metric::kThreadFreezeTime);
+        status = MH_ApplyQueuedEx2(reinterpret_cast<ULONG_PTR>(this),
+                                   &threadsFrozen);
+    }
+    if (threadsFrozen) {
+        m_metrics.Add(EngineMetrics::Metric::kThreadFreezes);
+    }
     if (status != MH_OK) {
-        LOG(L"Mod %s error: MH_ApplyQueuedEx returned %d", m_modName.c_str(),
+        LOG(L"Mod %s error: MH_ApplyQueuedEx2 returned %d", m_modName.c_str(),
             status);
     }
 
@@ -1328,26 +1707,148 @@ BOOL LoadedMod::ApplyHookOperations() {
 #endif  // WH_HOOKING_ENGINE
 }
 
-HANDLE LoadedMod::FindFirstSymbol(HMODULE hModule,
-                                  PCWSTR symbolServer,
-                                  BYTE* findData) {
-    WH_FIND_SYMBOL_OPTIONS options = {
-        .optionsSize = sizeof(options),
-        .symbolServer = symbolServer,
-    };
-    WH_FIND_SYMBOL newFindData;
-    HANDLE findHandle = FindFirstSymbol4(hModule, &options, &newFindData);
-    if (!findHandle) {
-        return nullptr;
+BOOL LoadedMod::SetImportHook(HMODULE module,
+                              PCSTR importModuleName,
+                              PCSTR functionName,
+                              void* hookFunction,
+                              void** originalFunction) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    VERBOSE(L"Module: %p", module);
+    VERBOSE(L"Hook: %p", hookFunction);
+
+    if (!module || !importModuleName || !functionName) {
+        LOG(L"Invalid arguments");
+        return FALSE;
     }
 
-    struct {
-        PCWSTR symbol;
-        void* address;
-    }* findDataOldStruct = (decltype(findDataOldStruct))findData;
+    void** entry =
+        Functions::FindImportPtr(module, importModuleName, functionName);
+    if (!entry) {
+        LOG(L"Mod %s error: Import not found", m_modName.c_str());
+        return FALSE;
+    }
 
-    findDataOldStruct->symbol = newFindData.symbol;
-    findDataOldStruct->address = newFindData.address;
+    try {
+        auto tableHook = std::make_unique<TableHook>(entry, hookFunction);
+        void* original = tableHook->GetOriginalFunction();
+
+        BOOL result = SetTableHook(std::move(tableHook));
+        if (result && originalFunction) {
+            *originalFunction = original;
+        }
+
+        return result;
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+
+    return FALSE;
+}
+
+BOOL LoadedMod::RemoveImportHook(HMODULE module,
+                                 PCSTR importModuleName,
+                                 PCSTR functionName) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    VERBOSE(L"Module: %p", module);
+
+    if (!module || !importModuleName || !functionName) {
+        LOG(L"Invalid arguments");
+        return FALSE;
+    }
+
+    void** entry =
+        Functions::FindImportPtr(module, importModuleName, functionName);
+    if (!entry) {
+        LOG(L"Mod %s error: Import not found", m_modName.c_str());
+        return FALSE;
+    }
+
+    return QueueRemoveTableHook(entry);
+}
+
+BOOL LoadedMod::SetExportHook(HMODULE module,
+                              PCSTR functionName,
+                              void* hookFunction,
+                              void** originalFunction) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    VERBOSE(L"Module: %p", module);
+    VERBOSE(L"Hook: %p", hookFunction);
+
+    if (!module || !functionName) {
+        LOG(L"Invalid arguments");
+        return FALSE;
+    }
+
+    DWORD* entry = Functions::FindExportPtr(module, functionName);
+    if (!entry) {
+        LOG(L"Mod %s error: Export not found", m_modName.c_str());
+        return FALSE;
+    }
+
+    // Also resolves forwarded exports.
+    void* exportedFunction =
+        reinterpret_cast<void*>(GetProcAddress(module, functionName));
+    if (!exportedFunction) {
+        LOG(L"Mod %s error: Export couldn't be resolved", m_modName.c_str());
+        return FALSE;
+    }
+
+    try {
+        auto tableHook = std::make_unique<TableHook>(
+            module, entry, exportedFunction, hookFunction);
+        void* original = tableHook->GetOriginalFunction();
+
+        BOOL result = SetTableHook(std::move(tableHook));
+        if (result && originalFunction) {
+            *originalFunction = original;
+        }
+
+        return result;
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+
+    return FALSE;
+}
+
+BOOL LoadedMod::RemoveExportHook(HMODULE module, PCSTR functionName) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    VERBOSE(L"Module: %p", module);
+
+    if (!module || !functionName) {
+        LOG(L"Invalid arguments");
+        return FALSE;
+    }
+
+    DWORD* entry = Functions::FindExportPtr(module, functionName);
+    if (!entry) {
+        LOG(L"Mod %s error: Export not found", m_modName.c_str());
+        return FALSE;
+    }
+
+    return QueueRemoveTableHook(entry);
+}
+
+HANDLE LoadedMod::FindFirstSymbol(HMODULE hModule,
+                                  PCWSTR symbolServer,
+                                  BYTE* findData) {
+    WH_FIND_SYMBOL_OPTIONS options = {
+        .optionsSize = sizeof(options),
+        .symbolServer = symbolServer,
+    };
+    WH_FIND_SYMBOL newFindData;
+    HANDLE findHandle = FindFirstSymbol4(hModule, &options, &newFindData);
+    if (!findHandle) {
+        return nullptr;
+    }
+
+    struct {
+        PCWSTR symbol;
+        void* address;
+    }* findDataOldStruct = (decltype(findDataOldStruct))findData;
+
+    findDataOldStruct->symbol = newFindData.symbol;
+    findDataOldStruct->address = newFindData.address;
 
     return findHandle;
 }
@@ -1638,6 +2139,10 @@ BOOL LoadedMod::HookSymbols(HMODULE module,
     }
 
     try {
+        TraceRecorder::Span span("HookSymbols", m_modName);
+        EngineMetrics::ScopedTimer timer(
+            &m_metrics, EngineMetrics::Metric::kSymbolResolutionTime);
+
         auto hookSymbolsSession =
             HookSymbolsSession(module, symbolHooks, symbolHooksCount);
 
@@ -1676,9 +2181,9 @@ BOOL LoadedMod::HookSymbols(HMODULE module,
         auto applySessionPendingHooks = [this, &hookSymbolsSession]() {
             hookSymbolsSession.ApplyPendingHooks(
                 [this](void* targetFunction, void* hookFunction,
-                       void** originalFunction) {
+                       void** originalFunction, PCWSTR symbol) {
                     return SetFunctionHook(targetFunction, hookFunction,
-                                           originalFunction);
+                                           originalFunction, symbol);
                 });
         };
 
@@ -1704,12 +2209,14 @@ BOOL LoadedMod::HookSymbols(HMODULE module,
 
             hookSymbolsSession.ResolveSymbolsFromCache(cacheBuffer);
             if (hookSymbolsSession.AreAllSymbolsResolved()) {
+                m_metrics.Add(EngineMetrics::Metric::kSymbolLocalCacheHits);
                 applySessionPendingHooks();
                 return TRUE;
             }
         }
 
         VERBOSE(L"Couldn't resolve all symbols from local cache");
+        m_metrics.Add(EngineMetrics::Metric::kSymbolLocalCacheMisses);
 
         std::wstring onlineCacheUrl;
         if (options && options->onlineCacheUrl) {
@@ -1760,6 +2267,9 @@ BOOL LoadedMod::HookSymbols(HMODULE module,
 
                     hookSymbolsSession.ResolveSymbolsFromCache(cacheBuffer);
                     if (hookSymbolsSession.AreAllSymbolsResolved()) {
+                        // Stored by another process in the meantime.
+                        m_metrics.Add(
+                            EngineMetrics::Metric::kSymbolLocalCacheHits);
                         applySessionPendingHooks();
                         return TRUE;
                     }
@@ -1769,8 +2279,12 @@ BOOL LoadedMod::HookSymbols(HMODULE module,
             onlineCacheUrl += hookSymbolsSession.GetCacheStrKey();
             onlineCacheUrl += L".txt";
 
-            const WH_URL_CONTENT* onlineCacheUrlContent =
-                GetUrlContent(onlineCacheUrl.c_str(), nullptr);
+            const WH_URL_CONTENT* onlineCacheUrlContent;
+            {
+                TraceRecorder::Span span("GetOnlineSymbolCache", m_modName);
+                onlineCacheUrlContent =
+                    GetUrlContent(onlineCacheUrl.c_str(), nullptr);
+            }
             if (onlineCacheUrlContent) {
                 std::wstring onlineCache;
                 if (onlineCacheUrlContent->statusCode == 200) {
@@ -1793,6 +2307,8 @@ BOOL LoadedMod::HookSymbols(HMODULE module,
 
                     hookSymbolsSession.ResolveSymbolsFromCache(onlineCache);
                     if (hookSymbolsSession.AreAllSymbolsResolved()) {
+                        m_metrics.Add(
+                            EngineMetrics::Metric::kSymbolOnlineCacheHits);
                         applySessionPendingHooks();
 
                         try {
@@ -1825,8 +2341,12 @@ BOOL LoadedMod::HookSymbols(HMODULE module,
             }
 
             VERBOSE(L"Couldn't resolve all symbols from online cache");
+            m_metrics.Add(EngineMetrics::Metric::kSymbolOnlineCacheMisses);
         }
 
+        TraceRecorder::Span enumSymbolsSpan("EnumSymbols", m_modName);
+        m_metrics.Add(EngineMetrics::Metric::kSymbolEnumerations);
+
         WH_FIND_SYMBOL findSymbol;
         WH_FIND_SYMBOL_OPTIONS findFirstSymbolOptions = {
             .optionsSize = sizeof(findFirstSymbolOptions),
@@ -1891,6 +2411,144 @@ BOOL LoadedMod::HookSymbols(HMODULE module,
     return FALSE;
 }
 
+BOOL LoadedMod::SetModuleLoadHooks(const WH_MODULE_LOAD_HOOKS* hooks) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    if (!hooks || hooks->size != sizeof(WH_MODULE_LOAD_HOOKS)) {
+        LOG(L"Unsupported hooks->size value");
+        return FALSE;
+    }
+
+    if (!hooks->moduleName) {
+        LOG(L"Module name is null");
+        return FALSE;
+    }
+
+    if ((hooks->exportHooksCount > 0 && !hooks->exportHooks) ||
+        (hooks->symbolHooksCount > 0 && !hooks->symbolHooks)) {
+        LOG(L"Hooks array is null");
+        return FALSE;
+    }
+
+    if (hooks->hookSymbolsOptions &&
+        hooks->hookSymbolsOptions->optionsSize !=
+            sizeof(WH_HOOK_SYMBOLS_OPTIONS)) {
+        LOG(L"Unsupported options->optionsSize value");
+        return FALSE;
+    }
+
+    if (m_uninitializing) {
+        VERBOSE(L"Uninitializing, not allowed to set hooks");
+        return FALSE;
+    }
+
+    VERBOSE(L"Module: %s", hooks->moduleName);
+
+    try {
+        auto moduleLoadHooks = std::make_unique<ModuleLoadHooks>();
+        moduleLoadHooks->moduleName = hooks->moduleName;
+
+        moduleLoadHooks->exportNames.reserve(hooks->exportHooksCount);
+        moduleLoadHooks->exportHooks.reserve(hooks->exportHooksCount);
+        for (size_t i = 0; i < hooks->exportHooksCount; i++) {
+            const auto& exportHook = hooks->exportHooks[i];
+            if (!exportHook.exportName) {
+                LOG(L"Export name is null");
+                return FALSE;
+            }
+
+            const auto& exportName =
+                moduleLoadHooks->exportNames.emplace_back(
+                    exportHook.exportName);
+            moduleLoadHooks->exportHooks.push_back(exportHook);
+            moduleLoadHooks->exportHooks.back().exportName =
+                exportName.c_str();
+        }
+
+        moduleLoadHooks->symbolNameStrings.reserve(hooks->symbolHooksCount);
+        moduleLoadHooks->symbolNames.reserve(hooks->symbolHooksCount);
+        moduleLoadHooks->symbolHooks.reserve(hooks->symbolHooksCount);
+        for (size_t i = 0; i < hooks->symbolHooksCount; i++) {
+            const auto& symbolHook = hooks->symbolHooks[i];
+
+            auto& strings = moduleLoadHooks->symbolNameStrings.emplace_back();
+            auto& names = moduleLoadHooks->symbolNames.emplace_back();
+            strings.reserve(symbolHook.symbolsCount);
+            names.reserve(symbolHook.symbolsCount);
+            for (size_t j = 0; j < symbolHook.symbolsCount; j++) {
+                const auto& string = strings.emplace_back(
+                    symbolHook.symbols[j].string,
+                    symbolHook.symbols[j].length);
+                names.push_back({string.c_str(), string.length()});
+            }
+
+            moduleLoadHooks->symbolHooks.push_back(symbolHook);
+            moduleLoadHooks->symbolHooks.back().symbols = names.data();
+        }
+
+        if (hooks->hookSymbolsOptions) {
+            auto& options = moduleLoadHooks->hookSymbolsOptions.emplace(
+                *hooks->hookSymbolsOptions);
+            if (options.symbolServer) {
+                options.symbolServer =
+                    moduleLoadHooks->symbolServer.emplace(options.symbolServer)
+                        .c_str();
+            }
+            if (options.onlineCacheUrl) {
+                options.onlineCacheUrl =
+                    moduleLoadHooks->onlineCacheUrl
+                        .emplace(options.onlineCacheUrl)
+                        .c_str();
+            }
+        }
+
+        auto* moduleLoadHooksPtr = moduleLoadHooks.get();
+
+        {
+            std::lock_guard<std::mutex> guard(m_moduleLoadHooksMutex);
+
+            m_moduleLoadHooks.push_back(std::move(moduleLoadHooks));
+
+            if (!m_moduleLoadWork) {
+                m_moduleLoadWork.reset(CreateThreadpoolWork(
+                    ModuleLoadWorkCallback, this, nullptr));
+                THROW_LAST_ERROR_IF_NULL(m_moduleLoadWork);
+            }
+        }
+
+        std::lock_guard<std::mutex> setGuard(m_moduleLoadHooksSetMutex);
+
+        // Start listening before checking whether the module is already
+        // loaded, so that a concurrent load isn't missed. Modules which were
+        // already hooked are skipped by SetHooksForModule.
+        if (!m_listeningToDllNotifications) {
+            DllNotificationDispatcher::GetInstance().AddListener(this);
+            m_listeningToDllNotifications = true;
+        }
+
+        HMODULE module;
+        if (!GetModuleHandleEx(0, moduleLoadHooksPtr->moduleName.c_str(),
+                               &module)) {
+            VERBOSE(L"Module isn't loaded yet");
+            return TRUE;
+        }
+
+        bool hooksSet = SetHooksForModule(*moduleLoadHooksPtr, module);
+
+        // Before initialization, the hooks are applied by the engine after
+        // Wh_ModInit returns.
+        if (hooksSet && m_initialized) {
+            ApplyHookOperations();
+        }
+
+        return hooksSet;
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+
+    return FALSE;
+}
+
 BOOL LoadedMod::Disasm(void* address, WH_DISASM_RESULT* result) {
 #if defined(_M_ARM64)
     int rc = aarch64_decompose_and_disassemble(
@@ -2141,6 +2799,9 @@ const WH_URL_CONTENT* LoadedMod::GetUrlContent(
 
         content->length = downloadedTotal;
 
+        m_metrics.Add(EngineMetrics::Metric::kBytesDownloaded,
+                      static_cast<LONG64>(downloadedTotal));
+
         return content.release();
     } catch (const std::exception& e) {
         LogFunctionError(e);
@@ -2158,10 +2819,495 @@ void LoadedMod::FreeUrlContent(const WH_URL_CONTENT* content) {
     }
 }
 
+BOOL LoadedMod::SetTableHook(std::unique_ptr<TableHook> tableHook) {
+    if (m_uninitializing) {
+        VERBOSE(L"Uninitializing, not allowed to set hooks");
+        return FALSE;
+    }
+
+    std::lock_guard<std::mutex> guard(m_tableHooksMutex);
+
+    for (const auto& existingTableHook : m_tableHooks) {
+        if (existingTableHook.hook->GetEntry() == tableHook->GetEntry()) {
+            LOG(L"Mod %s error: Already hooked", m_modName.c_str());
+            return FALSE;
+        }
+    }
+
+    m_tableHooks.push_back({
+        .hook = std::move(tableHook),
+        .queueEnable = true,
+    });
+    return TRUE;
+}
+
+BOOL LoadedMod::QueueRemoveTableHook(void* entry) {
+    if (!m_initialized) {
+        VERBOSE(L"Not initialized, not allowed to remove hooks");
+        return FALSE;
+    }
+
+    if (m_uninitializing) {
+        VERBOSE(L"Uninitializing, not allowed to remove hooks");
+        return FALSE;
+    }
+
+    std::lock_guard<std::mutex> guard(m_tableHooksMutex);
+
+    for (auto& tableHook : m_tableHooks) {
+        if (tableHook.hook->GetEntry() == entry) {
+            tableHook.queueEnable = false;
+            return TRUE;
+        }
+    }
+
+    LOG(L"Mod %s error: Not hooked", m_modName.c_str());
+    return FALSE;
+}
+
+void LoadedMod::ApplyTableHooks() {
+    std::lock_guard<std::mutex> guard(m_tableHooksMutex);
+
+    for (auto it = m_tableHooks.begin(); it != m_tableHooks.end();) {
+        auto& tableHook = *it;
+
+        try {
+            if (tableHook.queueEnable) {
+                tableHook.hook->Enable();
+            } else {
+                tableHook.hook->Disable();
+            }
+        } catch (const std::exception& e) {
+            LogFunctionError(e);
+        }
+
+        if (!tableHook.queueEnable && !tableHook.hook->IsEnabled()) {
+            it = m_tableHooks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void LoadedMod::RemoveAllTableHooks() {
+    {
+        std::lock_guard<std::mutex> guard(m_tableHooksMutex);
+
+        for (auto& tableHook : m_tableHooks) {
+            tableHook.queueEnable = false;
+        }
+    }
+
+    ApplyTableHooks();
+}
+
+void LoadedMod::OnDllLoaded(void* dllBase,
+                            std::wstring_view baseDllName,
+                            std::wstring_view fullDllName) {
+    // Called with the loader lock held, only record the module and let a
+    // worker thread set the hooks.
+    std::lock_guard<std::mutex> guard(m_moduleLoadHooksMutex);
+
+    for (const auto& moduleLoadHooks : m_moduleLoadHooks) {
+        const auto& moduleName = moduleLoadHooks->moduleName;
+        if (CompareStringOrdinal(
+                baseDllName.data(), wil::safe_cast<int>(baseDllName.length()),
+                moduleName.data(), wil::safe_cast<int>(moduleName.length()),
+                /*bIgnoreCase=*/TRUE) == CSTR_EQUAL) {
+            m_pendingLoadedModules.push_back(dllBase);
+            SubmitThreadpoolWork(m_moduleLoadWork.get());
+            return;
+        }
+    }
+}
+
+void LoadedMod::OnDllUnloaded(void* dllBase) {
+    std::lock_guard<std::mutex> guard(m_moduleLoadHooksMutex);
+
+    std::erase(m_pendingLoadedModules, dllBase);
+}
+
+// static
+void CALLBACK LoadedMod::ModuleLoadWorkCallback(PTP_CALLBACK_INSTANCE instance,
+                                                PVOID context,
+                                                PTP_WORK work) {
+    auto* loadedMod = static_cast<LoadedMod*>(context);
+
+    try {
+        loadedMod->HandleLoadedModules();
+    } catch (const std::exception& e) {
+        loadedMod->LogFunctionError(e);
+    }
+}
+
+void LoadedMod::HandleLoadedModules() {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    std::lock_guard<std::mutex> setGuard(m_moduleLoadHooksSetMutex);
+
+    bool hooksSet = false;
+
+    while (true) {
+        void* dllBase;
+        std::vector<ModuleLoadHooks*> moduleLoadHooksList;
+
+        {
+            std::lock_guard<std::mutex> guard(m_moduleLoadHooksMutex);
+
+            if (m_pendingLoadedModules.empty()) {
+                break;
+            }
+
+            dllBase = m_pendingLoadedModules.front();
+            m_pendingLoadedModules.erase(m_pendingLoadedModules.begin());
+
+            for (const auto& moduleLoadHooks : m_moduleLoadHooks) {
+                moduleLoadHooksList.push_back(moduleLoadHooks.get());
+            }
+        }
+
+        // Fails if the module was unloaded in the meantime, e.g. if its
+        // initialization failed.
+        HMODULE module;
+        if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                               static_cast<PCWSTR>(dllBase), &module)) {
+            VERBOSE(L"Module %p was unloaded", dllBase);
+            continue;
+        }
+
+        wil::unique_hmodule moduleRef(module);
+
+        if (module != dllBase) {
+            // Another module was loaded at an overlapping address.
+            continue;
+        }
+
+        std::filesystem::path modulePath =
+            wil::GetModuleFileName<std::wstring>(module);
+        const auto& moduleFileName = modulePath.filename().native();
+
+        for (auto* moduleLoadHooks : moduleLoadHooksList) {
+            const auto& moduleName = moduleLoadHooks->moduleName;
+            if (CompareStringOrdinal(
+                    moduleFileName.data(),
+                    wil::safe_cast<int>(moduleFileName.length()),
+                    moduleName.data(), wil::safe_cast<int>(moduleName.length()),
+                    /*bIgnoreCase=*/TRUE) != CSTR_EQUAL) {
+                continue;
+            }
+
+            // Each registration keeps its own module reference.
+            HMODULE hookedModule;
+            if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                                   static_cast<PCWSTR>(dllBase),
+                                   &hookedModule)) {
+                continue;
+            }
+
+            if (SetHooksForModule(*moduleLoadHooks, hookedModule)) {
+                hooksSet = true;
+            }
+        }
+    }
+
+    // Before initialization, the hooks are applied by the engine after
+    // Wh_ModInit returns.
+    if (hooksSet && m_initialized) {
+        ApplyHookOperations();
+    }
+}
+
+// Takes ownership of the module reference.
+bool LoadedMod::SetHooksForModule(ModuleLoadHooks& moduleLoadHooks,
+                                  HMODULE module) {
+    wil::unique_hmodule moduleRef(module);
+
+    for (const auto& hookedModule : moduleLoadHooks.hookedModules) {
+        if (hookedModule.get() == module) {
+            return false;
+        }
+    }
+
+    auto modulePath = wil::GetModuleFileName<std::wstring>(module);
+    if (moduleLoadHooks.failedModulePaths.contains(modulePath)) {
+        VERBOSE(L"Skipping %s, setting the hooks failed before",
+                modulePath.c_str());
+        return false;
+    }
+
+    VERBOSE(L"Setting hooks for %s", modulePath.c_str());
+
+    std::vector<void*> exportAddresses(moduleLoadHooks.exportHooks.size());
+    for (size_t i = 0; i < moduleLoadHooks.exportHooks.size(); i++) {
+        const auto& exportHook = moduleLoadHooks.exportHooks[i];
+        exportAddresses[i] = reinterpret_cast<void*>(
+            GetProcAddress(module, exportHook.exportName));
+        if (!exportAddresses[i] && !exportHook.optional) {
+            LOG(L"Mod %s error: Export %S not found in %s", m_modName.c_str(),
+                exportHook.exportName, modulePath.c_str());
+            moduleLoadHooks.failedModulePaths.insert(std::move(modulePath));
+            return false;
+        }
+    }
+
+    // HookSymbols only sets the hooks if all symbols were resolved, so nothing
+    // needs to be undone if it fails.
+    if (!moduleLoadHooks.symbolHooks.empty() &&
+        !HookSymbols(module, moduleLoadHooks.symbolHooks.data(),
+                     moduleLoadHooks.symbolHooks.size(),
+                     moduleLoadHooks.hookSymbolsOptions
+                         ? &*moduleLoadHooks.hookSymbolsOptions
+                         : nullptr)) {
+        LOG(L"Mod %s error: Hooking symbols failed for %s", m_modName.c_str(),
+            modulePath.c_str());
+        moduleLoadHooks.failedModulePaths.insert(std::move(modulePath));
+        return false;
+    }
+
+    for (size_t i = 0; i < moduleLoadHooks.exportHooks.size(); i++) {
+        if (!exportAddresses[i]) {
+            continue;
+        }
+
+        const auto& exportHook = moduleLoadHooks.exportHooks[i];
+        std::wstring exportName(
+            exportHook.exportName,
+            exportHook.exportName + strlen(exportHook.exportName));
+        SetFunctionHook(exportAddresses[i], exportHook.hookFunction,
+                        exportHook.pOriginalFunction, exportName.c_str());
+    }
+
+    moduleLoadHooks.hookedModules.push_back(std::move(moduleRef));
+    return true;
+}
+
+void LoadedMod::StopModuleLoadHooks() {
+    {
+        std::lock_guard<std::mutex> setGuard(m_moduleLoadHooksSetMutex);
+
+        if (m_listeningToDllNotifications) {
+            DllNotificationDispatcher::GetInstance().RemoveListener(this);
+            m_listeningToDllNotifications = false;
+        }
+    }
+
+    // Cancels pending work and waits for running work to complete. Must not
+    // be done while holding m_moduleLoadHooksSetMutex, which the work
+    // acquires.
+    m_moduleLoadWork.reset();
+}
+
+bool LoadedMod::QueueStorageWrite(PCWSTR valueName, StorageValue value) {
+    std::lock_guard<std::mutex> guard(m_storageMutex);
+
+    bool writeBehind = m_storageWriteBehindDelay > 0 && m_storageFlushTimer;
+    if (m_storageBatchDepth == 0 && !writeBehind) {
+        return false;
+    }
+
+    m_queuedStorageWrites.insert_or_assign(std::wstring(valueName),
+                                           std::move(value));
+
+    // The first queued write schedules the flush, so that the values are
+    // written at most flushDelay milliseconds after they were set.
+    if (m_storageBatchDepth == 0 && !m_storageFlushScheduled) {
+        FILETIME dueTime = wil::filetime::from_int64(
+            -static_cast<INT64>(m_storageWriteBehindDelay) *
+            wil::filetime_duration::one_millisecond);
+        SetThreadpoolTimer(m_storageFlushTimer.get(), &dueTime, 0, 0);
+        m_storageFlushScheduled = true;
+    }
+
+    return true;
+}
+
+std::optional<LoadedMod::StorageValue> LoadedMod::GetQueuedStorageWrite(
+    PCWSTR valueName) {
+    std::lock_guard<std::mutex> guard(m_storageMutex);
+
+    auto it = m_queuedStorageWrites.find(valueName);
+    if (it == m_queuedStorageWrites.end()) {
+        return std::nullopt;
+    }
+
+    return it->second;
+}
+
+void LoadedMod::WriteQueuedStorageValues() {
+    // m_storageMutex must be held.
+    if (m_queuedStorageWrites.empty()) {
+        return;
+    }
+
+    VERBOSE(L"Writing %zu queued storage values",
+            m_queuedStorageWrites.size());
+
+    auto settings = StorageManager::GetInstance().GetModWritableConfig(
+        m_modName.c_str(), L"LocalStorage", true);
+
+    settings->BeginWriteBatch();
+
+    for (const auto& [valueName, value] : m_queuedStorageWrites) {
+        if (auto intValue = std::get_if<int>(&value)) {
+            settings->SetInt(valueName.c_str(), *intValue);
+        } else if (auto stringValue = std::get_if<std::wstring>(&value)) {
+            settings->SetString(valueName.c_str(), stringValue->c_str());
+        } else if (auto binaryValue = std::get_if<std::vector<BYTE>>(&value)) {
+            settings->SetBinary(valueName.c_str(), binaryValue->data(),
+                                binaryValue->size());
+        } else {
+            settings->Remove(valueName.c_str());
+        }
+    }
+
+    settings->CommitWriteBatch();
+
+    m_queuedStorageWrites.clear();
+}
+
+void CALLBACK LoadedMod::StorageFlushTimerCallback(
+    PTP_CALLBACK_INSTANCE instance,
+    PVOID context,
+    PTP_TIMER timer) {
+    auto* loadedMod = static_cast<LoadedMod*>(context);
+
+    std::lock_guard<std::mutex> guard(loadedMod->m_storageMutex);
+
+    loadedMod->m_storageFlushScheduled = false;
+
+    // If a batch is in progress, the values are written when it's committed.
+    if (loadedMod->m_storageBatchDepth > 0) {
+        return;
+    }
+
+    try {
+        loadedMod->WriteQueuedStorageValues();
+    } catch (const std::exception& e) {
+        loadedMod->LogFunctionError(e);
+    }
+}
+
+void LoadedMod::StopStorageWriteBehind() {
+    {
+        std::lock_guard<std::mutex> guard(m_storageMutex);
+        m_storageWriteBehindDelay = 0;
+    }
+
+    // Cancels a pending flush and waits for a running flush to complete. Must
+    // not be done while holding m_storageMutex, which the callback acquires.
+    m_storageFlushTimer.reset();
+
+    std::lock_guard<std::mutex> guard(m_storageMutex);
+
+    m_storageFlushScheduled = false;
+
+    // Write everything, including values of a batch which was never
+    // committed.
+    try {
+        WriteQueuedStorageValues();
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+}
+
+bool LoadedMod::SettingNameLess::operator()(std::wstring_view a,
+                                            std::wstring_view b) const {
+    auto isDigit = [](WCHAR c) { return c >= L'0' && c <= L'9'; };
+
+    // Runs of digits, such as array indices, are compared by their numeric
+    // value, so that "items[9]" comes before "items[10]". The rest is compared
+    // case-insensitively. Numbers which only differ in leading zeros are
+    // ordered by length, so that distinct names are never equivalent.
+    int leadingZerosResult = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.length() && j < b.length()) {
+        if (isDigit(a[i]) && isDigit(b[j])) {
+            size_t aStart = i;
+            size_t bStart = j;
+            while (i < a.length() && isDigit(a[i])) {
+                i++;
+            }
+            while (j < b.length() && isDigit(b[j])) {
+                j++;
+            }
+
+            std::wstring_view aDigits = a.substr(aStart, i - aStart);
+            std::wstring_view bDigits = b.substr(bStart, j - bStart);
+            size_t aLength = aDigits.length();
+            size_t bLength = bDigits.length();
+
+            aDigits.remove_prefix(
+                std::min(aDigits.find_first_not_of(L'0'), aLength));
+            bDigits.remove_prefix(
+                std::min(bDigits.find_first_not_of(L'0'), bLength));
+
+            if (aDigits.length() != bDigits.length()) {
+                return aDigits.length() < bDigits.length();
+            }
+
+            int result = aDigits.compare(bDigits);
+            if (result != 0) {
+                return result < 0;
+            }
+
+            if (leadingZerosResult == 0 && aLength != bLength) {
+                leadingZerosResult = aLength < bLength ? -1 : 1;
+            }
+
+            continue;
+        }
+
+        size_t aStart = i;
+        size_t bStart = j;
+        while (i < a.length() && !isDigit(a[i])) {
+            i++;
+        }
+        while (j < b.length() && !isDigit(b[j])) {
+            j++;
+        }
+
+        int result = CompareStringOrdinal(
+            a.data() + aStart, wil::safe_cast<int>(i - aStart),
+            b.data() + bStart, wil::safe_cast<int>(j - bStart),
+            /*bIgnoreCase=*/TRUE);
+        if (result != CSTR_EQUAL) {
+            return result == CSTR_LESS_THAN;
+        }
+    }
+
+    if (i < a.length() || j < b.length()) {
+        return j < b.length();
+    }
+
+    return leadingZerosResult < 0;
+}
+
+std::shared_ptr<const LoadedMod::SettingsSnapshot>
+LoadedMod::GetSettingsSnapshot() {
+    std::lock_guard<std::mutex> guard(m_settingsSnapshotMutex);
+
+    if (!m_settingsSnapshot) {
+        auto settings = StorageManager::GetInstance().GetModConfig(
+            m_modName.c_str(), L"Settings");
+
+        auto settingsSnapshot = std::make_shared<SettingsSnapshot>();
+        for (auto it = settings->EnumStringValues(); it; ++it) {
+            auto [valueName, value] = *it;
+            settingsSnapshot->try_emplace(std::move(valueName),
+                                          std::move(value));
+        }
+
+        m_settingsSnapshot = std::move(settingsSnapshot);
+    }
+
+    return m_settingsSnapshot;
+}
+
 void LoadedMod::SetTask(PCWSTR task) {
     try {
-        SetModMetadataValue(m_modTaskFile, task, L"mod-task",
-                            m_modInstanceId.c_str());
+        SetModStatusTableText(m_modTaskSlot, task, ModStatusTable::Kind::kTask,
+                              m_modName.c_str());
     } catch (const std::exception& e) {
         LOG(L"%S", e.what());
     }
@@ -2171,8 +3317,60 @@ void LoadedMod::LogFunctionError(const std::exception& e) {
     LOG(L"Mod %s error: %S", m_modName.c_str(), e.what());
 }
 
+void LoadedMod::ReportSuppressedLogMessages(DWORD count) {
+    Logger::GetInstance().LogLine(
+        L"[WH] [%s] %u log messages were suppressed by the rate limit\n",
+        m_modName.c_str(), count);
+}
+
+void LoadedMod::AddHookedFunction(void* targetFunction, PCWSTR targetName) {
+    std::wstring name;
+    if (targetName) {
+        name = targetName;
+    } else {
+        // Describe the target as module+offset, which can be resolved to a
+        // symbol by tooling.
+        HMODULE module;
+        if (GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                                  GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                              static_cast<PCWSTR>(targetFunction), &module)) {
+            std::filesystem::path modulePath =
+                wil::GetModuleFileName<std::wstring>(module);
+            WCHAR offset[32];
+            swprintf_s(offset, L"+0x%zX",
+                       reinterpret_cast<ULONG_PTR>(targetFunction) -
+                           reinterpret_cast<ULONG_PTR>(module));
+            name = modulePath.filename().native() + offset;
+        } else {
+            WCHAR address[32];
+            swprintf_s(address, L"%p", targetFunction);
+            name = address;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(m_hookedFunctionsMutex);
+
+    auto it = std::find_if(m_hookedFunctions.begin(), m_hookedFunctions.end(),
+                           [targetFunction](const HookedFunction& hooked) {
+                               return hooked.targetFunction == targetFunction;
+                           });
+    if (it != m_hookedFunctions.end()) {
+        // A new hook for a target which was unhooked, counting starts over.
+        it->targetName = std::move(name);
+        it->lastCallCount = 0;
+        it->slot.reset();
+        return;
+    }
+
+    m_hookedFunctions.push_back({
+        .targetFunction = targetFunction,
+        .targetName = std::move(name),
+        .lastCallCount = 0,
+    });
+}
+
 Mod::Mod(PCWSTR modName)
-    : m_modName(modName), m_modInstanceId(GenerateModInstanceId(modName)) {
+    : m_modName(modName) {
     SetStatus(L"Pending...");
 }
 
@@ -2181,28 +3379,28 @@ void Mod::Load() {
         throw std::logic_error("Already loaded");
     }
 
+    TraceRecorder::Span span("LoadMod", m_modName);
+
     auto setStatusOnExit = wil::scope_exit(
         [this] { SetStatus(m_loadedMod ? L"Loaded" : L"Unloaded"); });
 
     auto& storageManager = StorageManager::GetInstance();
     auto settings = storageManager.GetModConfig(m_modName.c_str(), nullptr);
 
-    m_libraryFileName = settings->GetString(L"LibraryFileName").value_or(L"");
+    auto values = ModConfig::GetLoadedModValues(*settings);
+
+    m_libraryFileName = values.libraryFileName;
     if (m_libraryFileName.empty()) {
         throw std::runtime_error("Missing LibraryFileName value");
     }
 
     auto libraryPath = storageManager.GetModsPath() / m_libraryFileName;
 
-    m_settingsChangeTime = settings->GetInt(L"SettingsChangeTime").value_or(0);
-
-    bool loggingEnabled = settings->GetInt(L"LoggingEnabled").value_or(0);
-    bool debugLoggingEnabled =
-        settings->GetInt(L"DebugLoggingEnabled").value_or(0);
+    m_settingsChangeTime = values.settingsChangeTime;
 
     m_loadedMod = std::make_unique<LoadedMod>(
-        m_modName.c_str(), m_modInstanceId.c_str(), libraryPath.c_str(),
-        loggingEnabled, debugLoggingEnabled);
+        m_modName.c_str(), libraryPath.c_str(), values.loggingEnabled,
+        values.debugLoggingEnabled, values.logLimits);
 
     SetStatus(L"Loading...");
 
@@ -2229,20 +3427,19 @@ void Mod::Uninitialize() {
     }
 }
 
-bool Mod::ApplyChangedSettings(bool* reload) {
+bool Mod::ApplyChangedSettings(const PortableSettings& settings,
+                               bool* reload) {
     *reload = false;
 
-    auto& storageManager = StorageManager::GetInstance();
-    auto settings = storageManager.GetModConfig(m_modName.c_str(), nullptr);
+    auto values = ModConfig::GetLoadedModValues(settings);
 
-    if (settings->GetString(L"LibraryFileName").value_or(L"") !=
-        m_libraryFileName) {
+    if (values.libraryFileName != m_libraryFileName) {
         *reload = true;
         return true;
     }
 
     int oldSettingsChangeTime = m_settingsChangeTime;
-    m_settingsChangeTime = settings->GetInt(L"SettingsChangeTime").value_or(0);
+    m_settingsChangeTime = values.settingsChangeTime;
 
     if (m_settingsChangeTime != oldSettingsChangeTime) {
         if (!m_loadedMod) {
@@ -2256,11 +3453,9 @@ bool Mod::ApplyChangedSettings(bool* reload) {
     }
 
     if (m_loadedMod) {
-        m_loadedMod->EnableLogging(
-            settings->GetInt(L"LoggingEnabled").value_or(0));
-
-        m_loadedMod->EnableDebugLogging(
-            settings->GetInt(L"DebugLoggingEnabled").value_or(0));
+        m_loadedMod->EnableLogging(values.loggingEnabled);
+        m_loadedMod->EnableDebugLogging(values.debugLoggingEnabled);
+        m_loadedMod->SetLogLimits(values.logLimits);
     }
 
     return true;
@@ -2275,64 +3470,41 @@ HMODULE Mod::GetLoadedModModuleHandle() {
     return m_loadedMod ? m_loadedMod->GetModModuleHandle() : nullptr;
 }
 
+void Mod::UpdateHookCallCounts() {
+    if (m_loadedMod) {
+        m_loadedMod->UpdateHookCallCounts();
+    }
+}
+
 // static
 bool Mod::ShouldLoadInRunningProcess(PCWSTR modName) {
     auto settings =
         StorageManager::GetInstance().GetModConfig(modName, nullptr);
 
-    if (settings->GetInt(L"Disabled").value_or(0)) {
-        return false;
-    }
-
-    auto architecturePattern =
-        settings->GetString(L"Architecture").value_or(L"");
-    if (!architecturePattern.empty() &&
-        !DoesArchitectureMatchPattern(architecturePattern)) {
-        return false;
-    }
-
-    bool patternsMatchCriticalSystemProcesses =
-        settings->GetInt(L"PatternsMatchCriticalSystemProcesses").value_or(0);
-
-    std::wstring processPath = wil::GetModuleFileName<std::wstring>();
-
-    bool includeExcludeCustomOnly =
-        settings->GetInt(L"IncludeExcludeCustomOnly").value_or(0);
-
-    bool matchPatternExplicitOnly =
-        !patternsMatchCriticalSystemProcesses &&
-        (Functions::DoesPathMatchPattern(processPath,
-                                         ProcessLists::kCriticalProcesses) ||
-         Functions::DoesPathMatchPattern(
-             processPath, ProcessLists::kCriticalProcessesForMods));
-
-    bool include =
-        (!includeExcludeCustomOnly &&
-         Functions::DoesPathMatchPattern(
-             processPath, settings->GetString(L"Include").value_or(L""),
-             matchPatternExplicitOnly)) ||
-        Functions::DoesPathMatchPattern(
-            processPath, settings->GetString(L"IncludeCustom").value_or(L""),
-            matchPatternExplicitOnly);
-
-    if (!include) {
-        return false;
-    }
+    return ShouldLoadInRunningProcess(*settings);
+}
 
-    bool exclude =
-        (!includeExcludeCustomOnly &&
-         Functions::DoesPathMatchPattern(
-             processPath, settings->GetString(L"Exclude").value_or(L""))) ||
-        Functions::DoesPathMatchPattern(
-            processPath, settings->GetString(L"ExcludeCustom").value_or(L""));
+// static
+bool Mod::ShouldLoadInRunningProcess(const PortableSettings& settings) {
+    ModConfig::PatternMatchers matchers;
+    return ShouldLoadInRunningProcess(settings, matchers);
+}
 
-    return !exclude;
+// static
+bool Mod::ShouldLoadInRunningProcess(const PortableSettings& settings,
+                                     ModConfig::PatternMatchers& matchers) {
+    ModConfig::Process process{
+        .path = GetProcessPathForMatching(),
+        .isCriticalForMods = IsCriticalProcessForMods(),
+    };
+    return ModConfig::ShouldLoadInProcess(settings, process, matchers);
 }
 
 void Mod::SetStatus(PCWSTR status) {
     try {
-        SetModMetadataValue(m_modStatusFile, status, L"mod-status",
-                            m_modInstanceId.c_str());
+        SetModStatusTableText(m_modStatusSlot, status,
+                              ModStatusTable::Kind::kStatus,
+                              m_modName.c_str());
     } catch (const std::exception& e) {
         LOG(L"%S", e.what());
     }
@@ -1,14 +1,22 @@
 #pragma once
 
+#include "dll_notification_dispatcher.h"
+#include "engine_metrics.h"
+#include "log_rate_limiter.h"
+#include "mod_config.h"
+#include "mod_log_record.h"
+#include "mod_status_table.h"
 #include "mods_api.h"
+#include "portable_settings.h"
+#include "table_hooks.h"
 
-class LoadedMod {
+class LoadedMod : private DllNotificationDispatcher::Listener {
    public:
     LoadedMod(PCWSTR modName,
-              PCWSTR modInstanceId,
               PCWSTR libraryPath,
               bool loggingEnabled,
-              bool debugLoggingEnabled);
+              bool debugLoggingEnabled,
+              const LogRateLimiter::Limits& logLimits);
     ~LoadedMod();
 
     // Disallow copy and move - we assume that the pointer of the class won't
@@ -22,9 +30,11 @@ class LoadedMod {
     void Uninitialize();
     void EnableLogging(bool enable);
     void EnableDebugLogging(bool enable);
+    void SetLogLimits(const LogRateLimiter::Limits& limits);
     bool SettingsChanged(bool* reload);
 
     HMODULE GetModModuleHandle();
+    void UpdateHookCallCounts();
 
     BOOL IsLogEnabled();
     void Log(PCWSTR format, va_list args);
@@ -40,19 +50,43 @@ class LoadedMod {
                         const void* buffer,
                         size_t bufferSize);
     BOOL DeleteValue(PCWSTR valueName);
+    BOOL BeginStorageBatch();
+    BOOL CommitStorageBatch();
+    BOOL SetStorageWriteBehind(DWORD flushDelay);
+    BOOL FlushStorage();
 
     size_t GetModStoragePath(PWSTR pathBuffer, size_t bufferChars);
 
     int GetIntSetting(PCWSTR valueName, va_list args);
     PCWSTR GetStringSetting(PCWSTR valueName, va_list args);
     void FreeStringSetting(PCWSTR string);
+    const WH_SETTINGS_SNAPSHOT* CreateSettingsSnapshot();
+    const WH_SETTING* FindSetting(const WH_SETTINGS_SNAPSHOT* snapshot,
+                                  PCWSTR valueName,
+                                  va_list args);
+    void FreeSettingsSnapshot(const WH_SETTINGS_SNAPSHOT* snapshot);
 
     BOOL SetFunctionHook(void* targetFunction,
                          void* hookFunction,
-                         void** originalFunction);
+                         void** originalFunction,
+                         PCWSTR targetName = nullptr);
     BOOL RemoveFunctionHook(void* targetFunction);
     BOOL ApplyHookOperations();
 
+    BOOL SetImportHook(HMODULE module,
+                       PCSTR importModuleName,
+                       PCSTR functionName,
+                       void* hookFunction,
+                       void** originalFunction);
+    BOOL RemoveImportHook(HMODULE module,
+                          PCSTR importModuleName,
+                          PCSTR functionName);
+    BOOL SetExportHook(HMODULE module,
+                       PCSTR functionName,
+                       void* hookFunction,
+                       void** originalFunction);
+    BOOL RemoveExportHook(HMODULE module, PCSTR functionName);
+
     HANDLE FindFirstSymbol(HMODULE hModule,
                            PCWSTR symbolServer,
                            BYTE* findData);
@@ -74,6 +108,8 @@ class LoadedMod {
                      size_t symbolHooksCount,
                      const WH_HOOK_SYMBOLS_OPTIONS* options);
 
+    BOOL SetModuleLoadHooks(const WH_MODULE_LOAD_HOOKS* hooks);
+
     BOOL Disasm(void* address, WH_DISASM_RESULT* result);
 
     const WH_URL_CONTENT* GetUrlContent(
@@ -82,14 +118,103 @@ class LoadedMod {
     void FreeUrlContent(const WH_URL_CONTENT* content);
 
    private:
+    struct HookedFunction {
+        void* targetFunction;
+        std::wstring targetName;
+        UINT64 lastCallCount;
+        // Claimed once the function is called.
+        std::unique_ptr<ModStatusTable::Slot> slot;
+    };
+
+    // A table hook, enabled or disabled when hook operations are applied.
+    struct QueuedTableHook {
+        std::unique_ptr<TableHook> hook;
+        bool queueEnable;
+    };
+
+    BOOL SetTableHook(std::unique_ptr<TableHook> tableHook);
+    BOOL QueueRemoveTableHook(void* entry);
+    void ApplyTableHooks();
+    void RemoveAllTableHooks();
+
+    using SymbolHookName =
+        std::remove_cvref_t<decltype(*std::declval<WH_SYMBOL_HOOK>().symbols)>;
+
+    // A copy of the data passed to SetModuleLoadHooks.
+    struct ModuleLoadHooks {
+        std::wstring moduleName;
+        std::vector<std::string> exportNames;
+        std::vector<WH_EXPORT_HOOK> exportHooks;
+        std::vector<std::vector<std::wstring>> symbolNameStrings;
+        std::vector<std::vector<SymbolHookName>> symbolNames;
+        std::vector<WH_SYMBOL_HOOK> symbolHooks;
+        std::optional<WH_HOOK_SYMBOLS_OPTIONS> hookSymbolsOptions;
+        std::optional<std::wstring> symbolServer;
+        std::optional<std::wstring> onlineCacheUrl;
+
+        // Modules for which the hooks were set. A reference is kept to make
+        // sure that the modules aren't unloaded while hooked.
+        std::vector<wil::unique_hmodule> hookedModules;
+        // Full paths of modules for which setting the hooks failed, to avoid
+        // retrying every time the module is loaded.
+        std::unordered_set<std::wstring> failedModulePaths;
+    };
+
+    void OnDllLoaded(void* dllBase,
+                     std::wstring_view baseDllName,
+                     std::wstring_view fullDllName) override;
+    void OnDllUnloaded(void* dllBase) override;
+    static void CALLBACK ModuleLoadWorkCallback(PTP_CALLBACK_INSTANCE instance,
+                                                PVOID context,
+                                                PTP_WORK work);
+    void HandleLoadedModules();
+    bool SetHooksForModule(ModuleLoadHooks& moduleLoadHooks, HMODULE module);
+    void StopModuleLoadHooks();
+
+    // Value names are compared case-insensitively, like the underlying
+    // storage does. Numbers in names are compared by value, so that array
+    // items are ordered by index.
+    struct SettingNameLess {
+        using is_transparent = void;
+        bool operator()(std::wstring_view a, std::wstring_view b) const;
+    };
+
+    using SettingsSnapshot =
+        std::map<std::wstring, std::wstring, SettingNameLess>;
+
+    std::shared_ptr<const SettingsSnapshot> GetSettingsSnapshot();
+
+    // A local storage value which wasn't written yet. std::monostate means
+    // that the value is deleted.
+    using StorageValue =
+        std::variant<std::monostate, int, std::wstring, std::vector<BYTE>>;
+
+    bool QueueStorageWrite(PCWSTR valueName, StorageValue value);
+    std::optional<StorageValue> GetQueuedStorageWrite(PCWSTR valueName);
+    void WriteQueuedStorageValues();
+    static void CALLBACK StorageFlushTimerCallback(
+        PTP_CALLBACK_INSTANCE instance,
+        PVOID context,
+        PTP_TIMER timer);
+    void StopStorageWriteBehind();
+
     void SetTask(PCWSTR task);
     void LogFunctionError(const std::exception& e);
+    void ReportSuppressedLogMessages(DWORD count);
+    void AddHookedFunction(void* targetFunction, PCWSTR targetName);
+    // Returns nullptr if no row is available. Must be called with
+    // m_hookedFunctionsMutex held.
+    std::unique_ptr<ModStatusTable::Slot> ClaimHookCallsRow(
+        const std::wstring& targetName,
+        UINT64 callCount);
 
     std::wstring m_modName;
-    std::wstring m_modInstanceId;
-    wil::unique_hfile m_modTaskFile;
+    std::optional<ModStatusTable::Slot> m_modTaskSlot;
     std::atomic<bool> m_loggingEnabled = false;
     std::atomic<bool> m_debugLoggingEnabled = false;
+    LogRateLimiter m_logRateLimiter;
+    ModLogRecordWriter m_logRecordWriter;
+    EngineMetrics m_metrics;
     std::atomic<bool> m_initialized = false;
     std::atomic<bool> m_uninitializing = false;
 
@@ -99,6 +224,43 @@ class LoadedMod {
     // Temporary compatibility shim library.
     wil::unique_hmodule m_modShimLibrary;
 
+    // Only tracked if hook call counting is enabled.
+    std::mutex m_hookedFunctionsMutex;
+    std::vector<HookedFunction> m_hookedFunctions;
+    // Set if a hook calls row couldn't be claimed, in which case calls are
+    // only counted in the mod's metrics.
+    bool m_hookCallRowsUnavailable = false;
+
+    // An immutable copy of the mod's settings, loaded on first access and
+    // dropped when the settings change.
+    std::mutex m_settingsSnapshotMutex;
+    std::shared_ptr<const SettingsSnapshot> m_settingsSnapshot;
+
+    // Local storage writes are queued while a batch is in progress, or if
+    // write-behind is enabled.
+    std::mutex m_storageMutex;
+    std::map<std::wstring, StorageValue, SettingNameLess>
+        m_queuedStorageWrites;
+    int m_storageBatchDepth = 0;
+    DWORD m_storageWriteBehindDelay = 0;
+    bool m_storageFlushScheduled = false;
+    wil::unique_threadpool_timer m_storageFlushTimer;
+
+    std::mutex m_tableHooksMutex;
+    std::vector<QueuedTableHook> m_tableHooks;
+
+    // Module load hooks. The registrations are only added, never removed, so
+    // pointers to them stay valid. m_moduleLoadHooksMutex is acquired by the
+    // loader notification callback, and must not be held while calling
+    // functions which might wait for the loader lock.
+    std::mutex m_moduleLoadHooksMutex;
+    std::vector<std::unique_ptr<ModuleLoadHooks>> m_moduleLoadHooks;
+    std::vector<void*> m_pendingLoadedModules;
+    bool m_listeningToDllNotifications = false;
+    // Serializes setting the hooks for loaded modules.
+    std::mutex m_moduleLoadHooksSetMutex;
+    wil::unique_threadpool_work m_moduleLoadWork;
+
     wil::unique_hmodule m_modModule;
 };
 
@@ -110,19 +272,23 @@ class Mod {
     void AfterInit();
     void BeforeUninit();
     void Uninitialize();
-    bool ApplyChangedSettings(bool* reload);
+    bool ApplyChangedSettings(const PortableSettings& settings, bool* reload);
     void Unload();
 
     HMODULE GetLoadedModModuleHandle();
+    void UpdateHookCallCounts();
 
     static bool ShouldLoadInRunningProcess(PCWSTR modName);
+    static bool ShouldLoadInRunningProcess(const PortableSettings& settings);
+    static bool ShouldLoadInRunningProcess(
+        const PortableSettings& settings,
+        ModConfig::PatternMatchers& matchers);
 
    private:
     void SetStatus(PCWSTR status);
 
     std::wstring m_modName;
-    std::wstring m_modInstanceId;
-    wil::unique_hfile m_modStatusFile;
+    std::optional<ModStatusTable::Slot> m_modStatusSlot;
     std::wstring m_libraryFileName;
     int m_settingsChangeTime = 0;
     std::unique_ptr<LoadedMod> m_loadedMod;
@@ -0,0 +1,129 @@
+#include "stdafx.h"
+
+#include "functions.h"
+#include "mod_config.h"
+
+namespace {
+
+bool DoesArchitectureMatchPatternPart(std::wstring_view patternPart) {
+#if defined(_M_IX86)
+    if (patternPart == L"x86") {
+        return true;
+    }
+#elif defined(_M_X64)
+    // For now, x86-64 matches both x64 and ARM64.
+    if (patternPart == L"x86-64" || patternPart == L"amd64") {
+        return true;
+    }
+#elif defined(_M_ARM64)
+    // For now, x86-64 matches both x64 and ARM64.
+    if (patternPart == L"x86-64" || patternPart == L"arm64") {
+        return true;
+    }
+#else
+#error "Unsupported architecture"
+#endif
+
+    return false;
+}
+
+}  // namespace
+
+namespace ModConfig {
+
+bool DoesArchitectureMatchPattern(std::wstring_view pattern) {
+    for (const auto& patternPart :
+         Functions::SplitStringToViews(pattern, L'|')) {
+        if (DoesArchitectureMatchPatternPart(patternPart)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const PathPatternMatcher& CachedPathPatternMatcher::Get(
+    std::wstring_view pattern) {
+    if (pattern != m_pattern) {
+        m_matcher = PathPatternMatcher(pattern);
+        m_pattern = pattern;
+    }
+
+    return m_matcher;
+}
+
+bool ShouldLoadInProcess(const PortableSettings& settings,
+                         const Process& process,
+                         PatternMatchers& matchers) {
+    if (settings.GetInt(L"Disabled").value_or(0)) {
+        return false;
+    }
+
+    auto architecturePattern =
+        settings.GetString(L"Architecture").value_or(L"");
+    if (!architecturePattern.empty() &&
+        !DoesArchitectureMatchPattern(architecturePattern)) {
+        return false;
+    }
+
+    bool patternsMatchCriticalSystemProcesses =
+        settings.GetInt(L"PatternsMatchCriticalSystemProcesses").value_or(0);
+
+    bool includeExcludeCustomOnly =
+        settings.GetInt(L"IncludeExcludeCustomOnly").value_or(0);
+
+    bool matchPatternExplicitOnly =
+        !patternsMatchCriticalSystemProcesses && process.isCriticalForMods;
+
+    auto matches = [&settings, &process](CachedPathPatternMatcher& matcher,
+                                         PCWSTR valueName, bool explicitOnly) {
+        return matcher.Get(settings.GetString(valueName).value_or(L""))
+            .Matches(process.path, explicitOnly);
+    };
+
+    bool include = (!includeExcludeCustomOnly &&
+                    matches(matchers.include, L"Include",
+                            matchPatternExplicitOnly)) ||
+                   matches(matchers.includeCustom, L"IncludeCustom",
+                           matchPatternExplicitOnly);
+
+    if (!include) {
+        return false;
+    }
+
+    bool exclude =
+        (!includeExcludeCustomOnly &&
+         matches(matchers.exclude, L"Exclude", /*explicitOnly=*/false)) ||
+        matches(matchers.excludeCustom, L"ExcludeCustom",
+                /*explicitOnly=*/false);
+
+    return !exclude;
+}
+
+bool ShouldLoadInProcess(const PortableSettings& settings,
+                         const Process& process) {
+    PatternMatchers matchers;
+    return ShouldLoadInProcess(settings, process, matchers);
+}
+
+LoadedModValues GetLoadedModValues(const PortableSettings& settings) {
+    auto getLimit = [&settings](PCWSTR valueName) {
+        return static_cast<DWORD>(
+            std::max(settings.GetInt(valueName).value_or(0), 0));
+    };
+
+    LoadedModValues values;
+    values.libraryFileName =
+        settings.GetString(L"LibraryFileName").value_or(L"");
+    values.settingsChangeTime =
+        settings.GetInt(L"SettingsChangeTime").value_or(0);
+    values.loggingEnabled = settings.GetInt(L"LoggingEnabled").value_or(0);
+    values.debugLoggingEnabled =
+        settings.GetInt(L"DebugLoggingEnabled").value_or(0);
+    values.logLimits.rate = getLimit(L"LogRateLimit");
+    values.logLimits.burst = getLimit(L"LogRateLimitBurst");
+    values.logLimits.sampling = getLimit(L"LogSampling");
+    return values;
+}
+
+}  // namespace ModConfig
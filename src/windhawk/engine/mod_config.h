@@ -0,0 +1,59 @@
+#pragma once
+
+#include "log_rate_limiter.h"
+#include "path_pattern_matcher.h"
+#include "portable_settings.h"
+
+// Decisions made from the config of a mod. They only depend on the config and
+// on the given process, so that they can be tested without loading mods.
+namespace ModConfig {
+
+// The process in which the mod might be loaded.
+struct Process {
+    const PathPatternMatcher::Path& path;
+    // Critical processes are only matched by patterns without wildcards,
+    // unless the mod sets PatternsMatchCriticalSystemProcesses.
+    bool isCriticalForMods;
+};
+
+// The values a loaded mod depends on. A change of the library requires
+// reloading the mod, the other values are applied to the loaded mod.
+struct LoadedModValues {
+    std::wstring libraryFileName;
+    int settingsChangeTime;
+    bool loggingEnabled;
+    bool debugLoggingEnabled;
+    LogRateLimiter::Limits logLimits;
+};
+
+// A matcher which is only compiled again when its pattern changes.
+class CachedPathPatternMatcher {
+   public:
+    const PathPatternMatcher& Get(std::wstring_view pattern);
+
+   private:
+    std::wstring m_pattern;
+    PathPatternMatcher m_matcher;
+};
+
+// The matchers of the include and exclude patterns of a mod, which are kept
+// between reloads. Compiling a pattern expands environment variables and
+// builds automatons, while reading it from the config to see whether it
+// changed is cheap.
+struct PatternMatchers {
+    CachedPathPatternMatcher include;
+    CachedPathPatternMatcher includeCustom;
+    CachedPathPatternMatcher exclude;
+    CachedPathPatternMatcher excludeCustom;
+};
+
+bool DoesArchitectureMatchPattern(std::wstring_view pattern);
+bool ShouldLoadInProcess(const PortableSettings& settings,
+                         const Process& process,
+                         PatternMatchers& matchers);
+// Compiles the patterns for a single check.
+bool ShouldLoadInProcess(const PortableSettings& settings,
+                         const Process& process);
+LoadedModValues GetLoadedModValues(const PortableSettings& settings);
+
+}  // namespace ModConfig
@@ -0,0 +1,1028 @@
+#include "stdafx.h"
+
+#include "functions.h"
+#include "log_ring_buffer.h"
+#include "mod_log_record.h"
+#include "var_init_once.h"
+
+namespace {
+
+// A format record starts with this header, followed by the mod name and the
+// format string.
+struct FormatRecordHeader {
+    DWORD processId;
+    DWORD formatId;
+    FILETIME processCreationTime;
+    // The pointer size of the writing process, which determines the size of
+    // arguments such as %p and %zu.
+    WORD pointerSize;
+    WORD modNameLength;
+    DWORD formatLength;
+};
+
+// A message record starts with this header, followed by the arguments.
+struct MessageRecordHeader {
+    FILETIME timestamp;
+    FILETIME processCreationTime;
+    DWORD processId;
+    DWORD threadId;
+    DWORD formatId;
+};
+
+// Messages are truncated to this length, like messages which are formatted in
+// place.
+constexpr size_t kMaxMessageLength = 1024;
+constexpr size_t kMaxModNameLength = 128;
+constexpr int kMaxWidth = static_cast<int>(kMaxMessageLength);
+constexpr size_t kMaxConversions = 64;
+constexpr size_t kMaxFormatsPerMod = 1024;
+constexpr size_t kMaxFormatsPerProcess = 16384;
+// The formats of the least recently used process are dropped when a new
+// process is added beyond this limit, e.g. of processes which exited.
+constexpr size_t kMaxProcesses = 256;
+
+// String arguments are stored with a length prefix, this length means that
+// the string is null.
+constexpr WORD kNullStringLength = 0xFFFF;
+static_assert(kMaxMessageLength < kNullStringLength);
+
+enum class ArgKind : BYTE {
+    // A literal percent sign, which has no argument.
+    kNone,
+    kInt32,
+    kInt64,
+    kDouble,
+    kPointer32,
+    kPointer64,
+    kWideString,
+    kAnsiString,
+};
+
+struct Conversion {
+    // The position and the length of the conversion in the format string.
+    size_t offset;
+    size_t length;
+    // The flags follow the percent sign.
+    size_t flagsLength;
+    // -1 if not specified.
+    int width;
+    int precision;
+    bool widthFromArg;
+    bool precisionFromArg;
+    bool isUnsigned;
+    ArgKind kind;
+    // The size prefix and the type character to format the argument with,
+    // which don't depend on the pointer size of the formatting process. Not
+    // used for pointers.
+    WCHAR type[4];
+};
+
+size_t GetArgSize(ArgKind kind) {
+    switch (kind) {
+        case ArgKind::kNone:
+            return 0;
+
+        case ArgKind::kInt32:
+        case ArgKind::kPointer32:
+            return sizeof(DWORD);
+
+        case ArgKind::kInt64:
+        case ArgKind::kPointer64:
+            return sizeof(ULONGLONG);
+
+        case ArgKind::kDouble:
+            return sizeof(double);
+
+        case ArgKind::kWideString:
+        case ArgKind::kAnsiString:
+            // The length prefix.
+            return sizeof(WORD);
+    }
+
+    return 0;
+}
+
+int ParseNumber(std::wstring_view format, size_t* position) {
+    int value = 0;
+    while (*position < format.length() && format[*position] >= L'0' &&
+           format[*position] <= L'9') {
+        value = std::min(value * 10 + (format[*position] - L'0'), kMaxWidth);
+        (*position)++;
+    }
+
+    return value;
+}
+
+// Parses a printf-style format string, as supported by the Microsoft CRT.
+// Returns false if the format string has conversions which can't be deferred,
+// such as %n and %Z, or conversions which are invalid.
+bool ParseFormat(std::wstring_view format,
+                 size_t pointerSize,
+                 std::vector<Conversion>* conversions) {
+    enum class Size {
+        kDefault,
+        kChar,
+        kShort,
+        kLong,
+        kLongLong,
+        kLongDouble,
+        kWide,
+        kInt32,
+        kInt64,
+        kIntPtr,
+    };
+
+    auto charAt = [format](size_t position) {
+        return position < format.length() ? format[position] : L'\0';
+    };
+
+    conversions->clear();
+
+    for (size_t i = 0; i < format.length(); i++) {
+        if (format[i] != L'%') {
+            continue;
+        }
+
+        if (conversions->size() == kMaxConversions) {
+            return false;
+        }
+
+        Conversion conversion{};
+        conversion.offset = i;
+        conversion.width = -1;
+        conversion.precision = -1;
+
+        size_t p = i + 1;
+        while (charAt(p) != L'\0' && wcschr(L"-+ #0", charAt(p))) {
+            p++;
+        }
+
+        conversion.flagsLength = p - (i + 1);
+
+        if (charAt(p) == L'*') {
+            conversion.widthFromArg = true;
+            p++;
+        } else if (charAt(p) >= L'0' && charAt(p) <= L'9') {
+            conversion.width = ParseNumber(format, &p);
+        }
+
+        if (charAt(p) == L'.') {
+            p++;
+            if (charAt(p) == L'*') {
+                conversion.precisionFromArg = true;
+                p++;
+            } else {
+                conversion.precision = ParseNumber(format, &p);
+            }
+        }
+
+        Size size = Size::kDefault;
+        switch (charAt(p)) {
+            case L'h':
+                p++;
+                size = Size::kShort;
+                if (charAt(p) == L'h') {
+                    p++;
+                    size = Size::kChar;
+                }
+                break;
+
+            case L'l':
+                p++;
+                size = Size::kLong;
+                if (charAt(p) == L'l') {
+                    p++;
+                    size = Size::kLongLong;
+                }
+                break;
+
+            case L'L':
+                p++;
+                size = Size::kLongDouble;
+                break;
+
+            case L'w':
+                p++;
+                size = Size::kWide;
+                break;
+
+            case L'j':
+                p++;
+                size = Size::kInt64;
+                break;
+
+            case L'z':
+            case L't':
+                p++;
+                size = Size::kIntPtr;
+                break;
+
+            case L'I':
+                p++;
+                size = Size::kIntPtr;
+                if (charAt(p) == L'3' && charAt(p + 1) == L'2') {
+                    p += 2;
+                    size = Size::kInt32;
+                } else if (charAt(p) == L'6' && charAt(p + 1) == L'4') {
+                    p += 2;
+                    size = Size::kInt64;
+                }
+                break;
+        }
+
+        WCHAR type = charAt(p);
+        PCWSTR prefix = L"";
+
+        switch (type) {
+            case L'%':
+                conversion.kind = ArgKind::kNone;
+                break;
+
+            case L'd':
+            case L'i':
+            case L'o':
+            case L'u':
+            case L'x':
+            case L'X':
+                conversion.isUnsigned = type != L'd' && type != L'i';
+                switch (size) {
+                    case Size::kDefault:
+                    case Size::kLong:
+                    case Size::kInt32:
+                        conversion.kind = ArgKind::kInt32;
+                        break;
+
+                    case Size::kShort:
+                        conversion.kind = ArgKind::kInt32;
+                        prefix = L"h";
+                        break;
+
+                    case Size::kChar:
+                        conversion.kind = ArgKind::kInt32;
+                        prefix = L"hh";
+                        break;
+
+                    case Size::kLongLong:
+                    case Size::kInt64:
+                        conversion.kind = ArgKind::kInt64;
+                        prefix = L"ll";
+                        break;
+
+                    case Size::kIntPtr:
+                        if (pointerSize == sizeof(ULONGLONG)) {
+                            conversion.kind = ArgKind::kInt64;
+                            prefix = L"ll";
+                        } else {
+                            conversion.kind = ArgKind::kInt32;
+                        }
+                        break;
+
+                    default:
+                        return false;
+                }
+                break;
+
+            case L'c':
+            case L'C': {
+                // In wide functions, %c is a wide character and %C is a
+                // narrow one, unless a size prefix is specified.
+                bool wide;
+                if (size == Size::kDefault) {
+                    wide = type == L'c';
+                } else if (size == Size::kLong || size == Size::kWide) {
+                    wide = true;
+                } else if (size == Size::kShort) {
+                    wide = false;
+                } else {
+                    return false;
+                }
+
+                conversion.kind = ArgKind::kInt32;
+                conversion.isUnsigned = true;
+                prefix = wide ? L"l" : L"h";
+                type = L'c';
+                break;
+            }
+
+            case L'e':
+            case L'E':
+            case L'f':
+            case L'F':
+            case L'g':
+            case L'G':
+            case L'a':
+            case L'A':
+                if (size != Size::kDefault && size != Size::kLong &&
+                    size != Size::kLongDouble) {
+                    return false;
+                }
+
+                conversion.kind = ArgKind::kDouble;
+                break;
+
+            case L's':
+            case L'S': {
+                // Same as for characters.
+                bool wide;
+                if (size == Size::kDefault) {
+                    wide = type == L's';
+                } else if (size == Size::kLong || size == Size::kWide) {
+                    wide = true;
+                } else if (size == Size::kShort) {
+                    wide = false;
+                } else {
+                    return false;
+                }
+
+                conversion.kind =
+                    wide ? ArgKind::kWideString : ArgKind::kAnsiString;
+                prefix = wide ? L"l" : L"h";
+                type = L's';
+                break;
+            }
+
+            case L'p':
+                if (size != Size::kDefault) {
+                    return false;
+                }
+
+                conversion.kind = pointerSize == sizeof(ULONGLONG)
+                                      ? ArgKind::kPointer64
+                                      : ArgKind::kPointer32;
+                conversion.isUnsigned = true;
+                break;
+
+            default:
+                return false;
+        }
+
+        p++;
+
+        wcscpy_s(conversion.type, prefix);
+        size_t prefixLength = wcslen(conversion.type);
+        conversion.type[prefixLength] = type;
+        conversion.type[prefixLength + 1] = L'\0';
+
+        conversion.length = p - i;
+        conversions->push_back(conversion);
+
+        i = p - 1;
+    }
+
+    return true;
+}
+
+void GetCurrentTimestamp(FILETIME* timestamp) {
+    using GetSystemTimePreciseAsFileTime_t = VOID(WINAPI*)(LPFILETIME);
+    GET_PROC_ADDRESS_ONCE(GetSystemTimePreciseAsFileTime_t,
+                          pGetSystemTimePreciseAsFileTime, L"kernel32.dll",
+                          "GetSystemTimePreciseAsFileTime");
+
+    if (pGetSystemTimePreciseAsFileTime) {
+        pGetSystemTimePreciseAsFileTime(timestamp);
+    } else {
+        GetSystemTimeAsFileTime(timestamp);
+    }
+}
+
+FILETIME GetProcessCreationTimeUncached() {
+    FILETIME creationTime{};
+    FILETIME exitTime;
+    FILETIME kernelTime;
+    FILETIME userTime;
+    GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime,
+                    &userTime);
+    return creationTime;
+}
+
+// Together with the process id, identifies the process, since process ids are
+// reused.
+FILETIME GetProcessCreationTime() {
+    STATIC_INIT_ONCE_TRIVIAL(FILETIME, creationTime,
+                             GetProcessCreationTimeUncached());
+    return creationTime;
+}
+
+std::wstring AnsiToWide(std::string_view s) {
+    int size = MultiByteToWideChar(CP_ACP, 0, s.data(),
+                                   static_cast<int>(s.length()), nullptr, 0);
+    std::wstring result(size, L'\0');
+    MultiByteToWideChar(CP_ACP, 0, s.data(), static_cast<int>(s.length()),
+                        result.data(), size);
+    return result;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// ModLogRecordWriter
+
+struct ModLogRecordWriter::Format {
+    DWORD id;
+    std::vector<Conversion> conversions;
+    // The size of the arguments, excluding the contents of strings.
+    size_t fixedArgsSize;
+};
+
+std::atomic<DWORD> ModLogRecordWriter::m_lastFormatId;
+
+ModLogRecordWriter::ModLogRecordWriter(std::wstring_view modName)
+    : m_modName(modName.substr(0, kMaxModNameLength)) {}
+
+ModLogRecordWriter::~ModLogRecordWriter() = default;
+
+bool ModLogRecordWriter::Write(LogRingBuffer& ringBuffer,
+                               PCWSTR format,
+                               va_list args) {
+    bool dropped = false;
+    const Format* parsedFormat = GetFormat(ringBuffer, format, &dropped);
+    if (!parsedFormat) {
+        return dropped;
+    }
+
+    MessageRecordHeader header;
+    GetCurrentTimestamp(&header.timestamp);
+    header.processCreationTime = GetProcessCreationTime();
+    header.processId = GetCurrentProcessId();
+    header.threadId = GetCurrentThreadId();
+    header.formatId = parsedFormat->id;
+
+    BYTE record[LogRingBuffer::kMaxRecordSize];
+    size_t recordSize = 0;
+    auto append = [&record, &recordSize](const void* data, size_t size) {
+        memcpy(record + recordSize, data, size);
+        recordSize += size;
+    };
+
+    append(&header, sizeof(header));
+
+    // Strings are truncated to fit in the record.
+    size_t stringsBudget =
+        sizeof(record) - sizeof(header) - parsedFormat->fixedArgsSize;
+
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+
+    for (const auto& conversion : parsedFormat->conversions) {
+        if (conversion.widthFromArg) {
+            int width = va_arg(argsCopy, int);
+            append(&width, sizeof(width));
+        }
+
+        int precision = conversion.precision;
+        if (conversion.precisionFromArg) {
+            precision = va_arg(argsCopy, int);
+            append(&precision, sizeof(precision));
+        }
+
+        switch (conversion.kind) {
+            case ArgKind::kNone:
+                break;
+
+            case ArgKind::kInt32: {
+                int value = va_arg(argsCopy, int);
+                append(&value, sizeof(value));
+                break;
+            }
+
+            case ArgKind::kInt64: {
+                INT64 value = va_arg(argsCopy, INT64);
+                append(&value, sizeof(value));
+                break;
+            }
+
+            case ArgKind::kDouble: {
+                double value = va_arg(argsCopy, double);
+                append(&value, sizeof(value));
+                break;
+            }
+
+            case ArgKind::kPointer32: {
+                DWORD value = static_cast<DWORD>(
+                    reinterpret_cast<ULONG_PTR>(va_arg(argsCopy, void*)));
+                append(&value, sizeof(value));
+                break;
+            }
+
+            case ArgKind::kPointer64: {
+                ULONGLONG value = static_cast<ULONGLONG>(
+                    reinterpret_cast<ULONG_PTR>(va_arg(argsCopy, void*)));
+                append(&value, sizeof(value));
+                break;
+            }
+
+            case ArgKind::kWideString:
+            case ArgKind::kAnsiString: {
+                bool wide = conversion.kind == ArgKind::kWideString;
+                size_t charSize = wide ? sizeof(WCHAR) : sizeof(char);
+                const void* value = va_arg(argsCopy, const void*);
+
+                WORD length = kNullStringLength;
+                if (value) {
+                    // The string doesn't have to be null-terminated if a
+                    // precision is specified.
+                    size_t maxLength =
+                        std::min(kMaxMessageLength, stringsBudget / charSize);
+                    if (precision >= 0) {
+                        maxLength =
+                            std::min(maxLength, static_cast<size_t>(precision));
+                    }
+
+                    length = static_cast<WORD>(
+                        wide ? wcsnlen(static_cast<PCWSTR>(value), maxLength)
+                             : strnlen(static_cast<PCSTR>(value), maxLength));
+                    stringsBudget -= length * charSize;
+                }
+
+                append(&length, sizeof(length));
+                if (value) {
+                    append(value, length * charSize);
+                }
+                break;
+            }
+        }
+    }
+
+    va_end(argsCopy);
+
+    ringBuffer.Write(LogRingBuffer::RecordType::kModLogMessage,
+                     std::span(record, recordSize));
+    return true;
+}
+
+const ModLogRecordWriter::Format* ModLogRecordWriter::GetFormat(
+    LogRingBuffer& ringBuffer,
+    PCWSTR format,
+    bool* dropped) {
+    {
+        std::shared_lock lock(m_formatsMutex);
+        auto it = m_formats.find(format);
+        if (it != m_formats.end()) {
+            return it->second.get();
+        }
+    }
+
+    std::lock_guard lock(m_formatsMutex);
+
+    auto it = m_formats.find(format);
+    if (it != m_formats.end()) {
+        return it->second.get();
+    }
+
+    if (m_formats.size() >= kMaxFormatsPerMod) {
+        return nullptr;
+    }
+
+    // The format string is truncated to fit in the record. The truncated
+    // string is the one which is parsed, so that the decoder sees the same
+    // conversions.
+    size_t maxFormatLength =
+        (LogRingBuffer::kMaxRecordSize - sizeof(FormatRecordHeader)) /
+            sizeof(WCHAR) -
+        m_modName.length();
+    std::wstring_view formatView(format, wcsnlen(format, maxFormatLength));
+
+    auto parsedFormat = std::make_unique<Format>();
+    if (!ParseFormat(formatView, sizeof(void*), &parsedFormat->conversions)) {
+        m_formats.try_emplace(format, nullptr);
+        return nullptr;
+    }
+
+    parsedFormat->fixedArgsSize = 0;
+    for (const auto& conversion : parsedFormat->conversions) {
+        parsedFormat->fixedArgsSize +=
+            (conversion.widthFromArg ? sizeof(int) : 0) +
+            (conversion.precisionFromArg ? sizeof(int) : 0) +
+            GetArgSize(conversion.kind);
+    }
+
+    parsedFormat->id = ++m_lastFormatId;
+
+    FormatRecordHeader header;
+    header.processId = GetCurrentProcessId();
+    header.formatId = parsedFormat->id;
+    header.processCreationTime = GetProcessCreationTime();
+    header.pointerSize = sizeof(void*);
+    header.modNameLength = static_cast<WORD>(m_modName.length());
+    header.formatLength = static_cast<DWORD>(formatView.length());
+
+    std::vector<BYTE> record(sizeof(header) +
+                             (m_modName.length() + formatView.length()) *
+                                 sizeof(WCHAR));
+    BYTE* p = record.data();
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, m_modName.data(), m_modName.length() * sizeof(WCHAR));
+    p += m_modName.length() * sizeof(WCHAR);
+    memcpy(p, formatView.data(), formatView.length() * sizeof(WCHAR));
+
+    if (!ringBuffer.Write(LogRingBuffer::RecordType::kModLogFormat, record)) {
+        // The buffer is full, the message is dropped and the format is
+        // registered again next time.
+        *dropped = true;
+        return nullptr;
+    }
+
+    return m_formats.try_emplace(format, std::move(parsedFormat))
+        .first->second.get();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ModLogRecordDecoder
+
+struct ModLogRecordDecoder::Format {
+    std::wstring modName;
+    std::wstring format;
+    std::vector<Conversion> conversions;
+};
+
+ModLogRecordDecoder::ModLogRecordDecoder() = default;
+
+ModLogRecordDecoder::~ModLogRecordDecoder() = default;
+
+bool ModLogRecordDecoder::AddFormat(std::span<const BYTE> record) {
+    FormatRecordHeader header;
+    if (record.size() < sizeof(header)) {
+        return false;
+    }
+
+    memcpy(&header, record.data(), sizeof(header));
+    record = record.subspan(sizeof(header));
+
+    if ((header.pointerSize != sizeof(DWORD) &&
+         header.pointerSize != sizeof(ULONGLONG)) ||
+        header.modNameLength > kMaxModNameLength ||
+        header.formatLength > LogRingBuffer::kMaxRecordSize ||
+        record.size() !=
+            (size_t{header.modNameLength} + header.formatLength) *
+                sizeof(WCHAR)) {
+        return false;
+    }
+
+    auto format = std::make_unique<Format>();
+
+    format->modName.resize(header.modNameLength);
+    memcpy(format->modName.data(), record.data(),
+           header.modNameLength * sizeof(WCHAR));
+    record = record.subspan(header.modNameLength * sizeof(WCHAR));
+
+    format->format.resize(header.formatLength);
+    memcpy(format->format.data(), record.data(),
+           header.formatLength * sizeof(WCHAR));
+
+    if (!ParseFormat(format->format, header.pointerSize,
+                     &format->conversions)) {
+        return false;
+    }
+
+    ProcessKey processKey{
+        .processId = header.processId,
+        .creationTime = wil::filetime::to_int64(header.processCreationTime),
+    };
+
+    auto processIt = m_processFormats.find(processKey);
+    if (processIt == m_processFormats.end()) {
+        if (m_processFormats.size() >= kMaxProcesses) {
+            EvictLeastRecentlyUsedProcess();
+        }
+
+        processIt = m_processFormats.try_emplace(processKey).first;
+    }
+
+    auto& processFormats = processIt->second;
+    processFormats.lastUse = ++m_useCounter;
+
+    if (processFormats.formats.size() >= kMaxFormatsPerProcess &&
+        !processFormats.formats.contains(header.formatId)) {
+        return false;
+    }
+
+    processFormats.formats[header.formatId] = std::move(format);
+    return true;
+}
+
+std::optional<ModLogRecordDecoder::Message> ModLogRecordDecoder::Decode(
+    std::span<const BYTE> record) {
+    MessageRecordHeader header;
+    if (record.size() < sizeof(header)) {
+        return std::nullopt;
+    }
+
+    memcpy(&header, record.data(), sizeof(header));
+    record = record.subspan(sizeof(header));
+
+    auto processIt = m_processFormats.find({
+        .processId = header.processId,
+        .creationTime = wil::filetime::to_int64(header.processCreationTime),
+    });
+    if (processIt == m_processFormats.end()) {
+        return std::nullopt;
+    }
+
+    auto& processFormats = processIt->second;
+    processFormats.lastUse = ++m_useCounter;
+
+    auto formatIt = processFormats.formats.find(header.formatId);
+    if (formatIt == processFormats.formats.end()) {
+        return std::nullopt;
+    }
+
+    const Format& format = *formatIt->second;
+
+    Message message{
+        .timestamp = header.timestamp,
+        .processId = header.processId,
+        .threadId = header.threadId,
+        .modName = format.modName,
+        .format = format.format,
+    };
+
+    auto read = [&record](void* value, size_t size) {
+        if (record.size() < size) {
+            return false;
+        }
+
+        memcpy(value, record.data(), size);
+        record = record.subspan(size);
+        return true;
+    };
+
+    WCHAR buffer[kMaxMessageLength + 1];
+    size_t literalBegin = 0;
+
+    for (const auto& conversion : format.conversions) {
+        message.text.append(format.format, literalBegin,
+                            conversion.offset - literalBegin);
+        literalBegin = conversion.offset + conversion.length;
+
+        if (conversion.kind == ArgKind::kNone) {
+            message.text += L'%';
+            continue;
+        }
+
+        // Build a conversion with the values of width and precision
+        // arguments, and a size prefix which matches the stored value.
+        std::wstring spec = L"%";
+        spec.append(format.format, conversion.offset + 1,
+                    conversion.flagsLength);
+
+        int width = conversion.width;
+        if (conversion.widthFromArg) {
+            if (!read(&width, sizeof(width))) {
+                return std::nullopt;
+            }
+
+            // A negative width is a left-justify flag followed by a positive
+            // width.
+            if (width < 0) {
+                spec += L'-';
+                width = width < -kMaxWidth ? kMaxWidth : -width;
+            }
+
+            width = std::min(width, kMaxWidth);
+        }
+
+        if (width >= 0) {
+            spec += std::to_wstring(width);
+        }
+
+        int precision = conversion.precision;
+        if (conversion.precisionFromArg) {
+            if (!read(&precision, sizeof(precision))) {
+                return std::nullopt;
+            }
+
+            // A negative precision is ignored.
+            precision = precision < 0 ? -1 : std::min(precision, kMaxWidth);
+        }
+
+        if (precision >= 0) {
+            spec += L'.';
+            spec += std::to_wstring(precision);
+        }
+
+        spec += conversion.type;
+
+        buffer[0] = L'\0';
+
+        switch (conversion.kind) {
+            case ArgKind::kNone:
+                break;
+
+            case ArgKind::kInt32: {
+                int value;
+                if (!read(&value, sizeof(value))) {
+                    return std::nullopt;
+                }
+
+                _snwprintf_s(buffer, _TRUNCATE, spec.c_str(), value);
+                if (conversion.isUnsigned) {
+                    message.args.push_back(
+                        ULONGLONG{static_cast<DWORD>(value)});
+                } else {
+                    message.args.push_back(INT64{value});
+                }
+                break;
+            }
+
+            case ArgKind::kInt64: {
+                INT64 value;
+                if (!read(&value, sizeof(value))) {
+                    return std::nullopt;
+                }
+
+                _snwprintf_s(buffer, _TRUNCATE, spec.c_str(), value);
+                if (conversion.isUnsigned) {
+                    message.args.push_back(static_cast<ULONGLONG>(value));
+                } else {
+                    message.args.push_back(value);
+                }
+                break;
+            }
+
+            case ArgKind::kDouble: {
+                double value;
+                if (!read(&value, sizeof(value))) {
+                    return std::nullopt;
+                }
+
+                _snwprintf_s(buffer, _TRUNCATE, spec.c_str(), value);
+                message.args.push_back(value);
+                break;
+            }
+
+            // Pointers are formatted the way %p formats them in the writing
+            // process.
+            case ArgKind::kPointer32: {
+                DWORD value;
+                if (!read(&value, sizeof(value))) {
+                    return std::nullopt;
+                }
+
+                _snwprintf_s(buffer, _TRUNCATE, L"%08X", value);
+                message.args.push_back(ULONGLONG{value});
+                break;
+            }
+
+            case ArgKind::kPointer64: {
+                ULONGLONG value;
+                if (!read(&value, sizeof(value))) {
+                    return std::nullopt;
+                }
+
+                _snwprintf_s(buffer, _TRUNCATE, L"%016llX", value);
+                message.args.push_back(value);
+                break;
+            }
+
+            case ArgKind::kWideString: {
+                WORD length;
+                if (!read(&length, sizeof(length))) {
+                    return std::nullopt;
+                }
+
+                if (length == kNullStringLength) {
+                    _snwprintf_s(buffer, _TRUNCATE, spec.c_str(),
+                                 static_cast<PCWSTR>(nullptr));
+                    message.args.push_back(std::monostate{});
+                    break;
+                }
+
+                std::wstring value(length, L'\0');
+                if (!read(value.data(), length * sizeof(WCHAR))) {
+                    return std::nullopt;
+                }
+
+                _snwprintf_s(buffer, _TRUNCATE, spec.c_str(), value.c_str());
+                message.args.push_back(std::move(value));
+                break;
+            }
+
+            case ArgKind::kAnsiString: {
+                WORD length;
+                if (!read(&length, sizeof(length))) {
+                    return std::nullopt;
+                }
+
+                if (length == kNullStringLength) {
+                    _snwprintf_s(buffer, _TRUNCATE, spec.c_str(),
+                                 static_cast<PCSTR>(nullptr));
+                    message.args.push_back(std::monostate{});
+                    break;
+                }
+
+                std::string value(length, '\0');
+                if (!read(value.data(), length)) {
+                    return std::nullopt;
+                }
+
+                _snwprintf_s(buffer, _TRUNCATE, spec.c_str(), value.c_str());
+                message.args.push_back(AnsiToWide(value));
+                break;
+            }
+        }
+
+        message.text += buffer;
+    }
+
+    message.text.append(format.format, literalBegin);
+
+    if (message.text.length() > kMaxMessageLength) {
+        message.text.resize(kMaxMessageLength);
+    }
+
+    return message;
+}
+
+void ModLogRecordDecoder::EvictLeastRecentlyUsedProcess() {
+    auto leastRecentlyUsed = std::min_element(
+        m_processFormats.begin(), m_processFormats.end(),
+        [](const auto& a, const auto& b) {
+            return a.second.lastUse < b.second.lastUse;
+        });
+    if (leastRecentlyUsed != m_processFormats.end()) {
+        m_processFormats.erase(leastRecentlyUsed);
+    }
+}
+
+// static
+std::wstring ModLogRecordDecoder::FormatText(const Message& message) {
+    // The source is formatted like the one of other forwarded lines, see
+    // LogRingBufferConsumer.
+    WCHAR source[32];
+    swprintf_s(source, L"[%u:%u] ", message.processId, message.threadId);
+
+    std::wstring text = L"[WH] ";
+    text += source;
+    text += L"[" + message.modName + L"] ";
+    text += message.text;
+
+    // Same as LoggerBase::VLogLine.
+    if (text.length() > kMaxMessageLength) {
+        text.resize(kMaxMessageLength);
+    }
+
+    while (!text.empty() && text.back() == L'\n') {
+        text.pop_back();
+    }
+
+    text += L'\n';
+    return text;
+}
+
+// static
+std::string ModLogRecordDecoder::FormatJson(const Message& message) {
+    SYSTEMTIME time{};
+    FileTimeToSystemTime(&message.timestamp, &time);
+
+    WCHAR timeString[32];
+    swprintf_s(timeString, L"%04u-%02u-%02uT%02u:%02u:%02u.%07uZ", time.wYear,
+               time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond,
+               static_cast<DWORD>(wil::filetime::to_int64(message.timestamp) %
+                                  wil::filetime_duration::one_second));
+
+    std::wstring json = L"{\"time\":\"";
+    json += timeString;
+    json += L"\",\"pid\":";
+    json += std::to_wstring(message.processId);
+    json += L",\"tid\":";
+    json += std::to_wstring(message.threadId);
+    json += L",\"mod\":";
+    Functions::AppendJsonString(&json, message.modName);
+    json += L",\"format\":";
+    Functions::AppendJsonString(&json, message.format);
+    json += L",\"args\":[";
+
+    for (size_t i = 0; i < message.args.size(); i++) {
+        if (i > 0) {
+            json += L',';
+        }
+
+        const Arg& arg = message.args[i];
+        if (auto* value = std::get_if<INT64>(&arg)) {
+            json += std::to_wstring(*value);
+        } else if (auto* value = std::get_if<ULONGLONG>(&arg)) {
+            json += std::to_wstring(*value);
+        } else if (auto* value = std::get_if<double>(&arg);
+                   value && std::isfinite(*value)) {
+            WCHAR number[32];
+            swprintf_s(number, L"%.17g", *value);
+            json += number;
+        } else if (auto* value = std::get_if<std::wstring>(&arg)) {
+            Functions::AppendJsonString(&json, *value);
+        } else {
+            json += L"null";
+        }
+    }
+
+    std::wstring_view text = message.text;
+    while (!text.empty() && text.back() == L'\n') {
+        text.remove_suffix(1);
+    }
+
+    json += L"],\"message\":";
+    Functions::AppendJsonString(&json, text);
+    json += L"}\n";
+
+    return Functions::WideToUtf8(json);
+}
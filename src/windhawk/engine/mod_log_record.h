@@ -0,0 +1,119 @@
+#pragma once
+
+class LogRingBuffer;
+
+// Mod log messages are written to the log ring buffer as binary records
+// instead of text. The logging thread only copies the format arguments, and
+// the session manager formats the message when it drains the buffer.
+//
+// A format string is sent once per process in a format record, along with the
+// mod name, and message records refer to it by id. A message record holds the
+// timestamp, the process and thread ids, the format id and the arguments. The
+// call site is part of the message, since Wh_Log passes the line number and
+// the function name as the first arguments. Both records also hold the
+// creation time of the process, since format ids are only unique within a
+// process, and process ids are reused.
+
+// Writes the log messages of a single mod. Can be used from multiple threads.
+class ModLogRecordWriter {
+   public:
+    ModLogRecordWriter(std::wstring_view modName);
+    ~ModLogRecordWriter();
+
+    ModLogRecordWriter(const ModLogRecordWriter&) = delete;
+    ModLogRecordWriter& operator=(const ModLogRecordWriter&) = delete;
+
+    // Returns false if the format string isn't supported, in which case the
+    // message should be formatted in place. Returns true if the message was
+    // handled, including if it was dropped because the buffer is full.
+    bool Write(LogRingBuffer& ringBuffer, PCWSTR format, va_list args);
+
+   private:
+    struct Format;
+
+    // Returns the parsed format, registering it if it's new. Returns nullptr
+    // if the format isn't supported, or if registering it failed, in which
+    // case dropped is set.
+    const Format* GetFormat(LogRingBuffer& ringBuffer,
+                            PCWSTR format,
+                            bool* dropped);
+
+    static std::atomic<DWORD> m_lastFormatId;
+
+    const std::wstring m_modName;
+    std::shared_mutex m_formatsMutex;
+    // Formats which aren't supported are kept as nullptr.
+    std::unordered_map<PCWSTR, std::unique_ptr<Format>> m_formats;
+};
+
+// Decodes the records in the session manager. Keeps the format strings of
+// each process, up to a limited amount of processes, dropping the least
+// recently used ones. Records come from shared memory which everyone can write
+// to, and are validated.
+class ModLogRecordDecoder {
+   public:
+    ModLogRecordDecoder();
+    ~ModLogRecordDecoder();
+
+    ModLogRecordDecoder(const ModLogRecordDecoder&) = delete;
+    ModLogRecordDecoder& operator=(const ModLogRecordDecoder&) = delete;
+
+    // Values of integer and pointer conversions are kept as unsigned if the
+    // conversion is unsigned, and values of string conversions are kept as
+    // std::monostate if the string is null.
+    using Arg =
+        std::variant<std::monostate, INT64, ULONGLONG, double, std::wstring>;
+
+    struct Message {
+        FILETIME timestamp;
+        DWORD processId;
+        DWORD threadId;
+        std::wstring modName;
+        std::wstring format;
+        std::vector<Arg> args;
+        std::wstring text;
+    };
+
+    // Returns false if the record is invalid.
+    bool AddFormat(std::span<const BYTE> record);
+    // Returns std::nullopt if the record is invalid or if its format is
+    // unknown.
+    std::optional<Message> Decode(std::span<const BYTE> record);
+
+    // Renders the message as the line which is written to the debugger output
+    // if records aren't used, with the process and thread ids, since the line
+    // is written by the session manager.
+    static std::wstring FormatText(const Message& message);
+    // Renders the message as a single line JSON object, encoded as UTF-8.
+    static std::string FormatJson(const Message& message);
+
+   private:
+    struct Format;
+
+    struct ProcessKey {
+        DWORD processId;
+        INT64 creationTime;
+
+        bool operator==(const ProcessKey&) const = default;
+    };
+
+    struct ProcessKeyHash {
+        size_t operator()(const ProcessKey& key) const {
+            return std::hash<ULONGLONG>{}(
+                static_cast<ULONGLONG>(key.creationTime) ^
+                (ULONGLONG{key.processId} << 32));
+        }
+    };
+
+    struct ProcessFormats {
+        std::unordered_map<DWORD, std::unique_ptr<Format>> formats;
+        // The value of m_useCounter when the formats were last used.
+        ULONGLONG lastUse = 0;
+    };
+
+    void EvictLeastRecentlyUsedProcess();
+
+    std::unordered_map<ProcessKey, ProcessFormats, ProcessKeyHash>
+        m_processFormats;
+    ULONGLONG m_useCounter = 0;
+};
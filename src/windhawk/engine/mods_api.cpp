@@ -51,6 +51,22 @@ BOOL InternalWh_DeleteValue(void* mod, PCWSTR valueName) {
     return static_cast<LoadedMod*>(mod)->DeleteValue(valueName);
 }
 
+BOOL InternalWh_BeginStorageBatch(void* mod) {
+    return static_cast<LoadedMod*>(mod)->BeginStorageBatch();
+}
+
+BOOL InternalWh_CommitStorageBatch(void* mod) {
+    return static_cast<LoadedMod*>(mod)->CommitStorageBatch();
+}
+
+BOOL InternalWh_SetStorageWriteBehind(void* mod, DWORD flushDelay) {
+    return static_cast<LoadedMod*>(mod)->SetStorageWriteBehind(flushDelay);
+}
+
+BOOL InternalWh_FlushStorage(void* mod) {
+    return static_cast<LoadedMod*>(mod)->FlushStorage();
+}
+
 size_t InternalWh_GetModStoragePath(void* mod,
                                     PWSTR pathBuffer,
                                     size_t bufferChars) {
@@ -70,6 +86,23 @@ void InternalWh_FreeStringSetting(void* mod, PCWSTR string) {
     static_cast<LoadedMod*>(mod)->FreeStringSetting(string);
 }
 
+const WH_SETTINGS_SNAPSHOT* InternalWh_GetSettingsSnapshot(void* mod) {
+    return static_cast<LoadedMod*>(mod)->CreateSettingsSnapshot();
+}
+
+const WH_SETTING* InternalWh_FindSetting(void* mod,
+                                         const WH_SETTINGS_SNAPSHOT* snapshot,
+                                         PCWSTR valueName,
+                                         va_list args) {
+    return static_cast<LoadedMod*>(mod)->FindSetting(snapshot, valueName,
+                                                     args);
+}
+
+void InternalWh_FreeSettingsSnapshot(void* mod,
+                                     const WH_SETTINGS_SNAPSHOT* snapshot) {
+    static_cast<LoadedMod*>(mod)->FreeSettingsSnapshot(snapshot);
+}
+
 BOOL InternalWh_SetFunctionHook(void* mod,
                                 void* targetFunction,
                                 void* hookFunction,
@@ -86,6 +119,41 @@ BOOL InternalWh_ApplyHookOperations(void* mod) {
     return static_cast<LoadedMod*>(mod)->ApplyHookOperations();
 }
 
+BOOL InternalWh_SetImportHook(void* mod,
+                              HMODULE module,
+                              PCSTR importModuleName,
+                              PCSTR functionName,
+                              void* hookFunction,
+                              void** originalFunction) {
+    return static_cast<LoadedMod*>(mod)->SetImportHook(
+        module, importModuleName, functionName, hookFunction,
+        originalFunction);
+}
+
+BOOL InternalWh_RemoveImportHook(void* mod,
+                                 HMODULE module,
+                                 PCSTR importModuleName,
+                                 PCSTR functionName) {
+    return static_cast<LoadedMod*>(mod)->RemoveImportHook(
+        module, importModuleName, functionName);
+}
+
+BOOL InternalWh_SetExportHook(void* mod,
+                              HMODULE module,
+                              PCSTR functionName,
+                              void* hookFunction,
+                              void** originalFunction) {
+    return static_cast<LoadedMod*>(mod)->SetExportHook(
+        module, functionName, hookFunction, originalFunction);
+}
+
+BOOL InternalWh_RemoveExportHook(void* mod,
+                                 HMODULE module,
+                                 PCSTR functionName) {
+    return static_cast<LoadedMod*>(mod)->RemoveExportHook(module,
+                                                          functionName);
+}
+
 HANDLE InternalWh_FindFirstSymbol(void* mod,
                                   HMODULE hModule,
                                   PCWSTR symbolServer,
@@ -141,6 +209,11 @@ BOOL InternalWh_HookSymbols(void* mod,
                                                      symbolHooksCount, options);
 }
 
+BOOL InternalWh_SetModuleLoadHooks(void* mod,
+                                   const WH_MODULE_LOAD_HOOKS* hooks) {
+    return static_cast<LoadedMod*>(mod)->SetModuleLoadHooks(hooks);
+}
+
 BOOL InternalWh_Disasm(void* mod, void* address, WH_DISASM_RESULT* result) {
     return static_cast<LoadedMod*>(mod)->Disasm(address, result);
 }
@@ -42,6 +42,31 @@ typedef struct tagWH_HOOK_SYMBOLS_OPTIONS {
     PCWSTR onlineCacheUrl;
 } WH_HOOK_SYMBOLS_OPTIONS;
 
+typedef struct tagWH_EXPORT_HOOK {
+    // The name of the exported function.
+    PCSTR exportName;
+    void** pOriginalFunction;
+    void* hookFunction;
+    // If set, a missing export doesn't prevent the other hooks from being set.
+    bool optional;
+} WH_EXPORT_HOOK;
+
+typedef struct tagWH_MODULE_LOAD_HOOKS {
+    // Must be set to `sizeof(WH_MODULE_LOAD_HOOKS)`.
+    size_t size;
+    // The file name of the module, e.g. `L"twinui.pcshell.dll"`. The
+    // comparison is case-insensitive.
+    PCWSTR moduleName;
+    // Hooks for exported functions, resolved with `GetProcAddress`.
+    const WH_EXPORT_HOOK* exportHooks;
+    size_t exportHooksCount;
+    // Hooks for symbols, same as for `Wh_HookSymbols`.
+    const struct tagWH_SYMBOL_HOOK* symbolHooks;
+    size_t symbolHooksCount;
+    // Same as for `Wh_HookSymbols`. Can be `NULL`.
+    const WH_HOOK_SYMBOLS_OPTIONS* hookSymbolsOptions;
+} WH_MODULE_LOAD_HOOKS;
+
 typedef struct tagWH_DISASM_RESULT {
     // The length of the decoded instruction.
     size_t length;
@@ -65,6 +90,22 @@ typedef struct tagWH_URL_CONTENT {
     int statusCode;
 } WH_URL_CONTENT;
 
+typedef struct tagWH_SETTING {
+    // The full name of the setting, e.g. `L"items[0].name"`.
+    PCWSTR name;
+    PCWSTR stringValue;
+    // The value converted to an integer, same as for `Wh_GetIntSetting`.
+    int intValue;
+} WH_SETTING;
+
+typedef struct tagWH_SETTINGS_SNAPSHOT {
+    // The settings, sorted case-insensitively by name, with array indices
+    // and other numbers in names sorted by value. As a result, the settings
+    // of each array element or group are adjacent and in order.
+    const WH_SETTING* settings;
+    size_t count;
+} WH_SETTINGS_SNAPSHOT;
+
 // Definitions for mods.
 #ifdef WH_MOD
 
@@ -191,6 +232,60 @@ inline BOOL Wh_DeleteValue(PCWSTR valueName) {
                           FALSE);
 }
 
+/**
+ * @brief Starts a batch of changes to the mod's local storage. Until the batch
+ *     is committed with `Wh_CommitStorageBatch`, set and deleted values are
+ *     kept in memory, and are then written all at once. Batches can be nested,
+ *     in which case the values are written when the outermost batch is
+ *     committed. The batch applies to the whole mod, not only to the calling
+ *     thread.
+ * @since Windhawk v1.7
+ * @return A boolean value indicating whether the function succeeded.
+ */
+inline BOOL Wh_BeginStorageBatch() {
+    return WH_INTERNAL_OR(InternalWh_BeginStorageBatch(InternalWhModPtr),
+                          FALSE);
+}
+
+/**
+ * @brief Commits a batch of changes started with `Wh_BeginStorageBatch`. When
+ *     the outermost batch is committed, all pending changes, including the
+ *     ones queued by write-behind, are written before the function returns.
+ * @since Windhawk v1.7
+ * @return A boolean value indicating whether the function succeeded.
+ */
+inline BOOL Wh_CommitStorageBatch() {
+    return WH_INTERNAL_OR(InternalWh_CommitStorageBatch(InternalWhModPtr),
+                          FALSE);
+}
+
+/**
+ * @brief Enables or disables write-behind for the mod's local storage. With
+ *     write-behind, set and deleted values are kept in memory and written at
+ *     most `flushDelay` milliseconds later, coalescing repeated changes.
+ *     Pending changes are also written when the mod is unloaded. Values read
+ *     by the mod always include the pending changes.
+ * @since Windhawk v1.7
+ * @param flushDelay The delay in milliseconds before pending changes are
+ *     written. Pass zero to disable write-behind, which also writes the
+ *     pending changes.
+ * @return A boolean value indicating whether the function succeeded.
+ */
+inline BOOL Wh_SetStorageWriteBehind(DWORD flushDelay) {
+    return WH_INTERNAL_OR(
+        InternalWh_SetStorageWriteBehind(InternalWhModPtr, flushDelay), FALSE);
+}
+
+/**
+ * @brief Writes the pending changes queued by write-behind before returning.
+ *     Fails if a batch started with `Wh_BeginStorageBatch` is in progress.
+ * @since Windhawk v1.7
+ * @return A boolean value indicating whether the function succeeded.
+ */
+inline BOOL Wh_FlushStorage() {
+    return WH_INTERNAL_OR(InternalWh_FlushStorage(InternalWhModPtr), FALSE);
+}
+
 /**
  * @brief Retrieves the mod's storage directory path. The directory can be used
  *     by the mod to store any necessary files. The directory will be removed
@@ -253,6 +348,52 @@ inline void Wh_FreeStringSetting(PCWSTR string) {
     WH_INTERNAL(InternalWh_FreeStringSetting(InternalWhModPtr, string));
 }
 
+/**
+ * @brief Retrieves all of the mod's user settings at once, in a single memory
+ *     block. Useful for mods with many settings, e.g. arrays of objects. When
+ *     no longer needed, free the snapshot with `Wh_FreeSettingsSnapshot`.
+ * @since Windhawk v1.7
+ * @return The settings snapshot. In case of an error, `NULL` is returned.
+ */
+inline const WH_SETTINGS_SNAPSHOT* Wh_GetSettingsSnapshot() {
+    return WH_INTERNAL_OR(InternalWh_GetSettingsSnapshot(InternalWhModPtr),
+                          NULL);
+}
+
+/**
+ * @brief Finds a setting in a snapshot returned by `Wh_GetSettingsSnapshot`.
+ *     The returned pointer stays valid until the snapshot is freed, and can be
+ *     kept to avoid repeated lookups.
+ * @since Windhawk v1.7
+ * @param snapshot The settings snapshot.
+ * @param valueName The name of the setting to find. It can optionally contain
+ *     embedded printf-style format specifiers that are replaced by the values
+ *     specified in subsequent additional arguments and formatted as requested.
+ * @return The found setting. If the setting doesn't exist or in case of an
+ *     error, `NULL` is returned.
+ */
+inline const WH_SETTING* Wh_FindSetting(const WH_SETTINGS_SNAPSHOT* snapshot,
+                                        PCWSTR valueName,
+                                        ...) {
+    va_list args;
+    va_start(args, valueName);
+    const WH_SETTING* result = WH_INTERNAL_OR(
+        InternalWh_FindSetting(InternalWhModPtr, snapshot, valueName, args),
+        NULL);
+    va_end(args);
+    return result;
+}
+
+/**
+ * @brief Frees a snapshot returned by `Wh_GetSettingsSnapshot`.
+ * @since Windhawk v1.7
+ * @param snapshot The snapshot to free. If `NULL`, the function does nothing.
+ * @return None.
+ */
+inline void Wh_FreeSettingsSnapshot(const WH_SETTINGS_SNAPSHOT* snapshot) {
+    WH_INTERNAL(InternalWh_FreeSettingsSnapshot(InternalWhModPtr, snapshot));
+}
+
 /**
  * @brief Registers a hook for the specified target function. Can't be called
  *     after `Wh_ModBeforeUninit` returns. Registered hook operations can be
@@ -304,6 +445,97 @@ inline BOOL Wh_ApplyHookOperations() {
                           FALSE);
 }
 
+/**
+ * @brief Registers a hook for a function imported by the specified module.
+ *     Unlike `Wh_SetFunctionHook`, only calls made by that module via its
+ *     import table are affected. The hook is set by replacing the import table
+ *     entry, without a trampoline and without suspending threads. The same
+ *     lifecycle as for `Wh_SetFunctionHook` applies: can't be called after
+ *     `Wh_ModBeforeUninit` returns, and registered hook operations can be
+ *     applied with `Wh_ApplyHookOperations`.
+ * @since Windhawk v1.7
+ * @param module The module whose import table is patched.
+ * @param importModuleName The name of the imported module, e.g.
+ *     `"user32.dll"`. The comparison is case-insensitive.
+ * @param functionName The name of the imported function, or an ordinal value
+ *     cast to `PCSTR`.
+ * @param hookFunction A pointer to the detour function.
+ * @param originalFunction A pointer which receives a function which calls the
+ *     imported function, or the next hook if another mod hooked the same
+ *     entry. Can be `NULL`.
+ * @return A boolean value indicating whether the function succeeded.
+ */
+inline BOOL Wh_SetImportHook(HMODULE module,
+                             PCSTR importModuleName,
+                             PCSTR functionName,
+                             void* hookFunction,
+                             void** originalFunction) {
+    return WH_INTERNAL_OR(
+        InternalWh_SetImportHook(InternalWhModPtr, module, importModuleName,
+                                 functionName, hookFunction, originalFunction),
+        FALSE);
+}
+
+/**
+ * @brief Registers an import hook, set with `Wh_SetImportHook`, to be removed.
+ *     Can't be called before `Wh_ModInit` returns or after
+ *     `Wh_ModBeforeUninit` returns. Registered hook operations can be applied
+ *     with `Wh_ApplyHookOperations`.
+ * @since Windhawk v1.7
+ * @param module Same as for `Wh_SetImportHook`.
+ * @param importModuleName Same as for `Wh_SetImportHook`.
+ * @param functionName Same as for `Wh_SetImportHook`.
+ * @return A boolean value indicating whether the function succeeded.
+ */
+inline BOOL Wh_RemoveImportHook(HMODULE module,
+                                PCSTR importModuleName,
+                                PCSTR functionName) {
+    return WH_INTERNAL_OR(
+        InternalWh_RemoveImportHook(InternalWhModPtr, module, importModuleName,
+                                    functionName),
+        FALSE);
+}
+
+/**
+ * @brief Registers a hook for a function exported by the specified module. The
+ *     hook is set by replacing the export table entry, so it only affects
+ *     `GetProcAddress` calls and modules which are loaded afterwards. Imports
+ *     which were already resolved aren't affected. The same lifecycle as for
+ *     `Wh_SetImportHook` applies.
+ * @since Windhawk v1.7
+ * @param module The module whose export table is patched.
+ * @param functionName The name of the exported function, or an ordinal value
+ *     cast to `PCSTR`.
+ * @param hookFunction A pointer to the detour function.
+ * @param originalFunction A pointer which receives a function which calls the
+ *     exported function, or the next hook if another mod hooked the same
+ *     entry. Can be `NULL`.
+ * @return A boolean value indicating whether the function succeeded.
+ */
+inline BOOL Wh_SetExportHook(HMODULE module,
+                             PCSTR functionName,
+                             void* hookFunction,
+                             void** originalFunction) {
+    return WH_INTERNAL_OR(
+        InternalWh_SetExportHook(InternalWhModPtr, module, functionName,
+                                 hookFunction, originalFunction),
+        FALSE);
+}
+
+/**
+ * @brief Registers an export hook, set with `Wh_SetExportHook`, to be removed.
+ *     The same lifecycle as for `Wh_RemoveImportHook` applies.
+ * @since Windhawk v1.7
+ * @param module Same as for `Wh_SetExportHook`.
+ * @param functionName Same as for `Wh_SetExportHook`.
+ * @return A boolean value indicating whether the function succeeded.
+ */
+inline BOOL Wh_RemoveExportHook(HMODULE module, PCSTR functionName) {
+    return WH_INTERNAL_OR(
+        InternalWh_RemoveExportHook(InternalWhModPtr, module, functionName),
+        FALSE);
+}
+
 /**
  * @brief Returns information about the first symbol for the specified module
  *     handle.
@@ -353,6 +585,25 @@ inline void Wh_FindCloseSymbol(HANDLE symSearch) {
     WH_INTERNAL(InternalWh_FindCloseSymbol(InternalWhModPtr, symSearch));
 }
 
+/**
+ * @brief Registers hooks for a module which might not be loaded yet. If the
+ *     module is already loaded, the hooks are set right away, and are applied
+ *     like hooks set with `Wh_SetFunctionHook`. Otherwise, the hooks are set
+ *     and applied shortly after the module is loaded. The module is kept
+ *     loaded while the hooks are in place. Can't be called after
+ *     `Wh_ModBeforeUninit` returns.
+ * @since Windhawk v1.7
+ * @param hooks The module and the hooks to set. The data is copied, and
+ *     doesn't have to remain valid after the function returns.
+ * @return A boolean value indicating whether the function succeeded. The
+ *     return value only indicates whether the registration succeeded. If the
+ *     module is already loaded, it also indicates whether the hooks were set.
+ */
+inline BOOL Wh_SetModuleLoadHooks(const WH_MODULE_LOAD_HOOKS* hooks) {
+    return WH_INTERNAL_OR(
+        InternalWh_SetModuleLoadHooks(InternalWhModPtr, hooks), FALSE);
+}
+
 /**
  * @brief Disassembles an instruction and formats it to human-readable text.
  * @since Windhawk v1.2
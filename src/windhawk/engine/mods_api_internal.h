@@ -15,9 +15,12 @@ typedef struct tagWH_SYMBOL_HOOK {
     bool optional;
 } WH_SYMBOL_HOOK;
 typedef struct tagWH_HOOK_SYMBOLS_OPTIONS WH_HOOK_SYMBOLS_OPTIONS;
+typedef struct tagWH_MODULE_LOAD_HOOKS WH_MODULE_LOAD_HOOKS;
 typedef struct tagWH_DISASM_RESULT WH_DISASM_RESULT;
 typedef struct tagWH_GET_URL_CONTENT_OPTIONS WH_GET_URL_CONTENT_OPTIONS;
 typedef struct tagWH_URL_CONTENT WH_URL_CONTENT;
+typedef struct tagWH_SETTING WH_SETTING;
+typedef struct tagWH_SETTINGS_SNAPSHOT WH_SETTINGS_SNAPSHOT;
 
 // Internal functions, do not call directly.
 #ifdef __cplusplus
@@ -43,6 +46,10 @@ BOOL InternalWh_SetBinaryValue(void* mod,
                                const void* buffer,
                                size_t bufferSize);
 BOOL InternalWh_DeleteValue(void* mod, PCWSTR valueName);
+BOOL InternalWh_BeginStorageBatch(void* mod);
+BOOL InternalWh_CommitStorageBatch(void* mod);
+BOOL InternalWh_SetStorageWriteBehind(void* mod, DWORD flushDelay);
+BOOL InternalWh_FlushStorage(void* mod);
 
 size_t InternalWh_GetModStoragePath(void* mod,
                                     PWSTR pathBuffer,
@@ -51,6 +58,13 @@ size_t InternalWh_GetModStoragePath(void* mod,
 int InternalWh_GetIntSetting(void* mod, PCWSTR valueName, va_list args);
 PCWSTR InternalWh_GetStringSetting(void* mod, PCWSTR valueName, va_list args);
 void InternalWh_FreeStringSetting(void* mod, PCWSTR string);
+const WH_SETTINGS_SNAPSHOT* InternalWh_GetSettingsSnapshot(void* mod);
+const WH_SETTING* InternalWh_FindSetting(void* mod,
+                                         const WH_SETTINGS_SNAPSHOT* snapshot,
+                                         PCWSTR valueName,
+                                         va_list args);
+void InternalWh_FreeSettingsSnapshot(void* mod,
+                                     const WH_SETTINGS_SNAPSHOT* snapshot);
 
 BOOL InternalWh_SetFunctionHook(void* mod,
                                 void* targetFunction,
@@ -59,6 +73,25 @@ BOOL InternalWh_SetFunctionHook(void* mod,
 BOOL InternalWh_RemoveFunctionHook(void* mod, void* targetFunction);
 BOOL InternalWh_ApplyHookOperations(void* mod);
 
+BOOL InternalWh_SetImportHook(void* mod,
+                              HMODULE module,
+                              PCSTR importModuleName,
+                              PCSTR functionName,
+                              void* hookFunction,
+                              void** originalFunction);
+BOOL InternalWh_RemoveImportHook(void* mod,
+                                 HMODULE module,
+                                 PCSTR importModuleName,
+                                 PCSTR functionName);
+BOOL InternalWh_SetExportHook(void* mod,
+                              HMODULE module,
+                              PCSTR functionName,
+                              void* hookFunction,
+                              void** originalFunction);
+BOOL InternalWh_RemoveExportHook(void* mod,
+                                 HMODULE module,
+                                 PCSTR functionName);
+
 HANDLE InternalWh_FindFirstSymbol4(void* mod,
                                    HMODULE hModule,
                                    const WH_FIND_SYMBOL_OPTIONS* options,
@@ -74,6 +107,9 @@ BOOL InternalWh_HookSymbols(void* mod,
                             size_t symbolHooksCount,
                             const WH_HOOK_SYMBOLS_OPTIONS* options);
 
+BOOL InternalWh_SetModuleLoadHooks(void* mod,
+                                   const WH_MODULE_LOAD_HOOKS* hooks);
+
 BOOL InternalWh_Disasm(void* mod, void* address, WH_DISASM_RESULT* result);
 
 const WH_URL_CONTENT* InternalWh_GetUrlContent(
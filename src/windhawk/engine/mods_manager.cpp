@@ -1,8 +1,10 @@
 #include "stdafx.h"
 
+#include "engine_metrics.h"
 #include "logger.h"
 #include "mods_manager.h"
 #include "storage_manager.h"
+#include "trace_recorder.h"
 
 namespace {
 
@@ -13,12 +15,69 @@ DWORD GetModuleSizeOfImage(HMODULE module) {
     return ntHeader->OptionalHeader.SizeOfImage;
 }
 
+// Waits until no thread executes the code of the unloaded mods, then they can
+// be freed. The call stacks of all threads are walked, since a thread can be
+// inside a mod without going through a hook, e.g. in a thread or a callback
+// created by the mod. Counting the calls in progress in the hook relays isn't
+// enough to skip the walk, and the relays can't see a call return without
+// replacing the return address, which breaks x64 unwinding.
+void WaitForModsToStopExecuting(
+    const std::vector<ThreadCallStackRegionInfo>& regions) {
+    if (regions.empty()) {
+        return;
+    }
+
+    EngineMetrics::ScopedTimer timer(EngineMetrics::GetEngineInstance(),
+                                     EngineMetrics::Metric::kUnloadWaitTime);
+    ThreadsCallStackWaitForRegions(
+        regions.data(), static_cast<DWORD>(regions.size()), 200, 400);
+}
+
+std::optional<StorageManager::ModGenerations> ReadModGenerations() {
+    try {
+        return StorageManager::GetInstance().GetModGenerations();
+    } catch (const std::exception& e) {
+        LOG(L"Reading mod generations failed: %S", e.what());
+        return std::nullopt;
+    }
+}
+
+std::unordered_set<std::wstring> GetChangedMods(
+    const StorageManager::ModGenerations& previous,
+    const StorageManager::ModGenerations& current) {
+    std::unordered_set<std::wstring> changedMods;
+
+    for (const auto& [name, generation] : current) {
+        auto it = previous.find(name);
+        if (it == previous.end() || it->second != generation) {
+            changedMods.insert(name);
+        }
+    }
+
+    for (const auto& [name, generation] : previous) {
+        if (!current.contains(name)) {
+            changedMods.insert(name);
+        }
+    }
+
+    return changedMods;
+}
+
 }  // namespace
 
 ModsManager::ModsManager() {
-    StorageManager::GetInstance().EnumMods([this](PCWSTR modName) {
+    TraceRecorder::Span span("LoadMods");
+
+    // Read before the mods, so that a change which happens while loading is
+    // seen by the next reload.
+    m_modGenerations = ReadModGenerations();
+
+    auto& storageManager = StorageManager::GetInstance();
+    storageManager.EnumMods([this, &storageManager](PCWSTR modName) {
         try {
-            if (Mod::ShouldLoadInRunningProcess(modName)) {
+            auto settings = storageManager.GetModConfig(modName, nullptr);
+            if (Mod::ShouldLoadInRunningProcess(
+                    *settings, m_modPatternMatchers[modName])) {
                 auto result = m_mods.emplace(modName, modName);
                 if (!result.second) {
                     throw std::logic_error(
@@ -57,13 +116,12 @@ ModsManager::~ModsManager() {
         }
     }
 
-    if (!regions.empty()) {
-        ThreadsCallStackWaitForRegions(
-            regions.data(), static_cast<DWORD>(regions.size()), 200, 400);
-    }
+    WaitForModsToStopExecuting(regions);
 }
 
 void ModsManager::AfterInit() {
+    TraceRecorder::Span span("AfterInit");
+
     for (auto& [name, mod] : m_mods) {
         try {
             mod.AfterInit();
@@ -83,16 +141,35 @@ void ModsManager::BeforeUninit() {
     }
 }
 
+void ModsManager::UpdateHookCallCounts() {
+    for (auto& [name, mod] : m_mods) {
+        try {
+            mod.UpdateHookCallCounts();
+        } catch (const std::exception& e) {
+            LOG(L"Mod (%s) UpdateHookCallCounts failed: %S", name.c_str(),
+                e.what());
+        }
+    }
+}
+
 void ModsManager::ReloadModsAndSettings() {
+    TraceRecorder::Span span("ReloadModsAndSettings");
+
+    EngineMetrics::AddToEngine(EngineMetrics::Metric::kReloads);
+
     std::unordered_set<std::wstring> modsToKeepLoaded;
     std::unordered_set<std::wstring> modsToKeepUnloaded;
     std::vector<std::wstring> modsToLoad;
 
-    StorageManager::GetInstance().EnumMods([this, &modsToKeepLoaded,
-                                            &modsToKeepUnloaded,
-                                            &modsToLoad](PCWSTR modName) {
+    auto checkMod = [this, &modsToKeepLoaded, &modsToKeepUnloaded,
+                     &modsToLoad](PCWSTR modName) {
         try {
-            bool shouldBeLoaded = Mod::ShouldLoadInRunningProcess(modName);
+            // Read once for both checks, each read opens the mod config.
+            auto settings =
+                StorageManager::GetInstance().GetModConfig(modName, nullptr);
+
+            bool shouldBeLoaded = Mod::ShouldLoadInRunningProcess(
+                *settings, m_modPatternMatchers[modName]);
             if (!shouldBeLoaded) {
                 return;
             }
@@ -102,7 +179,7 @@ void ModsManager::ReloadModsAndSettings() {
                 auto& loadedMod = it->second;
 
                 bool reload = false;
-                if (!loadedMod.ApplyChangedSettings(&reload)) {
+                if (!loadedMod.ApplyChangedSettings(*settings, &reload)) {
                     modsToKeepUnloaded.emplace(modName);
                 } else if (reload) {
                     modsToLoad.emplace_back(modName);
@@ -115,7 +192,49 @@ void ModsManager::ReloadModsAndSettings() {
         } catch (const std::exception& e) {
             LOG(L"Mod (%s) reloading failed: %S", modName, e.what());
         }
-    });
+    };
+
+    auto modGenerations = ReadModGenerations();
+    if (m_modGenerations && modGenerations) {
+        // Only re-read the config of the mods which changed, the other mods
+        // keep their state.
+        auto changedMods = GetChangedMods(*m_modGenerations, *modGenerations);
+        m_modGenerations = std::move(modGenerations);
+
+        if (changedMods.empty()) {
+            return;
+        }
+
+        for (const auto& [name, mod] : m_mods) {
+            if (!changedMods.contains(name)) {
+                modsToKeepLoaded.insert(name);
+            }
+        }
+
+        // Mods which are no longer in the table were deleted, and are
+        // unloaded below.
+        for (const auto& modName : changedMods) {
+            if (m_modGenerations->contains(modName)) {
+                checkMod(modName.c_str());
+            } else {
+                m_modPatternMatchers.erase(modName);
+            }
+        }
+    } else {
+        m_modGenerations = std::move(modGenerations);
+
+        std::unordered_set<std::wstring> modNames;
+        StorageManager::GetInstance().EnumMods(
+            [&checkMod, &modNames](PCWSTR modName) {
+                modNames.insert(modName);
+                checkMod(modName);
+            });
+
+        // Drop the matchers of deleted mods.
+        std::erase_if(m_modPatternMatchers, [&modNames](const auto& item) {
+            return !modNames.contains(item.first);
+        });
+    }
 
     for (auto& [name, mod] : m_mods) {
         if (!modsToKeepLoaded.contains(name)) {
@@ -129,9 +248,19 @@ void ModsManager::ReloadModsAndSettings() {
     }
 
 #ifdef WH_HOOKING_ENGINE_MINHOOK
-    MH_STATUS status = MH_ApplyQueuedEx(MH_ALL_IDENTS);
+    MH_STATUS status;
+    BOOL threadsFrozen;
+    {
+        EngineMetrics::ScopedTimer timer(
+            EngineMetrics::GetEngineInstance(),
+            EngineMetrics::Metric::kThreadFreezeTime);
+        status = MH_ApplyQueuedEx2(MH_ALL_IDENTS, &threadsFrozen);
+    }
+    if (threadsFrozen) {
+        EngineMetrics::AddToEngine(EngineMetrics::Metric::kThreadFreezes);
+    }
     if (status != MH_OK) {
-        LOG(L"MH_ApplyQueuedEx failed with %d", status);
+        LOG(L"MH_ApplyQueuedEx2 failed with %d", status);
     }
 #elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
 // For testing without a hooking engine.
@@ -159,10 +288,7 @@ void ModsManager::ReloadModsAndSettings() {
         }
     }
 
-    if (!regions.empty()) {
-        ThreadsCallStackWaitForRegions(
-            regions.data(), static_cast<DWORD>(regions.size()), 200, 400);
-    }
+    WaitForModsToStopExecuting(regions);
 
     for (auto it = m_mods.begin(); it != m_mods.end();) {
         auto& [name, mod] = *it;
@@ -201,9 +327,17 @@ void ModsManager::ReloadModsAndSettings() {
     }
 
 #ifdef WH_HOOKING_ENGINE_MINHOOK
-    status = MH_ApplyQueuedEx(MH_ALL_IDENTS);
+    {
+        EngineMetrics::ScopedTimer timer(
+            EngineMetrics::GetEngineInstance(),
+            EngineMetrics::Metric::kThreadFreezeTime);
+        status = MH_ApplyQueuedEx2(MH_ALL_IDENTS, &threadsFrozen);
+    }
+    if (threadsFrozen) {
+        EngineMetrics::AddToEngine(EngineMetrics::Metric::kThreadFreezes);
+    }
     if (status != MH_OK) {
-        LOG(L"MH_ApplyQueuedEx failed with %d", status);
+        LOG(L"MH_ApplyQueuedEx2 failed with %d", status);
     }
 #elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
 // For testing without a hooking engine.
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "mod.h"
+#include "storage_manager.h"
 
 class ModsManager {
    public:
@@ -13,7 +14,15 @@ class ModsManager {
     void AfterInit();
     void BeforeUninit();
     void ReloadModsAndSettings();
+    void UpdateHookCallCounts();
 
    private:
     std::unordered_map<std::wstring, Mod> m_mods;
+    // The mod generations as of the last reload. If not available, the next
+    // reload re-reads the config of all mods.
+    std::optional<StorageManager::ModGenerations> m_modGenerations;
+    // The compiled patterns of all mods, including the ones which aren't
+    // loaded, since most reloads don't change the patterns.
+    std::unordered_map<std::wstring, ModConfig::PatternMatchers>
+        m_modPatternMatchers;
 };
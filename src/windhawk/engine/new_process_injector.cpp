@@ -4,9 +4,7 @@
 #include "functions.h"
 #include "logger.h"
 #include "new_process_injector.h"
-#include "process_lists.h"
 #include "session_private_namespace.h"
-#include "storage_manager.h"
 
 // This static pointer is used in the hook procedure.
 // As a result, only one instance of the class can be used at any given time.
@@ -114,36 +112,6 @@ NewProcessInjector::NewProcessInjector(HANDLE hSessionManagerProcess)
     if (!createProcessInternalWHooked) {
         LOG(L"Failed to hook CreateProcessInternalW");
     }
-
-    auto settings = StorageManager::GetInstance().GetAppConfig(L"Settings");
-    m_includePattern = settings->GetString(L"Include").value_or(L"");
-    m_excludePattern = settings->GetString(L"Exclude").value_or(L"");
-    m_threadAttachExemptPattern =
-        settings->GetString(L"ThreadAttachExempt").value_or(L"");
-
-    if (!settings->GetInt(L"InjectIntoCriticalProcesses").value_or(0)) {
-        if (!m_excludePattern.empty()) {
-            m_excludePattern += L'|';
-        }
-
-        m_excludePattern += ProcessLists::kCriticalProcesses;
-    }
-
-    if (!settings->GetInt(L"InjectIntoIncompatiblePrograms").value_or(0)) {
-        if (!m_excludePattern.empty()) {
-            m_excludePattern += L'|';
-        }
-
-        m_excludePattern += ProcessLists::kIncompatiblePrograms;
-    }
-
-    if (!settings->GetInt(L"InjectIntoGames").value_or(0)) {
-        if (!m_excludePattern.empty()) {
-            m_excludePattern += L'|';
-        }
-
-        m_excludePattern += ProcessLists::kGames;
-    }
 }
 
 NewProcessInjector::~NewProcessInjector() {
@@ -157,6 +125,11 @@ NewProcessInjector::~NewProcessInjector() {
     }
 }
 
+void NewProcessInjector::ResetModTargetFilter() {
+    std::lock_guard<std::mutex> guard(m_modTargetFilterMutex);
+    m_modTargetFilter.reset();
+}
+
 // static
 BOOL WINAPI NewProcessInjector::CreateProcessInternalW_Hook(
     HANDLE hToken,
@@ -214,9 +187,10 @@ void NewProcessInjector::HandleCreatedProcess(
     LPPROCESS_INFORMATION lpProcessInformation) {
     try {
         bool threadAttachExempt;
+        bool propagationOnly;
         if (ShouldSkipNewProcess(lpProcessInformation->hProcess,
                                  lpProcessInformation->dwProcessId,
-                                 &threadAttachExempt)) {
+                                 &threadAttachExempt, &propagationOnly)) {
             return;
         }
 
@@ -233,7 +207,8 @@ void NewProcessInjector::HandleCreatedProcess(
 
         DllInject::DllInject(
             lpProcessInformation->hProcess, lpProcessInformation->hThread,
-            m_sessionManagerProcess, mutex.get(), threadAttachExempt);
+            m_sessionManagerProcess, mutex.get(), threadAttachExempt,
+            propagationOnly);
         VERBOSE(L"DllInject succeeded for new process %u",
                 lpProcessInformation->dwProcessId);
     } catch (const std::exception& e) {
@@ -244,18 +219,40 @@ void NewProcessInjector::HandleCreatedProcess(
 
 bool NewProcessInjector::ShouldSkipNewProcess(HANDLE hProcess,
                                               DWORD dwProcessId,
-                                              bool* threadAttachExempt) {
+                                              bool* threadAttachExempt,
+                                              bool* propagationOnly) {
     auto processImageName =
         wil::QueryFullProcessImageName<std::wstring>(hProcess);
 
-    if (Functions::DoesPathMatchPattern(processImageName, m_excludePattern) &&
-        !Functions::DoesPathMatchPattern(processImageName, m_includePattern)) {
+    auto decision = m_injectionFilter.Decide(processImageName);
+    if (decision.skip) {
         VERBOSE(L"Skipping excluded process %u", dwProcessId);
         return true;
     }
 
-    *threadAttachExempt = Functions::DoesPathMatchPattern(
-        processImageName, m_threadAttachExemptPattern);
+    *threadAttachExempt = decision.threadAttachExempt;
+    *propagationOnly = !MightBeTargeted(processImageName);
+    if (*propagationOnly) {
+        VERBOSE(L"Process %u isn't targeted by any mod", dwProcessId);
+    }
 
     return false;
 }
+
+bool NewProcessInjector::MightBeTargeted(
+    const std::wstring& processImageName) {
+    std::lock_guard<std::mutex> guard(m_modTargetFilterMutex);
+
+    if (!m_modTargetFilter) {
+        try {
+            m_modTargetFilter.emplace();
+        } catch (const std::exception& e) {
+            // Assume that the process is targeted, mods are then loaded as
+            // usual.
+            LOG(L"ModTargetFilter constructor failed: %S", e.what());
+            return true;
+        }
+    }
+
+    return m_modTargetFilter->MightBeTargeted(processImageName);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "injection_filter.h"
+
 class NewProcessInjector {
    public:
     NewProcessInjector(HANDLE hSessionManagerProcess);
@@ -11,6 +13,10 @@ class NewProcessInjector {
     NewProcessInjector& operator=(const NewProcessInjector&) = delete;
     NewProcessInjector& operator=(NewProcessInjector&&) noexcept = delete;
 
+    // Must be called on mod config changes, the filter is rebuilt for the
+    // next new process.
+    void ResetModTargetFilter();
+
    private:
     using CreateProcessInternalW_t =
         BOOL(WINAPI*)(HANDLE hToken,
@@ -42,7 +48,9 @@ class NewProcessInjector {
     void HandleCreatedProcess(LPPROCESS_INFORMATION lpProcessInformation);
     bool ShouldSkipNewProcess(HANDLE hProcess,
                               DWORD dwProcessId,
-                              bool* threadAttachExempt);
+                              bool* threadAttachExempt,
+                              bool* propagationOnly);
+    bool MightBeTargeted(const std::wstring& processImageName);
 
     // Limited to a single instance at a time.
     static std::atomic<NewProcessInjector*> m_pThis;
@@ -50,7 +58,9 @@ class NewProcessInjector {
     HANDLE m_sessionManagerProcess;
     CreateProcessInternalW_t m_originalCreateProcessInternalW = nullptr;
     std::atomic<int> m_hookProcCallCounter = 0;
-    std::wstring m_includePattern;
-    std::wstring m_excludePattern;
-    std::wstring m_threadAttachExemptPattern;
+    InjectionFilter m_injectionFilter;
+    // Processes which no mod targets get a propagation-only session, which
+    // only injects into their children. Built on first use.
+    std::mutex m_modTargetFilterMutex;
+    std::optional<ModTargetFilter> m_modTargetFilter;
 };
@@ -0,0 +1,183 @@
+#include "stdafx.h"
+
+#include "functions.h"
+#include "path_pattern_matcher.h"
+
+namespace {
+
+void ToUpperInPlace(std::wstring& s) {
+    if (s.empty()) {
+        return;
+    }
+
+    // A case-insensitive comparison as recommended here:
+    // https://stackoverflow.com/q/410502
+
+    // Don't use CharUpperBuff to avoid depending on user32.dll. Use
+    // LCMapStringEx just like it's called internally by CharUpperBuff.
+    LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE, &s[0],
+                  wil::safe_cast<int>(s.length()), &s[0],
+                  wil::safe_cast<int>(s.length()), nullptr, nullptr, 0);
+}
+
+std::wstring NormalizePatternPart(std::wstring_view patternPartView) {
+    auto patternPart = std::wstring{patternPartView};
+
+#ifndef _WIN64
+    BOOL isWow64;
+    if (IsWow64Process(GetCurrentProcess(), &isWow64) && isWow64) {
+        // Get the native Program Files path regardless of the current process
+        // architecture.
+        patternPart = Functions::ReplaceAll(patternPart, L"%ProgramFiles%",
+                                            L"%ProgramW6432%",
+                                            /*ignoreCase=*/true);
+    }
+#endif  // _WIN64
+
+    auto patternPartNormalized =
+        wil::ExpandEnvironmentStrings<std::wstring>(patternPart.c_str());
+
+    ToUpperInPlace(patternPartNormalized);
+
+    return patternPartNormalized;
+}
+
+}  // namespace
+
+PathPatternMatcher::Path::Path(std::wstring_view path) : m_pathUpper(path) {
+    ToUpperInPlace(m_pathUpper);
+
+    if (size_t i = m_pathUpper.rfind(L'\\'); i != m_pathUpper.npos) {
+        m_fileNameOffset = i + 1;
+    }
+}
+
+PathPatternMatcher::PathPatternMatcher(std::wstring_view pattern) {
+    if (pattern.empty()) {
+        return;
+    }
+
+    for (const auto& patternPartView :
+         Functions::SplitStringToViews(pattern, L'|')) {
+        // Wildcards are checked before expanding environment variables, like
+        // for explicit-only matching.
+        bool patternIsWildcard =
+            patternPartView.find_first_of(L"*?") != patternPartView.npos;
+
+        auto patternPart = NormalizePatternPart(patternPartView);
+
+        // If there's no backslash in the pattern part, match only against the
+        // file name, not the full path.
+        bool matchFullPath = patternPart.find(L'\\') != patternPart.npos;
+
+        if (patternIsWildcard) {
+            auto& automaton =
+                matchFullPath ? m_fullPathWildcards : m_fileNameWildcards;
+            automaton.AddPattern(patternPart);
+        } else {
+            auto& literals =
+                matchFullPath ? m_fullPathLiterals : m_fileNameLiterals;
+            literals.insert(std::move(patternPart));
+        }
+    }
+}
+
+bool PathPatternMatcher::Matches(const Path& path, bool explicitOnly) const {
+    if (m_fullPathLiterals.contains(path.GetFullPath()) ||
+        m_fileNameLiterals.contains(path.GetFileName())) {
+        return true;
+    }
+
+    if (explicitOnly) {
+        return false;
+    }
+
+    return m_fullPathWildcards.Matches(path.GetFullPath()) ||
+           m_fileNameWildcards.Matches(path.GetFileName());
+}
+
+bool PathPatternMatcher::Matches(std::wstring_view path,
+                                 bool explicitOnly) const {
+    return Matches(Path(path), explicitOnly);
+}
+
+void PathPatternMatcher::WildcardAutomaton::AddPattern(
+    std::wstring_view pattern) {
+    m_startStates.push_back(m_states.length());
+
+    for (size_t i = 0; i < pattern.length(); i++) {
+        // Consecutive asterisks are equivalent to a single one.
+        if (pattern[i] == L'*' && i > 0 && pattern[i - 1] == L'*') {
+            continue;
+        }
+
+        m_states += pattern[i];
+    }
+
+    m_states += L'\0';
+}
+
+// The semantics are the same as of Functions::wcsmatch: '*' matches any
+// sequence of characters, '?' matches any single character, and any other
+// character matches itself.
+bool PathPatternMatcher::WildcardAutomaton::Matches(
+    std::wstring_view string) const {
+    if (m_startStates.empty()) {
+        return false;
+    }
+
+    std::vector<size_t> current;
+    std::vector<size_t> next;
+
+    // The position of the string at which each state was last added, to avoid
+    // adding a state twice.
+    std::vector<size_t> addedAt(m_states.length(), SIZE_MAX);
+
+    auto addState = [this, &addedAt](std::vector<size_t>& states, size_t state,
+                                     size_t position) {
+        if (addedAt[state] == position) {
+            return;
+        }
+
+        addedAt[state] = position;
+        states.push_back(state);
+
+        // An asterisk can match an empty sequence, so the state after it is
+        // active too.
+        if (m_states[state] == L'*') {
+            state++;
+            if (addedAt[state] != position) {
+                addedAt[state] = position;
+                states.push_back(state);
+            }
+        }
+    };
+
+    for (size_t state : m_startStates) {
+        addState(current, state, 0);
+    }
+
+    for (size_t i = 0; i < string.length(); i++) {
+        WCHAR c = string[i];
+        next.clear();
+
+        for (size_t state : current) {
+            WCHAR stateChar = m_states[state];
+            if (stateChar == L'*') {
+                addState(next, state, i + 1);
+            } else if (stateChar != L'\0' &&
+                       (stateChar == L'?' || stateChar == c)) {
+                addState(next, state + 1, i + 1);
+            }
+        }
+
+        if (next.empty()) {
+            return false;
+        }
+
+        current.swap(next);
+    }
+
+    return std::ranges::any_of(
+        current, [this](size_t state) { return m_states[state] == L'\0'; });
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// Matches paths against a pattern in the format used by the include and
+// exclude lists: a list of wildcard patterns separated by '|', which can
+// contain environment variables. A pattern without a backslash is matched
+// against the file name only. Matching is case-insensitive.
+//
+// The pattern is compiled once: environment variables are expanded, the case
+// is folded, patterns without wildcards are stored in hash sets, and wildcard
+// patterns are combined into automatons which match all of them in a single
+// pass over the path.
+class PathPatternMatcher {
+   public:
+    // A path prepared for matching, which can be reused for multiple
+    // matchers.
+    class Path {
+       public:
+        explicit Path(std::wstring_view path);
+
+       private:
+        friend class PathPatternMatcher;
+
+        std::wstring_view GetFullPath() const { return m_pathUpper; }
+        std::wstring_view GetFileName() const {
+            return std::wstring_view(m_pathUpper).substr(m_fileNameOffset);
+        }
+
+        std::wstring m_pathUpper;
+        size_t m_fileNameOffset = 0;
+    };
+
+    // Matches nothing.
+    PathPatternMatcher() = default;
+    explicit PathPatternMatcher(std::wstring_view pattern);
+
+    // If explicitOnly is set, only patterns without wildcards are used.
+    bool Matches(const Path& path, bool explicitOnly = false) const;
+    bool Matches(std::wstring_view path, bool explicitOnly = false) const;
+
+   private:
+    // A combined NFA of wildcard patterns. Each pattern is stored as its
+    // characters followed by a null, which marks the accepting state, and a
+    // state is the index of the next pattern character to match.
+    class WildcardAutomaton {
+       public:
+        void AddPattern(std::wstring_view pattern);
+        bool Matches(std::wstring_view string) const;
+
+       private:
+        std::wstring m_states;
+        std::vector<size_t> m_startStates;
+    };
+
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::wstring_view s) const {
+            return std::hash<std::wstring_view>{}(s);
+        }
+    };
+
+    using StringSet =
+        std::unordered_set<std::wstring, StringHash, std::equal_to<>>;
+
+    StringSet m_fullPathLiterals;
+    StringSet m_fileNameLiterals;
+    WildcardAutomaton m_fullPathWildcards;
+    WildcardAutomaton m_fileNameWildcards;
+};
@@ -18,18 +18,24 @@
 
 // STL
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <exception>
 #include <filesystem>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <new>
 #include <optional>
 #include <ranges>
+#include <shared_mutex>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <tuple>
@@ -95,6 +95,119 @@ std::filesystem::path PathFromStorage(
     return (baseFolderPath / expandedPath).lexically_normal();
 }
 
+int ConfigSnapshotStringToInt(std::wstring_view value) {
+    // Same as for strings in the registry.
+    long longValue = std::stol(std::wstring(value), nullptr, 0);
+    if (longValue > INT_MAX) {
+        return INT_MAX;
+    } else if (longValue < INT_MIN) {
+        return INT_MIN;
+    }
+
+    return static_cast<int>(longValue);
+}
+
+template <typename Type>
+class EnumIteratorConfigSnapshot : public EnumIteratorImpl<Type> {
+   public:
+    EnumIteratorConfigSnapshot(
+        std::shared_ptr<const ConfigSnapshot::Reader> snapshot,
+        ConfigSnapshot::Reader::Section section)
+        : snapshot(std::move(snapshot)), section(section) {
+        next();
+    }
+
+    void next() override {
+        if (index >= section.GetValueCount()) {
+            this->done = true;
+            return;
+        }
+
+        auto [name, value] = section.GetValueAt(index++);
+        if constexpr (std::is_same_v<Type, int>) {
+            this->item = {std::wstring(name), ConfigSnapshotStringToInt(value)};
+        } else {
+            this->item = {std::wstring(name), std::wstring(value)};
+        }
+    }
+
+    std::unique_ptr<EnumIteratorImpl<Type>> clone() const override {
+        return std::make_unique<EnumIteratorConfigSnapshot>(*this);
+    }
+
+   private:
+    std::shared_ptr<const ConfigSnapshot::Reader> snapshot;
+    ConfigSnapshot::Reader::Section section;
+    size_t index = 0;
+};
+
+// A read-only section of a config snapshot.
+class ConfigSnapshotSettings : public PortableSettings {
+   public:
+    ConfigSnapshotSettings(
+        std::shared_ptr<const ConfigSnapshot::Reader> snapshot,
+        ConfigSnapshot::Reader::Section section)
+        : snapshot(std::move(snapshot)), section(section) {}
+
+    std::optional<std::wstring> GetString(PCWSTR valueName) const override {
+        auto value = section.GetValue(valueName);
+        if (!value) {
+            return std::nullopt;
+        }
+
+        return std::wstring(*value);
+    }
+
+    void SetString(PCWSTR valueName, PCWSTR string) override {
+        throw std::logic_error("The config snapshot is read-only");
+    }
+
+    std::optional<int> GetInt(PCWSTR valueName) const override {
+        auto value = section.GetValue(valueName);
+        if (!value) {
+            return std::nullopt;
+        }
+
+        return ConfigSnapshotStringToInt(*value);
+    }
+
+    void SetInt(PCWSTR valueName, int value) override {
+        throw std::logic_error("The config snapshot is read-only");
+    }
+
+    std::optional<std::vector<BYTE>> GetBinary(
+        PCWSTR valueName) const override {
+        // Binary values aren't included in snapshots.
+        return std::nullopt;
+    }
+
+    void SetBinary(PCWSTR valueName,
+                   const BYTE* buffer,
+                   size_t bufferSize) override {
+        throw std::logic_error("The config snapshot is read-only");
+    }
+
+    void Remove(PCWSTR valueName) override {
+        throw std::logic_error("The config snapshot is read-only");
+    }
+
+    EnumIterator<int> EnumIntValues() const override {
+        return EnumIterator<int>(
+            std::make_unique<EnumIteratorConfigSnapshot<int>>(snapshot,
+                                                              section));
+    }
+
+    EnumIterator<std::wstring> EnumStringValues() const override {
+        return EnumIterator<std::wstring>(
+            std::make_unique<EnumIteratorConfigSnapshot<std::wstring>>(
+                snapshot, section));
+    }
+
+   private:
+    std::shared_ptr<const ConfigSnapshot::Reader> snapshot;
+    ConfigSnapshot::Reader::Section section;
+};
+
 }  // namespace
 
 // static
@@ -104,10 +217,14 @@ StorageManager& StorageManager::GetInstance() {
 }
 
 std::unique_ptr<PortableSettings> StorageManager::GetAppConfig(PCWSTR section) {
+    if (auto snapshotSettings = GetConfigSnapshotSection(section)) {
+        return snapshotSettings;
+    }
+
     if (portableStorage) {
         const auto& iniFileSettingsPath = std::get<IniFilePath>(settingsPath);
         return std::make_unique<IniFileSettings>(
-            iniFileSettingsPath.path.c_str(), section, false);
+            iniFileSettingsPath.path.c_str(), section, false, &iniFileCache);
     } else {
         const auto& registrySettingsPath = std::get<RegistryPath>(settingsPath);
         std::wstring subKey = registrySettingsPath.subKey + L'\\' + section;
@@ -118,12 +235,24 @@ std::unique_ptr<PortableSettings> StorageManager::GetAppConfig(PCWSTR section) {
 
 std::unique_ptr<PortableSettings> StorageManager::GetModConfig(PCWSTR modName,
                                                                PCWSTR section) {
+    std::wstring snapshotSectionName = L"Mods\\";
+    snapshotSectionName += modName;
+    if (section) {
+        snapshotSectionName += L'\\';
+        snapshotSectionName += section;
+    }
+
+    if (auto snapshotSettings = GetConfigSnapshotSection(snapshotSectionName)) {
+        return snapshotSettings;
+    }
+
     if (portableStorage) {
         std::wstring iniFileName = modName;
         iniFileName += L".ini";
         auto modConfigPath = appDataPath / L"Mods" / iniFileName;
-        return std::make_unique<IniFileSettings>(
-            modConfigPath.c_str(), section ? section : L"Mod", false);
+        return std::make_unique<IniFileSettings>(modConfigPath.c_str(),
+                                                 section ? section : L"Mod",
+                                                 false, &iniFileCache);
     } else {
         const auto& registrySettingsPath = std::get<RegistryPath>(settingsPath);
         std::wstring subKey =
@@ -153,8 +282,9 @@ std::unique_ptr<PortableSettings> StorageManager::GetModWritableConfig(
         std::wstring iniFileName = modName;
         iniFileName += L".ini";
         auto modConfigPath = modsWritablePath / iniFileName;
-        return std::make_unique<IniFileSettings>(
-            modConfigPath.c_str(), section ? section : L"Mod", write);
+        return std::make_unique<IniFileSettings>(modConfigPath.c_str(),
+                                                 section ? section : L"Mod",
+                                                 write, &iniFileCache);
     } else {
         const auto& registrySettingsPath = std::get<RegistryPath>(settingsPath);
         std::wstring subKey =
@@ -170,11 +300,63 @@ std::unique_ptr<PortableSettings> StorageManager::GetModWritableConfig(
 }
 
 void StorageManager::EnumMods(std::function<void(PCWSTR)> enumCallback) {
+    if (auto snapshot = GetConfigSnapshot()) {
+        // The mod sections are "Mods\<name>", followed by their subsections.
+        constexpr std::wstring_view kPrefix = L"Mods\\";
+        for (size_t i = 0; i < snapshot->GetSectionCount(); i++) {
+            auto sectionName = snapshot->GetSectionAt(i).GetName();
+            if (sectionName.starts_with(kPrefix) &&
+                sectionName.find(L'\\', kPrefix.length()) ==
+                    sectionName.npos) {
+                // Section names are null-terminated.
+                enumCallback(sectionName.data() + kPrefix.length());
+            }
+        }
+
+        return;
+    }
+
+    auto callback = [&enumCallback](PCWSTR modName, ULONGLONG) {
+        enumCallback(modName);
+    };
+
+    if (portableStorage) {
+        IniFilesEnumMods(callback);
+    } else {
+        RegistryEnumMods(callback);
+    }
+}
+
+StorageManager::ModGenerations StorageManager::GetModGenerations() {
+    ModGenerations generations;
+
+    if (auto settings = GetConfigSnapshotSection(L"Mods")) {
+        // Maintained by the publisher of the snapshot, as the values of the
+        // Mods section.
+        for (auto it = settings->EnumStringValues(); it; ++it) {
+            generations.try_emplace(it->first, std::stoull(it->second));
+        }
+
+        return generations;
+    }
+
+    auto callback = [&generations](PCWSTR modName, ULONGLONG lastWriteTime) {
+        generations.try_emplace(modName, lastWriteTime);
+    };
+
     if (portableStorage) {
-        IniFilesEnumMods(std::move(enumCallback));
+        IniFilesEnumMods(callback);
     } else {
-        RegistryEnumMods(std::move(enumCallback));
+        RegistryEnumMods(callback);
     }
+
+    return generations;
+}
+
+void StorageManager::SetConfigSnapshot(
+    std::shared_ptr<const ConfigSnapshot::Reader> snapshot) {
+    std::lock_guard<std::mutex> guard(configSnapshotMutex);
+    configSnapshot = std::move(snapshot);
 }
 
 std::filesystem::path StorageManager::GetModStoragePath(PCWSTR modName) {
@@ -194,38 +376,6 @@ std::filesystem::path StorageManager::GetModMetadataPath(
     return appDataPath / L"ModsWritable" / metadataCategory;
 }
 
-wil::unique_hfile StorageManager::CreateModMetadataFile(PCWSTR metadataCategory,
-                                                        PCWSTR modInstanceId) {
-    auto metadataCategoryPath = GetModMetadataPath(metadataCategory);
-
-    if (!std::filesystem::is_directory(metadataCategoryPath)) {
-        std::error_code ec;
-        std::filesystem::create_directories(metadataCategoryPath, ec);
-    }
-
-    auto metadataFilePath = metadataCategoryPath / modInstanceId;
-
-    wil::unique_hfile file(CreateFile(
-        metadataFilePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
-        CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
-        nullptr));
-    THROW_LAST_ERROR_IF(!file);
-
-    return file;
-}
-
-void StorageManager::SetModMetadataValue(wil::unique_hfile& file,
-                                         PCWSTR value) {
-    THROW_LAST_ERROR_IF(SetFilePointer(file.get(), 0, nullptr, FILE_BEGIN) ==
-                        INVALID_SET_FILE_POINTER);
-    THROW_IF_WIN32_BOOL_FALSE(SetEndOfFile(file.get()));
-
-    DWORD dwNumberOfBytesWritten;
-    THROW_IF_WIN32_BOOL_FALSE(WriteFile(
-        file.get(), value, wil::safe_cast<DWORD>(wcslen(value) * sizeof(WCHAR)),
-        &dwNumberOfBytesWritten, nullptr));
-}
-
 std::filesystem::path StorageManager::GetEnginePath(USHORT machine) {
     std::filesystem::path libraryPath =
         wil::GetModuleFileName<std::wstring>(g_hDllInst);
@@ -305,6 +455,11 @@ std::filesystem::path StorageManager::GetSymbolsPath() {
     return appDataPath / L"Symbols";
 }
 
+std::filesystem::path StorageManager::GetTracesPath() {
+    // Must be writable by all processes.
+    return appDataPath / L"ModsWritable" / L"traces";
+}
+
 StorageManager::StorageManager() {
     std::filesystem::path dllPath =
         wil::GetModuleFileName<std::wstring>(g_hDllInst);
@@ -361,8 +516,29 @@ StorageManager::StorageManager() {
 
 StorageManager::~StorageManager() = default;
 
-void StorageManager::RegistryEnumMods(
-    std::function<void(PCWSTR)> enumCallback) {
+std::shared_ptr<const ConfigSnapshot::Reader>
+StorageManager::GetConfigSnapshot() {
+    std::lock_guard<std::mutex> guard(configSnapshotMutex);
+    return configSnapshot;
+}
+
+std::unique_ptr<PortableSettings> StorageManager::GetConfigSnapshotSection(
+    std::wstring_view sectionName) {
+    auto snapshot = GetConfigSnapshot();
+    if (!snapshot) {
+        return nullptr;
+    }
+
+    auto section = snapshot->FindSection(sectionName);
+    if (!section) {
+        return nullptr;
+    }
+
+    return std::make_unique<ConfigSnapshotSettings>(std::move(snapshot),
+                                                    *section);
+}
+
+void StorageManager::RegistryEnumMods(EnumModsCallback enumCallback) {
     const auto& registrySettingsPath = std::get<RegistryPath>(settingsPath);
     std::wstring subKey = registrySettingsPath.subKey + L"\\Mods";
 
@@ -390,9 +566,11 @@ void StorageManager::RegistryEnumMods(
         }
 
         DWORD dwSubKeyLen = dwMaxSubKeyLen + 1;
+        FILETIME lastWriteTime;
 
-        error = RegEnumKeyEx(hModsKey.get(), dwIndex, &subKeyName[0],
-                             &dwSubKeyLen, nullptr, nullptr, nullptr, nullptr);
+        error =
+            RegEnumKeyEx(hModsKey.get(), dwIndex, &subKeyName[0], &dwSubKeyLen,
+                         nullptr, nullptr, nullptr, &lastWriteTime);
         if (error == ERROR_NO_MORE_ITEMS) {
             break;
         }
@@ -404,14 +582,14 @@ void StorageManager::RegistryEnumMods(
 
         THROW_IF_WIN32_ERROR(error);
 
-        enumCallback(subKeyName.c_str());
+        enumCallback(subKeyName.c_str(),
+                     wil::filetime::to_int64(lastWriteTime));
 
         dwIndex++;
     }
 }
 
-void StorageManager::IniFilesEnumMods(
-    std::function<void(PCWSTR)> enumCallback) {
+void StorageManager::IniFilesEnumMods(EnumModsCallback enumCallback) {
     auto modsConfigPath = appDataPath / L"Mods";
 
     if (!std::filesystem::exists(modsConfigPath)) {
@@ -424,7 +602,8 @@ void StorageManager::IniFilesEnumMods(
         }
 
         if (p.path().extension() == L".ini") {
-            enumCallback(p.path().stem().c_str());
+            enumCallback(p.path().stem().c_str(),
+                         p.last_write_time().time_since_epoch().count());
         }
     }
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "config_snapshot.h"
+#include "ini_file.h"
 #include "no_destructor.h"
 #include "portable_settings.h"
 
@@ -20,18 +22,29 @@ class StorageManager {
                                                            bool write);
     void EnumMods(std::function<void(PCWSTR)> enumCallback);
 
+    // A value for each mod which changes whenever the mod's config changes,
+    // no matter which writer changed it, so that only the changed mods have
+    // to be re-read. With a config snapshot, it's the snapshot sequence in
+    // which the mod's config last changed. Otherwise, it's the last write
+    // time of the mod's registry key or INI file.
+    using ModGenerations = std::unordered_map<std::wstring, ULONGLONG>;
+    ModGenerations GetModGenerations();
+
+    // While set, the app and mod config sections which are included in the
+    // snapshot are read from it instead of the storage.
+    void SetConfigSnapshot(
+        std::shared_ptr<const ConfigSnapshot::Reader> snapshot);
+
     std::filesystem::path GetModStoragePath(PCWSTR modName);
 
     std::filesystem::path GetModMetadataPath(PCWSTR metadataCategory);
-    wil::unique_hfile CreateModMetadataFile(PCWSTR metadataCategory,
-                                            PCWSTR modInstanceId);
-    void SetModMetadataValue(wil::unique_hfile& file, PCWSTR value);
 
     std::filesystem::path GetEnginePath(
         USHORT machine = IMAGE_FILE_MACHINE_UNKNOWN);
     std::filesystem::path GetModsPath(
         USHORT machine = IMAGE_FILE_MACHINE_UNKNOWN);
     std::filesystem::path GetSymbolsPath();
+    std::filesystem::path GetTracesPath();
 
     class ModConfigChangeNotification {
        public:
@@ -62,8 +75,14 @@ class StorageManager {
     StorageManager();
     ~StorageManager();
 
-    void RegistryEnumMods(std::function<void(PCWSTR)> enumCallback);
-    void IniFilesEnumMods(std::function<void(PCWSTR)> enumCallback);
+    using EnumModsCallback =
+        std::function<void(PCWSTR modName, ULONGLONG lastWriteTime)>;
+    void RegistryEnumMods(EnumModsCallback enumCallback);
+    void IniFilesEnumMods(EnumModsCallback enumCallback);
+
+    std::shared_ptr<const ConfigSnapshot::Reader> GetConfigSnapshot();
+    std::unique_ptr<PortableSettings> GetConfigSnapshotSection(
+        std::wstring_view sectionName);
 
     struct RegistryPath {
         HKEY hKey = 0;
@@ -77,4 +96,7 @@ class StorageManager {
     bool portableStorage;
     std::filesystem::path appDataPath;
     std::variant<std::monostate, RegistryPath, IniFilePath> settingsPath;
+    IniFileCache iniFileCache;
+    std::mutex configSnapshotMutex;
+    std::shared_ptr<const ConfigSnapshot::Reader> configSnapshot;
 };
@@ -0,0 +1,65 @@
+#include "stdafx.h"
+
+#include "functions.h"
+#include "symbol_cache.h"
+
+namespace SymbolCache {
+
+std::optional<ULONG_PTR> ParseAddressOffset(std::wstring_view address,
+                                            DWORD moduleSizeOfImage) {
+    if (address.empty()) {
+        return std::nullopt;
+    }
+
+    // The offset is checked after each digit, so it stays below 2^32 before
+    // being multiplied, which can't overflow a 64-bit value. A ULONG_PTR
+    // would overflow in 32-bit processes.
+    UINT64 offset = 0;
+    for (WCHAR c : address) {
+        if (c < L'0' || c > L'9') {
+            return std::nullopt;
+        }
+
+        offset = offset * 10 + (c - L'0');
+        if (offset >= moduleSizeOfImage) {
+            return std::nullopt;
+        }
+    }
+
+    return static_cast<ULONG_PTR>(offset);
+}
+
+std::optional<std::vector<Entry>> Parse(std::wstring_view cache,
+                                        WCHAR separator,
+                                        DWORD moduleSizeOfImage) {
+    auto cacheParts = Functions::SplitStringToViews(cache, separator);
+
+    // In the new format, cacheParts[1] and cacheParts[2] are ignored and act
+    // like comments.
+    std::vector<Entry> entries;
+    if (cacheParts.size() < 3 ||
+        cacheParts[0] != std::wstring_view(&kVersion, 1)) {
+        return entries;
+    }
+
+    entries.reserve((cacheParts.size() - 3) / 2);
+
+    for (size_t i = 3; i + 1 < cacheParts.size(); i += 2) {
+        const auto& symbol = cacheParts[i];
+        const auto& address = cacheParts[i + 1];
+
+        Entry entry{.symbol = symbol};
+        if (!address.empty()) {
+            entry.offset = ParseAddressOffset(address, moduleSizeOfImage);
+            if (!entry.offset) {
+                return std::nullopt;
+            }
+        }
+
+        entries.push_back(entry);
+    }
+
+    return entries;
+}
+
+}  // namespace SymbolCache
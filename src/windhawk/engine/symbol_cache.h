@@ -0,0 +1,34 @@
+#pragma once
+
+// Parses the symbol cache strings which are stored in the SymbolCache section
+// of a mod config, or downloaded from the online symbol cache. The parts of a
+// cache string are separated by a separator character: the version, two parts
+// which are ignored, and then a symbol and its offset in the module for each
+// entry. An empty offset means that the symbol doesn't exist in the module.
+//
+// The cache might come from the online cache or be corrupted, so offsets are
+// validated before they're used.
+namespace SymbolCache {
+
+inline constexpr WCHAR kVersion = L'1';
+
+struct Entry {
+    std::wstring_view symbol;
+    // Empty if the symbol doesn't exist in the module.
+    std::optional<ULONG_PTR> offset;
+};
+
+// Parses a decimal offset without allocating. Returns std::nullopt if the
+// string isn't a plain decimal number, or if the offset is outside of the
+// module.
+std::optional<ULONG_PTR> ParseAddressOffset(std::wstring_view address,
+                                            DWORD moduleSizeOfImage);
+
+// Returns no entries if the cache has a different version. Returns
+// std::nullopt if any offset is invalid, so that a malformed cache is ignored
+// as a whole. The entries point into the cache string.
+std::optional<std::vector<Entry>> Parse(std::wstring_view cache,
+                                        WCHAR separator,
+                                        DWORD moduleSizeOfImage);
+
+}  // namespace SymbolCache
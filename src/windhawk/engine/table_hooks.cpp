@@ -0,0 +1,376 @@
+#include "stdafx.h"
+
+#include "logger.h"
+#include "no_destructor.h"
+#include "table_hooks.h"
+
+namespace {
+
+// Each stub chunk is an allocation granularity sized reservation with two
+// committed pages: stub code, which is made executable once all of the stubs
+// are written, and stub targets, which stay writable and non-executable.
+constexpr size_t kStubSize = 16;
+
+struct StubChunk {
+    BYTE* code;
+    void** targets;
+    size_t count;
+    size_t used;
+};
+
+// Writes a stub which jumps to *target.
+void WriteStubCode(BYTE* p, void** target) {
+#if defined(_M_IX86)
+    // jmp dword ptr [target]
+    p[0] = 0xFF;
+    p[1] = 0x25;
+    *reinterpret_cast<DWORD*>(p + 2) = reinterpret_cast<DWORD>(target);
+#elif defined(_M_X64)
+    // jmp qword ptr [rip+offset]
+    p[0] = 0xFF;
+    p[1] = 0x25;
+    *reinterpret_cast<LONG*>(p + 2) = static_cast<LONG>(
+        reinterpret_cast<BYTE*>(target) - (p + 6));
+#elif defined(_M_ARM64)
+    // ldr x16, target
+    // br x16
+    DWORD imm19 = static_cast<DWORD>(
+        (reinterpret_cast<BYTE*>(target) - p) / 4);
+    reinterpret_cast<DWORD*>(p)[0] = 0x58000010 | ((imm19 & 0x7FFFF) << 5);
+    reinterpret_cast<DWORD*>(p)[1] = 0xD61F0200;
+#else
+#error "Unsupported architecture"
+#endif
+}
+
+// Allocates a chunk. If nearModule is set, the chunk is placed above the
+// module base and within 4 GB of it, so that its stubs can be referenced by
+// export table RVAs.
+StubChunk AllocateStubChunk(HMODULE nearModule) {
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+
+    ULONG_PTR granularity = systemInfo.dwAllocationGranularity;
+    ULONG_PTR pageSize = systemInfo.dwPageSize;
+
+    wil::unique_virtualalloc_ptr<BYTE> chunk;
+
+    if (!nearModule) {
+        chunk.reset(static_cast<BYTE*>(VirtualAlloc(
+            nullptr, pageSize * 2, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE)));
+    } else {
+        ULONG_PTR address = reinterpret_cast<ULONG_PTR>(nearModule);
+        ULONG_PTR maxAddress = reinterpret_cast<ULONG_PTR>(
+            systemInfo.lpMaximumApplicationAddress);
+#ifdef _WIN64
+        maxAddress = std::min(maxAddress, address + 0xFFFFFFFF - granularity);
+#endif
+
+        while (!chunk && address < maxAddress) {
+            MEMORY_BASIC_INFORMATION mbi;
+            if (!VirtualQuery(reinterpret_cast<void*>(address), &mbi,
+                              sizeof(mbi))) {
+                break;
+            }
+
+            ULONG_PTR regionStart =
+                reinterpret_cast<ULONG_PTR>(mbi.BaseAddress);
+            ULONG_PTR regionEnd = regionStart + mbi.RegionSize;
+
+            if (mbi.State == MEM_FREE) {
+                ULONG_PTR candidate =
+                    (regionStart + granularity - 1) & ~(granularity - 1);
+                if (candidate < regionEnd) {
+                    chunk.reset(static_cast<BYTE*>(VirtualAlloc(
+                        reinterpret_cast<void*>(candidate), pageSize * 2,
+                        MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE)));
+                }
+            }
+
+            address = regionEnd;
+        }
+    }
+
+    if (!chunk) {
+        throw std::runtime_error("Failed to allocate a stub chunk");
+    }
+
+    BYTE* code = chunk.get();
+    void** targets = reinterpret_cast<void**>(code + pageSize);
+    size_t count = pageSize / kStubSize;
+
+    // Write all of the stubs at once, so that the code page never has to be
+    // made writable again. Unused stubs are never handed out.
+    memset(code, 0, pageSize);
+    for (size_t i = 0; i < count; i++) {
+        WriteStubCode(code + i * kStubSize, &targets[i]);
+    }
+
+    DWORD oldProtect;
+    THROW_IF_WIN32_BOOL_FALSE(
+        VirtualProtect(code, pageSize, PAGE_EXECUTE_READ, &oldProtect));
+    FlushInstructionCache(GetCurrentProcess(), code, pageSize);
+
+    chunk.release();
+
+    return {
+        .code = code,
+        .targets = targets,
+        .count = count,
+        .used = 0,
+    };
+}
+
+}  // namespace
+
+struct TableHook::Chain {
+    // The entry value and the function before the first hook was enabled.
+    ULONG_PTR originalValue;
+    void* originalFunction;
+    // In the order of enabling, the last hook is the one set in the entry.
+    std::vector<TableHook*> hooks;
+};
+
+// Shared by all mods, since they might hook the same entries.
+struct TableHook::State {
+    std::mutex mutex;
+    std::unordered_map<void*, Chain> chains;
+    std::vector<StubChunk> stubChunks;
+};
+
+TableHook::TableHook(void** entry, void* hookFunction)
+    : m_isExport(false),
+      m_entry(entry),
+      m_hookFunction(hookFunction),
+      m_hookValue(reinterpret_cast<ULONG_PTR>(hookFunction)),
+      m_exportedFunction(*entry) {
+    auto& state = GetState();
+    std::lock_guard<std::mutex> guard(state.mutex);
+
+    auto it = state.chains.find(m_entry);
+    m_originalStub = AllocateStub(
+        state, nullptr,
+        it != state.chains.end() ? GetChainTopFunction(it->second)
+                                 : m_exportedFunction);
+}
+
+TableHook::TableHook(HMODULE module,
+                     DWORD* entry,
+                     void* exportedFunction,
+                     void* hookFunction)
+    : m_isExport(true),
+      m_entry(entry),
+      m_hookFunction(hookFunction),
+      m_exportedFunction(exportedFunction) {
+    auto& state = GetState();
+    std::lock_guard<std::mutex> guard(state.mutex);
+
+    m_entryStub = AllocateStub(state, module, hookFunction);
+    m_hookValue = (reinterpret_cast<ULONG_PTR>(m_entryStub.code) -
+                   reinterpret_cast<ULONG_PTR>(module)) &
+                  0xFFFFFFFF;
+
+    auto it = state.chains.find(m_entry);
+    m_originalStub = AllocateStub(
+        state, nullptr,
+        it != state.chains.end() ? GetChainTopFunction(it->second)
+                                 : m_exportedFunction);
+}
+
+TableHook::~TableHook() {
+    try {
+        Disable();
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+}
+
+void TableHook::Enable() {
+    if (m_enabled) {
+        return;
+    }
+
+    auto& state = GetState();
+    std::lock_guard<std::mutex> guard(state.mutex);
+
+    auto [it, inserted] = state.chains.try_emplace(m_entry);
+    auto& chain = it->second;
+    if (inserted) {
+        chain.originalValue =
+            m_isExport ? *static_cast<DWORD*>(m_entry)
+                       : reinterpret_cast<ULONG_PTR>(*static_cast<void**>(
+                             m_entry));
+        chain.originalFunction =
+            m_isExport ? m_exportedFunction
+                       : reinterpret_cast<void*>(chain.originalValue);
+    }
+
+    // Resolve the original function now, the chain might have changed since
+    // the hook was created.
+    SetStubTarget(m_originalStub, GetChainTopFunction(chain));
+
+    try {
+        ExchangeEntry(m_entry, m_isExport, m_hookValue);
+    } catch (...) {
+        if (chain.hooks.empty()) {
+            state.chains.erase(it);
+        }
+
+        throw;
+    }
+
+    chain.hooks.push_back(this);
+    m_enabled = true;
+}
+
+void TableHook::Disable() {
+    if (!m_enabled) {
+        return;
+    }
+
+    auto& state = GetState();
+    std::lock_guard<std::mutex> guard(state.mutex);
+
+    auto it = state.chains.find(m_entry);
+    if (it == state.chains.end()) {
+        throw std::logic_error("Table hook chain not found");
+    }
+
+    auto& chain = it->second;
+    auto& hooks = chain.hooks;
+
+    auto hookIt = std::find(hooks.begin(), hooks.end(), this);
+    if (hookIt == hooks.end()) {
+        throw std::logic_error("Table hook not found in chain");
+    }
+
+    bool isFirst = hookIt == hooks.begin();
+    ULONG_PTR belowValue =
+        isFirst ? chain.originalValue : (*(hookIt - 1))->m_hookValue;
+    void* belowFunction =
+        isFirst ? chain.originalFunction : (*(hookIt - 1))->m_hookFunction;
+
+    if (hookIt + 1 == hooks.end()) {
+        ULONG_PTR previousValue =
+            ExchangeEntry(m_entry, m_isExport, belowValue);
+        if (previousValue != m_hookValue) {
+            // Someone else replaced the entry after us, and might still call
+            // our hook. The entry was restored anyway, since the hook function
+            // is about to go away.
+            LOG(L"Table entry %p was modified by a third party", m_entry);
+        }
+    } else {
+        // Make the hook above call the one below instead of this one.
+        SetStubTarget((*(hookIt + 1))->m_originalStub, belowFunction);
+    }
+
+    hooks.erase(hookIt);
+    void* originalFunction = chain.originalFunction;
+    if (hooks.empty()) {
+        state.chains.erase(it);
+    }
+
+    // The stubs might still be in use, by a thread which runs the hook
+    // function, or by a caller which got the export stub with GetProcAddress.
+    // Make them jump to the original function, which outlives all hooks.
+    SetStubTarget(m_originalStub, originalFunction);
+    if (m_isExport) {
+        SetStubTarget(m_entryStub, originalFunction);
+    }
+
+    m_enabled = false;
+}
+
+// static
+TableHook::State& TableHook::GetState() {
+    STATIC_INIT_ONCE(NoDestructorIfTerminating<State>, s);
+    return **s;
+}
+
+// static
+TableHook::Stub TableHook::AllocateStub(State& state,
+                                        HMODULE nearModule,
+                                        void* target) {
+    auto isUsable = [nearModule](const StubChunk& chunk) {
+        if (chunk.used == chunk.count) {
+            return false;
+        }
+
+        if (!nearModule) {
+            return true;
+        }
+
+        ULONG_PTR offset = reinterpret_cast<ULONG_PTR>(chunk.code) -
+                           reinterpret_cast<ULONG_PTR>(nearModule);
+        return chunk.code > reinterpret_cast<BYTE*>(nearModule) &&
+               offset <= 0xFFFFFFFF - chunk.count * kStubSize;
+    };
+
+    auto it = std::find_if(state.stubChunks.begin(), state.stubChunks.end(),
+                           isUsable);
+    if (it == state.stubChunks.end()) {
+        state.stubChunks.push_back(AllocateStubChunk(nearModule));
+        it = state.stubChunks.end() - 1;
+    }
+
+    size_t index = it->used++;
+
+    Stub stub{
+        .code = it->code + index * kStubSize,
+        .target = &it->targets[index],
+    };
+
+    SetStubTarget(stub, target);
+
+    return stub;
+}
+
+// static
+void TableHook::SetStubTarget(const Stub& stub, void* target) {
+    InterlockedExchangePointer(stub.target, target);
+}
+
+// Replaces an import table entry (a pointer) or an export table entry (an
+// RVA) atomically. Returns the previous value. Must be called with the state
+// lock held, so that protection changes of the same page don't race.
+// static
+ULONG_PTR TableHook::ExchangeEntry(void* entry,
+                                   bool isExport,
+                                   ULONG_PTR value) {
+    size_t size = isExport ? sizeof(DWORD) : sizeof(void*);
+
+    // Tables can share a page with code, keep it executable in that case so
+    // that threads running that code don't fault.
+    MEMORY_BASIC_INFORMATION mbi;
+    THROW_LAST_ERROR_IF(VirtualQuery(entry, &mbi, sizeof(mbi)) == 0);
+
+    constexpr DWORD kExecuteFlags = PAGE_EXECUTE | PAGE_EXECUTE_READ |
+                                    PAGE_EXECUTE_READWRITE |
+                                    PAGE_EXECUTE_WRITECOPY;
+    DWORD newProtect = (mbi.Protect & kExecuteFlags) ? PAGE_EXECUTE_READWRITE
+                                                     : PAGE_READWRITE;
+
+    DWORD oldProtect;
+    THROW_IF_WIN32_BOOL_FALSE(
+        VirtualProtect(entry, size, newProtect, &oldProtect));
+
+    ULONG_PTR previousValue;
+    if (isExport) {
+        previousValue = InterlockedExchange(static_cast<LONG*>(entry),
+                                            static_cast<LONG>(value));
+        previousValue &= 0xFFFFFFFF;
+    } else {
+        previousValue = reinterpret_cast<ULONG_PTR>(InterlockedExchangePointer(
+            static_cast<void**>(entry), reinterpret_cast<void*>(value)));
+    }
+
+    VirtualProtect(entry, size, oldProtect, &oldProtect);
+
+    return previousValue;
+}
+
+// static
+void* TableHook::GetChainTopFunction(const Chain& chain) {
+    return chain.hooks.empty() ? chain.originalFunction
+                               : chain.hooks.back()->m_hookFunction;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// A hook which replaces an import table entry (a function pointer) or an
+// export table entry (an RVA) instead of patching the function itself.
+//
+// Hooks of the same entry, possibly set by different mods, are chained like
+// inline hooks: the original function of each hook calls the next hook in the
+// chain, and is resolved when the hook is enabled. Removing a hook re-links
+// its neighbors, so hooks can be removed in any order.
+//
+// Calls go through jump stubs whose targets are kept on a separate
+// non-executable page. Retargeting a stub is an interlocked write which never
+// changes the protection of a page with code. Stubs are never freed, since
+// their addresses might be in use after the hook is removed.
+class TableHook {
+   public:
+    // entry is the import table entry.
+    TableHook(void** entry, void* hookFunction);
+
+    // entry is the export table entry of module. exportedFunction is the
+    // function which the entry resolves to, which differs from the RVA target
+    // for forwarded exports.
+    TableHook(HMODULE module,
+              DWORD* entry,
+              void* exportedFunction,
+              void* hookFunction);
+
+    // Disables the hook if it's enabled.
+    ~TableHook();
+
+    TableHook(const TableHook&) = delete;
+    TableHook& operator=(const TableHook&) = delete;
+
+    void* GetEntry() const { return m_entry; }
+
+    // A stub which calls the next hook in the chain, or the original function.
+    // Valid even before the hook is enabled.
+    void* GetOriginalFunction() const { return m_originalStub.code; }
+
+    bool IsEnabled() const { return m_enabled; }
+    void Enable();
+    void Disable();
+
+   private:
+    struct Stub {
+        void* code;
+        void** target;
+    };
+
+    struct Chain;
+    struct State;
+
+    static State& GetState();
+    static Stub AllocateStub(State& state, HMODULE nearModule, void* target);
+    static void SetStubTarget(const Stub& stub, void* target);
+    static ULONG_PTR ExchangeEntry(void* entry,
+                                  bool isExport,
+                                  ULONG_PTR value);
+    static void* GetChainTopFunction(const Chain& chain);
+
+    bool m_isExport;
+    void* m_entry;
+    void* m_hookFunction;
+    // The value written to the entry: the hook function for an import, the
+    // RVA of m_entryStub for an export.
+    ULONG_PTR m_hookValue;
+    // The original function, used if the entry isn't hooked yet.
+    void* m_exportedFunction;
+    Stub m_entryStub{};
+    Stub m_originalStub{};
+    bool m_enabled = false;
+};
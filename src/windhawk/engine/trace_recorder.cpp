@@ -0,0 +1,260 @@
+#include "stdafx.h"
+
+#include "functions.h"
+#include "logger.h"
+#include "storage_manager.h"
+#include "trace_recorder.h"
+
+namespace {
+
+// Limits the memory used by a long running process, such as a process which
+// keeps loading and unloading mods.
+constexpr size_t kMaxEvents = 16384;
+
+constexpr WCHAR kMergedFileName[] = L"merged.json";
+
+bool ReadEngineTracingSetting() {
+    try {
+        auto settings = StorageManager::GetInstance().GetAppConfig(L"Settings");
+        return settings->GetInt(L"EngineTracing").value_or(0) != 0;
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+
+    return false;
+}
+
+std::wstring GetProcessFileName() {
+    FILETIME creationTime;
+    FILETIME exitTime;
+    FILETIME kernelTime;
+    FILETIME userTime;
+    THROW_IF_WIN32_BOOL_FALSE(GetProcessTimes(GetCurrentProcess(),
+                                              &creationTime, &exitTime,
+                                              &kernelTime, &userTime));
+
+    // The creation time makes the name unique if a process id is reused.
+    WCHAR fileName[64];
+    swprintf_s(fileName, L"process_%u_%I64u.json", GetCurrentProcessId(),
+               wil::filetime::to_int64(creationTime));
+    return fileName;
+}
+
+void WriteFileContent(const std::filesystem::path& path,
+                      std::string_view content) {
+    wil::unique_hfile file(CreateFile(path.c_str(), GENERIC_WRITE,
+                                      FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                      nullptr, CREATE_ALWAYS,
+                                      FILE_ATTRIBUTE_NORMAL, nullptr));
+    THROW_LAST_ERROR_IF(!file);
+
+    DWORD written;
+    THROW_IF_WIN32_BOOL_FALSE(WriteFile(file.get(), content.data(),
+                                        static_cast<DWORD>(content.size()),
+                                        &written, nullptr));
+}
+
+std::string ReadFileContent(const std::filesystem::path& path) {
+    wil::unique_hfile file(
+        CreateFile(path.c_str(), GENERIC_READ,
+                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                   nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+    THROW_LAST_ERROR_IF(!file);
+
+    std::string content;
+    char buffer[4096];
+    DWORD read;
+    while (true) {
+        THROW_IF_WIN32_BOOL_FALSE(
+            ReadFile(file.get(), buffer, sizeof(buffer), &read, nullptr));
+        if (read == 0) {
+            break;
+        }
+
+        content.append(buffer, read);
+    }
+
+    return content;
+}
+
+void AppendEvent(std::string* content, std::string_view event) {
+    if (!content->empty()) {
+        *content += ",\n";
+    }
+
+    *content += event;
+}
+
+}  // namespace
+
+TraceRecorder::Span::Span(PCSTR name, std::wstring_view detail)
+    : m_name(name),
+      m_detail(detail),
+      m_begin(Functions::QueryPerformanceCounterValue()) {}
+
+TraceRecorder::Span::~Span() {
+    if (!IsEnabled()) {
+        return;
+    }
+
+    try {
+        GetInstance().AddEvent({
+            .name = m_name,
+            .detail = std::wstring(m_detail),
+            .begin = m_begin,
+            .end = Functions::QueryPerformanceCounterValue(),
+            .threadId = GetCurrentThreadId(),
+        });
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+}
+
+// static
+bool TraceRecorder::IsEnabled() {
+    // Engine settings changes restart the engine, so reading once is enough.
+    STATIC_INIT_ONCE_TRIVIAL(bool, enabled, ReadEngineTracingSetting());
+    return enabled;
+}
+
+// static
+TraceRecorder& TraceRecorder::GetInstance() {
+    STATIC_INIT_ONCE(TraceRecorder, traceRecorder);
+    return *traceRecorder;
+}
+
+void TraceRecorder::WriteProcessFile() {
+    DWORD processId = GetCurrentProcessId();
+
+    // Each event is written in a separate line, which is what MergeFiles
+    // relies on.
+    std::wstring json;
+    json += L"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":";
+    json += std::to_wstring(processId);
+    json += L",\"args\":{\"name\":";
+    Functions::AppendJsonString(
+        &json, wil::GetModuleFileName<std::wstring>(nullptr));
+    json += L"}}";
+
+    std::string events = Functions::WideToUtf8(json);
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        for (const auto& event : m_events) {
+            ULONGLONG begin =
+                Functions::PerformanceCounterToMicroseconds(event.begin);
+            ULONGLONG end =
+                Functions::PerformanceCounterToMicroseconds(event.end);
+
+            json = L"{\"name\":";
+            Functions::AppendJsonString(
+                &json, std::wstring(event.name,
+                                    event.name + strlen(event.name)));
+            json += L",\"cat\":\"windhawk\",\"ph\":\"X\",\"ts\":";
+            json += std::to_wstring(begin);
+            json += L",\"dur\":";
+            json += std::to_wstring(end - begin);
+            json += L",\"pid\":";
+            json += std::to_wstring(processId);
+            json += L",\"tid\":";
+            json += std::to_wstring(event.threadId);
+            if (!event.detail.empty()) {
+                json += L",\"args\":{\"detail\":";
+                Functions::AppendJsonString(&json, event.detail);
+                json += L"}";
+            }
+            json += L"}";
+
+            AppendEvent(&events, Functions::WideToUtf8(json));
+        }
+    }
+
+    WriteFileContent(
+        StorageManager::GetInstance().GetTracesPath() / GetProcessFileName(),
+        "[\n" + events + "\n]\n");
+}
+
+// static
+void TraceRecorder::DeleteFiles() {
+    auto tracesPath = StorageManager::GetInstance().GetTracesPath();
+
+    std::error_code ec;
+    std::filesystem::remove_all(tracesPath, ec);
+    if (ec) {
+        LOG(L"Removing %s failed: %S", tracesPath.c_str(),
+            ec.message().c_str());
+    }
+
+    std::filesystem::create_directories(tracesPath, ec);
+    if (ec) {
+        LOG(L"Creating %s failed: %S", tracesPath.c_str(),
+            ec.message().c_str());
+    }
+}
+
+// static
+void TraceRecorder::MergeFiles() {
+    auto tracesPath = StorageManager::GetInstance().GetTracesPath();
+
+    std::string events;
+
+    std::error_code ec;
+    for (const auto& entry :
+         std::filesystem::directory_iterator(tracesPath, ec)) {
+        auto fileName = entry.path().filename().wstring();
+        if (!fileName.starts_with(L"process_") ||
+            !fileName.ends_with(L".json")) {
+            continue;
+        }
+
+        std::string content;
+        try {
+            content = ReadFileContent(entry.path());
+        } catch (const std::exception& e) {
+            LOG(L"Reading %s failed: %S", fileName.c_str(), e.what());
+            continue;
+        }
+
+        // Take the event lines, skipping the array brackets. A file which is
+        // being written by a process that's still running might be
+        // truncated, in which case its last line is skipped.
+        size_t lineBegin = 0;
+        while (lineBegin < content.size()) {
+            size_t lineEnd = content.find('\n', lineBegin);
+            if (lineEnd == content.npos) {
+                break;
+            }
+
+            std::string_view line(content.data() + lineBegin,
+                                  lineEnd - lineBegin);
+            lineBegin = lineEnd + 1;
+
+            if (line.ends_with(',')) {
+                line.remove_suffix(1);
+            }
+
+            if (line.starts_with('{') && line.ends_with('}')) {
+                AppendEvent(&events, line);
+            }
+        }
+    }
+
+    if (ec) {
+        LOG(L"Listing %s failed: %S", tracesPath.c_str(),
+            ec.message().c_str());
+        return;
+    }
+
+    WriteFileContent(
+        tracesPath / kMergedFileName,
+        "{\"traceEvents\":[\n" + events + "\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+void TraceRecorder::AddEvent(Event event) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if (m_events.size() < kMaxEvents) {
+        m_events.push_back(std::move(event));
+    }
+}
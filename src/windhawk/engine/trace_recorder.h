@@ -0,0 +1,54 @@
+#pragma once
+
+// Records spans of engine activity, such as loading and initializing mods, if
+// the EngineTracing setting is enabled. The spans of each process are written
+// to a file in the traces folder in the Chrome trace event format, which can
+// be viewed in chrome://tracing or in Perfetto. The session manager merges the
+// files of all processes into a single timeline, merged.json.
+//
+// Timestamps are taken from the performance counter, which is shared by all
+// processes, so spans of different processes line up.
+class TraceRecorder {
+   public:
+    // Records the time between construction and destruction. The name must be
+    // a string literal, and the detail must outlive the span.
+    class Span {
+       public:
+        Span(PCSTR name, std::wstring_view detail = {});
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+       private:
+        PCSTR m_name;
+        std::wstring_view m_detail;
+        LONGLONG m_begin;
+    };
+
+    static bool IsEnabled();
+    static TraceRecorder& GetInstance();
+
+    // Writes the spans recorded so far to the file of the current process,
+    // replacing its previous content.
+    void WriteProcessFile();
+
+    // Used by the session manager to start a new timeline.
+    static void DeleteFiles();
+    // Used by the session manager to merge the files of all processes.
+    static void MergeFiles();
+
+   private:
+    struct Event {
+        PCSTR name;
+        std::wstring detail;
+        LONGLONG begin;
+        LONGLONG end;
+        DWORD threadId;
+    };
+
+    void AddEvent(Event event);
+
+    std::mutex m_mutex;
+    std::vector<Event> m_events;
+};
@@ -0,0 +1,649 @@
+#include "stdafx.h"
+
+#include "ini_file.h"
+
+#include "portable_settings.h"
+
+// Use WIL to throw exceptions if possible.
+#ifdef THROW_WIN32
+#define INI_FILE_THROW_WIN32(error) THROW_WIN32(error)
+#else
+#define INI_FILE_THROW_WIN32(error) throw PortableSettingsException(error)
+#endif
+
+namespace {
+
+constexpr BYTE kUtf8Bom[] = {0xEF, 0xBB, 0xBF};
+constexpr BYTE kUtf16LeBom[] = {0xFF, 0xFE};
+
+std::wstring_view TrimWhitespace(std::wstring_view s) {
+    size_t begin = s.find_first_not_of(L" \t");
+    if (begin == s.npos) {
+        return {};
+    }
+
+    size_t end = s.find_last_not_of(L" \t");
+    return s.substr(begin, end - begin + 1);
+}
+
+std::wstring DecodeText(const BYTE* data, size_t size, UINT codePage) {
+    if (size == 0) {
+        return {};
+    }
+
+    int chars = MultiByteToWideChar(codePage, 0,
+                                    reinterpret_cast<const char*>(data),
+                                    wil::safe_cast<int>(size), nullptr, 0);
+    if (chars == 0) {
+        INI_FILE_THROW_WIN32(GetLastError());
+    }
+
+    std::wstring result(chars, L'\0');
+    MultiByteToWideChar(codePage, 0, reinterpret_cast<const char*>(data),
+                        wil::safe_cast<int>(size), result.data(), chars);
+    return result;
+}
+
+void EncodeText(std::wstring_view text, UINT codePage, std::vector<BYTE>& out) {
+    if (text.empty()) {
+        return;
+    }
+
+    int bytes = WideCharToMultiByte(codePage, 0, text.data(),
+                                    wil::safe_cast<int>(text.length()), nullptr,
+                                    0, nullptr, nullptr);
+    if (bytes == 0) {
+        INI_FILE_THROW_WIN32(GetLastError());
+    }
+
+    size_t offset = out.size();
+    out.resize(offset + bytes);
+    WideCharToMultiByte(codePage, 0, text.data(),
+                        wil::safe_cast<int>(text.length()),
+                        reinterpret_cast<char*>(out.data() + offset), bytes,
+                        nullptr, nullptr);
+}
+
+// Returns the section name if the line is a section header.
+std::optional<std::wstring_view> ParseSectionHeader(std::wstring_view line) {
+    line = TrimWhitespace(line);
+    if (line.empty() || line[0] != L'[') {
+        return std::nullopt;
+    }
+
+    line.remove_prefix(1);
+    size_t end = line.find(L']');
+    if (end != line.npos) {
+        line = line.substr(0, end);
+    }
+
+    return TrimWhitespace(line);
+}
+
+// Returns the key name and value if the line is a key line.
+std::optional<std::pair<std::wstring_view, std::wstring_view>> ParseKeyLine(
+    std::wstring_view line) {
+    line = TrimWhitespace(line);
+    if (line.empty() || line[0] == L';') {
+        return std::nullopt;
+    }
+
+    size_t equals = line.find(L'=');
+    if (equals == line.npos) {
+        return std::nullopt;
+    }
+
+    std::wstring_view name = TrimWhitespace(line.substr(0, equals));
+    if (name.empty()) {
+        return std::nullopt;
+    }
+
+    std::wstring_view value = TrimWhitespace(line.substr(equals + 1));
+    if (value.length() >= 2 && (value[0] == L'"' || value[0] == L'\'') &&
+        value.back() == value[0]) {
+        value = value.substr(1, value.length() - 2);
+    }
+
+    return std::make_pair(name, value);
+}
+
+std::wstring MakeKeyLine(std::wstring_view keyName, std::wstring_view value) {
+    std::wstring line;
+    line.reserve(keyName.length() + 1 + value.length());
+    line += keyName;
+    line += L'=';
+    line += value;
+    return line;
+}
+
+std::wstring MakeSectionHeader(std::wstring_view sectionName) {
+    std::wstring line;
+    line.reserve(sectionName.length() + 2);
+    line += L'[';
+    line += sectionName;
+    line += L']';
+    return line;
+}
+
+wil::unique_hfile OpenFileForReading(PCWSTR path) {
+    // Allow the file to be replaced while it's open.
+    return wil::unique_hfile(
+        CreateFile(path, GENERIC_READ,
+                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                   nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+}
+
+std::vector<BYTE> ReadWholeFile(HANDLE file, ULONGLONG fileSize) {
+    std::vector<BYTE> data(wil::safe_cast<size_t>(fileSize));
+
+    size_t offset = 0;
+    while (offset < data.size()) {
+        DWORD bytesRead;
+        if (!ReadFile(file, data.data() + offset,
+                      wil::safe_cast<DWORD>(std::min<size_t>(
+                          data.size() - offset, 0x10000000)),
+                      &bytesRead, nullptr)) {
+            INI_FILE_THROW_WIN32(GetLastError());
+        }
+
+        if (bytesRead == 0) {
+            // The file was truncated while reading.
+            data.resize(offset);
+            break;
+        }
+
+        offset += bytesRead;
+    }
+
+    return data;
+}
+
+void WriteWholeFile(PCWSTR path, const std::vector<BYTE>& data) {
+    wil::unique_hfile file(CreateFile(path, GENERIC_WRITE, 0, nullptr,
+                                      CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                                      nullptr));
+    if (!file) {
+        INI_FILE_THROW_WIN32(GetLastError());
+    }
+
+    size_t offset = 0;
+    while (offset < data.size()) {
+        DWORD bytesWritten;
+        if (!WriteFile(file.get(), data.data() + offset,
+                       wil::safe_cast<DWORD>(std::min<size_t>(
+                           data.size() - offset, 0x10000000)),
+                       &bytesWritten, nullptr)) {
+            INI_FILE_THROW_WIN32(GetLastError());
+        }
+
+        offset += bytesWritten;
+    }
+}
+
+// Serializes updates of the file across processes until the returned handle
+// is closed. The lock file is kept, since deleting it would allow two
+// processes to lock two different files with the same name.
+wil::unique_hfile LockFileForUpdate(PCWSTR path) {
+    std::wstring lockPath = path;
+    lockPath += L".lock";
+
+    wil::unique_hfile file(CreateFile(
+        lockPath.c_str(), GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_HIDDEN, nullptr));
+    if (!file) {
+        INI_FILE_THROW_WIN32(GetLastError());
+    }
+
+    OVERLAPPED overlapped{};
+    if (!LockFileEx(file.get(), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0,
+                    &overlapped)) {
+        INI_FILE_THROW_WIN32(GetLastError());
+    }
+
+    return file;
+}
+
+void UnlockFileForUpdate(HANDLE file) {
+    OVERLAPPED overlapped{};
+    UnlockFileEx(file, 0, 1, 0, &overlapped);
+}
+
+std::wstring CacheKeyFromPath(PCWSTR path) {
+    std::wstring key = path;
+    CharUpperBuff(key.data(), wil::safe_cast<DWORD>(key.length()));
+    return key;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// IniFile
+
+IniFile::IniFile(const BYTE* data, size_t size) {
+    std::wstring text;
+
+    if (size >= sizeof(kUtf16LeBom) &&
+        memcmp(data, kUtf16LeBom, sizeof(kUtf16LeBom)) == 0) {
+        m_encoding = Encoding::kUtf16Le;
+        m_hasBom = true;
+        text.assign(reinterpret_cast<const WCHAR*>(data + sizeof(kUtf16LeBom)),
+                    (size - sizeof(kUtf16LeBom)) / sizeof(WCHAR));
+    } else if (size >= sizeof(kUtf8Bom) &&
+               memcmp(data, kUtf8Bom, sizeof(kUtf8Bom)) == 0) {
+        m_encoding = Encoding::kUtf8;
+        m_hasBom = true;
+        text = DecodeText(data + sizeof(kUtf8Bom), size - sizeof(kUtf8Bom),
+                          CP_UTF8);
+    } else {
+        // Files without a BOM are treated as ANSI, like the
+        // GetPrivateProfileString family of functions does.
+        m_encoding = Encoding::kAnsi;
+        m_hasBom = false;
+        text = DecodeText(data, size, CP_ACP);
+    }
+
+    std::wstring_view remaining = text;
+    while (!remaining.empty()) {
+        size_t lineEnd = remaining.find(L'\n');
+        std::wstring_view line = remaining.substr(0, lineEnd);
+        remaining.remove_prefix(lineEnd == remaining.npos ? remaining.length()
+                                                          : lineEnd + 1);
+
+        if (!line.empty() && line.back() == L'\r') {
+            line.remove_suffix(1);
+        }
+
+        m_lines.emplace_back(line);
+    }
+
+    BuildIndex();
+}
+
+std::optional<std::wstring_view> IniFile::GetValue(
+    std::wstring_view sectionName,
+    std::wstring_view keyName) const {
+    const Section* section = FindSection(sectionName);
+    if (!section) {
+        return std::nullopt;
+    }
+
+    auto it = section->keyIndex.find(keyName);
+    if (it == section->keyIndex.end()) {
+        return std::nullopt;
+    }
+
+    return section->keys[it->second].value;
+}
+
+std::vector<std::pair<std::wstring_view, std::wstring_view>> IniFile::GetValues(
+    std::wstring_view sectionName) const {
+    std::vector<std::pair<std::wstring_view, std::wstring_view>> values;
+
+    const Section* section = FindSection(sectionName);
+    if (section) {
+        values.reserve(section->keys.size());
+        for (const auto& key : section->keys) {
+            values.emplace_back(key.name, key.value);
+        }
+    }
+
+    return values;
+}
+
+void IniFile::SetValue(std::wstring_view sectionName,
+                       std::wstring_view keyName,
+                       std::wstring_view value) {
+    std::wstring keyLine = MakeKeyLine(keyName, value);
+
+    // The index is updated in place. Names which don't read back as
+    // themselves, e.g. a key name with "=", are rare, and the whole index is
+    // rebuilt for them to get the same result as parsing the written file.
+    auto parsedKeyLine = ParseKeyLine(keyLine);
+    if (!parsedKeyLine || !NamesEqual(parsedKeyLine->first, keyName)) {
+        SetValueAndBuildIndex(sectionName, keyName, std::move(keyLine));
+        return;
+    }
+
+    std::wstring_view parsedValue = parsedKeyLine->second;
+
+    auto sectionIt = m_sections.find(sectionName);
+    if (sectionIt == m_sections.end()) {
+        std::wstring sectionHeader = MakeSectionHeader(sectionName);
+        auto parsedSectionName = ParseSectionHeader(sectionHeader);
+        if (!parsedSectionName ||
+            !NamesEqual(*parsedSectionName, sectionName)) {
+            SetValueAndBuildIndex(sectionName, keyName, std::move(keyLine));
+            return;
+        }
+
+        // The last section, if any, already ends at the new section.
+        size_t headerLine = m_lines.size();
+        Section section{
+            .headerLine = headerLine,
+            .endLine = headerLine + 2,
+        };
+        section.keyIndex.try_emplace(std::wstring(parsedKeyLine->first), 0);
+        section.keys.push_back({std::wstring(parsedKeyLine->first),
+                                std::wstring(parsedValue), headerLine + 1});
+
+        m_sections.try_emplace(std::wstring(*parsedSectionName),
+                               std::move(section));
+        m_lines.push_back(std::move(sectionHeader));
+        m_lines.push_back(std::move(keyLine));
+        return;
+    }
+
+    Section& section = sectionIt->second;
+    if (auto it = section.keyIndex.find(keyName);
+        it != section.keyIndex.end()) {
+        Key& key = section.keys[it->second];
+        key.name = parsedKeyLine->first;
+        key.value = parsedValue;
+        m_lines[key.line] = std::move(keyLine);
+        return;
+    }
+
+    // Insert after the last key of the section, or right after the header if
+    // the section has no keys.
+    size_t insertAt = section.keys.empty() ? section.headerLine + 1
+                                           : section.keys.back().line + 1;
+
+    // Copied before the line, which the parsed views point to, is moved.
+    Key key{std::wstring(parsedKeyLine->first), std::wstring(parsedValue),
+            insertAt};
+
+    m_lines.insert(m_lines.begin() + insertAt, std::move(keyLine));
+    ShiftLineIndices(insertAt, 1);
+
+    section.keyIndex.try_emplace(key.name, section.keys.size());
+    section.keys.push_back(std::move(key));
+}
+
+void IniFile::RemoveValue(std::wstring_view sectionName,
+                          std::wstring_view keyName) {
+    const Section* section = FindSection(sectionName);
+    if (!section) {
+        return;
+    }
+
+    auto it = section->keyIndex.find(keyName);
+    if (it == section->keyIndex.end()) {
+        return;
+    }
+
+    m_lines.erase(m_lines.begin() + section->keys[it->second].line);
+
+    BuildIndex();
+}
+
+void IniFile::RemoveSection(std::wstring_view sectionName) {
+    const Section* section = FindSection(sectionName);
+    if (!section) {
+        return;
+    }
+
+    m_lines.erase(m_lines.begin() + section->headerLine,
+                  m_lines.begin() + section->endLine);
+
+    BuildIndex();
+}
+
+std::vector<BYTE> IniFile::Serialize() const {
+    std::vector<BYTE> data;
+
+    size_t textLength = 0;
+    for (const auto& line : m_lines) {
+        textLength += line.length() + 2;
+    }
+
+    if (m_encoding == Encoding::kUtf16Le) {
+        data.reserve(sizeof(kUtf16LeBom) + textLength * sizeof(WCHAR));
+        if (m_hasBom) {
+            data.insert(data.end(), std::begin(kUtf16LeBom),
+                        std::end(kUtf16LeBom));
+        }
+
+        for (const auto& line : m_lines) {
+            auto lineBytes = reinterpret_cast<const BYTE*>(line.data());
+            data.insert(data.end(), lineBytes,
+                        lineBytes + line.length() * sizeof(WCHAR));
+            data.insert(data.end(), {'\r', 0, '\n', 0});
+        }
+    } else {
+        UINT codePage = m_encoding == Encoding::kUtf8 ? CP_UTF8 : CP_ACP;
+
+        data.reserve(sizeof(kUtf8Bom) + textLength);
+        if (m_hasBom) {
+            data.insert(data.end(), std::begin(kUtf8Bom), std::end(kUtf8Bom));
+        }
+
+        for (const auto& line : m_lines) {
+            EncodeText(line, codePage, data);
+            data.insert(data.end(), {'\r', '\n'});
+        }
+    }
+
+    return data;
+}
+
+// static
+bool IniFile::NamesEqual(std::wstring_view a, std::wstring_view b) {
+    return CompareStringOrdinal(a.data(), wil::safe_cast<int>(a.length()),
+                                b.data(), wil::safe_cast<int>(b.length()),
+                                /*bIgnoreCase=*/TRUE) == CSTR_EQUAL;
+}
+
+bool IniFile::NameLess::operator()(std::wstring_view a,
+                                   std::wstring_view b) const {
+    return CompareStringOrdinal(a.data(), wil::safe_cast<int>(a.length()),
+                                b.data(), wil::safe_cast<int>(b.length()),
+                                /*bIgnoreCase=*/TRUE) == CSTR_LESS_THAN;
+}
+
+void IniFile::SetValueAndBuildIndex(std::wstring_view sectionName,
+                                    std::wstring_view keyName,
+                                    std::wstring keyLine) {
+    const Section* section = FindSection(sectionName);
+    if (!section) {
+        m_lines.push_back(MakeSectionHeader(sectionName));
+        m_lines.push_back(std::move(keyLine));
+    } else if (auto it = section->keyIndex.find(keyName);
+               it != section->keyIndex.end()) {
+        m_lines[section->keys[it->second].line] = std::move(keyLine);
+    } else {
+        size_t insertAt = section->keys.empty()
+                              ? section->headerLine + 1
+                              : section->keys.back().line + 1;
+        m_lines.insert(m_lines.begin() + insertAt, std::move(keyLine));
+    }
+
+    BuildIndex();
+}
+
+void IniFile::ShiftLineIndices(size_t fromLine, size_t count) {
+    for (auto& [name, section] : m_sections) {
+        if (section.headerLine >= fromLine) {
+            section.headerLine += count;
+        }
+
+        if (section.endLine >= fromLine) {
+            section.endLine += count;
+        }
+
+        for (auto& key : section.keys) {
+            if (key.line >= fromLine) {
+                key.line += count;
+            }
+        }
+    }
+}
+
+void IniFile::BuildIndex() {
+    m_sections.clear();
+
+    Section* currentSection = nullptr;
+    for (size_t i = 0; i < m_lines.size(); i++) {
+        const auto& line = m_lines[i];
+
+        if (auto sectionName = ParseSectionHeader(line)) {
+            if (currentSection) {
+                currentSection->endLine = i;
+            }
+
+            auto [it, inserted] =
+                m_sections.try_emplace(std::wstring(*sectionName));
+            if (inserted) {
+                currentSection = &it->second;
+                currentSection->headerLine = i;
+            } else {
+                // A duplicate section, its keys are ignored.
+                currentSection = nullptr;
+            }
+
+            continue;
+        }
+
+        if (!currentSection) {
+            continue;
+        }
+
+        if (auto keyAndValue = ParseKeyLine(line)) {
+            auto [name, value] = *keyAndValue;
+            auto [it, inserted] = currentSection->keyIndex.try_emplace(
+                std::wstring(name), currentSection->keys.size());
+            if (inserted) {
+                currentSection->keys.push_back(
+                    {std::wstring(name), std::wstring(value), i});
+            }
+        }
+    }
+
+    if (currentSection) {
+        currentSection->endLine = m_lines.size();
+    }
+}
+
+const IniFile::Section* IniFile::FindSection(
+    std::wstring_view sectionName) const {
+    auto it = m_sections.find(sectionName);
+    if (it == m_sections.end()) {
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// IniFileCache
+
+bool IniFileCache::FileVersion::operator==(const FileVersion& other) const {
+    return volumeSerialNumber == other.volumeSerialNumber &&
+           fileIndex == other.fileIndex && fileSize == other.fileSize &&
+           CompareFileTime(&lastWriteTime, &other.lastWriteTime) == 0;
+}
+
+// static
+std::shared_ptr<const IniFile> IniFileCache::Load(IniFileCache* cache,
+                                                  PCWSTR path) {
+    wil::unique_hfile file = OpenFileForReading(path);
+    if (!file) {
+        DWORD error = GetLastError();
+        if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND) {
+            return nullptr;
+        }
+
+        INI_FILE_THROW_WIN32(error);
+    }
+
+    BY_HANDLE_FILE_INFORMATION fileInformation;
+    if (!GetFileInformationByHandle(file.get(), &fileInformation)) {
+        INI_FILE_THROW_WIN32(GetLastError());
+    }
+
+    FileVersion version{
+        .volumeSerialNumber = fileInformation.dwVolumeSerialNumber,
+        .fileIndex = (ULONGLONG)fileInformation.nFileIndexHigh << 32 |
+                     fileInformation.nFileIndexLow,
+        .fileSize = (ULONGLONG)fileInformation.nFileSizeHigh << 32 |
+                    fileInformation.nFileSizeLow,
+        .lastWriteTime = fileInformation.ftLastWriteTime,
+    };
+
+    std::wstring cacheKey;
+    if (cache) {
+        cacheKey = CacheKeyFromPath(path);
+
+        std::lock_guard<std::mutex> guard(cache->m_mutex);
+        auto it = cache->m_entries.find(cacheKey);
+        if (it != cache->m_entries.end() && it->second.version == version) {
+            return it->second.iniFile;
+        }
+    }
+
+    std::vector<BYTE> data = ReadWholeFile(file.get(), version.fileSize);
+    auto iniFile = std::make_shared<const IniFile>(data.data(), data.size());
+
+    if (cache) {
+        std::lock_guard<std::mutex> guard(cache->m_mutex);
+        cache->m_entries.insert_or_assign(std::move(cacheKey),
+                                          Entry{version, iniFile});
+    }
+
+    return iniFile;
+}
+
+// static
+void IniFileCache::Update(IniFileCache* cache,
+                          PCWSTR path,
+                          const std::function<void(IniFile& iniFile)>& modify) {
+    std::unique_lock<std::mutex> updateLock;
+    if (cache) {
+        updateLock = std::unique_lock<std::mutex>(cache->m_updateMutex);
+    }
+
+    // Other processes might update the file concurrently, and the file must
+    // not change between reading it and replacing it, or their changes would
+    // be lost.
+    wil::unique_hfile lockFile = LockFileForUpdate(path);
+    auto unlock = wil::scope_exit(
+        [&lockFile] { UnlockFileForUpdate(lockFile.get()); });
+
+    auto currentIniFile = Load(cache, path);
+    IniFile iniFile = currentIniFile ? *currentIniFile : IniFile();
+    modify(iniFile);
+
+    // Write to a temporary file in the same folder, then replace the target
+    // file, so that readers never see a partially written file.
+    std::wstring tempPath = path;
+    tempPath += L'.';
+    tempPath += std::to_wstring(GetCurrentProcessId());
+    tempPath += L'.';
+    tempPath += std::to_wstring(GetCurrentThreadId());
+    tempPath += L".tmp";
+
+    try {
+        WriteWholeFile(tempPath.c_str(), iniFile.Serialize());
+    } catch (...) {
+        DeleteFile(tempPath.c_str());
+        throw;
+    }
+
+    // The target file might be briefly opened without FILE_SHARE_DELETE by
+    // another process, retry a few times in this case.
+    constexpr int kMaxAttempts = 5;
+    for (int attempt = 1;; attempt++) {
+        if (MoveFileEx(tempPath.c_str(), path, MOVEFILE_REPLACE_EXISTING)) {
+            break;
+        }
+
+        DWORD error = GetLastError();
+        if (attempt == kMaxAttempts || (error != ERROR_ACCESS_DENIED &&
+                                        error != ERROR_SHARING_VIOLATION)) {
+            DeleteFile(tempPath.c_str());
+            INI_FILE_THROW_WIN32(error);
+        }
+
+        Sleep(10 * attempt);
+    }
+}
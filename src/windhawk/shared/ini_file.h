@@ -0,0 +1,118 @@
+#pragma once
+
+// An INI file which is read and written in the same format as the
+// GetPrivateProfileString family of functions: section and key names are
+// case-insensitive, names and values are trimmed, and a value enclosed in
+// quotation marks has them removed. Unlike these functions, the file is parsed
+// once and then queried from memory, and changes replace the file atomically.
+//
+// The lines of the file are kept as is, so that writing a file results in the
+// same bytes except for the changed lines. Lines are always written with CRLF
+// line endings, like the GetPrivateProfileString family of functions does.
+class IniFile {
+   public:
+    enum class Encoding {
+        kAnsi,
+        kUtf8,
+        kUtf16Le,
+    };
+
+    // Creates an empty file. New files are created as UTF-16LE with a BOM to
+    // enable Unicode.
+    IniFile() = default;
+    IniFile(const BYTE* data, size_t size);
+
+    std::optional<std::wstring_view> GetValue(std::wstring_view sectionName,
+                                              std::wstring_view keyName) const;
+    // Returns the keys and values of the section in file order.
+    std::vector<std::pair<std::wstring_view, std::wstring_view>> GetValues(
+        std::wstring_view sectionName) const;
+
+    void SetValue(std::wstring_view sectionName,
+                  std::wstring_view keyName,
+                  std::wstring_view value);
+    void RemoveValue(std::wstring_view sectionName, std::wstring_view keyName);
+    void RemoveSection(std::wstring_view sectionName);
+
+    std::vector<BYTE> Serialize() const;
+
+   private:
+    struct NameLess {
+        using is_transparent = void;
+        bool operator()(std::wstring_view a, std::wstring_view b) const;
+    };
+
+    struct Key {
+        std::wstring name;
+        std::wstring value;
+        size_t line;
+    };
+
+    struct Section {
+        size_t headerLine;
+        // The index of the next section's header line, or the line count.
+        size_t endLine;
+        // The keys in file order, and an index by name.
+        std::vector<Key> keys;
+        std::map<std::wstring, size_t, NameLess> keyIndex;
+    };
+
+    static bool NamesEqual(std::wstring_view a, std::wstring_view b);
+
+    void SetValueAndBuildIndex(std::wstring_view sectionName,
+                               std::wstring_view keyName,
+                               std::wstring keyLine);
+    // Lines were inserted at fromLine, which is inside a section or at its
+    // end.
+    void ShiftLineIndices(size_t fromLine, size_t count);
+    void BuildIndex();
+    const Section* FindSection(std::wstring_view sectionName) const;
+
+    Encoding m_encoding = Encoding::kUtf16Le;
+    bool m_hasBom = true;
+    std::vector<std::wstring> m_lines;
+    // Only the first occurrence of each section and key is used, like the
+    // GetPrivateProfileString family of functions does.
+    std::map<std::wstring, Section, NameLess> m_sections;
+};
+
+// Caches parsed INI files, and reuses them as long as the file on disk wasn't
+// replaced or modified, as indicated by its file id, size and last write time.
+class IniFileCache {
+   public:
+    IniFileCache() = default;
+
+    IniFileCache(const IniFileCache&) = delete;
+    IniFileCache& operator=(const IniFileCache&) = delete;
+
+    // Returns nullptr if the file doesn't exist. `cache` can be nullptr.
+    static std::shared_ptr<const IniFile> Load(IniFileCache* cache,
+                                               PCWSTR path);
+    // Calls `modify` with the current contents of the file, or an empty file
+    // if it doesn't exist, and atomically replaces the file with the result.
+    // Updates are serialized across processes with a lock file next to the
+    // file. `cache` can be nullptr.
+    static void Update(IniFileCache* cache,
+                       PCWSTR path,
+                       const std::function<void(IniFile& iniFile)>& modify);
+
+   private:
+    struct FileVersion {
+        DWORD volumeSerialNumber;
+        ULONGLONG fileIndex;
+        ULONGLONG fileSize;
+        FILETIME lastWriteTime;
+
+        bool operator==(const FileVersion& other) const;
+    };
+
+    struct Entry {
+        FileVersion version;
+        std::shared_ptr<const IniFile> iniFile;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::wstring, Entry> m_entries;
+    // Serializes updates within the process.
+    std::mutex m_updateMutex;
+};
@@ -26,11 +26,16 @@ void LoggerBase::VLogLine(PCWSTR format, va_list args) {
     }
 
     // Leave only a single trailing newline.
-    if (buffer[len + 1] == L'\n' && buffer[len + 2] == L'\n') {
-        buffer[len + 2] = L'\0';
+    if (buffer[len + 1] == L'\n') {
+        len++;
+        buffer[len + 1] = L'\0';
     }
 
-    OutputDebugString(buffer);
+    WriteLine(buffer, len + 1);
+}
+
+void LoggerBase::WriteLine(PCWSTR line, size_t length) {
+    OutputDebugString(line);
 }
 
 void LoggerBase::LogLine(PCWSTR format, ...) {
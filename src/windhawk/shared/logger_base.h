@@ -11,12 +11,17 @@ class LoggerBase {
     static constexpr auto kDefaultVerbosity = Verbosity::kOn;
 
     LoggerBase(Verbosity initialVerbosity);
+    virtual ~LoggerBase() = default;
 
     void SetVerbosity(Verbosity verbosity);
     Verbosity GetVerbosity();
     void VLogLine(PCWSTR format, va_list args);
     void LogLine(PCWSTR format, ...);
 
+   protected:
+    // Outputs a formatted line. Writes to the debugger output by default.
+    virtual void WriteLine(PCWSTR line, size_t length);
+
    private:
     std::atomic<Verbosity> m_verbosity = kDefaultVerbosity;
 };
@@ -0,0 +1,583 @@
+#include "stdafx.h"
+
+#include "mod_status_table.h"
+
+#include "session_private_namespace.h"
+
+struct ModStatusTable::Header {
+    // Set last, once the rest of the header is initialized.
+    volatile LONG magic;
+    DWORD formatVersion;
+    DWORD slotCount;
+    // Slots at or above this index were never claimed, and aren't read.
+    volatile LONG slotHighWaterMark;
+};
+
+struct ModStatusTable::TableSlot {
+    volatile LONG sequence;
+    Kind kind;
+    // The process id in the low part, and the claim time in seconds since
+    // kOwnerEpoch in the high part, which is used to tell whether the process
+    // is still running. Zero if the slot is free.
+    volatile LONG64 owner;
+    FILETIME claimTime;
+    WCHAR modName[128];
+    WCHAR processName[128];
+    WCHAR text[128];
+    volatile LONG64 metrics[kMetricCount];
+};
+
+namespace {
+
+constexpr LONG kMagic = 'TSMW';
+constexpr DWORD kFormatVersion = 4;
+
+// 2020-01-01, so that the claim time in seconds fits in 32 bits.
+constexpr ULONGLONG kOwnerEpoch = 132223104000000000;
+constexpr ULONGLONG kFileTimeSecond = 10000000;
+
+// A slot which stays odd for that long belongs to a process which was
+// terminated while writing it.
+constexpr int kReadSlotAttempts = 10;
+
+constexpr PCWSTR kChangeEventNames[] = {
+    L"ModStatusTableStatusChanged",
+    L"ModStatusTableTaskChanged",
+};
+
+std::wstring MakeObjectName(DWORD sessionManagerProcessId, PCWSTR objectName) {
+    WCHAR sessionPrivateNamespaceName
+        [SessionPrivateNamespace::kPrivateNamespaceMaxLen + 1];
+    SessionPrivateNamespace::MakeName(sessionPrivateNamespaceName,
+                                      sessionManagerProcessId);
+
+    std::wstring name = sessionPrivateNamespaceName;
+    name += L'\\';
+    name += objectName;
+    return name;
+}
+
+// Allows everyone, including app containers and untrusted processes, to open
+// the object with the given access only.
+wil::unique_hlocal CreateSecurityDescriptor(DWORD access) {
+    WCHAR stringSecurityDescriptor[256];
+    swprintf_s(stringSecurityDescriptor,
+               L"D:P(A;;0x%08X;;;WD)(A;;0x%08X;;;S-1-15-2-1)"
+               L"(A;;0x%08X;;;S-1-15-2-2)S:(ML;;NW;;;S-1-16-0)",
+               access, access, access);
+
+    wil::unique_hlocal secDesc;
+    THROW_IF_WIN32_BOOL_FALSE(
+        ConvertStringSecurityDescriptorToSecurityDescriptor(
+            stringSecurityDescriptor, SDDL_REVISION_1, &secDesc, nullptr));
+
+    return secDesc;
+}
+
+wil::unique_private_namespace_close OpenSessionPrivateNamespace(
+    DWORD sessionManagerProcessId) {
+    // The namespace is already available in the session manager process.
+    if (sessionManagerProcessId == GetCurrentProcessId()) {
+        return {};
+    }
+
+    return SessionPrivateNamespace::Open(sessionManagerProcessId);
+}
+
+ULONG FileTimeToOwnerSeconds(const FILETIME& fileTime) {
+    ULONGLONG time = wil::filetime::to_int64(fileTime);
+    if (time <= kOwnerEpoch) {
+        return 0;
+    }
+
+    return static_cast<ULONG>((time - kOwnerEpoch) / kFileTimeSecond);
+}
+
+LONG64 MakeOwner(const FILETIME& claimTime) {
+    return (static_cast<LONG64>(FileTimeToOwnerSeconds(claimTime)) << 32) |
+           GetCurrentProcessId();
+}
+
+DWORD GetOwnerProcessId(LONG64 owner) {
+    return static_cast<DWORD>(owner);
+}
+
+bool IsOwnerRunning(LONG64 owner) {
+    wil::unique_process_handle process(OpenProcess(
+        PROCESS_QUERY_LIMITED_INFORMATION, FALSE, GetOwnerProcessId(owner)));
+    if (!process) {
+        // Assume that a process which can't be accessed is running.
+        return GetLastError() != ERROR_INVALID_PARAMETER;
+    }
+
+    DWORD exitCode;
+    if (GetExitCodeProcess(process.get(), &exitCode) &&
+        exitCode != STILL_ACTIVE) {
+        return false;
+    }
+
+    // Make sure that the process id wasn't reused by a newer process.
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(process.get(), &creationTime, &exitTime, &kernelTime,
+                         &userTime)) {
+        return true;
+    }
+
+    return FileTimeToOwnerSeconds(creationTime) <=
+           static_cast<ULONG>(owner >> 32);
+}
+
+LONG64 ReadOwner(volatile LONG64* owner) {
+    // A plain 64-bit read isn't atomic in 32-bit processes.
+    return InterlockedCompareExchange64(owner, 0, 0);
+}
+
+LONG64 ReadMetric(volatile LONG64* metric) {
+    return InterlockedCompareExchange64(metric, 0, 0);
+}
+
+template <size_t N>
+void CopyToField(WCHAR (&field)[N], std::wstring_view string) {
+    size_t length = std::min(string.length(), N - 1);
+    memcpy(field, string.data(), length * sizeof(WCHAR));
+    field[length] = L'\0';
+}
+
+template <size_t N>
+std::wstring CopyFromField(const WCHAR (&field)[N]) {
+    // The field might not be terminated if the table was corrupted.
+    return std::wstring(field, wcsnlen(field, N));
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// Slot
+
+ModStatusTable::Slot::Slot(std::shared_ptr<ModStatusTable> table,
+                           Kind kind,
+                           std::wstring_view modName)
+    : m_table(std::move(table)), m_kind(kind) {
+    std::filesystem::path processPath =
+        wil::QueryFullProcessImageName<std::wstring>(GetCurrentProcess());
+
+    m_index = m_table->ClaimSlot(kind, modName,
+                                 processPath.filename().native(), &m_owner);
+}
+
+ModStatusTable::Slot::~Slot() {
+    m_table->ReleaseSlot(m_index, m_kind, m_owner);
+}
+
+void ModStatusTable::Slot::SetText(std::wstring_view text) {
+    m_table->WriteSlotText(m_index, m_kind, m_owner, text);
+}
+
+void ModStatusTable::Slot::AddToMetric(Metric metric, LONG64 value) {
+    m_table->AddToSlotMetric(m_index, m_owner, metric, value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ChangeNotification
+
+ModStatusTable::ChangeNotification::ChangeNotification(
+    DWORD sessionManagerProcessId,
+    Kind kind) {
+    if (static_cast<size_t>(kind) >= std::size(kChangeEventNames)) {
+        throw std::logic_error("Changes of this kind aren't notified");
+    }
+
+    auto privateNamespace =
+        OpenSessionPrivateNamespace(sessionManagerProcessId);
+
+    m_event.reset(OpenEvent(
+        EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE,
+        MakeObjectName(sessionManagerProcessId,
+                       kChangeEventNames[static_cast<size_t>(kind)])
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_event);
+}
+
+HANDLE ModStatusTable::ChangeNotification::GetHandle() {
+    return m_event.get();
+}
+
+void ModStatusTable::ChangeNotification::ContinueMonitoring() {
+    // Changes made from now on set the event again. Earlier changes are seen
+    // by the read which follows the notification.
+    m_event.ResetEvent();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ModStatusTable
+
+// static
+ModStatusTable ModStatusTable::Create() {
+    DWORD sessionManagerProcessId = GetCurrentProcessId();
+
+    ModStatusTable table;
+
+    {
+        auto secDesc =
+            CreateSecurityDescriptor(EVENT_MODIFY_STATE | SYNCHRONIZE);
+
+        SECURITY_ATTRIBUTES secAttr = {sizeof(SECURITY_ATTRIBUTES)};
+        secAttr.lpSecurityDescriptor = secDesc.get();
+        secAttr.bInheritHandle = FALSE;
+
+        for (size_t i = 0; i < std::size(kChangeEventNames); i++) {
+            table.m_changeEvents[i].reset(
+                CreateEvent(&secAttr, TRUE, FALSE,
+                            MakeObjectName(sessionManagerProcessId,
+                                           kChangeEventNames[i])
+                                .c_str()));
+            THROW_LAST_ERROR_IF(!table.m_changeEvents[i] ||
+                                GetLastError() == ERROR_ALREADY_EXISTS);
+        }
+    }
+
+    auto secDesc = CreateSecurityDescriptor(FILE_MAP_READ | FILE_MAP_WRITE);
+
+    SECURITY_ATTRIBUTES secAttr = {sizeof(SECURITY_ATTRIBUTES)};
+    secAttr.lpSecurityDescriptor = secDesc.get();
+    secAttr.bInheritHandle = FALSE;
+
+    ULONGLONG mappingSize = sizeof(Header) + sizeof(TableSlot) * kSlotCount;
+    wil::unique_handle mapping(CreateFileMapping(
+        INVALID_HANDLE_VALUE, &secAttr, PAGE_READWRITE,
+        static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize),
+        MakeObjectName(sessionManagerProcessId, L"ModStatusTable").c_str()));
+    THROW_LAST_ERROR_IF(!mapping || GetLastError() == ERROR_ALREADY_EXISTS);
+
+    table.MapView(mapping.get());
+
+    // The rest of the table is zeroed, which means that all slots are free.
+    Header* header = table.GetHeader();
+    header->slotCount = kSlotCount;
+    header->formatVersion = kFormatVersion;
+    InterlockedExchange(&header->magic, kMagic);
+
+    return table;
+}
+
+// static
+ModStatusTable ModStatusTable::Open(DWORD sessionManagerProcessId) {
+    auto privateNamespace =
+        OpenSessionPrivateNamespace(sessionManagerProcessId);
+
+    ModStatusTable table;
+
+    for (size_t i = 0; i < std::size(kChangeEventNames); i++) {
+        table.m_changeEvents[i].reset(OpenEvent(
+            EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE,
+            MakeObjectName(sessionManagerProcessId, kChangeEventNames[i])
+                .c_str()));
+        THROW_LAST_ERROR_IF(!table.m_changeEvents[i]);
+    }
+
+    wil::unique_handle mapping(OpenFileMapping(
+        FILE_MAP_READ | FILE_MAP_WRITE, FALSE,
+        MakeObjectName(sessionManagerProcessId, L"ModStatusTable").c_str()));
+    THROW_LAST_ERROR_IF(!mapping);
+
+    table.MapView(mapping.get());
+
+    const Header* header = table.GetHeader();
+    if (ReadAcquire(&header->magic) != kMagic ||
+        header->formatVersion != kFormatVersion ||
+        header->slotCount != kSlotCount) {
+        throw std::runtime_error("Mod status table format is unsupported");
+    }
+
+    return table;
+}
+
+// static
+PCWSTR ModStatusTable::GetMetricName(Metric metric) {
+    switch (metric) {
+        case Metric::kHooksInstalled:
+            return L"hooks_installed";
+        case Metric::kThreadFreezes:
+            return L"thread_freezes";
+        case Metric::kThreadFreezeTime:
+            return L"thread_freeze_time_us";
+        case Metric::kSymbolLocalCacheHits:
+            return L"symbol_local_cache_hits";
+        case Metric::kSymbolLocalCacheMisses:
+            return L"symbol_local_cache_misses";
+        case Metric::kSymbolOnlineCacheHits:
+            return L"symbol_online_cache_hits";
+        case Metric::kSymbolOnlineCacheMisses:
+            return L"symbol_online_cache_misses";
+        case Metric::kSymbolEnumerations:
+            return L"symbol_enumerations";
+        case Metric::kBytesDownloaded:
+            return L"bytes_downloaded";
+        case Metric::kSettingsReads:
+            return L"settings_reads";
+        case Metric::kReloads:
+            return L"reloads";
+        case Metric::kUnloadWaitTime:
+            return L"unload_wait_time_us";
+        case Metric::kLoadTime:
+            return L"load_time_us";
+        case Metric::kInitTime:
+            return L"init_time_us";
+        case Metric::kSymbolResolutionTime:
+            return L"symbol_resolution_time_us";
+        case Metric::kHookSetupTime:
+            return L"hook_setup_time_us";
+        case Metric::kHookCalls:
+            return L"hook_calls";
+    }
+
+    throw std::logic_error("Unknown metric");
+}
+
+std::vector<ModStatusTable::Row> ModStatusTable::ReadRows(Kind kind) {
+    DWORD slotCount = std::min(
+        static_cast<DWORD>(ReadAcquire(&GetHeader()->slotHighWaterMark)),
+        kSlotCount);
+    if (m_cachedSlots.size() < slotCount) {
+        m_cachedSlots.resize(slotCount);
+    }
+
+    std::vector<Row> rows;
+
+    // Processes usually have several rows, check each process once.
+    std::unordered_map<LONG64, bool> ownerRunning;
+
+    for (DWORD i = 0; i < slotCount; i++) {
+        CachedSlot& cachedSlot = m_cachedSlots[i];
+        ReadSlot(i, &cachedSlot);
+
+        if (!cachedSlot.row || cachedSlot.kind != kind) {
+            continue;
+        }
+
+        auto [it, inserted] = ownerRunning.try_emplace(cachedSlot.owner);
+        if (inserted) {
+            it->second = IsOwnerRunning(cachedSlot.owner);
+        }
+
+        if (it->second) {
+            rows.push_back(*cachedSlot.row);
+            if (kind == Kind::kMetrics || kind == Kind::kHookCalls) {
+                ReadSlotMetrics(i, &rows.back());
+            }
+        }
+    }
+
+    return rows;
+}
+
+void ModStatusTable::MapView(HANDLE mapping) {
+    m_view.reset(MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0,
+                               0));
+    THROW_LAST_ERROR_IF_NULL(m_view);
+}
+
+ModStatusTable::Header* ModStatusTable::GetHeader() const {
+    return static_cast<Header*>(m_view.get());
+}
+
+ModStatusTable::TableSlot* ModStatusTable::GetSlot(DWORD index) const {
+    return reinterpret_cast<TableSlot*>(GetHeader() + 1) + index;
+}
+
+DWORD ModStatusTable::ClaimSlot(Kind kind,
+                                std::wstring_view modName,
+                                std::wstring_view processName,
+                                LONG64* owner) {
+    FILETIME claimTime;
+    GetSystemTimeAsFileTime(&claimTime);
+
+    LONG64 newOwner = MakeOwner(claimTime);
+
+    // Free slots are looked for first. Only if there are none, slots of
+    // processes which are no longer running are reclaimed.
+    for (bool reclaim : {false, true}) {
+        for (DWORD i = 0; i < kSlotCount; i++) {
+            TableSlot* slot = GetSlot(i);
+
+            LONG64 currentOwner = ReadOwner(&slot->owner);
+            if (currentOwner != 0 &&
+                (!reclaim || IsOwnerRunning(currentOwner))) {
+                continue;
+            }
+
+            Kind previousKind = slot->kind;
+
+            if (InterlockedCompareExchange64(&slot->owner, newOwner,
+                                             currentOwner) != currentOwner) {
+                continue;
+            }
+
+            // Raise the high water mark to include the slot.
+            LONG highWaterMark = ReadAcquire(&GetHeader()->slotHighWaterMark);
+            while (highWaterMark <= static_cast<LONG>(i)) {
+                LONG previous = InterlockedCompareExchange(
+                    &GetHeader()->slotHighWaterMark, i + 1, highWaterMark);
+                if (previous == highWaterMark) {
+                    break;
+                }
+
+                highWaterMark = previous;
+            }
+
+            // A slot left by a terminated writer might be odd, start a new
+            // odd sequence number either way.
+            LONG sequence = (ReadNoFence(&slot->sequence) + 1) | 1;
+            InterlockedExchange(&slot->sequence, sequence);
+
+            slot->kind = kind;
+            slot->claimTime = claimTime;
+            CopyToField(slot->modName, modName);
+            CopyToField(slot->processName, processName);
+            slot->text[0] = L'\0';
+            for (auto& metric : slot->metrics) {
+                InterlockedExchange64(&metric, 0);
+            }
+
+            InterlockedExchange(&slot->sequence, sequence + 1);
+
+            if (currentOwner != 0) {
+                // The row of the terminated process is gone.
+                NotifyChanged(previousKind);
+            }
+
+            *owner = newOwner;
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Mod status table is full");
+}
+
+void ModStatusTable::WriteSlotText(DWORD index,
+                                   Kind kind,
+                                   LONG64 owner,
+                                   std::wstring_view text) {
+    TableSlot* slot = GetSlot(index);
+    if (ReadOwner(&slot->owner) != owner) {
+        throw std::runtime_error("Mod status table slot was reclaimed");
+    }
+
+    // The owner is the only writer, so the sequence number is even here.
+    LONG sequence = ReadNoFence(&slot->sequence) + 1;
+    InterlockedExchange(&slot->sequence, sequence);
+
+    CopyToField(slot->text, text);
+
+    InterlockedExchange(&slot->sequence, sequence + 1);
+
+    NotifyChanged(kind);
+}
+
+void ModStatusTable::AddToSlotMetric(DWORD index,
+                                     LONG64 owner,
+                                     Metric metric,
+                                     LONG64 value) {
+    TableSlot* slot = GetSlot(index);
+    if (ReadOwner(&slot->owner) != owner) {
+        // The slot was reclaimed, which only happens if the table is full.
+        return;
+    }
+
+    InterlockedExchangeAdd64(&slot->metrics[static_cast<size_t>(metric)],
+                             value);
+}
+
+void ModStatusTable::ReleaseSlot(DWORD index, Kind kind, LONG64 owner) {
+    TableSlot* slot = GetSlot(index);
+    if (ReadOwner(&slot->owner) != owner) {
+        return;
+    }
+
+    bool hadText = slot->text[0] != L'\0';
+
+    LONG sequence = ReadNoFence(&slot->sequence) + 1;
+    InterlockedExchange(&slot->sequence, sequence);
+
+    slot->modName[0] = L'\0';
+    slot->processName[0] = L'\0';
+    slot->text[0] = L'\0';
+
+    InterlockedExchange(&slot->sequence, sequence + 1);
+
+    // Free the slot only after writing it, since a new owner might start
+    // writing it right away.
+    InterlockedCompareExchange64(&slot->owner, 0, owner);
+
+    if (hadText) {
+        NotifyChanged(kind);
+    }
+}
+
+void ModStatusTable::ReadSlot(DWORD index, CachedSlot* cachedSlot) const {
+    TableSlot* slot = GetSlot(index);
+
+    for (int attempt = 0; attempt < kReadSlotAttempts; attempt++) {
+        LONG sequence = ReadAcquire(&slot->sequence);
+        if (sequence == cachedSlot->sequence) {
+            return;
+        }
+
+        if (sequence & 1) {
+            SwitchToThread();
+            continue;
+        }
+
+        Kind kind = slot->kind;
+        LONG64 owner = ReadOwner(&slot->owner);
+        FILETIME claimTime = slot->claimTime;
+        std::wstring modName = CopyFromField(slot->modName);
+        std::wstring processName = CopyFromField(slot->processName);
+        std::wstring text = CopyFromField(slot->text);
+
+        // Make sure that the copy is complete before checking the sequence
+        // number again.
+        MemoryBarrier();
+
+        if (ReadNoFence(&slot->sequence) != sequence) {
+            continue;
+        }
+
+        cachedSlot->sequence = sequence;
+        cachedSlot->kind = kind;
+        cachedSlot->owner = owner;
+        if (owner != 0 && (!text.empty() || kind == Kind::kMetrics)) {
+            cachedSlot->row = Row{
+                .processId = GetOwnerProcessId(owner),
+                .creationTime = claimTime,
+                .modName = std::move(modName),
+                .processName = std::move(processName),
+                .text = std::move(text),
+            };
+        } else {
+            cachedSlot->row.reset();
+        }
+
+        return;
+    }
+
+    // The slot is being written for too long, skip it for now. The sequence
+    // number isn't updated, so that it's read again next time.
+    cachedSlot->row.reset();
+}
+
+void ModStatusTable::ReadSlotMetrics(DWORD index, Row* row) const {
+    TableSlot* slot = GetSlot(index);
+
+    for (size_t i = 0; i < kMetricCount; i++) {
+        row->metrics[i] = ReadMetric(&slot->metrics[i]);
+    }
+}
+
+void ModStatusTable::NotifyChanged(Kind kind) {
+    // The kind might come from a corrupted slot.
+    size_t eventIndex = static_cast<size_t>(kind);
+    if (eventIndex < std::size(m_changeEvents)) {
+        SetEvent(m_changeEvents[eventIndex].get());
+    }
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+// A table of the mod statuses and the mod tasks of all processes in the
+// session, in shared memory in the session private namespace. The engine
+// writes a row for each mod status and each mod task, and the app reads the
+// table to show the loaded mods and the tasks in progress.
+//
+// The table has a fixed layout of fixed-size slots. A slot is claimed by a
+// process with an atomic compare-and-swap of its owner, and is then only
+// written by its owner. Each slot has a sequence number, which is odd while
+// the slot is being written, so that readers can copy a slot without locking
+// and retry if it changed during the copy. The sequence number also serves as
+// the generation of the slot, so readers only copy slots which changed since
+// their last read.
+//
+// Slots of processes which exited without releasing their slots are skipped by
+// readers, and are reclaimed once the table is full.
+//
+// Each slot also has a set of counters, which are used by metrics and hook
+// calls rows. The counters are only ever added to, with interlocked
+// operations, and aren't covered by the sequence number.
+class ModStatusTable {
+   public:
+    enum class Kind : LONG {
+        kStatus,
+        kTask,
+        // The counters of a mod in a process, or of the engine in a process if
+        // the mod name is empty. Changes aren't notified.
+        kMetrics,
+        // The calls to a hooked function of a mod in a process, counted in the
+        // kHookCalls counter. The text is the name of the function. Changes
+        // aren't notified.
+        kHookCalls,
+    };
+
+    enum class Metric : DWORD {
+        kHooksInstalled,
+        // Applying queued hooks. Only counted if the other threads of the
+        // process were frozen, which doesn't happen if nothing was queued.
+        // The time is in microseconds.
+        kThreadFreezes,
+        kThreadFreezeTime,
+        kSymbolLocalCacheHits,
+        kSymbolLocalCacheMisses,
+        kSymbolOnlineCacheHits,
+        kSymbolOnlineCacheMisses,
+        kSymbolEnumerations,
+        kBytesDownloaded,
+        kSettingsReads,
+        kReloads,
+        // Waiting for threads to leave the code of unloaded mods, in
+        // microseconds.
+        kUnloadWaitTime,
+        // Wall time of a mod's startup steps, in microseconds. The init time
+        // includes symbol resolution and hook setup done by Wh_ModInit, both
+        // of which are also counted when done later. The symbol resolution
+        // time includes setting the hooks of the found symbols.
+        kLoadTime,
+        kInitTime,
+        kSymbolResolutionTime,
+        kHookSetupTime,
+        // Calls to hooked functions, only counted if hook call counting is
+        // enabled.
+        kHookCalls,
+    };
+
+    static constexpr size_t kMetricCount =
+        static_cast<size_t>(Metric::kHookCalls) + 1;
+
+    struct Row {
+        DWORD processId;
+        // The time the slot was claimed.
+        FILETIME creationTime;
+        std::wstring modName;
+        std::wstring processName;
+        std::wstring text;
+        // Only set for metrics and hook calls rows.
+        LONG64 metrics[kMetricCount]{};
+    };
+
+    // A slot owned by the current process, released on destruction. A slot
+    // must not be written by multiple threads concurrently, except for adding
+    // to its counters.
+    class Slot {
+       public:
+        // Throws if the table is full.
+        Slot(std::shared_ptr<ModStatusTable> table,
+             Kind kind,
+             std::wstring_view modName);
+        ~Slot();
+
+        Slot(const Slot&) = delete;
+        Slot& operator=(const Slot&) = delete;
+
+        void SetText(std::wstring_view text);
+        void AddToMetric(Metric metric, LONG64 value);
+
+       private:
+        std::shared_ptr<ModStatusTable> m_table;
+        Kind m_kind;
+        DWORD m_index;
+        LONG64 m_owner;
+    };
+
+    // Signaled when a row of the given kind, other than kMetrics, changes.
+    class ChangeNotification {
+       public:
+        ChangeNotification(DWORD sessionManagerProcessId, Kind kind);
+
+        HANDLE GetHandle();
+        void ContinueMonitoring();
+
+       private:
+        wil::unique_event m_event;
+    };
+
+    static constexpr DWORD kSlotCount = 8192;
+
+    // A stable name for exports, such as "hooks_installed".
+    static PCWSTR GetMetricName(Metric metric);
+
+    // Creates the table in the session manager process. The session private
+    // namespace must already exist.
+    static ModStatusTable Create();
+    // Opens the table of the given session manager process.
+    static ModStatusTable Open(DWORD sessionManagerProcessId);
+
+    // Returns the rows of the given kind of running processes. Only slots
+    // which changed since the previous call are copied, except for the
+    // counters of metrics and hook calls rows, which are always read.
+    std::vector<Row> ReadRows(Kind kind);
+
+   private:
+    struct Header;
+    struct TableSlot;
+
+    struct CachedSlot {
+        LONG sequence = 0;
+        Kind kind = Kind::kStatus;
+        LONG64 owner = 0;
+        std::optional<Row> row;
+    };
+
+    ModStatusTable() = default;
+
+    void MapView(HANDLE mapping);
+    Header* GetHeader() const;
+    TableSlot* GetSlot(DWORD index) const;
+    DWORD ClaimSlot(Kind kind,
+                    std::wstring_view modName,
+                    std::wstring_view processName,
+                    LONG64* owner);
+    void WriteSlotText(DWORD index,
+                       Kind kind,
+                       LONG64 owner,
+                       std::wstring_view text);
+    void AddToSlotMetric(DWORD index,
+                         LONG64 owner,
+                         Metric metric,
+                         LONG64 value);
+    void ReleaseSlot(DWORD index, Kind kind, LONG64 owner);
+    void ReadSlot(DWORD index, CachedSlot* cachedSlot) const;
+    void ReadSlotMetrics(DWORD index, Row* row) const;
+    void NotifyChanged(Kind kind);
+
+    wil::unique_mapview_ptr<void> m_view;
+    wil::unique_event m_changeEvents[2];
+    std::vector<CachedSlot> m_cachedSlots;
+};
@@ -2,6 +2,8 @@
 
 #include "portable_settings.h"
 
+#include "ini_file.h"
+
 // Use WIL to throw exceptions if possible.
 #ifdef THROW_WIN32
 #define PORTABLE_SETTINGS_THROW_WIN32(error) THROW_WIN32(error)
@@ -10,31 +12,6 @@
     throw PortableSettingsException(error)
 #endif
 
-////////////////////////////////////////////////////////////////////////////////
-// EnumIteratorImpl
-
-template <typename Type>
-class EnumIteratorImpl {
-   public:
-    bool is_done() const { return done; }
-
-    const std::pair<std::wstring, Type>& get_item() const { return item; }
-
-    virtual void next() = 0;
-    virtual std::unique_ptr<EnumIteratorImpl> clone() const = 0;
-    virtual ~EnumIteratorImpl() = default;
-
-   protected:
-    EnumIteratorImpl() = default;
-    EnumIteratorImpl(const EnumIteratorImpl&) = default;
-    EnumIteratorImpl(EnumIteratorImpl&&) = default;
-    EnumIteratorImpl& operator=(const EnumIteratorImpl&) = default;
-    EnumIteratorImpl& operator=(EnumIteratorImpl&&) = default;
-
-    bool done = false;
-    std::pair<std::wstring, Type> item;
-};
-
 ////////////////////////////////////////////////////////////////////////////////
 // EnumIterator
 
@@ -71,7 +48,7 @@ PortableSettings::EnumIterator<Type>::~EnumIterator() = default;
 
 template <typename Type>
 PortableSettings::EnumIterator<Type>::operator bool() const {
-    return impl->is_done();
+    return !impl->is_done();
 }
 
 template <typename Type>
@@ -467,6 +444,17 @@ int HexDigitValue(WCHAR hexDigit) {
     throw std::invalid_argument("invalid hex digit");
 }
 
+int StringToInt(const std::wstring& data) {
+    long longValue = std::stol(data, nullptr, 0);
+    if (longValue > INT_MAX) {
+        return INT_MAX;
+    } else if (longValue < INT_MIN) {
+        return INT_MIN;
+    }
+
+    return wil::safe_cast<int>(longValue);
+}
+
 }  // namespace IniFileSettingsHelperFunctions
 }  // namespace
 
@@ -477,50 +465,28 @@ template <typename Type>
 class EnumIteratorIniFileBase : public EnumIteratorImpl<Type> {
    public:
     EnumIteratorIniFileBase(const IniFileSettings* settings)
-        : settings(settings) {
-        for (DWORD size = 256;; size += 256) {
-            SetLastError(0);
-
-            valueNames.resize(size);
-            UINT returnedSize = GetPrivateProfileString(
-                settings->sectionName.c_str(), nullptr, nullptr, &valueNames[0],
-                size, settings->filename.c_str());
-
-            DWORD error = GetLastError();
-            if (error == ERROR_MORE_DATA) {
-                continue;  // try with a larger buffer
-            } else if (error != ERROR_SUCCESS) {
-                PORTABLE_SETTINGS_THROW_WIN32(error);
-            }
-
-            valueNames.resize(returnedSize);
-            break;
+        : iniFile(IniFileCache::Load(settings->cache,
+                                     settings->filename.c_str())) {
+        // The values are enumerated from a single parsed copy of the file,
+        // which is kept alive by the iterator.
+        if (iniFile) {
+            values = iniFile->GetValues(settings->sectionName);
         }
     }
 
    protected:
-    std::optional<std::wstring> get_next_value_name() {
-        size_t nextValueNameLen = wcslen(valueNames.c_str());
-        if (nextValueNameLen == 0) {
+    std::optional<std::pair<std::wstring_view, std::wstring_view>>
+    get_next_item_raw() {
+        if (index >= values.size()) {
             return std::nullopt;
         }
 
-        std::wstring nextValueName = valueNames.substr(0, nextValueNameLen);
-        valueNames.erase(0, nextValueNameLen + 1);
-
-        return nextValueName;
-    }
-
-    std::optional<std::wstring> get_string(PCWSTR valueName) const {
-        return settings->GetString(valueName);
-    }
-
-    std::optional<int> get_int(PCWSTR valueName) const {
-        return settings->GetInt(valueName);
+        return values[index++];
     }
 
-    const IniFileSettings* settings;
-    std::wstring valueNames;
+    std::shared_ptr<const IniFile> iniFile;
+    std::vector<std::pair<std::wstring_view, std::wstring_view>> values;
+    size_t index = 0;
 };
 
 class EnumIteratorIniFileInt : public EnumIteratorIniFileBase<int> {
@@ -531,19 +497,18 @@ class EnumIteratorIniFileInt : public EnumIteratorIniFileBase<int> {
     }
 
     void next() override {
-        auto valueName = get_next_value_name();
-        if (!valueName) {
+        auto result = get_next_item_raw();
+        if (!result) {
             done = true;
             return;
         }
 
-        auto itemValue = get_int(valueName->c_str());
-        if (!itemValue) {
-            done = true;
-            return;
-        }
+        auto [valueName, data] = *result;
+
+        int itemValue =
+            IniFileSettingsHelperFunctions::StringToInt(std::wstring(data));
 
-        item = {std::move(*valueName), *itemValue};
+        item = {std::wstring(valueName), itemValue};
     }
 
     std::unique_ptr<EnumIteratorImpl> clone() const override {
@@ -559,19 +524,15 @@ class EnumIteratorIniFileString : public EnumIteratorIniFileBase<std::wstring> {
     }
 
     void next() override {
-        auto valueName = get_next_value_name();
-        if (!valueName) {
+        auto result = get_next_item_raw();
+        if (!result) {
             done = true;
             return;
         }
 
-        auto itemValue = get_string(valueName->c_str());
-        if (!itemValue) {
-            done = true;
-            return;
-        }
+        auto [valueName, data] = *result;
 
-        item = {std::move(*valueName), std::move(*itemValue)};
+        item = {std::wstring(valueName), std::wstring(data)};
     }
 
     std::unique_ptr<EnumIteratorImpl> clone() const override {
@@ -584,8 +545,9 @@ class EnumIteratorIniFileString : public EnumIteratorIniFileBase<std::wstring> {
 
 IniFileSettings::IniFileSettings(PCWSTR filename,
                                  PCWSTR sectionName,
-                                 bool write)
-    : filename(filename), sectionName(sectionName) {
+                                 bool write,
+                                 IniFileCache* cache)
+    : filename(filename), sectionName(sectionName), cache(cache) {
     if (write) {
         HANDLE hFile =
             CreateFile(filename, GENERIC_WRITE, FILE_SHARE_READ, nullptr,
@@ -600,43 +562,32 @@ IniFileSettings::IniFileSettings(PCWSTR filename,
 }
 
 std::optional<std::wstring> IniFileSettings::GetString(PCWSTR valueName) const {
-    std::wstring itemValue;
-
-    for (DWORD size = 256;; size += 256) {
-        SetLastError(0);
-
-        itemValue.resize(size);
-        UINT returnedSize =
-            GetPrivateProfileString(sectionName.c_str(), valueName, nullptr,
-                                    &itemValue[0], size, filename.c_str());
-
-        DWORD error = GetLastError();
-        if (error == ERROR_MORE_DATA) {
-            continue;  // try with a larger buffer
-        } else if (error == ERROR_FILE_NOT_FOUND ||
-                   error == ERROR_PATH_NOT_FOUND) {
-            return std::nullopt;
-        } else if (error != ERROR_SUCCESS) {
-            PORTABLE_SETTINGS_THROW_WIN32(error);
-        }
+    auto iniFile = IniFileCache::Load(cache, filename.c_str());
+    if (!iniFile) {
+        return std::nullopt;
+    }
 
-        itemValue.resize(returnedSize);
-        break;
+    auto value = iniFile->GetValue(sectionName, valueName);
+    if (!value) {
+        return std::nullopt;
     }
 
-    return itemValue;
+    return std::wstring(*value);
 }
 
 void IniFileSettings::SetString(PCWSTR valueName, PCWSTR string) {
-    SetLastError(0);
-
-    WritePrivateProfileString(sectionName.c_str(), valueName, string,
-                              filename.c_str());
-
-    DWORD error = GetLastError();
-    if (error != ERROR_SUCCESS) {
-        PORTABLE_SETTINGS_THROW_WIN32(error);
+    if (writeBatch) {
+        writeBatch->push_back([valueName = std::wstring(valueName),
+                               string = std::wstring(string),
+                               this](IniFile& iniFile) {
+            iniFile.SetValue(sectionName, valueName, string);
+        });
+        return;
     }
+
+    IniFileCache::Update(cache, filename.c_str(), [&](IniFile& iniFile) {
+        iniFile.SetValue(sectionName, valueName, string);
+    });
 }
 
 std::optional<int> IniFileSettings::GetInt(PCWSTR valueName) const {
@@ -645,14 +596,7 @@ std::optional<int> IniFileSettings::GetInt(PCWSTR valueName) const {
         return std::nullopt;
     }
 
-    long longValue = std::stol(*data, nullptr, 0);
-    if (longValue > INT_MAX) {
-        return INT_MAX;
-    } else if (longValue < INT_MIN) {
-        return INT_MIN;
-    }
-
-    return wil::safe_cast<int>(longValue);
+    return IniFileSettingsHelperFunctions::StringToInt(*data);
 }
 
 void IniFileSettings::SetInt(PCWSTR valueName, int value) {
@@ -701,16 +645,22 @@ void IniFileSettings::SetBinary(PCWSTR valueName,
 }
 
 void IniFileSettings::Remove(PCWSTR valueName) {
-    SetLastError(0);
-
-    WritePrivateProfileString(sectionName.c_str(), valueName, nullptr,
-                              filename.c_str());
+    if (writeBatch) {
+        writeBatch->push_back([valueName = std::wstring(valueName),
+                               this](IniFile& iniFile) {
+            iniFile.RemoveValue(sectionName, valueName);
+        });
+        return;
+    }
 
-    DWORD error = GetLastError();
-    if (error != ERROR_SUCCESS && error != ERROR_FILE_NOT_FOUND &&
-        error != ERROR_PATH_NOT_FOUND) {
-        PORTABLE_SETTINGS_THROW_WIN32(error);
+    auto currentIniFile = IniFileCache::Load(cache, filename.c_str());
+    if (!currentIniFile || !currentIniFile->GetValue(sectionName, valueName)) {
+        return;
     }
+
+    IniFileCache::Update(cache, filename.c_str(), [&](IniFile& iniFile) {
+        iniFile.RemoveValue(sectionName, valueName);
+    });
 }
 
 IniFileSettings::EnumIterator<int> IniFileSettings::EnumIntValues() const {
@@ -724,15 +674,40 @@ IniFileSettings::EnumIterator<std::wstring> IniFileSettings::EnumStringValues()
         std::make_unique<EnumIteratorIniFileString>(this));
 }
 
-// static
-void IniFileSettings::RemoveSection(PCWSTR filename, PCWSTR sectionName) {
-    SetLastError(0);
+void IniFileSettings::BeginWriteBatch() {
+    if (writeBatch) {
+        throw std::logic_error("A write batch is already in progress");
+    }
 
-    WritePrivateProfileString(sectionName, nullptr, nullptr, filename);
+    writeBatch.emplace();
+}
 
-    DWORD error = GetLastError();
-    if (error != ERROR_SUCCESS && error != ERROR_FILE_NOT_FOUND &&
-        error != ERROR_PATH_NOT_FOUND) {
-        PORTABLE_SETTINGS_THROW_WIN32(error);
+void IniFileSettings::CommitWriteBatch() {
+    if (!writeBatch) {
+        throw std::logic_error("No write batch in progress");
+    }
+
+    auto batch = std::move(*writeBatch);
+    writeBatch.reset();
+
+    if (batch.empty()) {
+        return;
+    }
+
+    IniFileCache::Update(cache, filename.c_str(), [&](IniFile& iniFile) {
+        for (const auto& write : batch) {
+            write(iniFile);
+        }
+    });
+}
+
+// static
+void IniFileSettings::RemoveSection(PCWSTR filename, PCWSTR sectionName) {
+    if (!IniFileCache::Load(nullptr, filename)) {
+        return;
     }
+
+    IniFileCache::Update(nullptr, filename, [&](IniFile& iniFile) {
+        iniFile.RemoveSection(sectionName);
+    });
 }
@@ -14,8 +14,29 @@ class PortableSettingsException : public std::exception {
     DWORD error_code() const noexcept { return error; }
 };
 
+// Implemented by each storage type to enumerate its values. Defined here, so
+// that storage types can also be implemented outside of this file.
 template <typename Type>
-class EnumIteratorImpl;
+class EnumIteratorImpl {
+   public:
+    bool is_done() const { return done; }
+
+    const std::pair<std::wstring, Type>& get_item() const { return item; }
+
+    virtual void next() = 0;
+    virtual std::unique_ptr<EnumIteratorImpl> clone() const = 0;
+    virtual ~EnumIteratorImpl() = default;
+
+   protected:
+    EnumIteratorImpl() = default;
+    EnumIteratorImpl(const EnumIteratorImpl&) = default;
+    EnumIteratorImpl(EnumIteratorImpl&&) = default;
+    EnumIteratorImpl& operator=(const EnumIteratorImpl&) = default;
+    EnumIteratorImpl& operator=(EnumIteratorImpl&&) = default;
+
+    bool done = false;
+    std::pair<std::wstring, Type> item;
+};
 
 class PortableSettings {
    public:
@@ -62,6 +83,10 @@ class PortableSettings {
     virtual void Remove(PCWSTR valueName) = 0;
     virtual EnumIterator<int> EnumIntValues() const = 0;
     virtual EnumIterator<std::wstring> EnumStringValues() const = 0;
+    // Writes done between these calls might be buffered and written at once
+    // when the batch is committed. Reads don't see buffered writes.
+    virtual void BeginWriteBatch() {}
+    virtual void CommitWriteBatch() {}
 
    protected:
     PortableSettings() = default;
@@ -97,9 +122,16 @@ class RegistrySettings : public PortableSettings {
     wil::unique_hkey hKey;
 };
 
+class IniFile;
+class IniFileCache;
+
 class IniFileSettings : public PortableSettings {
    public:
-    IniFileSettings(PCWSTR filename, PCWSTR sectionName, bool write);
+    // If `cache` is set, parsed files are reused as long as they don't change.
+    IniFileSettings(PCWSTR filename,
+                    PCWSTR sectionName,
+                    bool write,
+                    IniFileCache* cache = nullptr);
 
     std::optional<std::wstring> GetString(PCWSTR valueName) const override;
     void SetString(PCWSTR valueName, PCWSTR string) override;
@@ -112,6 +144,9 @@ class IniFileSettings : public PortableSettings {
     void Remove(PCWSTR valueName) override;
     EnumIterator<int> EnumIntValues() const override;
     EnumIterator<std::wstring> EnumStringValues() const override;
+    // For INI files, the file is written once, atomically.
+    void BeginWriteBatch() override;
+    void CommitWriteBatch() override;
 
     static void RemoveSection(PCWSTR filename, PCWSTR sectionName);
 
@@ -121,4 +156,7 @@ class IniFileSettings : public PortableSettings {
 
     std::wstring filename;
     std::wstring sectionName;
+    IniFileCache* cache;
+    std::optional<std::vector<std::function<void(IniFile& iniFile)>>>
+        writeBatch;
 };
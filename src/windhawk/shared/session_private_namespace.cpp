@@ -1,6 +1,5 @@
 #include "stdafx.h"
 
-#include "functions.h"
 #include "session_private_namespace.h"
 
 namespace {
@@ -37,6 +36,20 @@ wil::unique_boundary_descriptor BuildBoundaryDescriptor() {
     return boundaryDesc;
 }
 
+// Full access for everyone, including app containers, with the untrusted
+// integrity level. Same as Functions::GetFullAccessSecurityDescriptor of the
+// engine, which isn't available in the app.
+wil::unique_hlocal GetFullAccessSecurityDescriptor() {
+    wil::unique_hlocal secDesc;
+    THROW_IF_WIN32_BOOL_FALSE(
+        ConvertStringSecurityDescriptorToSecurityDescriptor(
+            L"D:P(A;;GA;;;WD)(A;;GA;;;S-1-15-2-1)(A;;GA;;;S-1-15-2-2)"
+            L"S:(ML;;NW;;;S-1-16-0)",
+            SDDL_REVISION_1, &secDesc, nullptr));
+
+    return secDesc;
+}
+
 }  // namespace
 
 namespace SessionPrivateNamespace {
@@ -52,9 +65,7 @@ int MakeName(WCHAR szPrivateNamespaceName[kPrivateNamespaceMaxLen + 1],
 wil::unique_private_namespace_destroy Create(DWORD dwSessionManagerProcessId) {
     wil::unique_boundary_descriptor boundaryDesc(BuildBoundaryDescriptor());
 
-    wil::unique_hlocal secDesc;
-    THROW_IF_WIN32_BOOL_FALSE(
-        Functions::GetFullAccessSecurityDescriptor(&secDesc, nullptr));
+    wil::unique_hlocal secDesc = GetFullAccessSecurityDescriptor();
 
     SECURITY_ATTRIBUTES secAttr = {sizeof(SECURITY_ATTRIBUTES)};
     secAttr.lpSecurityDescriptor = secDesc.get();
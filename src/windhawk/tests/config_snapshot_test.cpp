@@ -0,0 +1,152 @@
+#include "config_snapshot.h"
+#include "test_framework.h"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+using ConfigSnapshot::Builder;
+using ConfigSnapshot::Reader;
+
+namespace {
+
+// The reader requires 8-byte alignment, which a vector of bytes doesn't
+// guarantee.
+struct AlignedCopy {
+    explicit AlignedCopy(const std::vector<std::uint8_t>& data)
+        : buffer(new std::uint64_t[data.size() / 8 + 1]), size(data.size()) {
+        memcpy(buffer.get(), data.data(), data.size());
+    }
+
+    std::uint8_t* Data() {
+        return reinterpret_cast<std::uint8_t*>(buffer.get());
+    }
+
+    std::unique_ptr<std::uint64_t[]> buffer;
+    size_t size;
+};
+
+Builder MakeBuilder() {
+    Builder builder;
+    builder.AddSection(L"Settings");
+    builder.SetValue(L"Mods", L"mod-b", L"2");
+    builder.SetValue(L"Mods", L"mod-a", L"1");
+    builder.SetValue(L"Mods\\mod-a", L"Disabled", L"0");
+    builder.SetValue(L"Mods\\mod-a", L"LibraryFileName", L"mod-a_1.0.dll");
+    builder.SetValue(L"Mods\\mod-a\\Settings", L"items[0].name", L"");
+    builder.SetValue(L"Mods\\mod-a\\Settings", L"unicode", L"\u00E9\u4E2D");
+    return builder;
+}
+
+}  // namespace
+
+TEST_CASE(ConfigSnapshot_RoundTrip) {
+    auto data = MakeBuilder().Serialize(42);
+    CHECK(data.size() % 8 == 0);
+
+    AlignedCopy copy(data);
+    Reader reader(copy.Data(), copy.size);
+
+    CHECK(reader.GetSequence() == 42);
+    CHECK(reader.GetSectionCount() == 4);
+
+    // Sections and values are ordered by name, case-insensitively.
+    CHECK(reader.GetSectionAt(0).GetName() == L"Mods");
+    CHECK(reader.GetSectionAt(1).GetName() == L"Mods\\mod-a");
+    CHECK(reader.GetSectionAt(2).GetName() == L"Mods\\mod-a\\Settings");
+    CHECK(reader.GetSectionAt(3).GetName() == L"Settings");
+
+    auto mods = reader.FindSection(L"MODS");
+    CHECK(mods);
+    CHECK(mods->GetValueCount() == 2);
+    CHECK(mods->GetValueAt(0) ==
+          std::make_pair(std::wstring_view(L"mod-a"), std::wstring_view(L"1")));
+    CHECK(mods->GetValue(L"Mod-B") == L"2");
+    CHECK(!mods->GetValue(L"mod-c"));
+
+    auto modSettings = reader.FindSection(L"mods\\MOD-A\\settings");
+    CHECK(modSettings);
+    CHECK(modSettings->GetValue(L"items[0].name") == L"");
+    CHECK(modSettings->GetValue(L"unicode") == L"\u00E9\u4E2D");
+
+    auto settings = reader.FindSection(L"Settings");
+    CHECK(settings);
+    CHECK(settings->GetValueCount() == 0);
+
+    CHECK(!reader.FindSection(L"Missing"));
+    CHECK_THROWS(reader.GetSectionAt(4));
+    CHECK_THROWS(mods->GetValueAt(2));
+}
+
+TEST_CASE(ConfigSnapshot_SetValueReplaces) {
+    Builder builder;
+    builder.SetValue(L"Section", L"Name", L"old");
+    builder.SetValue(L"SECTION", L"name", L"new");
+
+    AlignedCopy copy(builder.Serialize(1));
+    Reader reader(copy.Data(), copy.size);
+
+    CHECK(reader.GetSectionCount() == 1);
+    CHECK(reader.FindSection(L"section")->GetValueCount() == 1);
+    CHECK(reader.FindSection(L"section")->GetValue(L"NAME") == L"new");
+}
+
+TEST_CASE(ConfigSnapshot_EmptySnapshot) {
+    AlignedCopy copy(Builder().Serialize(7));
+    Reader reader(copy.Data(), copy.size);
+
+    CHECK(reader.GetSequence() == 7);
+    CHECK(reader.GetSectionCount() == 0);
+    CHECK(!reader.FindSection(L""));
+}
+
+TEST_CASE(ConfigSnapshot_LargerMappingIsAccepted) {
+    auto data = MakeBuilder().Serialize(1);
+
+    // Mappings are rounded up to the page size.
+    data.resize(4096);
+    AlignedCopy copy(data);
+    Reader reader(copy.Data(), copy.size);
+
+    CHECK(reader.GetSectionCount() == 4);
+}
+
+TEST_CASE(ConfigSnapshot_RejectsMalformedData) {
+    auto data = MakeBuilder().Serialize(1);
+
+    // Truncated.
+    {
+        AlignedCopy copy(data);
+        CHECK_THROWS(Reader(copy.Data(), copy.size - 8));
+        CHECK_THROWS(Reader(copy.Data(), 4));
+    }
+
+    // Misaligned.
+    {
+        std::vector<std::uint8_t> shifted(data.size() + 8);
+        AlignedCopy copy(shifted);
+        memcpy(copy.Data() + 1, data.data(), data.size());
+        CHECK_THROWS(Reader(copy.Data() + 1, data.size()));
+    }
+
+    // Corrupting any single byte must either be detected, or result in a
+    // snapshot which can be read safely.
+    for (size_t i = 0; i < data.size(); i++) {
+        auto corrupted = data;
+        corrupted[i] ^= 0xFF;
+
+        AlignedCopy copy(corrupted);
+        try {
+            Reader reader(copy.Data(), copy.size);
+            for (size_t s = 0; s < reader.GetSectionCount(); s++) {
+                auto section = reader.GetSectionAt(s);
+                reader.FindSection(section.GetName());
+                for (size_t v = 0; v < section.GetValueCount(); v++) {
+                    section.GetValue(section.GetValueAt(v).first);
+                }
+            }
+        } catch (const std::runtime_error&) {
+            // Detected.
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#include "stdafx.h"
+
+#include "functions.h"
+#include "test_framework.h"
+
+namespace {
+
+bool Match(std::wstring_view pattern, std::wstring_view str) {
+    return Functions::wcsmatch(pattern.data(), pattern.length(), str.data(),
+                               str.length());
+}
+
+// A string in the format of a symbol cache: a header followed by a symbol
+// name and its offset for each entry.
+std::wstring MakeSymbolCacheParts(int entryCount) {
+    std::wstring result = L"1;x64;";
+    for (int i = 0; i < entryCount; i++) {
+        result += L";public: void __cdecl Namespace::Class" +
+                  std::to_wstring(i) + L"::Method(int);" +
+                  std::to_wstring(i * 16);
+    }
+
+    return result;
+}
+
+}  // namespace
+
+TEST_CASE(Functions_SplitString) {
+    using Parts = std::vector<std::wstring_view>;
+
+    CHECK(Functions::SplitStringToViews(L"", L';').empty());
+    CHECK(Functions::SplitStringToViews(L"a", L';') == Parts{L"a"});
+    CHECK(Functions::SplitStringToViews(L"a;b", L';') == Parts({L"a", L"b"}));
+    CHECK(Functions::SplitStringToViews(L"a;;b", L';') ==
+          Parts({L"a", L"", L"b"}));
+    CHECK(Functions::SplitStringToViews(L";", L';') == Parts({L"", L""}));
+    CHECK(Functions::SplitStringToViews(L"a;", L';') == Parts({L"a", L""}));
+
+    CHECK(Functions::SplitString(L"", L'|').empty());
+    CHECK(Functions::SplitString(L"a|b", L'|') ==
+          std::vector<std::wstring>({L"a", L"b"}));
+}
+
+TEST_CASE(Functions_wcsmatch) {
+    CHECK(Match(L"", L""));
+    CHECK(!Match(L"", L"a"));
+    CHECK(Match(L"*", L""));
+    CHECK(Match(L"*", L"explorer.exe"));
+    CHECK(Match(L"explorer.exe", L"explorer.exe"));
+    CHECK(!Match(L"explorer.exe", L"explorer.exe2"));
+    CHECK(Match(L"*.exe", L"explorer.exe"));
+    CHECK(!Match(L"*.exe", L"explorer.dll"));
+    CHECK(Match(L"ex?lorer.*", L"explorer.exe"));
+    CHECK(!Match(L"?", L""));
+    CHECK(Match(L"*a*b*c", L"xaxxbxc"));
+    CHECK(!Match(L"*a*b*c", L"xaxxcxb"));
+    CHECK(Match(L"a**b", L"ab"));
+}
+
+TEST_CASE(Functions_ReplaceAll) {
+    CHECK(Functions::ReplaceAll(L"", L"a", L"b") == L"");
+    CHECK(Functions::ReplaceAll(L"aXbXc", L"X", L"--") == L"a--b--c");
+    CHECK(Functions::ReplaceAll(L"aaa", L"aa", L"b") == L"ba");
+    CHECK(Functions::ReplaceAll(L"aXbxc", L"x", L"-") == L"aXb-c");
+    CHECK(Functions::ReplaceAll(L"aXbxc", L"x", L"-", true) == L"a-b-c");
+    CHECK(Functions::ReplaceAll(L"%ProgramFiles%\\App", L"%programfiles%",
+                                L"C:\\Program Files", true) ==
+          L"C:\\Program Files\\App");
+}
+
+BENCHMARK(Functions_StringPaths) {
+    constexpr int kEntryCount = 50000;
+
+    std::wstring cacheParts = MakeSymbolCacheParts(kEntryCount);
+
+    printf("  %d symbol cache entries, times are per operation\n",
+           kEntryCount);
+
+    TestFramework::Measure("SplitStringToViews (symbol cache)", 20, [&] {
+        Functions::SplitStringToViews(cacheParts, L';');
+    });
+    TestFramework::Measure("SplitString (symbol cache)", 5, [&] {
+        Functions::SplitString(cacheParts, L';');
+    });
+
+    std::wstring path =
+        L"C:\\Program Files\\WindowsApps\\Microsoft.WindowsTerminal_1.0.0_x64_"
+        L"8wekyb3d8bbwe\\WindowsTerminal.exe";
+    TestFramework::Measure("wcsmatch (literal)", 100000, [&] {
+        Match(L"C:\\Windows\\explorer.exe", path);
+    });
+    TestFramework::Measure("wcsmatch (several wildcards)", 100000, [&] {
+        Match(L"*\\*Windows*Terminal*\\*.dll", path);
+    });
+
+    TestFramework::Measure("ReplaceAll", 10000, [&] {
+        Functions::ReplaceAll(path, L"Windows", L"X");
+    });
+    TestFramework::Measure("ReplaceAll (ignore case)", 10000, [&] {
+        Functions::ReplaceAll(path, L"windows", L"X", true);
+    });
+}
@@ -0,0 +1,381 @@
+#include "stdafx.h"
+
+#include "ini_file.h"
+#include "symbol_cache.h"
+#include "test_framework.h"
+
+namespace {
+
+// A file in the temp folder which is deleted at the end of the test, along
+// with the lock file created by IniFileCache::Update.
+class TempFile {
+   public:
+    TempFile() {
+        WCHAR tempPath[MAX_PATH];
+        THROW_LAST_ERROR_IF(GetTempPath(ARRAYSIZE(tempPath), tempPath) == 0);
+
+        static std::atomic<int> counter;
+        m_path = tempPath;
+        m_path += L"windhawk-test-" + std::to_wstring(GetCurrentProcessId()) +
+                  L"-" + std::to_wstring(counter++) + L".ini";
+    }
+
+    ~TempFile() {
+        DeleteFile(m_path.c_str());
+        DeleteFile((m_path + L".lock").c_str());
+    }
+
+    PCWSTR Path() const { return m_path.c_str(); }
+
+    void Write(const std::vector<BYTE>& data) const {
+        wil::unique_hfile file(CreateFile(m_path.c_str(), GENERIC_WRITE, 0,
+                                          nullptr, CREATE_ALWAYS,
+                                          FILE_ATTRIBUTE_NORMAL, nullptr));
+        THROW_LAST_ERROR_IF(!file);
+
+        DWORD written;
+        THROW_IF_WIN32_BOOL_FALSE(
+            WriteFile(file.get(), data.data(),
+                      wil::safe_cast<DWORD>(data.size()), &written, nullptr));
+    }
+
+    std::vector<BYTE> Read() const {
+        auto iniFile = IniFileCache::Load(nullptr, m_path.c_str());
+        return iniFile ? iniFile->Serialize() : std::vector<BYTE>();
+    }
+
+   private:
+    std::wstring m_path;
+};
+
+std::vector<BYTE> Utf16Bytes(std::wstring_view text, bool bom = true) {
+    std::vector<BYTE> data;
+    if (bom) {
+        data.insert(data.end(), {0xFF, 0xFE});
+    }
+
+    auto bytes = reinterpret_cast<const BYTE*>(text.data());
+    data.insert(data.end(), bytes, bytes + text.length() * sizeof(WCHAR));
+    return data;
+}
+
+std::vector<BYTE> AnsiBytes(std::string_view text) {
+    return std::vector<BYTE>(text.begin(), text.end());
+}
+
+IniFile Parse(const std::vector<BYTE>& data) {
+    return IniFile(data.data(), data.size());
+}
+
+// The value as read by the profile API, which the parser must match.
+std::optional<std::wstring> GetProfileValue(PCWSTR path,
+                                            PCWSTR sectionName,
+                                            PCWSTR keyName) {
+    constexpr WCHAR kDefault[] = L"\x1F<missing>";
+    WCHAR buffer[1024];
+    GetPrivateProfileString(sectionName, keyName, kDefault, buffer,
+                            ARRAYSIZE(buffer), path);
+    if (wcscmp(buffer, kDefault) == 0) {
+        return std::nullopt;
+    }
+
+    return buffer;
+}
+
+// Large enough for all the offsets of the symbol caches below.
+constexpr DWORD kSymbolCacheSizeOfImage = 0x1000000;
+
+// A symbol cache section with a cache of a single symbol for each module.
+std::wstring MakeSymbolCacheFile(int keyCount) {
+    std::wstring text = L"[Other]\r\nkey=value\r\n[SymbolCache]\r\n";
+    for (int i = 0; i < keyCount; i++) {
+        auto moduleName = L"module_" + std::to_wstring(i) + L".dll";
+        text += moduleName + L"=1#" + moduleName +
+                L"#1700000000-8675328#public: void __cdecl Class" +
+                std::to_wstring(i) + L"::Method(void)#" +
+                std::to_wstring(4096 + i * 16) + L"\r\n";
+    }
+
+    return text;
+}
+
+struct SymbolCacheCorpusEntry {
+    std::vector<BYTE> data;
+    PCWSTR keyName;
+    // The amount of parsed symbol cache entries, or -1 if the cache is
+    // invalid.
+    int expectedEntryCount;
+};
+
+// Symbol cache sections as written by the engine, by older versions or by
+// hand.
+std::vector<SymbolCacheCorpusEntry> GetSymbolCacheCorpus() {
+    return {
+        {Utf16Bytes(L"[SymbolCache]\r\n"
+                    L"pdb_0A1B2C3D4E5F60718293A4B5C6D7E8F91="
+                    L"1#twinui.pcshell.dll#1700000000-8675328#"
+                    L"public: class CWindow & __cdecl CWindow::operator=("
+                    L"class CWindow const &)#4096#missing symbol#\r\n"),
+         L"pdb_0A1B2C3D4E5F60718293A4B5C6D7E8F91", 2},
+        {Utf16Bytes(L"[SymbolCache]\r\n"
+                    L"pe_arm64_1700000000_4096_user32.dll_hybrid="
+                    L"1;user32.dll;1-4096;a#b;16;c;\r\n"),
+         L"pe_arm64_1700000000_4096_user32.dll_hybrid", 2},
+        {Utf16Bytes(L"[SymbolCache]\r\n  key  =  1#m#t#a#16  \r\n"), L"key", 1},
+        {Utf16Bytes(L"[SymbolCache]\r\nkey=\"1#m#t#a#16\"\r\n"), L"key", 1},
+        {Utf16Bytes(L"[SymbolCache]\r\nkey=1#m#t#a#16 #b#32\r\n"), L"key", -1},
+        {Utf16Bytes(L"[SymbolCache]\r\nkey=1#m#t#a#-16\r\n"), L"key", -1},
+        {Utf16Bytes(L"[SymbolCache]\r\n"
+                    L"key=1#m#t#a#99999999999999999999999\r\n"),
+         L"key", -1},
+        {Utf16Bytes(L"[SymbolCache]\r\nkey=0#a#16\r\n"), L"key", 0},
+        {Utf16Bytes(L"[SymbolCache]\r\nkey=1#m#t#a#16\r\nkey=1#m#t#a#-1\r\n"),
+         L"key", 1},
+        {AnsiBytes("[SymbolCache]\nkey=1#m#t#a#16#b#\n"), L"key", 2},
+        {AnsiBytes("\xEF\xBB\xBF[SymbolCache]\r\nkey=1#m#t#sym\xC3\xA9#16"),
+         L"key", 1},
+        {Utf16Bytes(MakeSymbolCacheFile(100)), L"module_42.dll", 1},
+    };
+}
+
+}  // namespace
+
+TEST_CASE(IniFile_ParsesLikeProfileApi) {
+    TempFile tempFile;
+    tempFile.Write(Utf16Bytes(
+        L"; comment\r\n"
+        L"orphan=ignored\r\n"
+        L"[Section]\r\n"
+        L"  key  =  value  \r\n"
+        L"quoted=\"  spaced  \"\r\n"
+        L"single='x'\r\n"
+        L"unbalanced=\"x\r\n"
+        L"Key=duplicate\r\n"
+        L";key2=commented\r\n"
+        L"no equals sign\r\n"
+        L"empty=\r\n"
+        L"[section]\r\n"
+        L"ignored=duplicate section\r\n"
+        L"[Other]\n"
+        L"k=line feed only\n"
+        L"[Last]\r\n"
+        L"last=no newline"));
+
+    auto iniFile = IniFileCache::Load(nullptr, tempFile.Path());
+    CHECK(iniFile);
+
+    const std::pair<PCWSTR, PCWSTR> keys[] = {
+        {L"Section", L"key"},    {L"Section", L"quoted"},
+        {L"Section", L"single"}, {L"Section", L"unbalanced"},
+        {L"Section", L"key2"},   {L"Section", L"empty"},
+        {L"Section", L"ignored"}, {L"Other", L"k"},
+        {L"Last", L"last"},      {L"Missing", L"key"},
+    };
+
+    for (const auto& [sectionName, keyName] : keys) {
+        auto expected =
+            GetProfileValue(tempFile.Path(), sectionName, keyName);
+        auto actual = iniFile->GetValue(sectionName, keyName);
+        CHECK(expected.has_value() == actual.has_value());
+        if (expected) {
+            CHECK(*expected == *actual);
+        }
+    }
+}
+
+TEST_CASE(IniFile_SerializeKeepsBytes) {
+    const std::vector<BYTE> inputs[] = {
+        Utf16Bytes(L"[a]\r\nx=1\r\n; comment\r\n\r\n[b]\r\ny = 2\r\n"),
+        AnsiBytes("[a]\r\nx=1\r\n[b]\r\ny=\"2\"\r\n"),
+        AnsiBytes("\xEF\xBB\xBF[a]\r\nx=\xC3\xA9\r\n"),
+    };
+
+    for (const auto& input : inputs) {
+        CHECK(Parse(input).Serialize() == input);
+    }
+}
+
+TEST_CASE(IniFile_SetValueUpdatesIndex) {
+    IniFile iniFile = Parse(Utf16Bytes(
+        L"[a]\r\nx=1\r\n; trailing comment\r\n[b]\r\ny=2\r\n[A]\r\nz=3\r\n"));
+
+    iniFile.SetValue(L"A", L"X", L"changed");
+    iniFile.SetValue(L"a", L"new", L"\"quoted\"");
+    iniFile.SetValue(L"b", L"y2", L"3");
+    iniFile.SetValue(L"c", L"z", L"4");
+    iniFile.SetValue(L"c", L"z2", L"5");
+    iniFile.SetValue(L"a", L"k=v", L"6");
+
+    // The incrementally updated index must match the index of the written
+    // file.
+    std::vector<BYTE> data = iniFile.Serialize();
+    IniFile reparsed = Parse(data);
+    CHECK(reparsed.Serialize() == data);
+
+    for (PCWSTR sectionName : {L"a", L"b", L"c", L"A"}) {
+        auto values = iniFile.GetValues(sectionName);
+        auto reparsedValues = reparsed.GetValues(sectionName);
+        CHECK(values == reparsedValues);
+    }
+
+    CHECK(iniFile.GetValue(L"a", L"x") == L"changed");
+    CHECK(iniFile.GetValue(L"a", L"new") == L"quoted");
+    CHECK(iniFile.GetValue(L"a", L"k") == L"v=6");
+    CHECK(iniFile.GetValue(L"b", L"y2") == L"3");
+    CHECK(iniFile.GetValue(L"c", L"z2") == L"5");
+    CHECK(!iniFile.GetValue(L"A", L"z"));
+
+    // New keys are added after the last key of the section.
+    CHECK(data == Utf16Bytes(L"[a]\r\nX=changed\r\nnew=\"quoted\"\r\n"
+                             L"k=v=6\r\n; trailing comment\r\n"
+                             L"[b]\r\ny=2\r\ny2=3\r\n[A]\r\nz=3\r\n"
+                             L"[c]\r\nz=4\r\nz2=5\r\n"));
+}
+
+TEST_CASE(IniFile_RemoveValueAndSection) {
+    IniFile iniFile =
+        Parse(Utf16Bytes(L"[a]\r\nx=1\r\ny=2\r\n[b]\r\nz=3\r\n[c]\r\nw=4\r\n"));
+
+    iniFile.RemoveValue(L"a", L"x");
+    iniFile.RemoveSection(L"B");
+    iniFile.SetValue(L"c", L"v", L"5");
+
+    CHECK(iniFile.Serialize() ==
+          Utf16Bytes(L"[a]\r\ny=2\r\n[c]\r\nw=4\r\nv=5\r\n"));
+}
+
+TEST_CASE(IniFileCache_ReloadsChangedFile) {
+    TempFile tempFile;
+    tempFile.Write(Utf16Bytes(L"[a]\r\nx=1\r\n"));
+
+    IniFileCache cache;
+    auto first = IniFileCache::Load(&cache, tempFile.Path());
+    CHECK(IniFileCache::Load(&cache, tempFile.Path()) == first);
+
+    // The file is replaced, so its file id changes even if the size and
+    // write time don't.
+    IniFileCache::Update(nullptr, tempFile.Path(), [](IniFile& iniFile) {
+        iniFile.SetValue(L"a", L"x", L"2");
+    });
+
+    auto second = IniFileCache::Load(&cache, tempFile.Path());
+    CHECK(second != first);
+    CHECK(second->GetValue(L"a", L"x") == L"2");
+}
+
+TEST_CASE(IniFileCache_ConcurrentUpdatesArentLost) {
+    TempFile tempFile;
+
+    // Each thread uses its own cache, like separate processes do, so that
+    // only the lock file serializes the updates.
+    constexpr int kThreads = 4;
+    constexpr int kUpdatesPerThread = 25;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&tempFile, t] {
+            IniFileCache cache;
+            for (int i = 0; i < kUpdatesPerThread; i++) {
+                IniFileCache::Update(
+                    &cache, tempFile.Path(), [t, i](IniFile& iniFile) {
+                        iniFile.SetValue(
+                            L"Keys",
+                            std::to_wstring(t) + L"_" + std::to_wstring(i),
+                            L"1");
+                    });
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto iniFile = IniFileCache::Load(nullptr, tempFile.Path());
+    CHECK(iniFile->GetValues(L"Keys").size() == kThreads * kUpdatesPerThread);
+}
+
+// Each symbol cache is read like the profile API reads it, and is then parsed
+// like the engine parses it.
+TEST_CASE(IniFile_SymbolCacheCorpus) {
+    for (const auto& [data, keyName, expectedEntryCount] :
+         GetSymbolCacheCorpus()) {
+        TempFile tempFile;
+        tempFile.Write(data);
+
+        auto expected =
+            GetProfileValue(tempFile.Path(), L"SymbolCache", keyName);
+        auto actual = Parse(data).GetValue(L"SymbolCache", keyName);
+        CHECK(expected && actual);
+        CHECK(*expected == *actual);
+
+        // The separator follows the version.
+        auto entries = SymbolCache::Parse(*actual, (*actual)[1],
+                                          kSymbolCacheSizeOfImage);
+        int entryCount = entries ? static_cast<int>(entries->size()) : -1;
+        CHECK(entryCount == expectedEntryCount);
+    }
+}
+
+BENCHMARK(IniFile_SymbolCache) {
+    constexpr int kKeyCount = 5000;
+    constexpr int kProfileApiLookups = 200;
+
+    TempFile tempFile;
+    tempFile.Write(Utf16Bytes(MakeSymbolCacheFile(kKeyCount)));
+
+    std::vector<std::wstring> keyNames;
+    for (int i = 0; i < kKeyCount; i++) {
+        keyNames.push_back(L"module_" + std::to_wstring(i) + L".dll");
+    }
+
+    printf("  %d keys, times are per operation\n", kKeyCount);
+
+    TestFramework::Measure("GetPrivateProfileString (one key)",
+                           kProfileApiLookups, [&] {
+                               static int i;
+                               GetProfileValue(
+                                   tempFile.Path(), L"SymbolCache",
+                                   keyNames[i++ % kKeyCount].c_str());
+                           });
+
+    IniFileCache cache;
+    TestFramework::Measure("IniFileCache::Load (uncached)", 20, [&] {
+        IniFileCache::Load(nullptr, tempFile.Path());
+    });
+    TestFramework::Measure("IniFileCache::Load (cached)", 1000, [&] {
+        IniFileCache::Load(&cache, tempFile.Path());
+    });
+
+    auto iniFile = IniFileCache::Load(&cache, tempFile.Path());
+    TestFramework::Measure("IniFile::GetValue (one key)", kKeyCount * 10, [&] {
+        static int i;
+        iniFile->GetValue(L"SymbolCache", keyNames[i++ % kKeyCount]);
+    });
+    TestFramework::Measure("IniFile::GetValues (whole section)", 100, [&] {
+        iniFile->GetValues(L"SymbolCache");
+    });
+    TestFramework::Measure("SymbolCache::Parse (whole section)", 100, [&] {
+        for (const auto& [keyName, value] :
+             iniFile->GetValues(L"SymbolCache")) {
+            SymbolCache::Parse(value, L'#', kSymbolCacheSizeOfImage);
+        }
+    });
+
+    IniFile modified = *iniFile;
+    TestFramework::Measure("IniFile::SetValue (existing key)", 1000, [&] {
+        static int i;
+        modified.SetValue(L"SymbolCache", keyNames[i++ % kKeyCount], L"x");
+    });
+    TestFramework::Measure("IniFile::SetValue (new key)", 1000, [&] {
+        static int i;
+        modified.SetValue(L"SymbolCache", L"new_" + std::to_wstring(i++),
+                          L"x");
+    });
+    TestFramework::Measure("IniFileCache::Update (one key)", 20, [&] {
+        static int i;
+        IniFileCache::Update(&cache, tempFile.Path(), [&](IniFile& ini) {
+            ini.SetValue(L"SymbolCache", keyNames[i++ % kKeyCount], L"y");
+        });
+    });
+}
@@ -0,0 +1,42 @@
+#include "test_framework.h"
+
+#include <cstring>
+#include <exception>
+
+// Usage: tests.exe [--benchmark] [name-filter]
+//
+// Runs the tests, or the benchmarks with --benchmark, whose name contains the
+// filter. Returns the number of failed tests.
+int main(int argc, char* argv[]) {
+    bool benchmark = false;
+    const char* filter = "";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--benchmark") == 0) {
+            benchmark = true;
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    int passed = 0;
+    int failed = 0;
+    for (const auto& testCase : TestFramework::GetTestCases()) {
+        if (testCase.isBenchmark != benchmark ||
+            !strstr(testCase.name, filter)) {
+            continue;
+        }
+
+        printf("%s\n", testCase.name);
+
+        try {
+            testCase.function();
+            passed++;
+        } catch (const std::exception& e) {
+            printf("  FAILED: %s\n", e.what());
+            failed++;
+        }
+    }
+
+    printf("%d passed, %d failed\n", passed, failed);
+    return failed;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "portable_settings.h"
+
+// Settings which are kept in memory, for tests of code which reads a config.
+// Values are stored as strings, like in INI files, and names are
+// case-insensitive.
+class MemorySettings : public PortableSettings {
+   public:
+    MemorySettings() = default;
+
+    MemorySettings(
+        std::initializer_list<std::pair<std::wstring, std::wstring>> values) {
+        for (const auto& [name, value] : values) {
+            m_values[name] = value;
+        }
+    }
+
+    std::optional<std::wstring> GetString(PCWSTR valueName) const override {
+        auto it = m_values.find(valueName);
+        if (it == m_values.end()) {
+            return std::nullopt;
+        }
+
+        return it->second;
+    }
+
+    void SetString(PCWSTR valueName, PCWSTR string) override {
+        m_values[valueName] = string;
+    }
+
+    std::optional<int> GetInt(PCWSTR valueName) const override {
+        auto it = m_values.find(valueName);
+        if (it == m_values.end()) {
+            return std::nullopt;
+        }
+
+        return std::stoi(it->second, nullptr, 0);
+    }
+
+    void SetInt(PCWSTR valueName, int value) override {
+        m_values[valueName] = std::to_wstring(value);
+    }
+
+    std::optional<std::vector<BYTE>> GetBinary(
+        PCWSTR valueName) const override {
+        auto it = m_binaryValues.find(valueName);
+        if (it == m_binaryValues.end()) {
+            return std::nullopt;
+        }
+
+        return it->second;
+    }
+
+    void SetBinary(PCWSTR valueName,
+                   const BYTE* buffer,
+                   size_t bufferSize) override {
+        m_binaryValues[valueName].assign(buffer, buffer + bufferSize);
+    }
+
+    void Remove(PCWSTR valueName) override {
+        m_values.erase(valueName);
+        m_binaryValues.erase(valueName);
+    }
+
+    EnumIterator<int> EnumIntValues() const override {
+        return EnumIterator<int>(
+            std::make_unique<EnumIteratorMemory<int>>(m_values));
+    }
+
+    EnumIterator<std::wstring> EnumStringValues() const override {
+        return EnumIterator<std::wstring>(
+            std::make_unique<EnumIteratorMemory<std::wstring>>(m_values));
+    }
+
+   private:
+    struct NameLess {
+        using is_transparent = void;
+        bool operator()(std::wstring_view a, std::wstring_view b) const {
+            return CompareStringOrdinal(
+                       a.data(), wil::safe_cast<int>(a.length()), b.data(),
+                       wil::safe_cast<int>(b.length()),
+                       /*bIgnoreCase=*/TRUE) == CSTR_LESS_THAN;
+        }
+    };
+
+    template <typename Value>
+    using ValueMap = std::map<std::wstring, Value, NameLess>;
+
+    // Iterates over a copy of the values, so that the settings can be changed
+    // while iterating.
+    template <typename Type>
+    class EnumIteratorMemory : public EnumIteratorImpl<Type> {
+       public:
+        explicit EnumIteratorMemory(const ValueMap<std::wstring>& values)
+            : m_values(std::make_shared<ValueMap<std::wstring>>(values)),
+              m_it(m_values->begin()) {
+            next();
+        }
+
+        void next() override {
+            if (m_it == m_values->end()) {
+                this->done = true;
+                return;
+            }
+
+            const auto& [name, value] = *m_it++;
+            if constexpr (std::is_same_v<Type, int>) {
+                this->item = {name, std::stoi(value, nullptr, 0)};
+            } else {
+                this->item = {name, value};
+            }
+        }
+
+        std::unique_ptr<EnumIteratorImpl<Type>> clone() const override {
+            return std::make_unique<EnumIteratorMemory>(*this);
+        }
+
+       private:
+        std::shared_ptr<const ValueMap<std::wstring>> m_values;
+        ValueMap<std::wstring>::const_iterator m_it;
+    };
+
+    ValueMap<std::wstring> m_values;
+    ValueMap<std::vector<BYTE>> m_binaryValues;
+};
@@ -0,0 +1,217 @@
+#include "stdafx.h"
+
+#include "memory_settings.h"
+#include "mod_config.h"
+#include "test_framework.h"
+
+namespace {
+
+#if defined(_M_IX86)
+constexpr WCHAR kArchitecture[] = L"x86";
+constexpr WCHAR kOtherArchitecture[] = L"x86-64";
+#else
+constexpr WCHAR kArchitecture[] = L"x86-64";
+constexpr WCHAR kOtherArchitecture[] = L"x86";
+#endif
+
+const PathPatternMatcher::Path& GetTestProcessPath() {
+    static const PathPatternMatcher::Path path(
+        L"C:\\Program Files\\App\\app.exe");
+    return path;
+}
+
+bool ShouldLoad(const MemorySettings& settings,
+                bool isCriticalForMods = false) {
+    ModConfig::Process process{
+        .path = GetTestProcessPath(),
+        .isCriticalForMods = isCriticalForMods,
+    };
+    return ModConfig::ShouldLoadInProcess(settings, process);
+}
+
+bool ShouldLoad(const MemorySettings& settings,
+                ModConfig::PatternMatchers& matchers) {
+    ModConfig::Process process{
+        .path = GetTestProcessPath(),
+        .isCriticalForMods = false,
+    };
+    return ModConfig::ShouldLoadInProcess(settings, process, matchers);
+}
+
+// A config similar to the ones of installed mods, with a mix of patterns
+// with and without wildcards.
+std::unique_ptr<MemorySettings> MakeModConfig(int index) {
+    auto settings = std::make_unique<MemorySettings>();
+    auto libraryFileName = L"mod-" + std::to_wstring(index) + L"_1.0.dll";
+    settings->SetString(L"LibraryFileName", libraryFileName.c_str());
+    settings->SetInt(L"SettingsChangeTime", 1700000000 + index);
+    settings->SetString(L"Architecture", L"x86|x86-64");
+    switch (index % 4) {
+        case 0:
+            settings->SetString(L"Include", L"explorer.exe");
+            break;
+        case 1:
+            settings->SetString(L"Include",
+                                L"explorer.exe|StartMenuExperienceHost.exe|"
+                                L"SearchHost.exe|ShellExperienceHost.exe");
+            break;
+        case 2:
+            settings->SetString(L"Include", L"*");
+            settings->SetString(
+                L"Exclude", L"%ProgramFiles%\\WindowsApps\\*|*\\steam*.exe");
+            break;
+        case 3:
+            settings->SetString(L"Include", L"%SystemRoot%\\*.exe");
+            settings->SetString(L"IncludeCustom", L"*\\App\\*.exe");
+            break;
+    }
+
+    return settings;
+}
+
+}  // namespace
+
+TEST_CASE(ModConfig_MemorySettings) {
+    MemorySettings settings{{L"Name", L"value"}, {L"Number", L"0x10"}};
+    CHECK(settings.GetString(L"NAME") == L"value");
+    CHECK(settings.GetInt(L"number") == 16);
+    CHECK(!settings.GetString(L"Missing"));
+
+    settings.SetInt(L"Number", -5);
+    CHECK(settings.GetString(L"Number") == L"-5");
+
+    settings.Remove(L"name");
+    CHECK(!settings.GetString(L"Name"));
+
+    int count = 0;
+    for (auto it = settings.EnumIntValues(); it; ++it) {
+        CHECK(it->first == L"Number");
+        CHECK(it->second == -5);
+        count++;
+    }
+    CHECK(count == 1);
+}
+
+TEST_CASE(ModConfig_ShouldLoadInProcess) {
+    CHECK(!ShouldLoad({}));
+    CHECK(ShouldLoad({{L"Include", L"*"}}));
+    CHECK(ShouldLoad({{L"Include", L"APP.EXE"}}));
+    CHECK(ShouldLoad({{L"Include", L"C:\\Program Files\\App\\app.exe"}}));
+    CHECK(!ShouldLoad({{L"Include", L"other.exe"}}));
+    CHECK(!ShouldLoad({{L"Include", L"*"}, {L"Disabled", L"1"}}));
+    CHECK(ShouldLoad({{L"Include", L"*"}, {L"Disabled", L"0"}}));
+
+    CHECK(!ShouldLoad({{L"Include", L"*"}, {L"Exclude", L"*\\App\\*"}}));
+    CHECK(!ShouldLoad({{L"Include", L"*"}, {L"ExcludeCustom", L"app.exe"}}));
+    CHECK(ShouldLoad({{L"Include", L"*"}, {L"Exclude", L"other.exe"}}));
+
+    // Custom patterns are used in addition to the mod's patterns, or instead
+    // of them.
+    CHECK(ShouldLoad({{L"Include", L"other.exe"}, {L"IncludeCustom", L"*"}}));
+    CHECK(!ShouldLoad(
+        {{L"Include", L"*"}, {L"IncludeExcludeCustomOnly", L"1"}}));
+    CHECK(ShouldLoad({{L"Include", L"other.exe"},
+                      {L"IncludeCustom", L"app.exe"},
+                      {L"Exclude", L"*"},
+                      {L"IncludeExcludeCustomOnly", L"1"}}));
+
+    CHECK(ShouldLoad({{L"Include", L"*"}, {L"Architecture", kArchitecture}}));
+    CHECK(!ShouldLoad(
+        {{L"Include", L"*"}, {L"Architecture", kOtherArchitecture}}));
+    CHECK(ShouldLoad({{L"Include", L"*"},
+                      {L"Architecture", std::wstring(kOtherArchitecture) +
+                                            L"|" + kArchitecture}}));
+}
+
+TEST_CASE(ModConfig_ShouldLoadInCriticalProcess) {
+    // Only patterns without wildcards match critical processes, unless the
+    // mod opts in. Exclusions always apply.
+    CHECK(!ShouldLoad({{L"Include", L"*"}}, true));
+    CHECK(!ShouldLoad({{L"IncludeCustom", L"*.exe"}}, true));
+    CHECK(ShouldLoad({{L"Include", L"app.exe"}}, true));
+    CHECK(ShouldLoad({{L"Include", L"*"},
+                      {L"PatternsMatchCriticalSystemProcesses", L"1"}},
+                     true));
+    CHECK(!ShouldLoad({{L"Include", L"app.exe"}, {L"Exclude", L"*.exe"}},
+                      true));
+}
+
+TEST_CASE(ModConfig_PatternMatchers) {
+    // The cached matchers follow changes of the patterns.
+    ModConfig::PatternMatchers matchers;
+    CHECK(ShouldLoad({{L"Include", L"app.exe"}}, matchers));
+    CHECK(!ShouldLoad({{L"Include", L"other.exe"}}, matchers));
+    CHECK(ShouldLoad({{L"Include", L"*.exe"}}, matchers));
+    CHECK(!ShouldLoad({{L"Include", L"*.exe"}, {L"Exclude", L"app.exe"}},
+                      matchers));
+    CHECK(ShouldLoad({{L"Include", L"*.exe"}, {L"Exclude", L"other.exe"}},
+                     matchers));
+    CHECK(!ShouldLoad({{L"Include", L"*.exe"}, {L"ExcludeCustom", L"*"}},
+                      matchers));
+    CHECK(ShouldLoad({{L"Include", L"*.exe"}}, matchers));
+    CHECK(!ShouldLoad({}, matchers));
+}
+
+TEST_CASE(ModConfig_GetLoadedModValues) {
+    auto values = ModConfig::GetLoadedModValues(MemorySettings{});
+    CHECK(values.libraryFileName.empty());
+    CHECK(values.settingsChangeTime == 0);
+    CHECK(!values.loggingEnabled);
+    CHECK(!values.debugLoggingEnabled);
+    CHECK(values.logLimits.rate == 0);
+    CHECK(values.logLimits.burst == 0);
+    CHECK(values.logLimits.sampling == 0);
+
+    values = ModConfig::GetLoadedModValues(MemorySettings{
+        {L"LibraryFileName", L"mod_1.0.dll"},
+        {L"SettingsChangeTime", L"1700000000"},
+        {L"LoggingEnabled", L"1"},
+        {L"DebugLoggingEnabled", L"1"},
+        {L"LogRateLimit", L"100"},
+        {L"LogRateLimitBurst", L"-1"},
+        {L"LogSampling", L"10"},
+    });
+    CHECK(values.libraryFileName == L"mod_1.0.dll");
+    CHECK(values.settingsChangeTime == 1700000000);
+    CHECK(values.loggingEnabled);
+    CHECK(values.debugLoggingEnabled);
+    CHECK(values.logLimits.rate == 100);
+    // Negative limits are treated as zero.
+    CHECK(values.logLimits.burst == 0);
+    CHECK(values.logLimits.sampling == 10);
+}
+
+// The decisions made for each changed mod during a reload: whether the mod
+// should be loaded, and the values applied to it if it's loaded.
+BENCHMARK(ModConfig_Reload) {
+    constexpr int kModCount = 100;
+
+    std::vector<std::unique_ptr<MemorySettings>> configs;
+    for (int i = 0; i < kModCount; i++) {
+        configs.push_back(MakeModConfig(i));
+    }
+
+    printf("  %d mods, times are per reload\n", kModCount);
+
+    TestFramework::Measure("ShouldLoadInProcess", 100, [&] {
+        for (const auto& config : configs) {
+            ShouldLoad(*config);
+        }
+    });
+    std::vector<ModConfig::PatternMatchers> matchers(kModCount);
+    TestFramework::Measure("ShouldLoadInProcess (cached patterns)", 100, [&] {
+        for (int i = 0; i < kModCount; i++) {
+            ShouldLoad(*configs[i], matchers[i]);
+        }
+    });
+    TestFramework::Measure("ShouldLoadInProcess (critical process)", 100, [&] {
+        for (const auto& config : configs) {
+            ShouldLoad(*config, true);
+        }
+    });
+    TestFramework::Measure("GetLoadedModValues", 100, [&] {
+        for (const auto& config : configs) {
+            ModConfig::GetLoadedModValues(*config);
+        }
+    });
+}
@@ -0,0 +1,190 @@
+#include "stdafx.h"
+
+#include "log_ring_buffer.h"
+#include "mod_log_record.h"
+#include "test_framework.h"
+
+namespace {
+
+struct CapturedRecord {
+    LogRingBuffer::RecordType type;
+    std::vector<BYTE> data;
+};
+
+std::vector<CapturedRecord> g_capturedRecords;
+
+std::wstring FormatInPlace(PCWSTR format, va_list args) {
+    WCHAR buffer[1025];
+    _vsnwprintf_s(buffer, _TRUNCATE, format, args);
+    return buffer;
+}
+
+// Writes the message the way a mod does, passes the written records to the
+// decoder, and checks that the decoded text matches the text formatted in
+// place.
+ModLogRecordDecoder::Message WriteAndDecode(ModLogRecordWriter& writer,
+                                            ModLogRecordDecoder& decoder,
+                                            PCWSTR format,
+                                            ...) {
+    auto ringBuffer = LogRingBuffer::Create();
+    g_capturedRecords.clear();
+
+    va_list args;
+    va_start(args, format);
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    bool written = writer.Write(ringBuffer, format, args);
+    std::wstring expectedText = FormatInPlace(format, argsCopy);
+    va_end(argsCopy);
+    va_end(args);
+
+    CHECK(written);
+
+    std::optional<ModLogRecordDecoder::Message> message;
+    for (const auto& record : g_capturedRecords) {
+        switch (record.type) {
+            case LogRingBuffer::RecordType::kModLogFormat:
+                CHECK(decoder.AddFormat(record.data));
+                break;
+
+            case LogRingBuffer::RecordType::kModLogMessage:
+                CHECK(!message);
+                message = decoder.Decode(record.data);
+                CHECK(message);
+                break;
+
+            default:
+                CHECK(false);
+        }
+    }
+
+    CHECK(message);
+    CHECK(message->text == expectedText);
+    return *message;
+}
+
+const CapturedRecord& GetCapturedRecord(LogRingBuffer::RecordType type) {
+    for (const auto& record : g_capturedRecords) {
+        if (record.type == type) {
+            return record;
+        }
+    }
+
+    throw std::logic_error("No such record");
+}
+
+}  // namespace
+
+// The ring buffer is replaced with a list of the written records, so that
+// they can be decoded without the shared memory of a session.
+LogRingBuffer LogRingBuffer::Create() {
+    return LogRingBuffer();
+}
+
+bool LogRingBuffer::Write(RecordType type, std::span<const BYTE> data) {
+    g_capturedRecords.push_back({type, {data.begin(), data.end()}});
+    return true;
+}
+
+TEST_CASE(ModLogRecord_RoundTrip) {
+    ModLogRecordWriter writer(L"test-mod");
+    ModLogRecordDecoder decoder;
+
+    auto message = WriteAndDecode(
+        writer, decoder,
+        L"[%d:%S]: int=%d uint=%u hex=%08X i64=%lld u64=%I64u str=%s "
+        L"ansi=%S ptr=%p dbl=%.3f pct=%% width=%*d|%-6s| precision=%.*s",
+        __LINE__, __FUNCTION__, -5, 7u, 0xBEEFu, -1234567890123LL,
+        18446744073709551615ULL, L"wide", "ansi",
+        reinterpret_cast<void*>(0x1234), 3.14159, 6, 12, L"left", 3,
+        L"abcdef");
+
+    CHECK(message.modName == L"test-mod");
+    CHECK(message.processId == GetCurrentProcessId());
+    CHECK(message.threadId == GetCurrentThreadId());
+    CHECK(message.args.size() == 14);
+    CHECK(std::get<INT64>(message.args[2]) == -5);
+    CHECK(std::get<ULONGLONG>(message.args[3]) == 7);
+    CHECK(std::get<INT64>(message.args[5]) == -1234567890123LL);
+    CHECK(std::get<ULONGLONG>(message.args[6]) == 18446744073709551615ULL);
+    CHECK(std::get<std::wstring>(message.args[7]) == L"wide");
+    CHECK(std::get<std::wstring>(message.args[8]) == L"ansi");
+    CHECK(std::get<ULONGLONG>(message.args[9]) == 0x1234);
+    CHECK(std::get<std::wstring>(message.args[13]) == L"abc");
+}
+
+TEST_CASE(ModLogRecord_NullStrings) {
+    ModLogRecordWriter writer(L"test-mod");
+    ModLogRecordDecoder decoder;
+
+    auto message = WriteAndDecode(writer, decoder, L"%s %S",
+                                  static_cast<PCWSTR>(nullptr),
+                                  static_cast<PCSTR>(nullptr));
+
+    CHECK(message.args.size() == 2);
+    CHECK(std::holds_alternative<std::monostate>(message.args[0]));
+    CHECK(std::holds_alternative<std::monostate>(message.args[1]));
+}
+
+TEST_CASE(ModLogRecord_FormatSentOnce) {
+    ModLogRecordWriter writer(L"test-mod");
+    ModLogRecordDecoder decoder;
+
+    PCWSTR format = L"value=%d";
+
+    WriteAndDecode(writer, decoder, format, 1);
+    CHECK(g_capturedRecords.size() == 2);
+
+    // The second message refers to the format which was already sent.
+    auto message = WriteAndDecode(writer, decoder, format, 2);
+    CHECK(g_capturedRecords.size() == 1);
+    CHECK(message.text == L"value=2");
+}
+
+TEST_CASE(ModLogRecord_UnknownFormat) {
+    ModLogRecordWriter writer(L"test-mod");
+    ModLogRecordDecoder decoder;
+
+    WriteAndDecode(writer, decoder, L"value=%d", 1);
+
+    ModLogRecordDecoder otherDecoder;
+    CHECK(!otherDecoder.Decode(
+        GetCapturedRecord(LogRingBuffer::RecordType::kModLogMessage).data));
+}
+
+TEST_CASE(ModLogRecord_FormatText) {
+    ModLogRecordWriter writer(L"test-mod");
+    ModLogRecordDecoder decoder;
+
+    auto message = WriteAndDecode(writer, decoder, L"hello\n\n");
+
+    std::wstring expectedPrefix = L"[WH] [" +
+                                  std::to_wstring(GetCurrentProcessId()) +
+                                  L":" + std::to_wstring(GetCurrentThreadId()) +
+                                  L"] [test-mod] ";
+    CHECK(ModLogRecordDecoder::FormatText(message) ==
+          expectedPrefix + L"hello\n");
+}
+
+TEST_CASE(ModLogRecord_TruncatedRecords) {
+    ModLogRecordWriter writer(L"test-mod");
+    ModLogRecordDecoder decoder;
+
+    WriteAndDecode(writer, decoder, L"%d %s %S %f", 1, L"wide", "ansi", 2.5);
+
+    auto formatRecord =
+        GetCapturedRecord(LogRingBuffer::RecordType::kModLogFormat).data;
+    auto messageRecord =
+        GetCapturedRecord(LogRingBuffer::RecordType::kModLogMessage).data;
+
+    ModLogRecordDecoder otherDecoder;
+    for (size_t size = 0; size < formatRecord.size(); size++) {
+        CHECK(!otherDecoder.AddFormat(std::span(formatRecord.data(), size)));
+    }
+
+    for (size_t size = 0; size < messageRecord.size(); size++) {
+        CHECK(!decoder.Decode(std::span(messageRecord.data(), size)));
+    }
+
+    CHECK(decoder.Decode(messageRecord));
+}
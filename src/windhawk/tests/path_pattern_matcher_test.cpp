@@ -0,0 +1,201 @@
+#include "stdafx.h"
+
+#include "functions.h"
+#include "path_pattern_matcher.h"
+#include "process_lists.h"
+#include "test_framework.h"
+
+namespace {
+
+constexpr WCHAR kTestVariable[] = L"WINDHAWK_TEST_PATTERN_DIR";
+
+void ToUpperInPlace(std::wstring& s) {
+    LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE, s.data(),
+                  wil::safe_cast<int>(s.length()), s.data(),
+                  wil::safe_cast<int>(s.length()), nullptr, nullptr, 0);
+}
+
+// The matching which PathPatternMatcher replaced: each pattern part is
+// expanded, case-folded and matched with wcsmatch on every call.
+bool ReferenceMatches(std::wstring_view path,
+                      std::wstring_view pattern,
+                      bool explicitOnly = false) {
+    if (pattern.empty()) {
+        return false;
+    }
+
+    std::wstring pathUpper{path};
+    ToUpperInPlace(pathUpper);
+
+    std::wstring_view pathFileNameUpper = pathUpper;
+    if (size_t i = pathFileNameUpper.rfind(L'\\');
+        i != pathFileNameUpper.npos) {
+        pathFileNameUpper.remove_prefix(i + 1);
+    }
+
+    for (const auto& patternPartView :
+         Functions::SplitStringToViews(pattern, L'|')) {
+        if (explicitOnly &&
+            patternPartView.find_first_of(L"*?") != patternPartView.npos) {
+            continue;
+        }
+
+        auto patternPart = std::wstring{patternPartView};
+
+#ifndef _WIN64
+        BOOL isWow64;
+        if (IsWow64Process(GetCurrentProcess(), &isWow64) && isWow64) {
+            patternPart =
+                Functions::ReplaceAll(patternPart, L"%ProgramFiles%",
+                                      L"%ProgramW6432%", /*ignoreCase=*/true);
+        }
+#endif  // _WIN64
+
+        auto patternPartNormalized =
+            wil::ExpandEnvironmentStrings<std::wstring>(patternPart.c_str());
+        ToUpperInPlace(patternPartNormalized);
+
+        std::wstring_view match = pathUpper;
+        if (patternPartNormalized.find(L'\\') == patternPartNormalized.npos) {
+            match = pathFileNameUpper;
+        }
+
+        if (Functions::wcsmatch(patternPartNormalized.data(),
+                                patternPartNormalized.length(), match.data(),
+                                match.length())) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Matches(std::wstring_view path,
+             std::wstring_view pattern,
+             bool explicitOnly = false) {
+    bool result = PathPatternMatcher(pattern).Matches(path, explicitOnly);
+    CHECK(result == ReferenceMatches(path, pattern, explicitOnly));
+    return result;
+}
+
+// Builds a string of random tokens, with at most `maxTokens` tokens.
+template <size_t N>
+std::wstring RandomString(std::mt19937& random,
+                          const std::array<PCWSTR, N>& tokens,
+                          int maxTokens) {
+    std::wstring result;
+    int tokenCount = std::uniform_int_distribution(0, maxTokens)(random);
+    for (int i = 0; i < tokenCount; i++) {
+        result += tokens[std::uniform_int_distribution<size_t>(0, N - 1)(
+            random)];
+    }
+
+    return result;
+}
+
+}  // namespace
+
+TEST_CASE(PathPatternMatcher_Matches) {
+    THROW_IF_WIN32_BOOL_FALSE(
+        SetEnvironmentVariable(kTestVariable, L"C:\\Dir"));
+    auto restoreVariable = wil::scope_exit(
+        [] { SetEnvironmentVariable(kTestVariable, nullptr); });
+
+    constexpr WCHAR kPath[] = L"C:\\Dir\\Sub\\App.exe";
+
+    CHECK(!Matches(kPath, L""));
+    CHECK(Matches(kPath, L"*"));
+    CHECK(Matches(kPath, L"**"));
+    CHECK(Matches(kPath, L"a*"));
+    CHECK(Matches(kPath, L"A??.EXE"));
+    CHECK(!Matches(kPath, L"A?.EXE"));
+    CHECK(Matches(kPath, L"c:\\dir\\sub\\app.exe"));
+    CHECK(Matches(kPath, L"other.exe|app.exe"));
+    CHECK(!Matches(kPath, L"other.exe|sub"));
+
+    // Patterns with a backslash are matched against the full path, others
+    // against the file name.
+    CHECK(Matches(kPath, L"C:\\*.exe"));
+    CHECK(Matches(kPath, L"*\\Sub\\*"));
+    CHECK(Matches(kPath, L"C:\\**app.exe"));
+    CHECK(!Matches(kPath, L"C:*"));
+    CHECK(!Matches(kPath, L"Sub\\App.exe"));
+    CHECK(!Matches(kPath, L"*Sub*"));
+
+    // Environment variables.
+    CHECK(Matches(kPath, L"%WINDHAWK_TEST_PATTERN_DIR%\\Sub\\App.exe"));
+    CHECK(Matches(kPath, L"%windhawk_test_pattern_dir%\\*"));
+    CHECK(!Matches(kPath, L"%WINDHAWK_TEST_PATTERN_DIR%\\App.exe"));
+    CHECK(!Matches(kPath, L"%WINDHAWK_TEST_PATTERN_MISSING%\\*"));
+
+    // Only patterns without wildcards are used for explicit matches.
+    CHECK(Matches(kPath, L"App.exe", true));
+    CHECK(Matches(kPath, L"*|App.exe", true));
+    CHECK(!Matches(kPath, L"*", true));
+    CHECK(!Matches(kPath, L"App.ex?", true));
+    CHECK(Matches(kPath, L"%WINDHAWK_TEST_PATTERN_DIR%\\Sub\\App.exe", true));
+}
+
+// Compares the matcher with the wcsmatch-based matching on random patterns
+// and paths made of a few tokens, so that the patterns often match.
+TEST_CASE(PathPatternMatcher_MatchesLikeWcsmatch) {
+    THROW_IF_WIN32_BOOL_FALSE(SetEnvironmentVariable(kTestVariable, L"a\\B"));
+    auto restoreVariable = wil::scope_exit(
+        [] { SetEnvironmentVariable(kTestVariable, nullptr); });
+
+    constexpr std::array<PCWSTR, 9> kPatternTokens = {
+        L"a",  L"B", L"\\", L"*", L"**", L"?", L"|", L"ab",
+        L"%WINDHAWK_TEST_PATTERN_DIR%",
+    };
+    constexpr std::array<PCWSTR, 5> kPathTokens = {
+        L"a", L"A", L"b", L"\\", L"ab",
+    };
+
+    std::mt19937 random(1);
+    for (int i = 0; i < 20000; i++) {
+        auto pattern = RandomString(random, kPatternTokens, 8);
+        auto path = RandomString(random, kPathTokens, 8);
+
+        PathPatternMatcher matcher(pattern);
+        PathPatternMatcher::Path preparedPath(path);
+        for (bool explicitOnly : {false, true}) {
+            if (matcher.Matches(preparedPath, explicitOnly) !=
+                ReferenceMatches(path, pattern, explicitOnly)) {
+                printf("  pattern: %S, path: %S, explicit only: %d\n",
+                       pattern.c_str(), path.c_str(), explicitOnly);
+                CHECK(false);
+            }
+        }
+    }
+}
+
+// The process lists which the injector matches every new process against,
+// when the corresponding settings are left at their defaults.
+BENCHMARK(PathPatternMatcher_ProcessLists) {
+    std::wstring pattern = std::wstring(ProcessLists::kCriticalProcesses) +
+                           L"|" + ProcessLists::kCriticalProcessesForMods +
+                           L"|" + ProcessLists::kIncompatiblePrograms + L"|" +
+                           ProcessLists::kGames;
+
+    TestFramework::Measure("Compile", 100,
+                           [&] { PathPatternMatcher matcher(pattern); });
+
+    PathPatternMatcher matcher(pattern);
+
+    for (PCWSTR path : {
+             L"C:\\Windows\\explorer.exe",
+             L"C:\\Program Files\\Epic Games\\Launcher\\Launcher.exe",
+         }) {
+        printf("  %S\n", path);
+
+        TestFramework::Measure("Matches", 10000,
+                               [&] { matcher.Matches(path); });
+
+        PathPatternMatcher::Path preparedPath(path);
+        TestFramework::Measure("Matches (prepared path)", 10000,
+                               [&] { matcher.Matches(preparedPath); });
+
+        TestFramework::Measure("wcsmatch for each pattern", 100,
+                               [&] { ReferenceMatches(path, pattern); });
+    }
+}
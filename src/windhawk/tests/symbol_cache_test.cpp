@@ -0,0 +1,126 @@
+#include "stdafx.h"
+
+#include "symbol_cache.h"
+#include "test_framework.h"
+
+namespace {
+
+constexpr DWORD kSizeOfImage = 0x1000;
+
+std::optional<ULONG_PTR> ParseOffset(std::wstring_view address,
+                                     DWORD sizeOfImage = kSizeOfImage) {
+    return SymbolCache::ParseAddressOffset(address, sizeOfImage);
+}
+
+// A cache string in the format written by the engine, with an offset for
+// each symbol except every tenth symbol, which is missing.
+std::wstring MakeCache(int entryCount, WCHAR separator) {
+    std::wstring cache = L"1";
+    cache += separator;
+    cache += L"twinui.pcshell.dll";
+    cache += separator;
+    cache += L"1700000000-8675328";
+    for (int i = 0; i < entryCount; i++) {
+        cache += separator;
+        cache += L"public: void __cdecl CMultitaskingViewManager::Method" +
+                 std::to_wstring(i) + L"(class CWindow *)";
+        cache += separator;
+        if (i % 10 != 9) {
+            cache += std::to_wstring(0x1000 + i * 16);
+        }
+    }
+
+    return cache;
+}
+
+}  // namespace
+
+TEST_CASE(SymbolCache_ParseAddressOffset) {
+    CHECK(ParseOffset(L"0") == 0);
+    CHECK(ParseOffset(L"4095") == 4095);
+    CHECK(ParseOffset(L"0004095") == 4095);
+
+    // SizeOfImage bounds.
+    CHECK(!ParseOffset(L"4096"));
+    CHECK(!ParseOffset(L"40950"));
+    CHECK(!ParseOffset(L"0", 0));
+    CHECK(ParseOffset(L"4294967294", MAXDWORD) == 4294967294);
+    CHECK(!ParseOffset(L"4294967295", MAXDWORD));
+
+    // Values which would overflow 32 and 64 bits if they weren't bounded by
+    // SizeOfImage.
+    CHECK(!ParseOffset(L"4294967296", MAXDWORD));
+    CHECK(!ParseOffset(L"42949672950", MAXDWORD));
+    CHECK(!ParseOffset(L"18446744073709551616", MAXDWORD));
+    CHECK(!ParseOffset(L"99999999999999999999999999999999", MAXDWORD));
+
+    // Only plain decimal numbers are accepted.
+    CHECK(!ParseOffset(L""));
+    CHECK(!ParseOffset(L" 1"));
+    CHECK(!ParseOffset(L"\t1"));
+    CHECK(!ParseOffset(L"1 "));
+    CHECK(!ParseOffset(L"+1"));
+    CHECK(!ParseOffset(L"-1"));
+    CHECK(!ParseOffset(L"1a"));
+    CHECK(!ParseOffset(L"0x10"));
+    CHECK(!ParseOffset(L"1.0"));
+    CHECK(!ParseOffset(L"1e3"));
+    CHECK(!ParseOffset(std::wstring_view(L"1\0" L"2", 3)));
+    // Fullwidth digits, which some number parsers accept.
+    CHECK(!ParseOffset(L"\uFF11"));
+}
+
+TEST_CASE(SymbolCache_Parse) {
+    auto entries = SymbolCache::Parse(L"1#mod.dll#1-4096#a#16#b##c#32",
+                                      L'#', kSizeOfImage);
+    CHECK(entries);
+    CHECK(entries->size() == 3);
+    CHECK((*entries)[0].symbol == L"a");
+    CHECK((*entries)[0].offset == 16);
+    CHECK((*entries)[1].symbol == L"b");
+    CHECK(!(*entries)[1].offset);
+    CHECK((*entries)[2].symbol == L"c");
+    CHECK((*entries)[2].offset == 32);
+
+    // Hybrid modules use a different separator.
+    entries =
+        SymbolCache::Parse(L"1;mod.dll;1-4096;a#b;16", L';', kSizeOfImage);
+    CHECK(entries && entries->size() == 1);
+    CHECK((*entries)[0].symbol == L"a#b");
+
+    // A trailing symbol without an offset part is ignored.
+    entries =
+        SymbolCache::Parse(L"1#mod.dll#1-4096#a#16#b", L'#', kSizeOfImage);
+    CHECK(entries && entries->size() == 1);
+
+    // Other versions and truncated headers have no entries.
+    for (PCWSTR cache : {L"", L"1", L"1#x", L"2#x#y#a#16", L"11#x#y#a#16"}) {
+        entries = SymbolCache::Parse(cache, L'#', kSizeOfImage);
+        CHECK(entries && entries->empty());
+    }
+
+    // A single invalid offset invalidates the whole cache.
+    for (PCWSTR cache : {L"1#x#y#a#16#b#4096", L"1#x#y#a#16#b#-1",
+                         L"1#x#y#a# 16", L"1#x#y#a#16#b#0x10"}) {
+        CHECK(!SymbolCache::Parse(cache, L'#', kSizeOfImage));
+    }
+}
+
+BENCHMARK(SymbolCache_ParseThroughput) {
+    constexpr DWORD kLargeSizeOfImage = 0x1000000;
+
+    for (int entryCount : {20, 5000}) {
+        std::wstring cache = MakeCache(entryCount, L'#');
+        printf("  %d entries, %zu KB\n", entryCount,
+               cache.length() * sizeof(WCHAR) / 1024);
+
+        int iterations = 200000 / entryCount;
+        TestFramework::Measure("SymbolCache::Parse", iterations, [&] {
+            SymbolCache::Parse(cache, L'#', kLargeSizeOfImage);
+        });
+    }
+
+    TestFramework::Measure("SymbolCache::ParseAddressOffset", 1000000, [&] {
+        SymbolCache::ParseAddressOffset(L"8675327", kLargeSizeOfImage);
+    });
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+// A minimal test framework. Tests and benchmarks register themselves at
+// startup and are run by main. Only the standard library is used, so that
+// tests of host-independent code can be built on any host.
+//
+// A failed check throws, which ends the test and marks it as failed.
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace TestFramework {
+
+using TestFunction = void (*)();
+
+struct TestCase {
+    const char* name;
+    TestFunction function;
+    bool isBenchmark;
+};
+
+inline std::vector<TestCase>& GetTestCases() {
+    static std::vector<TestCase> testCases;
+    return testCases;
+}
+
+struct Registrar {
+    Registrar(const char* name, TestFunction function, bool isBenchmark) {
+        GetTestCases().push_back({name, function, isBenchmark});
+    }
+};
+
+class CheckFailure : public std::runtime_error {
+   public:
+    using std::runtime_error::runtime_error;
+};
+
+[[noreturn]] inline void Fail(const char* file,
+                              int line,
+                              const char* expression) {
+    throw CheckFailure(std::string(file) + "(" + std::to_string(line) +
+                       "): check failed: " + expression);
+}
+
+// Measures the average duration of running `function` `iterations` times,
+// and prints it.
+template <typename Function>
+void Measure(const char* name, int iterations, Function&& function) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        function();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    double microseconds =
+        std::chrono::duration<double, std::micro>(elapsed).count() /
+        iterations;
+    printf("  %-48s %12.1f us\n", name, microseconds);
+}
+
+}  // namespace TestFramework
+
+#define TEST_FRAMEWORK_REGISTER(name, isBenchmark)                  \
+    static void name();                                             \
+    static TestFramework::Registrar name##Registrar(#name, name,    \
+                                                    isBenchmark); \
+    static void name()
+
+#define TEST_CASE(name) TEST_FRAMEWORK_REGISTER(name, false)
+#define BENCHMARK(name) TEST_FRAMEWORK_REGISTER(name, true)
+
+#define CHECK(expression)                                         \
+    do {                                                          \
+        if (!(expression)) {                                      \
+            TestFramework::Fail(__FILE__, __LINE__, #expression); \
+        }                                                         \
+    } while (0)
+
+#define CHECK_THROWS(expression)                                  \
+    do {                                                          \
+        bool threw = false;                                       \
+        try {                                                     \
+            (void)(expression);                                   \
+        } catch (const TestFramework::CheckFailure&) {            \
+            throw;                                                \
+        } catch (...) {                                           \
+            threw = true;                                         \
+        }                                                         \
+        if (!threw) {                                             \
+            TestFramework::Fail(__FILE__, __LINE__,               \
+                                "throws: " #expression);          \
+        }                                                         \
+    } while (0)
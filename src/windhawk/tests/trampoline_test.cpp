@@ -0,0 +1,439 @@
+#include "stdafx.h"
+
+#include "test_framework.h"
+
+// MinHook is only used on x86 and x64, ARM64 uses MinHook-Detours.
+#if defined(_M_IX86) || defined(_M_X64)
+
+extern "C" {
+#include "MinHook/include/MinHook.h"
+#include "MinHook/src/buffer.h"
+#include "MinHook/src/trampoline.h"
+}
+
+namespace {
+
+// An executable region for test code. A target function is written in the
+// first half of the region, surrounded by int3 padding, and its trampoline is
+// created in the second half, close enough for x64 RIP-relative operands.
+class CodeRegion {
+   public:
+    static constexpr size_t kSize = 0x1000;
+    static constexpr size_t kTargetOffset = 0x100;
+
+    CodeRegion()
+        : m_region(static_cast<BYTE*>(VirtualAlloc(nullptr, kSize,
+                                                   MEM_COMMIT | MEM_RESERVE,
+                                                   PAGE_EXECUTE_READWRITE))) {
+        THROW_LAST_ERROR_IF_NULL(m_region.get());
+        memset(m_region.get(), 0xCC, kSize);
+    }
+
+    BYTE* WriteTarget(std::initializer_list<BYTE> code) {
+        memset(m_region.get(), 0xCC, kSize);
+        BYTE* target = m_region.get() + kTargetOffset;
+        std::copy(code.begin(), code.end(), target);
+        return target;
+    }
+
+    BYTE* Trampoline() { return m_region.get() + kSize / 2; }
+
+    BYTE* At(size_t offset) { return m_region.get() + offset; }
+
+   private:
+    wil::unique_virtualalloc_ptr<BYTE> m_region;
+};
+
+std::optional<TRAMPOLINE> CreateTrampoline(CodeRegion& region, BYTE* target) {
+    TRAMPOLINE ct{};
+    ct.pTarget = target;
+    ct.pTrampoline = region.Trampoline();
+    ct.trampolineSize = MEMORY_SLOT_SIZE;
+    if (!CreateTrampolineFunction(&ct)) {
+        return std::nullopt;
+    }
+
+    return ct;
+}
+
+ULONG_PTR Address(const void* code) {
+    return reinterpret_cast<ULONG_PTR>(code);
+}
+
+// Returns the destination of a jump written by CreateTrampolineFunction or
+// CreateRelayFunction.
+ULONG_PTR JumpDestination(const BYTE* code) {
+    const auto* jmp = reinterpret_cast<const JMP_RELAY*>(code);
+#if defined(_M_X64)
+    CHECK(jmp->opcode0 == 0xFF && jmp->opcode1 == 0x25 && jmp->dummy == 0);
+    return jmp->address;
+#else
+    CHECK(jmp->opcode == 0xE9);
+    return Address(code) + sizeof(JMP_REL) +
+           static_cast<INT32>(jmp->operand);
+#endif
+}
+
+ULONG_PTR CallDestination(const BYTE* code) {
+#if defined(_M_X64)
+    // FF15 00000002: CALL [RIP+8], EB 08: JMP +10, and the address.
+    const auto* call = reinterpret_cast<const CALL_ABS*>(code);
+    CHECK(call->opcode0 == 0xFF && call->opcode1 == 0x15);
+    CHECK(call->dummy0 == 2 && call->dummy1 == 0xEB && call->dummy2 == 0x08);
+    return call->address;
+#else
+    const auto* call = reinterpret_cast<const CALL_REL*>(code);
+    CHECK(call->opcode == 0xE8);
+    return Address(code) + sizeof(CALL_REL) +
+           static_cast<INT32>(call->operand);
+#endif
+}
+
+// Returns the destination of a conditional jump, and checks that it's taken
+// on `condition`, the low nibble of the original Jcc opcode.
+ULONG_PTR ConditionalJumpDestination(const BYTE* code, UINT8 condition) {
+#if defined(_M_X64)
+    // The condition is inverted to skip an absolute jump, which follows the
+    // Jcc opcode and its operand.
+    const auto* jcc = reinterpret_cast<const JCC_ABS*>(code);
+    CHECK(jcc->opcode == (0x71 ^ condition) && jcc->dummy0 == 0x0E);
+    return JumpDestination(code + 2);
+#else
+    const auto* jcc = reinterpret_cast<const JCC_REL*>(code);
+    CHECK(jcc->opcode0 == 0x0F && jcc->opcode1 == (0x80 | condition));
+    return Address(code) + sizeof(JCC_REL) +
+           static_cast<INT32>(jcc->operand);
+#endif
+}
+
+#if defined(_M_X64)
+// Returns the address referenced by a RIP-relative instruction of `length`
+// bytes, which ends with an immediate of `immediateSize` bytes.
+ULONG_PTR RipRelativeAddress(const BYTE* code,
+                             size_t length,
+                             size_t immediateSize) {
+    INT32 displacement;
+    memcpy(&displacement, code + length - immediateSize - 4,
+           sizeof(displacement));
+    return Address(code) + length + displacement;
+}
+#endif
+
+// int __cdecl Add(int a, int b), with a prologue long enough to be hooked
+// without the hot patch area.
+#if defined(_M_X64)
+constexpr std::initializer_list<BYTE> kAddCode = {
+    0x48, 0x89, 0xC8,  // mov rax, rcx
+    0x48, 0x01, 0xD0,  // add rax, rdx
+    0xC3,              // ret
+};
+#else
+constexpr std::initializer_list<BYTE> kAddCode = {
+    0x8B, 0x44, 0x24, 0x04,  // mov eax, [esp+4]
+    0x03, 0x44, 0x24, 0x08,  // add eax, [esp+8]
+    0xC3,                    // ret
+};
+#endif
+
+using Add_t = int(__cdecl*)(int a, int b);
+
+Add_t Add_Original1;
+int __cdecl Add_Hook1(int a, int b) {
+    return Add_Original1(a, b) + 1;
+}
+
+Add_t Add_Original10;
+int __cdecl Add_Hook10(int a, int b) {
+    return Add_Original10(a, b) + 10;
+}
+
+MH_STATUS CreateAddHook(ULONG_PTR hookIdent,
+                        void* target,
+                        Add_t detour,
+                        Add_t* original) {
+    return MH_CreateHookEx(hookIdent, target, reinterpret_cast<void*>(detour),
+                           reinterpret_cast<void**>(original));
+}
+
+// Initializes MinHook for the duration of a test. Hooks which are still
+// enabled are removed on uninitialization.
+class MinHookScope {
+   public:
+    explicit MinHookScope(bool callCounting) {
+        CHECK(MH_Initialize() == MH_OK);
+        MH_SetCallCounting(callCounting);
+    }
+
+    ~MinHookScope() { MH_Uninitialize(); }
+
+    MinHookScope(const MinHookScope&) = delete;
+    MinHookScope& operator=(const MinHookScope&) = delete;
+};
+
+}  // namespace
+
+#if defined(_M_X64)
+TEST_CASE(MinHook_TrampolineRipRelative) {
+    CodeRegion region;
+
+    // mov rax, [rip+0x10]
+    BYTE* target = region.WriteTarget({0x48, 0x8B, 0x05, 0x10, 0, 0, 0});
+    auto ct = CreateTrampoline(region, target);
+    CHECK(ct);
+    BYTE* trampoline = region.Trampoline();
+    CHECK(ct->nIP == 2 && !ct->patchAbove);
+    CHECK(ct->oldIPs[1] == 7 && ct->newIPs[1] == 7);
+    CHECK(memcmp(trampoline, target, 3) == 0);
+    CHECK(RipRelativeAddress(trampoline, 7, 0) ==
+          RipRelativeAddress(target, 7, 0));
+    CHECK(JumpDestination(trampoline + 7) == Address(target + 7));
+
+    // mov qword ptr [rip+0x20], 0x12345678
+    target = region.WriteTarget(
+        {0x48, 0xC7, 0x05, 0x20, 0, 0, 0, 0x78, 0x56, 0x34, 0x12});
+    ct = CreateTrampoline(region, target);
+    CHECK(ct);
+    CHECK(ct->nIP == 2 && ct->newIPs[1] == 11);
+    CHECK(RipRelativeAddress(trampoline, 11, 4) ==
+          RipRelativeAddress(target, 11, 4));
+    CHECK(memcmp(trampoline + 7, target + 7, 4) == 0);
+
+    // jmp [rip+0x100], an import thunk, which ends the trampoline without a
+    // jump back.
+    target = region.WriteTarget({0xFF, 0x25, 0x00, 0x01, 0, 0});
+    ct = CreateTrampoline(region, target);
+    CHECK(ct);
+    CHECK(ct->nIP == 1);
+    CHECK(RipRelativeAddress(trampoline, 6, 0) ==
+          RipRelativeAddress(target, 6, 0));
+    CHECK(trampoline[6] == 0xCC);
+}
+#endif
+
+TEST_CASE(MinHook_TrampolineCall) {
+    CodeRegion region;
+
+    // call +0x100
+    BYTE* target = region.WriteTarget({0xE8, 0x00, 0x01, 0, 0, 0xC3});
+    auto ct = CreateTrampoline(region, target);
+    CHECK(ct);
+    BYTE* trampoline = region.Trampoline();
+    CHECK(ct->nIP == 2 && ct->oldIPs[1] == 5);
+    CHECK(CallDestination(trampoline) == Address(target + 5 + 0x100));
+    CHECK(JumpDestination(trampoline + ct->newIPs[1]) == Address(target + 5));
+}
+
+TEST_CASE(MinHook_TrampolineConditionalJump) {
+    CodeRegion region;
+
+    // test ecx, ecx; nop; je +0x20
+    BYTE* target = region.WriteTarget({0x85, 0xC9, 0x90, 0x74, 0x20, 0xC3});
+    auto ct = CreateTrampoline(region, target);
+    CHECK(ct);
+    BYTE* trampoline = region.Trampoline();
+    CHECK(ct->nIP == 4);
+    CHECK(ct->oldIPs[2] == 3 && ct->oldIPs[3] == 5);
+    CHECK(ct->newIPs[2] == 3);
+    CHECK(memcmp(trampoline, target, 3) == 0);
+    CHECK(ConditionalJumpDestination(trampoline + 3, 0x4) ==
+          Address(target + 5 + 0x20));
+    CHECK(JumpDestination(trampoline + ct->newIPs[3]) == Address(target + 5));
+
+    // loop +0x20 can't be relocated.
+    target = region.WriteTarget({0x85, 0xC9, 0x90, 0xE2, 0x20, 0xC3});
+    CHECK(!CreateTrampoline(region, target));
+}
+
+TEST_CASE(MinHook_TrampolineInternalJump) {
+    CodeRegion region;
+
+    // je +1; nop; nop; xor eax, eax. The jump stays within the patched
+    // bytes, so it's copied as is.
+    BYTE* target =
+        region.WriteTarget({0x74, 0x01, 0x90, 0x90, 0x31, 0xC0, 0xC3});
+    auto ct = CreateTrampoline(region, target);
+    CHECK(ct);
+    BYTE* trampoline = region.Trampoline();
+    CHECK(ct->nIP == 5);
+    CHECK(memcmp(ct->oldIPs, ct->newIPs, ct->nIP) == 0);
+    CHECK(memcmp(trampoline, target, 6) == 0);
+    CHECK(JumpDestination(trampoline + 6) == Address(target + 6));
+}
+
+TEST_CASE(MinHook_TrampolinePatchAbove) {
+    CodeRegion region;
+
+    // jmp +0x30, followed by padding which can be overwritten.
+    BYTE* target = region.WriteTarget({0xEB, 0x30});
+    auto ct = CreateTrampoline(region, target);
+    CHECK(ct);
+    CHECK(ct->nIP == 1 && !ct->patchAbove);
+    CHECK(JumpDestination(region.Trampoline()) ==
+          Address(target + 2 + 0x30));
+
+    // Followed by code, the long jump is placed in the padding above.
+    target = region.WriteTarget({0xEB, 0x30, 0xC3, 0xC3, 0xC3});
+    ct = CreateTrampoline(region, target);
+    CHECK(ct);
+    CHECK(ct->patchAbove);
+
+    // No padding above.
+    target[-1] = 0xC3;
+    CHECK(!CreateTrampoline(region, target));
+
+    // ret, too short even for a short jump.
+    target = region.WriteTarget({0xC3, 0xC3});
+    CHECK(!CreateTrampoline(region, target));
+
+    target = region.WriteTarget({0xC3});
+    ct = CreateTrampoline(region, target);
+    CHECK(ct);
+    CHECK(ct->nIP == 1 && !ct->patchAbove);
+    CHECK(region.Trampoline()[0] == 0xC3);
+}
+
+TEST_CASE(MinHook_Relays) {
+    CodeRegion region;
+    BYTE* relay = region.At(0x200);
+    BYTE* detour = region.At(0x300);
+
+    CreateRelayFunction(reinterpret_cast<PJMP_RELAY>(relay), detour);
+    CHECK(JumpDestination(relay) == Address(detour));
+
+    auto* countingRelay = reinterpret_cast<PCOUNTING_RELAY>(relay);
+    auto* callCount = reinterpret_cast<UINT64*>(region.At(0x400));
+    CHECK(CreateCountingRelayFunction(countingRelay, callCount, detour));
+    CHECK(JumpDestination(reinterpret_cast<const BYTE*>(&countingRelay->jmp)) ==
+          Address(detour));
+#if defined(_M_X64)
+    // F0 48 FF 05 xxxxxxxx: LOCK INC QWORD PTR [RIP+8+xxxxxxxx]
+    CHECK(memcmp(relay, "\xF0\x48\xFF\x05", 4) == 0);
+    CHECK(Address(relay) + 8 + static_cast<INT32>(countingRelay->operand) ==
+          Address(callCount));
+
+    // A counter out of the operand's range.
+    auto* farCallCount =
+        reinterpret_cast<UINT64*>(Address(relay) + 0x100000000);
+    memset(relay, 0xCC, sizeof(COUNTING_RELAY));
+    CHECK(!CreateCountingRelayFunction(countingRelay, farCallCount, detour));
+    CHECK(relay[0] == 0xCC);
+#else
+    // F0 83 05 xxxxxxxx 01: LOCK ADD DWORD PTR [xxxxxxxx], 1
+    // 73 07: JNC +9
+    // F0 FF 05 xxxxxxxx: LOCK INC DWORD PTR [xxxxxxxx]
+    CHECK(memcmp(relay, "\xF0\x83\x05", 3) == 0);
+    CHECK(countingRelay->operand0 == Address(callCount));
+    CHECK(countingRelay->imm0 == 0x01);
+    CHECK(countingRelay->opcode3 == 0x73 && countingRelay->imm1 == 0x07);
+    CHECK(memcmp(&countingRelay->opcode4, "\xF0\xFF\x05", 3) == 0);
+    CHECK(countingRelay->operand1 == Address(callCount) + 4);
+#endif
+}
+
+TEST_CASE(MinHook_CallCounting) {
+    CodeRegion region;
+    BYTE* target = region.WriteTarget(kAddCode);
+    auto add = reinterpret_cast<Add_t>(target);
+    MinHookScope minHook(/*callCounting=*/true);
+
+    CHECK(CreateAddHook(1, target, Add_Hook1, &Add_Original1) == MH_OK);
+    CHECK(add(2, 3) == 5);
+
+    CHECK(MH_EnableHookEx(1, target) == MH_OK);
+    for (int i = 0; i < 100; i++) {
+        CHECK(add(i, 1) == i + 2);
+    }
+
+    UINT64 callCount = 0;
+    CHECK(MH_GetCallCount(1, target, &callCount) == MH_OK);
+    CHECK(callCount == 100);
+
+    CHECK(MH_DisableHookEx(1, target) == MH_OK);
+    CHECK(add(2, 3) == 5);
+    CHECK(MH_GetCallCount(1, target, &callCount) == MH_OK);
+    CHECK(callCount == 100);
+
+    // Hooks created while call counting is disabled have no counter.
+    MH_SetCallCounting(FALSE);
+    CHECK(CreateAddHook(2, target, Add_Hook10, &Add_Original10) == MH_OK);
+    CHECK(MH_GetCallCount(2, target, &callCount) ==
+          MH_ERROR_UNSUPPORTED_FUNCTION);
+}
+
+TEST_CASE(MinHook_ChainedHooks) {
+    CodeRegion region;
+    BYTE* target = region.WriteTarget(kAddCode);
+    auto add = reinterpret_cast<Add_t>(target);
+    MinHookScope minHook(/*callCounting=*/false);
+
+    CHECK(CreateAddHook(1, target, Add_Hook1, &Add_Original1) == MH_OK);
+    CHECK(CreateAddHook(2, target, Add_Hook10, &Add_Original10) == MH_OK);
+
+    // The trampoline of the second hook relocates the jump of the first one.
+    CHECK(MH_EnableHookEx(1, target) == MH_OK);
+    CHECK(MH_EnableHookEx(2, target) == MH_OK);
+    CHECK(add(2, 3) == 16);
+
+    // Disabling a hook below another one rehooks the one above it.
+    CHECK(MH_DisableHookEx(1, target) == MH_OK);
+    CHECK(add(2, 3) == 15);
+
+    CHECK(MH_EnableHookEx(1, target) == MH_OK);
+    CHECK(add(2, 3) == 16);
+
+    CHECK(MH_DisableHookEx(2, target) == MH_OK);
+    CHECK(add(2, 3) == 6);
+
+    CHECK(MH_DisableHookEx(1, target) == MH_OK);
+    CHECK(add(2, 3) == 5);
+    CHECK(memcmp(target, kAddCode.begin(), kAddCode.size()) == 0);
+}
+
+// The cost of a call to a hooked function: the jump to the relay, the relay,
+// the detour, and the call of the original function through the trampoline.
+BENCHMARK(MinHook_CallOverhead) {
+    constexpr int kCalls = 1000;
+
+    CodeRegion region;
+    BYTE* target = region.WriteTarget(kAddCode);
+    auto add = reinterpret_cast<Add_t>(target);
+
+    auto measure = [&](const char* name) {
+        TestFramework::Measure(name, 1000, [&] {
+            int sum = 0;
+            for (int i = 0; i < kCalls; i++) {
+                sum += add(i, 1);
+            }
+            CHECK(sum != 0);
+        });
+    };
+
+    printf("  times are per %d calls\n", kCalls);
+
+    measure("Not hooked");
+
+    {
+        MinHookScope minHook(/*callCounting=*/false);
+        CHECK(CreateAddHook(1, target, Add_Hook1, &Add_Original1) == MH_OK);
+        CHECK(CreateAddHook(2, target, Add_Hook10, &Add_Original10) == MH_OK);
+
+        CHECK(MH_EnableHookEx(1, target) == MH_OK);
+        measure("Hooked");
+
+        CHECK(MH_EnableHookEx(2, target) == MH_OK);
+        measure("Hooked twice (chained)");
+
+        CHECK(MH_DisableHookEx(2, target) == MH_OK);
+        CHECK(MH_DisableHookEx(1, target) == MH_OK);
+        measure("Hooks disabled");
+    }
+
+    {
+        MinHookScope minHook(/*callCounting=*/true);
+        CHECK(CreateAddHook(1, target, Add_Hook1, &Add_Original1) == MH_OK);
+        CHECK(MH_EnableHookEx(1, target) == MH_OK);
+        measure("Hooked, with call counting");
+    }
+}
+
+#endif  // defined(_M_IX86) || defined(_M_X64)